@@ -8,16 +8,23 @@
 
 #if !_WIN32
 #include <time.h>					// for Linux version of GetTickCount()
+#include <sys/mman.h>				// for mmap()
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #if VSTUDIO_INTEGRATION
-#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
 #define _WIN32_WINDOWS 0x0500		// for IsDebuggerPresent()
-#include <windows.h>
-#endif // VSTUDIO_INTEGRATION
+#endif
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>				// for IsDebuggerPresent() and file mapping
+#endif
 
 
 static FILE *GLogFile = NULL;
+static FILE *GConsoleStream = NULL;
 
 void appOpenLogFile(const char *filename)
 {
@@ -28,6 +35,12 @@ void appOpenLogFile(const char *filename)
 		appPrintf("Unable to open log \"%s\"\n", filename);
 }
 
+void appSetConsoleStream(FILE *stream)
+{
+	fflush(GConsoleStream ? GConsoleStream : stdout);
+	GConsoleStream = stream;
+}
+
 
 void appPrintf(const char *fmt, ...)
 {
@@ -38,7 +51,7 @@ void appPrintf(const char *fmt, ...)
 	va_end(argptr);
 	if (len < 0 || len >= ARRAY_COUNT(buf) - 1) appError("appPrintf: buffer overflow");
 
-	fwrite(buf, len, 1, stdout);
+	fwrite(buf, len, 1, GConsoleStream ? GConsoleStream : stdout);
 	if (GLogFile) fwrite(buf, len, 1, GLogFile);
 
 #if VSTUDIO_INTEGRATION
@@ -182,6 +195,13 @@ void appUnwindThrow(const char *fmt, ...)
 	THROW;
 }
 
+void appResetError()
+{
+	GErrorHistory[0] = 0;
+	WasError = false;
+	GIsSwError = false;
+}
+
 #endif // DO_GUARD
 
 
@@ -478,6 +498,527 @@ bool appContainsWildcard(const char *string)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Fast number formatting
+-----------------------------------------------------------------------------*/
+
+int appFormatInt(char* buf, int64 Value)
+{
+	char tmp[24];
+	char* end = tmp + sizeof(tmp);
+	char* s = end;
+	uint64 v = (Value < 0) ? 0 - (uint64)Value : Value;
+	do
+	{
+		*--s = '0' + int(v % 10);
+		v /= 10;
+	} while (v);
+	if (Value < 0) *--s = '-';
+	int len = end - s;
+	memcpy(buf, s, len);
+	buf[len] = 0;
+	return len;
+}
+
+// Shortest float to decimal conversion, based on Ryu algorithm by Ulf Adams
+// (https://github.com/ulfjack/ryu, Apache 2.0 or Boost license).
+
+#define FLOAT_POW5_INV_BITCOUNT		59
+#define FLOAT_POW5_BITCOUNT			61
+
+static const uint64 FloatPow5InvSplit[31] =
+{
+	0x0800000000000001ULL, 0x0666666666666667ULL, 0x051EB851EB851EB9ULL,
+	0x04189374BC6A7EFAULL, 0x068DB8BAC710CB2AULL, 0x053E2D6238DA3C22ULL,
+	0x0431BDE82D7B634EULL, 0x06B5FCA6AF2BD216ULL, 0x055E63B88C230E78ULL,
+	0x044B82FA09B5A52DULL, 0x06DF37F675EF6EAEULL, 0x057F5FF85E592558ULL,
+	0x0465E6604B7A8447ULL, 0x0709709A125DA071ULL, 0x05A126E1A84AE6C1ULL,
+	0x0480EBE7B9D58567ULL, 0x0734ACA5F6226F0BULL, 0x05C3BD5191B525A3ULL,
+	0x049C97747490EAE9ULL, 0x0760F253EDB4AB0EULL, 0x05E72843249088D8ULL,
+	0x04B8ED0283A6D3E0ULL, 0x078E480405D7B966ULL, 0x060B6CD004AC9452ULL,
+	0x04D5F0A66A23A9DBULL, 0x07BCB43D769F762BULL, 0x063090312BB2C4EFULL,
+	0x04F3A68DBC8F03F3ULL, 0x07EC3DAF94180651ULL, 0x065697BFA9ACD1DAULL,
+	0x051212FFBAF0A7E2ULL,
+};
+
+static const uint64 FloatPow5Split[47] =
+{
+	0x1000000000000000ULL, 0x1400000000000000ULL, 0x1900000000000000ULL,
+	0x1F40000000000000ULL, 0x1388000000000000ULL, 0x186A000000000000ULL,
+	0x1E84800000000000ULL, 0x1312D00000000000ULL, 0x17D7840000000000ULL,
+	0x1DCD650000000000ULL, 0x12A05F2000000000ULL, 0x174876E800000000ULL,
+	0x1D1A94A200000000ULL, 0x12309CE540000000ULL, 0x16BCC41E90000000ULL,
+	0x1C6BF52634000000ULL, 0x11C37937E0800000ULL, 0x16345785D8A00000ULL,
+	0x1BC16D674EC80000ULL, 0x1158E460913D0000ULL, 0x15AF1D78B58C4000ULL,
+	0x1B1AE4D6E2EF5000ULL, 0x10F0CF064DD59200ULL, 0x152D02C7E14AF680ULL,
+	0x1A784379D99DB420ULL, 0x108B2A2C28029094ULL, 0x14ADF4B7320334B9ULL,
+	0x19D971E4FE8401E7ULL, 0x1027E72F1F128130ULL, 0x1431E0FAE6D7217CULL,
+	0x193E5939A08CE9DBULL, 0x1F8DEF8808B02452ULL, 0x13B8B5B5056E16B3ULL,
+	0x18A6E32246C99C60ULL, 0x1ED09BEAD87C0378ULL, 0x13426172C74D822BULL,
+	0x1812F9CF7920E2B6ULL, 0x1E17B84357691B64ULL, 0x12CED32A16A1B11EULL,
+	0x178287F49C4A1D66ULL, 0x1D6329F1C35CA4BFULL, 0x125DFA371A19E6F7ULL,
+	0x16F578C4E0A060B5ULL, 0x1CB2D6F618C878E3ULL, 0x11EFC659CF7D4B8DULL,
+	0x166BB7F0435C9E71ULL, 0x1C06A5EC5433C60DULL,
+};
+
+// ceil(log2(5^e))
+static FORCEINLINE int Pow5Bits(int e)
+{
+	return ((unsigned)e * 1217359 >> 19) + 1;
+}
+
+// floor(log10(2^e))
+static FORCEINLINE int Log10Pow2(int e)
+{
+	return (unsigned)e * 78913 >> 18;
+}
+
+// floor(log10(5^e))
+static FORCEINLINE int Log10Pow5(int e)
+{
+	return (unsigned)e * 732923 >> 20;
+}
+
+static FORCEINLINE bool MultipleOfPowerOf5(uint32 Value, int p)
+{
+	int count = 0;
+	while (Value % 5 == 0)
+	{
+		Value /= 5;
+		count++;
+	}
+	return count >= p;
+}
+
+static FORCEINLINE bool MultipleOfPowerOf2(uint32 Value, int p)
+{
+	return (Value & ((1u << p) - 1)) == 0;
+}
+
+static FORCEINLINE uint32 MulShift(uint32 m, uint64 Factor, int Shift)
+{
+	uint64 bits0 = (uint64)m * (uint32)Factor;
+	uint64 bits1 = (uint64)m * (uint32)(Factor >> 32);
+	uint64 sum = (bits0 >> 32) + bits1;
+	return (uint32)(sum >> (Shift - 32));
+}
+
+// Compute shortest decimal Digits * 10^Exponent which is parsed back to the same finite float value
+static void FloatToDecimal(uint32 Mantissa, int BiasedExponent, uint32& OutDigits, int& OutExponent)
+{
+	int e2;
+	uint32 m2;
+	if (BiasedExponent == 0)
+	{
+		e2 = 1 - 127 - 23 - 2;
+		m2 = Mantissa;
+	}
+	else
+	{
+		e2 = BiasedExponent - 127 - 23 - 2;
+		m2 = (1u << 23) | Mantissa;
+	}
+	bool acceptBounds = (m2 & 1) == 0;
+
+	// Step 2: determine the interval of valid decimal representations
+	uint32 mv = 4 * m2;
+	uint32 mp = 4 * m2 + 2;
+	uint32 mmShift = (Mantissa != 0 || BiasedExponent <= 1) ? 1 : 0;
+	uint32 mm = 4 * m2 - 1 - mmShift;
+
+	// Step 3: convert to a decimal power base
+	uint32 vr, vp, vm;
+	int e10;
+	bool vmIsTrailingZeros = false;
+	bool vrIsTrailingZeros = false;
+	uint32 lastRemovedDigit = 0;
+	if (e2 >= 0)
+	{
+		int q = Log10Pow2(e2);
+		e10 = q;
+		int k = FLOAT_POW5_INV_BITCOUNT + Pow5Bits(q) - 1;
+		int i = -e2 + q + k;
+		vr = MulShift(mv, FloatPow5InvSplit[q], i);
+		vp = MulShift(mp, FloatPow5InvSplit[q], i);
+		vm = MulShift(mm, FloatPow5InvSplit[q], i);
+		if (q != 0 && (vp - 1) / 10 <= vm / 10)
+		{
+			// We need to know one removed digit even if we are not going to loop below
+			int l = FLOAT_POW5_INV_BITCOUNT + Pow5Bits(q - 1) - 1;
+			lastRemovedDigit = MulShift(mv, FloatPow5InvSplit[q - 1], -e2 + q - 1 + l) % 10;
+		}
+		if (q <= 9)
+		{
+			// The largest power of 5 that fits in 24 bits is 5^10, but q <= 9 seems to be safe as well.
+			// Only one of mp, mv, and mm can be a multiple of 5, if any.
+			if (mv % 5 == 0)
+				vrIsTrailingZeros = MultipleOfPowerOf5(mv, q);
+			else if (acceptBounds)
+				vmIsTrailingZeros = MultipleOfPowerOf5(mm, q);
+			else
+				vp -= MultipleOfPowerOf5(mp, q);
+		}
+	}
+	else
+	{
+		int q = Log10Pow5(-e2);
+		e10 = q + e2;
+		int i = -e2 - q;
+		int k = Pow5Bits(i) - FLOAT_POW5_BITCOUNT;
+		int j = q - k;
+		vr = MulShift(mv, FloatPow5Split[i], j);
+		vp = MulShift(mp, FloatPow5Split[i], j);
+		vm = MulShift(mm, FloatPow5Split[i], j);
+		if (q != 0 && (vp - 1) / 10 <= vm / 10)
+		{
+			j = q - 1 - (Pow5Bits(i + 1) - FLOAT_POW5_BITCOUNT);
+			lastRemovedDigit = MulShift(mv, FloatPow5Split[i + 1], j) % 10;
+		}
+		if (q <= 1)
+		{
+			// {vr,vp,vm} is trailing zeros if {mv,mp,mm} has at least q trailing 0 bits.
+			// mv = 4 * m2, so it always has at least two trailing 0 bits.
+			vrIsTrailingZeros = true;
+			if (acceptBounds)
+				vmIsTrailingZeros = (mmShift == 1);		// mm = mv - 1 - mmShift, so it has 1 trailing 0 bit iff mmShift == 1
+			else
+				vp--;									// mp = mv + 2, so it always has at least one trailing 0 bit
+		}
+		else if (q < 31)
+		{
+			vrIsTrailingZeros = MultipleOfPowerOf2(mv, q - 1);
+		}
+	}
+
+	// Step 4: find the shortest decimal representation in the interval of valid representations
+	int removed = 0;
+	uint32 output;
+	if (vmIsTrailingZeros || vrIsTrailingZeros)
+	{
+		// General case, which happens rarely (~4.0%)
+		while (vp / 10 > vm / 10)
+		{
+			vmIsTrailingZeros &= (vm % 10 == 0);
+			vrIsTrailingZeros &= (lastRemovedDigit == 0);
+			lastRemovedDigit = vr % 10;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		if (vmIsTrailingZeros)
+		{
+			while (vm % 10 == 0)
+			{
+				vrIsTrailingZeros &= (lastRemovedDigit == 0);
+				lastRemovedDigit = vr % 10;
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed++;
+			}
+		}
+		if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+		{
+			// Round even if the exact number is .....50..0
+			lastRemovedDigit = 4;
+		}
+		// We need to take vr + 1 if vr is outside bounds or we need to round up
+		output = vr + (((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5) ? 1 : 0);
+	}
+	else
+	{
+		// Specialized for the common case (~96.0%)
+		while (vp / 10 > vm / 10)
+		{
+			lastRemovedDigit = vr % 10;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		output = vr + ((vr == vm || lastRemovedDigit >= 5) ? 1 : 0);
+	}
+
+	OutDigits = output;
+	OutExponent = e10 + removed;
+}
+
+int appFormatFloat(char* buf, float Value)
+{
+	uint32 bits;
+	memcpy(&bits, &Value, sizeof(bits));
+	uint32 Mantissa = bits & ((1u << 23) - 1);
+	int BiasedExponent = (bits >> 23) & 0xFF;
+	bool bNegative = (bits >> 31) != 0;
+
+	char* s = buf;
+	if (BiasedExponent == 0xFF)
+	{
+		strcpy(s, Mantissa ? "nan" : (bNegative ? "-inf" : "inf"));
+		return strlen(buf);
+	}
+	if (bNegative) *s++ = '-';
+	if (BiasedExponent == 0 && Mantissa == 0)
+	{
+		*s++ = '0';
+		*s = 0;
+		return s - buf;
+	}
+
+	uint32 Digits;
+	int Exponent;
+	FloatToDecimal(Mantissa, BiasedExponent, Digits, Exponent);
+
+	// Convert digits to text
+	char DigitBuf[16];
+	int NumDigits = appFormatInt(DigitBuf, Digits);
+	// Position of decimal point relative to the first digit
+	int PointPos = NumDigits + Exponent;
+
+	if (PointPos > 16 || PointPos < -4)
+	{
+		// Use scientific notation: d.ddde+XX
+		*s++ = DigitBuf[0];
+		if (NumDigits > 1)
+		{
+			*s++ = '.';
+			memcpy(s, DigitBuf + 1, NumDigits - 1);
+			s += NumDigits - 1;
+		}
+		int Exp10 = PointPos - 1;
+		*s++ = 'e';
+		*s++ = (Exp10 < 0) ? '-' : '+';
+		if (Exp10 < 0) Exp10 = -Exp10;
+		if (Exp10 < 10) *s++ = '0';
+		s += appFormatInt(s, Exp10);
+		return s - buf;
+	}
+
+	if (PointPos <= 0)
+	{
+		// 0.000ddd
+		*s++ = '0';
+		*s++ = '.';
+		memset(s, '0', -PointPos);
+		s += -PointPos;
+		memcpy(s, DigitBuf, NumDigits);
+		s += NumDigits;
+	}
+	else if (PointPos >= NumDigits)
+	{
+		// ddd000
+		memcpy(s, DigitBuf, NumDigits);
+		s += NumDigits;
+		memset(s, '0', PointPos - NumDigits);
+		s += PointPos - NumDigits;
+	}
+	else
+	{
+		// dd.ddd
+		memcpy(s, DigitBuf, PointPos);
+		s += PointPos;
+		*s++ = '.';
+		memcpy(s, DigitBuf + PointPos, NumDigits - PointPos);
+		s += NumDigits - PointPos;
+	}
+	*s = 0;
+	return s - buf;
+}
+
+int appFormatFixed(char* buf, double Value, int Decimals)
+{
+	static const double Pow10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12
+	};
+	// Fast path: scaling a float value by 10^Decimals is exact in double precision
+	// when Decimals <= 12, so rounding to integer gives the same result as printf.
+	if (Decimals >= 0 && Decimals < ARRAY_COUNT(Pow10) && (double)(float)Value == Value)
+	{
+		double Scaled = fabs(Value) * Pow10[Decimals];
+		if (Scaled < 9007199254740992.0)		// 2^53
+		{
+			uint64 v = (uint64)nearbyint(Scaled);
+			uint64 Div = (uint64)Pow10[Decimals];
+			char* s = buf;
+			if (signbit(Value)) *s++ = '-';
+			s += appFormatInt(s, int64(v / Div));
+			if (Decimals)
+			{
+				*s++ = '.';
+				uint64 Frac = v % Div;
+				for (int i = Decimals - 1; i >= 0; i--)
+				{
+					s[i] = '0' + int(Frac % 10);
+					Frac /= 10;
+				}
+				s += Decimals;
+			}
+			*s = 0;
+			return s - buf;
+		}
+	}
+	// Slow path
+	return snprintf(buf, 64, "%.*f", Decimals, Value);
+}
+
+int appFormatV(char* dest, int size, const char* fmt, va_list args)
+{
+	// Make a copy of args in a case we'll fall back to vsnprintf
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+
+	char* d = dest;
+	char* end = dest + size - 1;
+	char numBuf[64];
+
+	const char* s = fmt;
+	while (*s)
+	{
+		if (*s != '%')
+		{
+			if (d >= end) goto overflow;
+			*d++ = *s++;
+			continue;
+		}
+		// Parse format specification, only precision is supported
+		s++;
+		int Precision = -1;
+		if (*s == '.')
+		{
+			s++;
+			Precision = 0;
+			while (*s >= '0' && *s <= '9')
+				Precision = Precision * 10 + *s++ - '0';
+		}
+		const char* Str;
+		int len;
+		switch (*s++)
+		{
+		case 'd':
+		case 'i':
+			if (Precision >= 0) goto fallback;
+			len = appFormatInt(numBuf, va_arg(args, int));
+			Str = numBuf;
+			break;
+		case 'u':
+			if (Precision >= 0) goto fallback;
+			len = appFormatInt(numBuf, va_arg(args, unsigned));
+			Str = numBuf;
+			break;
+		case 's':
+			if (Precision >= 0) goto fallback;
+			Str = va_arg(args, const char*);
+			if (!Str) Str = "(null)";
+			len = strlen(Str);
+			break;
+		case 'c':
+			if (Precision >= 0) goto fallback;
+			numBuf[0] = (char)va_arg(args, int);
+			Str = numBuf;
+			len = 1;
+			break;
+		case 'f':
+			{
+				double v = va_arg(args, double);
+				// Large values (and NaN) are passed to printf
+				if (!(fabs(v) < 1e30) || Precision > 30) goto fallback;
+				len = appFormatFixed(numBuf, v, (Precision >= 0) ? Precision : 6);
+				Str = numBuf;
+			}
+			break;
+		case 'g':
+			{
+				if (Precision >= 0) goto fallback;
+				double v = va_arg(args, double);
+				// Values which are not representable as float are passed to printf
+				if ((double)(float)v != v && v == v) goto fallback;
+				len = appFormatFloat(numBuf, (float)v);
+				Str = numBuf;
+			}
+			break;
+		case '%':
+			Str = "%";
+			len = 1;
+			break;
+		default:
+			goto fallback;
+		}
+		if (d + len > end) goto overflow;
+		memcpy(d, Str, len);
+		d += len;
+	}
+	*d = 0;
+	va_end(argsCopy);
+	return d - dest;
+
+overflow:
+	*d = 0;
+	va_end(argsCopy);
+	return -1;
+
+fallback:
+	// Format specification is not supported, use standard function
+	int result = vsnprintf(dest, size, fmt, argsCopy);
+	va_end(argsCopy);
+	return result;
+}
+
+int appFormat(char* dest, int size, const char* fmt, ...)
+{
+	va_list	argptr;
+	va_start(argptr, fmt);
+	int len = appFormatV(dest, size, fmt, argptr);
+	va_end(argptr);
+	return len;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Hashing
+-----------------------------------------------------------------------------*/
+
+// Based on MurmurHash64A (public domain)
+uint64 appMemHash64(const void* Data, int Size, uint64 Seed)
+{
+	const uint64 M = 0xC6A4A7935BD1E995ULL;
+	const int R = 47;
+
+	uint64 Hash = Seed ^ (Size * M);
+
+	const byte* p = (const byte*)Data;
+	const byte* end = p + (Size & ~7);
+	for ( ; p < end; p += 8)
+	{
+		uint64 k;
+		memcpy(&k, p, 8);			// unaligned load
+		k *= M;
+		k ^= k >> R;
+		k *= M;
+		Hash ^= k;
+		Hash *= M;
+	}
+
+	switch (Size & 7)
+	{
+	case 7: Hash ^= uint64(p[6]) << 48;
+	case 6: Hash ^= uint64(p[5]) << 40;
+	case 5: Hash ^= uint64(p[4]) << 32;
+	case 4: Hash ^= uint64(p[3]) << 24;
+	case 3: Hash ^= uint64(p[2]) << 16;
+	case 2: Hash ^= uint64(p[1]) << 8;
+	case 1: Hash ^= uint64(p[0]);
+		Hash *= M;
+	}
+
+	Hash ^= Hash >> R;
+	Hash *= M;
+	Hash ^= Hash >> R;
+	return Hash;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Command line helpers
 -----------------------------------------------------------------------------*/
@@ -656,6 +1197,60 @@ unsigned appGetFileType(const char *filename)
 	return 0;						// just in case ... (may be, win32 have other file types?)
 }
 
+const void* appMapFile(const char *filename, size_t& OutSize)
+{
+	guard(appMapFile);
+
+	OutSize = 0;
+	const void* Data = NULL;
+
+#if _WIN32
+	HANDLE File = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE) return NULL;
+	LARGE_INTEGER Size;
+	if (GetFileSizeEx(File, &Size) && Size.QuadPart > 0 && (uint64)Size.QuadPart <= (size_t)-1)
+	{
+		// the view remains valid after closing file and mapping handles
+		HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (Mapping)
+		{
+			Data = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(Mapping);
+			if (Data) OutSize = (size_t)Size.QuadPart;
+		}
+	}
+	CloseHandle(File);
+#else
+	int File = open(filename, O_RDONLY);
+	if (File < 0) return NULL;
+	struct stat buf;
+	if (fstat(File, &buf) == 0 && buf.st_size > 0)
+	{
+		void* Mem = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, File, 0);
+		if (Mem != MAP_FAILED)
+		{
+			Data = Mem;
+			OutSize = buf.st_size;
+		}
+	}
+	close(File);
+#endif // _WIN32
+
+	return Data;
+
+	unguardf("%s", filename);
+}
+
+void appUnmapFile(const void* Data, size_t Size)
+{
+	if (!Data) return;
+#if _WIN32
+	UnmapViewOfFile(Data);
+#else
+	munmap(const_cast<void*>(Data), Size);
+#endif
+}
+
 #if !_WIN32
 
 // POSIX version of GetTickCount()
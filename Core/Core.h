@@ -288,6 +288,8 @@ inline void QSort(const char** array, int count, int (*cmpFunc)(const char**, co
 }
 
 void appOpenLogFile(const char *filename);
+// Redirect console output of appPrintf(), NULL restores stdout
+void appSetConsoleStream(FILE *stream);
 void appPrintf(const char *fmt, ...);
 
 extern bool GIsSwError;
@@ -308,6 +310,16 @@ int appSprintf(char *dest, int size, const char *fmt, ...);
 int appSprintf(wchar_t *dest, int size, const wchar_t *fmt, ...);
 // Allocate a copy of string. Analog of strdup(), but allocation is made with appMalloc.
 char* appStrdup(const char* str);
+// Fast text formatting. appFormat() works like snprintf(), but formats integers, strings and floats
+// without CRT, and falls back to vsnprintf() for unsupported format specifications. Differences with
+// printf: "%g" produces the shortest text which is read back to the same float value, and the function
+// returns -1 on buffer overflow.
+int appFormat(char* dest, int size, const char* fmt, ...);
+int appFormatV(char* dest, int size, const char* fmt, va_list args);
+// Helpers for appFormat, return length of the string. Buffer should be at least 64 characters long.
+int appFormatInt(char* buf, int64 Value);
+int appFormatFloat(char* buf, float Value);			// shortest round-trip representation
+int appFormatFixed(char* buf, double Value, int Decimals); // the same as "%.*f"
 // Copy string to dst with ensuring that string will not exceed 'count' capacity, including trailing zero character.
 // The resulting string is always null-terminated.
 void appStrncpyz(char *dst, const char *src, int count);
@@ -324,6 +336,10 @@ bool appMatchWildcard(const char *name, const char *mask, bool ignoreCase = fals
 // Returns true is string contains wildcard characters.
 bool appContainsWildcard(const char *string);
 
+// Fast non-cryptographic 64-bit hash of memory block. Large data could be hashed in pieces
+// by passing result of the previous call as Seed.
+uint64 appMemHash64(const void* Data, int Size, uint64 Seed = 0);
+
 void appNormalizeFilename(char *filename);
 void appMakeDirectory(const char *dirname);
 void appMakeDirectoryForFile(const char *filename);
@@ -338,6 +354,11 @@ void appParseResponseFile(const char* filename, int& outArgc, const char**& outA
 // and FS_DIR if this is a directory
 unsigned appGetFileType(const char *filename);
 
+// Map whole file into memory for reading. Returns NULL when file could not be opened or
+// is empty. Mapping should be released with appUnmapFile().
+const void* appMapFile(const char *filename, size_t& OutSize);
+void appUnmapFile(const void* Data, size_t Size);
+
 
 // Memory management
 
@@ -505,6 +526,8 @@ long win32ExceptFilter(struct _EXCEPTION_POINTERS *info);
 
 void appUnwindPrefix(const char *fmt);		// not vararg (will display function name for unguardf only)
 NORETURN void appUnwindThrow(const char *fmt, ...);
+// Forget the error which was caught and ignored, so it won't appear in the history of the next one
+void appResetError();
 
 extern char GErrorHistory[2048];
 
@@ -521,6 +544,8 @@ extern char GErrorHistory[2048];
 #define THROW_AGAIN		throw
 #define THROW			throw
 
+#define appResetError()
+
 #endif // DO_GUARD
 
 #if VSTUDIO_INTEGRATION
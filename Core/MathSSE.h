@@ -177,6 +177,14 @@ struct CCoords4
 		* (CVec3*)&mm[3] = src.origin;
 		f[3] = f[7] = f[11] = f[15] = 0;
 	}
+
+	void Get(CCoords &dst) const
+	{
+		dst.axis[0] = * (CVec3*)&mm[0];
+		dst.axis[1] = * (CVec3*)&mm[1];
+		dst.axis[2] = * (CVec3*)&mm[2];
+		dst.origin  = * (CVec3*)&mm[3];
+	}
 };
 
 
@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "Parallel.h"
 
 #if DEBUG_MEMORY
 #define MAX_STACK_TRACE			16
@@ -172,11 +173,11 @@ void *appMalloc(int size, int alignment)
 	hdr->stack = found;
 #endif // DEBUG_MEMORY
 
-	// statistics
-	GTotalAllocationSize += size;
-	GTotalAllocationCount++;
+	// statistics (memory could be allocated from worker threads)
+	appInterlockedAdd(&GTotalAllocationSize, size);
+	appInterlockedIncrement(&GTotalAllocationCount);
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedIncrement(&GNumAllocs);
 #endif
 
 	return ptr;
@@ -216,11 +217,11 @@ void* appRealloc(void *ptr, int newSize)
 
 	// statistics: we're allocating a new block with appMalloc, which counts statistics
 	// for this allocation, so only eliminate statistics from old memory block here
-	GTotalAllocationSize -= oldSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, -oldSize);
+	appInterlockedDecrement(&GTotalAllocationCount);
 
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedIncrement(&GNumAllocs);
 #endif
 
 	return newData;
@@ -245,8 +246,8 @@ void appFree(void *ptr)
 #endif
 
 	// statistics
-	GTotalAllocationSize -= hdr->blockSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, -hdr->blockSize);
+	appInterlockedDecrement(&GTotalAllocationCount);
 
 	free(block);
 
@@ -0,0 +1,300 @@
+#include "Core.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>				// _beginthreadex
+#else
+#include <pthread.h>
+#include <unistd.h>					// sysconf
+#endif
+
+
+int GNumThreads = 0;
+
+int appGetNumThreads()
+{
+	if (GNumThreads > 0)
+		return min(GNumThreads, MAX_WORKER_THREADS);
+
+	static int NumCores = 0;
+	if (!NumCores)
+	{
+#if _WIN32
+		SYSTEM_INFO Info;
+		GetSystemInfo(&Info);
+		NumCores = Info.dwNumberOfProcessors;
+#else
+		NumCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		NumCores = bound(NumCores, 1, MAX_WORKER_THREADS);
+	}
+	return NumCores;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Parallel loop
+-----------------------------------------------------------------------------*/
+
+struct CParallelJob
+{
+	ParallelForCallback_t Callback;
+	void*			Param;
+	int				Count;
+	volatile int	NextIndex;
+	volatile int	Failed;
+};
+
+// Set while appParallelFor() is executed, used to serialize nested loops. Could be changed
+// by different threads, so it is modified with atomic operations only.
+static volatile int GParallelDepth = 0;
+
+static void RunParallelJob(CParallelJob* Job)
+{
+	while (!Job->Failed)
+	{
+		int Index = appInterlockedIncrement(&Job->NextIndex) - 1;
+		if (Index >= Job->Count) break;
+		Job->Callback(Index, Job->Param);
+	}
+}
+
+// Executed in every thread. Catch errors here and let the calling thread rethrow them.
+static void RunParallelJobSafe(CParallelJob* Job)
+{
+	TRY
+	{
+		RunParallelJob(Job);
+	}
+	CATCH
+	{
+		Job->Failed = 1;
+	}
+}
+
+#if _WIN32
+
+static unsigned __stdcall ParallelThreadFunc(void* Arg)
+{
+	RunParallelJobSafe((CParallelJob*)Arg);
+	appProfilerThreadExit();
+	return 0;
+}
+
+#else
+
+static void* ParallelThreadFunc(void* Arg)
+{
+	RunParallelJobSafe((CParallelJob*)Arg);
+	appProfilerThreadExit();
+	return NULL;
+}
+
+#endif // _WIN32
+
+void appParallelForWorker(int Count, ParallelForCallback_t Callback, void* Param)
+{
+	guard(appParallelFor);
+
+	if (Count <= 0) return;
+
+	int NumThreads = min(appGetNumThreads(), Count);
+	if (NumThreads <= 1 || GParallelDepth)
+	{
+		// single-threaded or nested loop
+		for (int i = 0; i < Count; i++)
+			Callback(i, Param);
+		return;
+	}
+
+	CParallelJob Job;
+	Job.Callback  = Callback;
+	Job.Param     = Param;
+	Job.Count     = Count;
+	Job.NextIndex = 0;
+	Job.Failed    = 0;
+
+	appInterlockedIncrement(&GParallelDepth);
+
+	// start worker threads, calling thread will work too
+#if _WIN32
+	HANDLE Threads[MAX_WORKER_THREADS];
+#else
+	pthread_t Threads[MAX_WORKER_THREADS];
+#endif
+	int NumStarted = 0;
+	for (int i = 1; i < NumThreads; i++)
+	{
+#if _WIN32
+		HANDLE Thread = (HANDLE)_beginthreadex(NULL, 0, ParallelThreadFunc, &Job, 0, NULL);
+		if (!Thread) break;
+		Threads[NumStarted++] = Thread;
+#else
+		if (pthread_create(&Threads[NumStarted], NULL, ParallelThreadFunc, &Job) != 0) break;
+		NumStarted++;
+#endif
+	}
+
+	RunParallelJobSafe(&Job);
+
+	// wait for completion
+	for (int i = 0; i < NumStarted; i++)
+	{
+#if _WIN32
+		WaitForSingleObject(Threads[i], INFINITE);
+		CloseHandle(Threads[i]);
+#else
+		pthread_join(Threads[i], NULL);
+#endif
+	}
+
+	appInterlockedDecrement(&GParallelDepth);
+
+	if (Job.Failed)
+	{
+		// error message is already in GErrorHistory, continue unwinding in this thread
+		THROW;
+	}
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Mutex
+-----------------------------------------------------------------------------*/
+
+CMutex::CMutex()
+{
+#if _WIN32
+	CRITICAL_SECTION* Section = new CRITICAL_SECTION;
+	InitializeCriticalSection(Section);
+	Handle = Section;
+#else
+	pthread_mutex_t* Mutex = new pthread_mutex_t;
+	pthread_mutex_init(Mutex, NULL);
+	Handle = Mutex;
+#endif
+}
+
+CMutex::~CMutex()
+{
+#if _WIN32
+	DeleteCriticalSection((CRITICAL_SECTION*)Handle);
+	delete (CRITICAL_SECTION*)Handle;
+#else
+	pthread_mutex_destroy((pthread_mutex_t*)Handle);
+	delete (pthread_mutex_t*)Handle;
+#endif
+}
+
+void CMutex::Lock()
+{
+#if _WIN32
+	EnterCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	pthread_mutex_lock((pthread_mutex_t*)Handle);
+#endif
+}
+
+void CMutex::Unlock()
+{
+#if _WIN32
+	LeaveCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	pthread_mutex_unlock((pthread_mutex_t*)Handle);
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------
+	Background thread
+-----------------------------------------------------------------------------*/
+
+struct CThreadInfo
+{
+#if _WIN32
+	HANDLE			Handle;
+#else
+	pthread_t		Handle;
+#endif
+	ThreadCallback_t Callback;
+	void*			Param;
+	bool			Failed;
+};
+
+static void RunThreadSafe(CThreadInfo* Info)
+{
+	TRY
+	{
+		Info->Callback(Info->Param);
+	}
+	CATCH
+	{
+		Info->Failed = true;
+	}
+}
+
+#if _WIN32
+
+static unsigned __stdcall BackgroundThreadFunc(void* Arg)
+{
+	RunThreadSafe((CThreadInfo*)Arg);
+	appProfilerThreadExit();
+	return 0;
+}
+
+#else
+
+static void* BackgroundThreadFunc(void* Arg)
+{
+	RunThreadSafe((CThreadInfo*)Arg);
+	appProfilerThreadExit();
+	return NULL;
+}
+
+#endif // _WIN32
+
+void* appCreateThread(ThreadCallback_t Callback, void* Param)
+{
+	guard(appCreateThread);
+
+	CThreadInfo* Info = new CThreadInfo;
+	Info->Callback = Callback;
+	Info->Param    = Param;
+	Info->Failed   = false;
+#if _WIN32
+	Info->Handle = (HANDLE)_beginthreadex(NULL, 0, BackgroundThreadFunc, Info, 0, NULL);
+	if (!Info->Handle)
+#else
+	if (pthread_create(&Info->Handle, NULL, BackgroundThreadFunc, Info) != 0)
+#endif
+	{
+		delete Info;
+		return NULL;
+	}
+	return Info;
+
+	unguard;
+}
+
+bool appWaitThread(void* Thread)
+{
+	guard(appWaitThread);
+
+	CThreadInfo* Info = (CThreadInfo*)Thread;
+#if _WIN32
+	WaitForSingleObject(Info->Handle, INFINITE);
+	CloseHandle(Info->Handle);
+#else
+	pthread_join(Info->Handle, NULL);
+#endif
+	bool Result = !Info->Failed;
+	delete Info;
+	return Result;
+
+	unguard;
+}
@@ -0,0 +1,160 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+/*-----------------------------------------------------------------------------
+	Simple multithreading support
+-----------------------------------------------------------------------------*/
+
+// Maximal number of threads used by appParallelFor()
+#define MAX_WORKER_THREADS		64
+
+// Number of threads used for data processing. 0 means "use all CPU cores",
+// 1 disables multithreading. Set with "-threads=N" command line option.
+extern int GNumThreads;
+
+// Returns actual number of threads which appParallelFor() will use
+int appGetNumThreads();
+
+// Atomic operations, return new value
+#if _MSC_VER
+
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Amount)
+{
+	return _InterlockedExchangeAdd((volatile long*)Value, Amount) + Amount;
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, ptrdiff_t Amount)
+{
+#ifdef _WIN64
+	return _InterlockedExchangeAdd64((volatile __int64*)Value, Amount) + Amount;
+#else
+	return _InterlockedExchangeAdd((volatile long*)Value, Amount) + Amount;
+#endif
+}
+
+#else // _MSC_VER
+
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Amount)
+{
+	return __sync_add_and_fetch(Value, Amount);
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, ptrdiff_t Amount)
+{
+	return __sync_add_and_fetch(Value, Amount);
+}
+
+#endif // _MSC_VER
+
+// Atomically replace Value with Exchange when it is equal to Comparand, returns initial value
+#if _MSC_VER
+
+FORCEINLINE int appInterlockedCompareExchange(volatile int* Value, int Exchange, int Comparand)
+{
+	return _InterlockedCompareExchange((volatile long*)Value, Exchange, Comparand);
+}
+
+#else
+
+FORCEINLINE int appInterlockedCompareExchange(volatile int* Value, int Exchange, int Comparand)
+{
+	return __sync_val_compare_and_swap(Value, Comparand, Exchange);
+}
+
+#endif // _MSC_VER
+
+// Atomically replace Value with Exchange, returns initial value
+FORCEINLINE int appInterlockedExchange(volatile int* Value, int Exchange)
+{
+	int OldValue;
+	do
+	{
+		OldValue = *Value;
+	} while (appInterlockedCompareExchange(Value, Exchange, OldValue) != OldValue);
+	return OldValue;
+}
+
+FORCEINLINE int appInterlockedIncrement(volatile int* Value)
+{
+	return appInterlockedAdd(Value, 1);
+}
+
+FORCEINLINE int appInterlockedDecrement(volatile int* Value)
+{
+	return appInterlockedAdd(Value, -1);
+}
+
+// Execute Callback(Index, Param) for all Index values in range [0, Count) using
+// all available threads. The function returns when all items are processed.
+// Errors (appError) raised inside a callback are passed to the calling thread.
+// Nested calls are executed in a single thread. Callback should not use va()
+// and other functions working with shared static buffers.
+typedef void (*ParallelForCallback_t)(int Index, void* Param);
+
+void appParallelForWorker(int Count, ParallelForCallback_t Callback, void* Param);
+
+template<typename T>
+struct TParallelForThunk
+{
+	void			(*Callback)(int, T&);
+	T*				Param;
+
+	static void Run(int Index, void* Thunk)
+	{
+		TParallelForThunk* This = (TParallelForThunk*)Thunk;
+		This->Callback(Index, *This->Param);
+	}
+};
+
+template<typename T>
+FORCEINLINE void appParallelFor(int Count, void (*Callback)(int, T&), T& Param)
+{
+	TParallelForThunk<T> Thunk;
+	Thunk.Callback = Callback;
+	Thunk.Param    = &Param;
+	appParallelForWorker(Count, TParallelForThunk<T>::Run, &Thunk);
+}
+
+// Mutual exclusion object for data shared between threads. Lock may be held while
+// doing file i/o, so threads waiting for it are put to sleep instead of spinning.
+class CMutex
+{
+public:
+	CMutex();
+	~CMutex();
+	void Lock();
+	void Unlock();
+
+private:
+	void*			Handle;
+};
+
+// Holds the mutex locked until the end of the scope
+class CScopedLock
+{
+public:
+	CScopedLock(CMutex& InMutex)
+	:	Mutex(InMutex)
+	{
+		Mutex.Lock();
+	}
+	~CScopedLock()
+	{
+		Mutex.Unlock();
+	}
+
+private:
+	CMutex&			Mutex;
+};
+
+// Execute Callback(Param) in a new thread. Returns NULL when thread could not be
+// created, caller should execute the work by itself in this case. appWaitThread()
+// must be called for every created thread, it returns false when an error was raised
+// inside the callback (the error is not passed to the calling thread). Callback should
+// not use appParallelFor().
+typedef void (*ThreadCallback_t)(void* Param);
+
+void* appCreateThread(ThreadCallback_t Callback, void* Param);
+bool appWaitThread(void* Thread);
+
+#endif // __PARALLEL_H__
@@ -0,0 +1,414 @@
+#include "Core.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>				// QueryPerformanceCounter
+#else
+#include <time.h>					// clock_gettime
+#endif
+
+#if _MSC_VER
+#define THREAD_LOCAL			__declspec(thread)
+#else
+#define THREAD_LOCAL			__thread
+#endif
+
+
+bool GProfilerEnabled = false;
+
+// Number of events in a single allocation block
+#define PROFILER_CHUNK_SIZE		4096
+// Maximal number of distinct scope names displayed in summary
+#define MAX_PROFILER_STAGES		256
+
+
+/*-----------------------------------------------------------------------------
+	Timer
+-----------------------------------------------------------------------------*/
+
+static int64  GProfilerStartTime;
+static double GTicksToMicroseconds = 0;
+
+static FORCEINLINE int64 ProfilerTicks()
+{
+#if _WIN32
+	LARGE_INTEGER Value;
+	QueryPerformanceCounter(&Value);
+	return Value.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void InitProfilerTimer()
+{
+#if _WIN32
+	LARGE_INTEGER Freq;
+	QueryPerformanceFrequency(&Freq);
+	GTicksToMicroseconds = 1000000.0 / Freq.QuadPart;
+#else
+	GTicksToMicroseconds = 0.001;
+#endif
+}
+
+int64 appCycles64()
+{
+	return ProfilerTicks();
+}
+
+double appCyclesToMsec(int64 Cycles)
+{
+	if (!GTicksToMicroseconds) InitProfilerTimer();
+	return Cycles * GTicksToMicroseconds / 1000.0;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Per-thread event buffers
+-----------------------------------------------------------------------------*/
+
+struct CProfileEvent
+{
+	const char*		Name;
+	int64			Start;
+	int64			Duration;
+	int64			SelfTime;			// Duration excluding nested scopes
+};
+
+struct CProfileEventChunk
+{
+	CProfileEventChunk* Next;
+	int				Count;
+	CProfileEvent	Events[PROFILER_CHUNK_SIZE];
+};
+
+struct CProfileStackItem
+{
+	const char*		Name;
+	int64			Start;
+	int64			ChildTime;
+};
+
+struct CProfilerThread
+{
+	CProfilerThread* Next;
+	int				ThreadId;			// used as "tid" in trace file
+	bool			InUse;				// buffer is owned by some thread
+	CProfileEventChunk* FirstChunk;
+	CProfileEventChunk* LastChunk;
+	int				StackDepth;
+	CProfileStackItem Stack[MAX_PROFILER_DEPTH];
+};
+
+// List of all thread buffers, in order of creation
+static CProfilerThread* GProfilerThreads = NULL;
+static int GNumProfilerThreads = 0;
+static volatile int GProfilerLock = 0;
+
+static THREAD_LOCAL CProfilerThread* GCurrentProfilerThread = NULL;
+
+static void LockProfiler()
+{
+	while (appInterlockedCompareExchange(&GProfilerLock, 1, 0) != 0)
+	{
+		// spin, the lock is held only while registering a thread
+	}
+}
+
+static void UnlockProfiler()
+{
+	appInterlockedCompareExchange(&GProfilerLock, 0, 1);
+}
+
+static CProfilerThread* GetProfilerThread()
+{
+	CProfilerThread* Thread = GCurrentProfilerThread;
+	if (Thread) return Thread;
+
+	// Reuse a buffer of finished thread, so worker threads of different parallel
+	// loops will appear as the same thread in trace
+	LockProfiler();
+	CProfilerThread* Last = NULL;
+	for (Thread = GProfilerThreads; Thread; Thread = Thread->Next)
+	{
+		if (!Thread->InUse) break;
+		Last = Thread;
+	}
+	if (!Thread)
+	{
+		Thread = (CProfilerThread*)appMalloc(sizeof(CProfilerThread));
+		Thread->ThreadId = GNumProfilerThreads++;
+		if (Last)
+			Last->Next = Thread;
+		else
+			GProfilerThreads = Thread;
+	}
+	Thread->InUse = true;
+	Thread->StackDepth = 0;
+	UnlockProfiler();
+
+	GCurrentProfilerThread = Thread;
+	return Thread;
+}
+
+int appProfilerBeginScope(const char* Name)
+{
+	CProfilerThread* Thread = GetProfilerThread();
+	int Depth = Thread->StackDepth;
+	if (Depth >= MAX_PROFILER_DEPTH) return -1;
+
+	CProfileStackItem& Item = Thread->Stack[Depth];
+	Item.Name = Name;
+	Item.ChildTime = 0;
+	Item.Start = ProfilerTicks();
+	Thread->StackDepth = Depth + 1;
+	return Depth;
+}
+
+void appProfilerEndScope(int Depth)
+{
+	CProfilerThread* Thread = GCurrentProfilerThread;
+	if (!Thread) return;
+
+	int64 Time = ProfilerTicks();
+	// Close all scopes up to Depth. There could be more than one scope when inner
+	// scope was interrupted with an error, and its destructor was not called.
+	while (Thread->StackDepth > Depth)
+	{
+		const CProfileStackItem& Item = Thread->Stack[--Thread->StackDepth];
+		int64 Duration = Time - Item.Start;
+		if (Thread->StackDepth > 0)
+			Thread->Stack[Thread->StackDepth - 1].ChildTime += Duration;
+
+		CProfileEventChunk* Chunk = Thread->LastChunk;
+		if (!Chunk || Chunk->Count == PROFILER_CHUNK_SIZE)
+		{
+			CProfileEventChunk* NewChunk = (CProfileEventChunk*)appMalloc(sizeof(CProfileEventChunk));
+			if (Chunk)
+				Chunk->Next = NewChunk;
+			else
+				Thread->FirstChunk = NewChunk;
+			Thread->LastChunk = Chunk = NewChunk;
+		}
+		CProfileEvent& Event = Chunk->Events[Chunk->Count++];
+		Event.Name     = Item.Name;
+		Event.Start    = Item.Start;
+		Event.Duration = Duration;
+		Event.SelfTime = Duration - Item.ChildTime;
+	}
+}
+
+void appProfilerThreadExit()
+{
+	CProfilerThread* Thread = GCurrentProfilerThread;
+	if (!Thread) return;
+
+	LockProfiler();
+	Thread->InUse = false;
+	UnlockProfiler();
+	GCurrentProfilerThread = NULL;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Trace file
+-----------------------------------------------------------------------------*/
+
+static char* GTraceFile = NULL;
+
+static void SaveTraceFile(const char* Filename)
+{
+	guard(SaveTraceFile);
+
+	FILE* f = fopen(Filename, "w");
+	if (!f)
+	{
+		appPrintf("Unable to create trace file \"%s\"\n", Filename);
+		return;
+	}
+
+	char Line[1024], TimeStr[64], DurationStr[64];
+	int Len;
+	fputs("{\"traceEvents\":[\n", f);
+	bool bFirst = true;
+
+	for (const CProfilerThread* Thread = GProfilerThreads; Thread; Thread = Thread->Next)
+	{
+		if (Thread->ThreadId == 0)
+			Len = appFormat(Line, sizeof(Line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Main thread\"}}",
+				bFirst ? "" : ",\n");
+		else
+			Len = appFormat(Line, sizeof(Line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Worker %d\"}}",
+				bFirst ? "" : ",\n", Thread->ThreadId, Thread->ThreadId);
+		fwrite(Line, Len, 1, f);
+		bFirst = false;
+
+		for (const CProfileEventChunk* Chunk = Thread->FirstChunk; Chunk; Chunk = Chunk->Next)
+		{
+			for (int i = 0; i < Chunk->Count; i++)
+			{
+				const CProfileEvent& Event = Chunk->Events[i];
+				appFormatFixed(TimeStr, (Event.Start - GProfilerStartTime) * GTicksToMicroseconds, 3);
+				appFormatFixed(DurationStr, Event.Duration * GTicksToMicroseconds, 3);
+				Len = appFormat(Line, sizeof(Line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%s,\"dur\":%s}",
+					Event.Name, Thread->ThreadId, TimeStr, DurationStr);
+				fwrite(Line, Len, 1, f);
+			}
+		}
+	}
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+	fclose(f);
+	appPrintf("Trace saved to %s\n", Filename);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Summary
+-----------------------------------------------------------------------------*/
+
+struct CProfileStageStats
+{
+	const char*		Name;
+	int				Count;
+	int64			TotalTime;
+	int64			SelfTime;
+	int64			MaxTime;
+};
+
+static int CompareStageStats(const CProfileStageStats* A, const CProfileStageStats* B)
+{
+	if (A->TotalTime != B->TotalTime)
+		return A->TotalTime > B->TotalTime ? -1 : 1;
+	return strcmp(A->Name, B->Name);
+}
+
+static void PrintProfilerSummary()
+{
+	guard(PrintProfilerSummary);
+
+	static CProfileStageStats Stats[MAX_PROFILER_STAGES];
+	int NumStats = 0;
+	int NumEvents = 0;
+
+	for (const CProfilerThread* Thread = GProfilerThreads; Thread; Thread = Thread->Next)
+	{
+		for (const CProfileEventChunk* Chunk = Thread->FirstChunk; Chunk; Chunk = Chunk->Next)
+		{
+			for (int i = 0; i < Chunk->Count; i++)
+			{
+				const CProfileEvent& Event = Chunk->Events[i];
+				// Find stage by name. The same string literal could have different
+				// addresses in different source files, so compare strings as well.
+				CProfileStageStats* S = NULL;
+				for (int j = 0; j < NumStats; j++)
+				{
+					if (Stats[j].Name == Event.Name || !strcmp(Stats[j].Name, Event.Name))
+					{
+						S = &Stats[j];
+						break;
+					}
+				}
+				if (!S)
+				{
+					if (NumStats == MAX_PROFILER_STAGES) continue;
+					S = &Stats[NumStats++];
+					memset(S, 0, sizeof(*S));
+					S->Name = Event.Name;
+				}
+				S->Count++;
+				S->TotalTime += Event.Duration;
+				S->SelfTime += Event.SelfTime;
+				if (Event.Duration > S->MaxTime) S->MaxTime = Event.Duration;
+				NumEvents++;
+			}
+		}
+	}
+
+	if (!NumStats) return;
+
+	QSort(Stats, NumStats, CompareStageStats);
+
+	double ToMs = GTicksToMicroseconds / 1000.0;
+	appPrintf("\nProfiler: %.3f sec, %d threads, %d events\n",
+		(ProfilerTicks() - GProfilerStartTime) * GTicksToMicroseconds / 1000000.0, GNumProfilerThreads, NumEvents);
+	appPrintf("%-24s %9s %12s %12s %10s %10s\n", "Stage", "Calls", "Total ms", "Self ms", "Avg ms", "Max ms");
+	for (int i = 0; i < NumStats; i++)
+	{
+		const CProfileStageStats& S = Stats[i];
+		appPrintf("%-24s %9d %12.2f %12.2f %10.3f %10.3f\n", S.Name, S.Count,
+			S.TotalTime * ToMs, S.SelfTime * ToMs, S.TotalTime * ToMs / S.Count, S.MaxTime * ToMs);
+	}
+	appPrintf("Time of scopes executed in worker threads is summed up, so it could exceed the total time.\n");
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Profiler control
+-----------------------------------------------------------------------------*/
+
+static void ProfilerAtExit()
+{
+	appStopProfiler();
+}
+
+void appStartProfiler(const char* TraceFile)
+{
+	if (GProfilerEnabled) return;
+
+	if (TraceFile)
+	{
+		if (GTraceFile) appFree(GTraceFile);
+		GTraceFile = appStrdup(TraceFile);
+	}
+
+	static bool bRegistered = false;
+	if (!bRegistered)
+	{
+		atexit(ProfilerAtExit);
+		bRegistered = true;
+	}
+
+	InitProfilerTimer();
+	GProfilerStartTime = ProfilerTicks();
+	// Register calling thread first, so it will be displayed as "main thread"
+	GetProfilerThread();
+	GProfilerEnabled = true;
+}
+
+void appStopProfiler()
+{
+	if (!GProfilerEnabled) return;
+	GProfilerEnabled = false;
+
+	// Close scopes which are still open in the calling thread
+	appProfilerEndScope(0);
+
+	PrintProfilerSummary();
+	if (GTraceFile)
+	{
+		SaveTraceFile(GTraceFile);
+		appFree(GTraceFile);
+		GTraceFile = NULL;
+	}
+
+	// Release recorded data
+	for (CProfilerThread* Thread = GProfilerThreads; Thread; Thread = Thread->Next)
+	{
+		CProfileEventChunk* Next;
+		for (CProfileEventChunk* Chunk = Thread->FirstChunk; Chunk; Chunk = Next)
+		{
+			Next = Chunk->Next;
+			appFree(Chunk);
+		}
+		Thread->FirstChunk = Thread->LastChunk = NULL;
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/*-----------------------------------------------------------------------------
+	Hierarchical stage profiler
+-----------------------------------------------------------------------------*/
+
+// Usage: put PROFILE_SCOPE("Name") at the beginning of a code block. Time spent
+// in the block is recorded when profiler is enabled, nested scopes are allowed.
+// Name should be a string literal (the pointer is stored, not a copy of the string).
+// Every thread records events into its own buffer, so there's no locking during
+// recording. When profiler is disabled, the scope costs a single check of a global
+// variable.
+
+// Maximal nesting level of profiler scopes, deeper scopes are not recorded
+#define MAX_PROFILER_DEPTH		64
+
+extern bool GProfilerEnabled;
+
+// High resolution timer, could be used without enabling profiler
+int64 appCycles64();
+double appCyclesToMsec(int64 Cycles);
+
+// Start recording. When TraceFile is not NULL, Chrome trace (json) will be saved
+// there (it could be viewed with chrome://tracing or ui.perfetto.dev). Results are
+// saved and summary table is printed when program exits.
+void appStartProfiler(const char* TraceFile = NULL);
+// Stop recording, save trace and print summary
+void appStopProfiler();
+
+int  appProfilerBeginScope(const char* Name);
+void appProfilerEndScope(int Depth);
+// Should be called before exit from a thread which could record profiler events,
+// allows reusing of thread's buffer by other threads.
+void appProfilerThreadExit();
+
+struct CProfileScope
+{
+	int		Depth;
+
+	FORCEINLINE CProfileScope(const char* Name)
+	{
+		Depth = GProfilerEnabled ? appProfilerBeginScope(Name) : -1;
+	}
+	FORCEINLINE ~CProfileScope()
+	{
+		if (Depth >= 0) appProfilerEndScope(Depth);
+	}
+};
+
+#define PROFILE_SCOPE_NAME2(line)	_ProfileScope##line
+#define PROFILE_SCOPE_NAME(line)	PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(Name)			CProfileScope PROFILE_SCOPE_NAME(__LINE__)(Name)
+
+#endif // __PROFILER_H__
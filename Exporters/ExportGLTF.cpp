@@ -31,7 +31,88 @@ static CVec3 GetMaterialDebugColor(int Index)
 	return r;
 }
 
-static void ExportMaterial(UUnrealMaterial* Mat, FArchive& Ar, int index, bool bLast)
+// Text buffer for glTF json. Printf() here supports only %d, %s and %g format specifiers
+// and formats numbers with appFormatInt() and appFormatFloat().
+struct JsonBuffer
+{
+	TArray<char> Text;
+
+	JsonBuffer()
+	{
+		Text.Empty(65536);
+	}
+
+	FORCEINLINE char* AddText(int Len)
+	{
+		int Pos = Text.Num();
+		if (Pos + Len > Text.Max())
+		{
+			Text.Reserve(max(Text.Max() * 2, Pos + Len));
+		}
+		Text.AddUninitialized(Len);
+		return Text.GetData() + Pos;
+	}
+
+	FORCEINLINE void Append(const char* Str, int Len)
+	{
+		memcpy(AddText(Len), Str, Len);
+	}
+
+	void AppendInt(int Value)
+	{
+		char buf[64];
+		int len = appFormatInt(buf, Value);
+		Append(buf, len);
+	}
+
+	void AppendFloat(float Value)
+	{
+		char buf[64];
+		int len = appFormatFloat(buf, Value);
+		Append(buf, len);
+	}
+
+	void Printf(const char* fmt, ...)
+	{
+		va_list	argptr;
+		va_start(argptr, fmt);
+		const char* s = fmt;
+		while (true)
+		{
+			const char* p = strchr(s, '%');
+			if (!p)
+			{
+				Append(s, strlen(s));
+				break;
+			}
+			Append(s, p - s);
+			switch (p[1])
+			{
+			case 'd':
+				AppendInt(va_arg(argptr, int));
+				break;
+			case 's':
+				{
+					const char* Str = va_arg(argptr, const char*);
+					Append(Str, strlen(Str));
+				}
+				break;
+			case 'g':
+				AppendFloat((float)va_arg(argptr, double));
+				break;
+			case '%':
+				Append("%", 1);
+				break;
+			default:
+				appError("JsonBuffer: unsupported format \"%s\"", fmt);
+			}
+			s = p + 2;
+		}
+		va_end(argptr);
+	}
+};
+
+static void ExportMaterial(UUnrealMaterial* Mat, JsonBuffer& Ar, int index, bool bLast)
 {
 	char dummyName[64];
 	appSprintf(ARRAY_ARG(dummyName), "dummy_material_%d", index);
@@ -73,6 +154,8 @@ inline void TransformRotation(CQuat& q)
 //??	q.w *= -1;				// changing left-handed to right-handed, so inverse rotation - works correctly without this line
 }
 
+// Describes single accessor. Accessor's data are placed directly into the binary buffer
+// shared by all accessors, so binary data is produced in its final layout.
 struct BufferData
 {
 	enum
@@ -85,7 +168,8 @@ struct BufferData
 		FLOAT = 5126
 	};
 
-	byte* Data;
+	TArray<byte>* Storage;
+	int Offset;				// offset of the data in Storage
 	int DataSize;
 	int ComponentType;
 	int Count;
@@ -93,23 +177,22 @@ struct BufferData
 	bool bNormalized;
 
 	// Data for filling buffer
-	byte* FillPtr;
+	int FillPos;
 #if MAX_DEBUG
 	int FillCount;
 	int ItemSize;
 #endif
 
+	// Data for finding duplicate blocks
+	uint64 Hash;
+	int HashNext;
+
 	FString BoundsMin;
 	FString BoundsMax;
 
-	BufferData()
-	: Data(NULL)
-	, DataSize(0)
-	{}
-
-	~BufferData()
+	FORCEINLINE byte* GetData() const
 	{
-		if (Data) appFree(Data);
+		return Storage->GetData() + Offset;
 	}
 
 	void Setup(int InCount, const char* InType, int InComponentType, int InItemSize, bool InNormalized = false)
@@ -121,10 +204,15 @@ struct BufferData
 		DataSize = InCount * InItemSize;
 		// Align all buffers by 4, as requested by glTF format
 		DataSize = Align(DataSize, 4);
-		// Use aligned alloc for CVec4
-		Data = (byte*) appMalloc(DataSize, 16);
+		// Allocate space in the binary buffer, zeroing alignment padding
+		Offset = Storage->Num();
+		if (Offset + DataSize > Storage->Max())
+		{
+			Storage->Reserve(max(Storage->Max() * 2, Offset + DataSize));
+		}
+		Storage->AddZeroed(DataSize);
 
-		FillPtr = Data;
+		FillPos = Offset;
 #if MAX_DEBUG
 		FillCount = 0;
 		ItemSize = InItemSize;
@@ -138,8 +226,9 @@ struct BufferData
 		assert(sizeof(T) == ItemSize);
 		assert(FillCount++ < Count);
 #endif
-		*(T*)FillPtr = p;
-		FillPtr += sizeof(T);
+		// Storage is 4-byte aligned only, so use memcpy
+		memcpy(Storage->GetData() + FillPos, &p, sizeof(T));
+		FillPos += sizeof(T);
 	}
 
 	bool IsSameAs(const BufferData& Other) const
@@ -151,21 +240,28 @@ struct BufferData
 			return false;
 		}
 		// Compare data
-		return (memcmp(Data, Other.Data, DataSize) == 0);
+		return (memcmp(GetData(), Other.GetData(), DataSize) == 0);
 	}
 };
 
+#define DEDUP_HASH_SIZE		4096
+
 struct GLTFExportContext
 {
 	const char* MeshName;
 	const CSkeletalMesh* SkelMesh;
 	const CStaticMesh* StatMesh;
+	bool bBinary;					// write .glb instead of .gltf + .bin
 
 	TArray<BufferData> Data;
+	TArray<byte> BinaryData;		// contents of the glTF binary buffer
+	int DedupHash[DEDUP_HASH_SIZE];
 
 	GLTFExportContext()
 	{
 		memset(this, 0, sizeof(*this));
+		memset(DedupHash, -1, sizeof(DedupHash));
+		BinaryData.Empty(1 << 20);
 	}
 
 	inline bool IsSkeletal() const
@@ -173,30 +269,46 @@ struct GLTFExportContext
 		return SkelMesh != NULL;
 	}
 
-	// Compare last item of Data with other itest starting with FirstDataIndex, drop the data
+	// Add new accessor, should call BufferData::Setup() then
+	int AddBuffer()
+	{
+		int Index = Data.AddZeroed();
+		Data[Index].Storage = &BinaryData;
+		return Index;
+	}
+
+	// Compare last item of Data with other items starting with FirstDataIndex, drop the data
 	// if same data block found and return its index. If no matching data were found, return
-	// index of that last data.
+	// index of that last data. Only blocks passed through this function are considered.
 	int GetFinalIndexForLastBlock(int FirstDataIndex)
 	{
 		int LastIndex = Data.Num()-1;
-		const BufferData& LastData = Data[LastIndex];
-		for (int index = FirstDataIndex; index < LastIndex; index++)
+		BufferData& LastData = Data[LastIndex];
+		uint64 Hash = appMemHash64(LastData.GetData(), LastData.DataSize, LastData.Count);
+		int h = Hash & (DEDUP_HASH_SIZE - 1);
+		for (int index = DedupHash[h]; index >= FirstDataIndex; index = Data[index].HashNext)
 		{
-			if (LastData.IsSameAs(Data[index]))
+			const BufferData& Other = Data[index];
+			if (Other.Hash == Hash && LastData.IsSameAs(Other))
 			{
-				// Found matching data
+				// Found matching data. The data block is the last one in the binary buffer, drop it.
+				assert(LastData.Offset + LastData.DataSize == BinaryData.Num());
+				BinaryData.RemoveAt(LastData.Offset, LastData.DataSize);
 				Data.RemoveAt(LastIndex);
 				return index;
 			}
 		}
 		// Not found
+		LastData.Hash = Hash;
+		LastData.HashNext = DedupHash[h];
+		DedupHash[h] = LastIndex;
 		return LastIndex;
 	}
 };
 
 #define VERT(n)		*OffsetPointer(Verts, (n) * VertexSize)
 
-static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, int SectonIndex, FArchive& Ar)
+static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, int SectonIndex, JsonBuffer& Ar)
 {
 	guard(ExportSection);
 
@@ -221,29 +333,29 @@ static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 	}
 
 	// Prepare buffers
-	int IndexBufIndex = Context.Data.AddZeroed();
-	int PositionBufIndex = Context.Data.AddZeroed();
-	int NormalBufIndex = Context.Data.AddZeroed();
-	int TangentBufIndex = Context.Data.AddZeroed();
+	int IndexBufIndex = Context.AddBuffer();
+	int PositionBufIndex = Context.AddBuffer();
+	int NormalBufIndex = Context.AddBuffer();
+	int TangentBufIndex = Context.AddBuffer();
 
 	int ColorBufIndex = -1;
 	if (Lod.VertexColors)
 	{
-		ColorBufIndex = Context.Data.AddZeroed();
+		ColorBufIndex = Context.AddBuffer();
 	}
 
 	int BonesBufIndex = -1;
 	int WeightsBufIndex = -1;
 	if (Context.IsSkeletal())
 	{
-		BonesBufIndex = Context.Data.AddZeroed();
-		WeightsBufIndex = Context.Data.AddZeroed();
+		BonesBufIndex = Context.AddBuffer();
+		WeightsBufIndex = Context.AddBuffer();
 	}
 
 	int UVBufIndex[MAX_MESH_UV_SETS];
 	for (int i = 0; i < Lod.NumTexCoords; i++)
 	{
-		UVBufIndex[i] = Context.Data.AddZeroed();
+		UVBufIndex[i] = Context.AddBuffer();
 	}
 
 	BufferData& IndexBuf = Context.Data[IndexBufIndex];
@@ -356,11 +468,11 @@ static void ExportSection(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 
 	// Compute bounds for PositionBuf
 	CVec3 Mins, Maxs;
-	ComputeBounds((CVec3*)PositionBuf.Data, numLocalVerts, sizeof(CVec3), Mins, Maxs);
+	ComputeBounds((CVec3*)PositionBuf.GetData(), numLocalVerts, sizeof(CVec3), Mins, Maxs);
 	char buf[256];
-	appSprintf(ARRAY_ARG(buf), "[ %g, %g, %g ]", VECTOR_ARG(Mins));
+	appFormat(ARRAY_ARG(buf), "[ %g, %g, %g ]", VECTOR_ARG(Mins));
 	PositionBuf.BoundsMin = buf;
-	appSprintf(ARRAY_ARG(buf), "[ %g, %g, %g ]", VECTOR_ARG(Maxs));
+	appFormat(ARRAY_ARG(buf), "[ %g, %g, %g ]", VECTOR_ARG(Maxs));
 	PositionBuf.BoundsMax = buf;
 
 	if (Lod.VertexColors)
@@ -479,13 +591,13 @@ struct CMat4
 	}
 };
 
-static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod, FArchive& Ar)
+static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod, JsonBuffer& Ar)
 {
 	guard(ExportSkinData);
 
 	int numBones = Context.SkelMesh->RefSkeleton.Num();
 
-	int MatrixBufIndex = Context.Data.AddZeroed();
+	int MatrixBufIndex = Context.AddBuffer();
 	BufferData& MatrixBuf = Context.Data[MatrixBufIndex];
 	MatrixBuf.Setup(numBones, "MAT4", BufferData::FLOAT, sizeof(CMat4));
 
@@ -603,7 +715,7 @@ static void ExportSkinData(GLTFExportContext& Context, const CSkelMeshLod& Lod,
 	unguard;
 }
 
-static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
+static void ExportAnimations(GLTFExportContext& Context, JsonBuffer& Ar)
 {
 	guard(ExportAnimations);
 
@@ -631,6 +743,14 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 		}
 	}
 
+	// When AnimSet replaces animated translation of some bones with bind pose, raw tracks
+	// doesn't match the animation displayed in the viewer. Bake such animations: sample
+	// local bone transforms at every frame using the same rules as the viewer does.
+	CPoseEvaluator Evaluator;
+	bool bBakePoses = Anim->AnimRotationOnly || Anim->ForceMeshTranslation.Num();
+	if (bBakePoses)
+		Evaluator.SetSkeleton(Context.SkelMesh, Anim);
+
 	Ar.Printf(
 		"  \"animations\" : [\n"
 	);
@@ -642,6 +762,10 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 	{
 		const CAnimSequence &Seq = *Anim->Sequences[SeqIndex];
 
+		int NumSamples = 0;
+		if (bBakePoses)
+			NumSamples = Evaluator.EvaluateFixedRate(&Seq, Seq.Rate);
+
 		Ar.Printf(
 			"    {\n"
 			"      \"name\" : \"%s\",\n",
@@ -707,6 +831,7 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 		for (int SamplerIndex = 0; SamplerIndex < Samplers.Num(); SamplerIndex++)
 		{
 			const AnimSampler& Sampler = Samplers[SamplerIndex];
+			int MeshBoneIndex = Sampler.BoneNodeIndex - FIRST_BONE_NODE;
 
 			// Prepare time array
 			const TArray<float>* TimeArray = (Sampler.Type == AnimSampler::TRANSLATION) ? &Sampler.Track->KeyPosTime : &Sampler.Track->KeyQuatTime;
@@ -716,14 +841,16 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 				TimeArray = &Sampler.Track->KeyTime;
 			}
 			int NumKeys = Sampler.Type == (AnimSampler::TRANSLATION) ? Sampler.Track->KeyPos.Num() : Sampler.Track->KeyQuat.Num();
+			if (NumSamples)
+				NumKeys = NumSamples;		// baked animation has a key for every frame
 
-			int TimeBufIndex = Context.Data.AddZeroed();
+			int TimeBufIndex = Context.AddBuffer();
 			BufferData& TimeBuf = Context.Data[TimeBufIndex];
 			TimeBuf.Setup(NumKeys, "SCALAR", BufferData::FLOAT, sizeof(float));
 
 			float RateScale = 1.0f / Seq.Rate;
 			float LastFrameTime = 0;
-			if (TimeArray->Num() == 0 || NumKeys == 1)
+			if (NumSamples || TimeArray->Num() == 0 || NumKeys == 1)
 			{
 				// Fill with equally spaced values
 				for (int i = 0; i < NumKeys; i++)
@@ -743,14 +870,14 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 			// Prepare min/max values for time track, it's required by glTF standard
 			TimeBuf.BoundsMin = "[ 0 ]";
 			char buf[64];
-			appSprintf(ARRAY_ARG(buf), "[ %g ]", LastFrameTime * RateScale);
+			appFormat(ARRAY_ARG(buf), "[ %g ]", LastFrameTime * RateScale);
 			TimeBuf.BoundsMax = buf;
 
 			// Try to reuse TimeBuf from previous tracks
 			TimeBufIndex = Context.GetFinalIndexForLastBlock(FirstDataIndex);
 
 			// Prepare data
-			int DataBufIndex = Context.Data.AddZeroed();
+			int DataBufIndex = Context.AddBuffer();
 			BufferData& DataBuf = Context.Data[DataBufIndex];
 			if (Sampler.Type == AnimSampler::TRANSLATION)
 			{
@@ -758,7 +885,16 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 				DataBuf.Setup(NumKeys, "VEC3", BufferData::FLOAT, sizeof(CVec3));
 				for (int i = 0; i < NumKeys; i++)
 				{
-					CVec3 Pos = Sampler.Track->KeyPos[i];
+					CVec3 Pos;
+					if (NumSamples)
+					{
+						CQuat Unused;
+						Evaluator.GetLocalTransform(i, MeshBoneIndex, Pos, Unused);
+					}
+					else
+					{
+						Pos = Sampler.Track->KeyPos[i];
+					}
 					TransformPosition(Pos);
 					DataBuf.Put(Pos);
 				}
@@ -769,9 +905,18 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 				DataBuf.Setup(NumKeys, "VEC4", BufferData::FLOAT, sizeof(CQuat));
 				for (int i = 0; i < NumKeys; i++)
 				{
-					CQuat Rot = Sampler.Track->KeyQuat[i];
+					CQuat Rot;
+					if (NumSamples)
+					{
+						CVec3 Unused;
+						Evaluator.GetLocalTransform(i, MeshBoneIndex, Unused, Rot);
+					}
+					else
+					{
+						Rot = Sampler.Track->KeyQuat[i];
+					}
 					TransformRotation(Rot);
-					if (Sampler.BoneNodeIndex - FIRST_BONE_NODE == 0)
+					if (MeshBoneIndex == 0)
 					{
 						Rot.Conjugate();
 					}
@@ -798,7 +943,7 @@ static void ExportAnimations(GLTFExportContext& Context, FArchive& Ar)
 	unguard;
 }
 
-static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, FArchive& Ar, FArchive& Ar2)
+static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, const CMeshVertex* Verts, JsonBuffer& Ar)
 {
 	guard(ExportMeshLod);
 
@@ -874,41 +1019,51 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 	}
 
 	// Write buffers
-	int bufferLength = 0;
-	for (int i = 0; i < Context.Data.Num(); i++)
+	if (!Context.bBinary)
 	{
-		bufferLength += Context.Data[i].DataSize;
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"uri\" : \"%s.bin\",\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			Context.MeshName, Context.BinaryData.Num()
+		);
+	}
+	else
+	{
+		// glb: buffer is stored in BIN chunk of the same file
+		Ar.Printf(
+			"  \"buffers\" : [\n"
+			"    {\n"
+			"      \"byteLength\" : %d\n"
+			"    }\n"
+			"  ],\n",
+			Context.BinaryData.Num()
+		);
 	}
-
-	Ar.Printf(
-		"  \"buffers\" : [\n"
-		"    {\n"
-		"      \"uri\" : \"%s.bin\",\n"
-		"      \"byteLength\" : %d\n"
-		"    }\n"
-		"  ],\n",
-		Context.MeshName, bufferLength
-	);
 
 	// Write bufferViews
 	Ar.Printf(
 		"  \"bufferViews\" : [\n"
 	);
-	int bufferOffset = 0;
 	for (int i = 0; i < Context.Data.Num(); i++)
 	{
 		const BufferData& B = Context.Data[i];
+#if MAX_DEBUG
+		assert(B.FillCount == B.Count);
+#endif
 		Ar.Printf(
 			"    {\n"
 			"      \"buffer\" : 0,\n"
 			"      \"byteOffset\" : %d,\n"
 			"      \"byteLength\" : %d\n"
 			"    }%s\n",
-			bufferOffset,
+			B.Offset,
 			B.DataSize,
 			i == (Context.Data.Num()-1) ? "" : ","
 		);
-		bufferOffset += B.DataSize;
 	}
 	Ar.Printf(
 		"  ],\n"
@@ -953,25 +1108,79 @@ static void ExportMeshLod(GLTFExportContext& Context, const CBaseMeshLod& Lod, c
 		"  ]\n"
 	);
 
-	// Write binary data
-	guard(WriteBIN);
-	for (int i = 0; i < Context.Data.Num(); i++)
+	// Closing brace
+	Ar.Printf("}\n");
+
+	unguard;
+}
+
+// Write glTF binary file: header, then JSON and BIN chunks
+static void WriteGLB(FArchive& Ar, JsonBuffer& Json, const TArray<byte>& BinaryData)
+{
+	guard(WriteGLB);
+
+	// Chunks should be aligned by 4 bytes. JSON is padded with spaces, binary buffer is already aligned.
+	while (Json.Text.Num() & 3)
 	{
-		const BufferData& B = Context.Data[i];
-#if MAX_DEBUG
-		assert(B.FillCount == B.Count);
-#endif
-		Ar2.Serialize(B.Data, B.DataSize);
+		Json.Append(" ", 1);
 	}
+	assert((BinaryData.Num() & 3) == 0);
+
+	uint32 JsonLength = Json.Text.Num();
+	uint32 BinLength = BinaryData.Num();
+
+	uint32 Magic = 0x46546C67;			// "glTF"
+	uint32 Version = 2;
+	uint32 TotalLength = 12 + 8 + JsonLength + 8 + BinLength;
+	Ar << Magic << Version << TotalLength;
+
+	uint32 JsonChunkType = 0x4E4F534A;	// "JSON"
+	Ar << JsonLength << JsonChunkType;
+	Ar.Serialize(Json.Text.GetData(), JsonLength);
+
+	uint32 BinChunkType = 0x004E4942;	// "BIN\0"
+	Ar << BinLength << BinChunkType;
+	Ar.Serialize(const_cast<byte*>(BinaryData.GetData()), BinLength);
+
 	unguard;
+}
 
-	// Closing brace
-	Ar.Printf("}\n");
+static void ExportMeshLodFiles(GLTFExportContext& Context, const UObject* OriginalMesh, const CBaseMeshLod& Lod, const CMeshVertex* Verts)
+{
+	guard(ExportMeshLodFiles);
+
+	if (!Context.bBinary)
+	{
+		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", Context.MeshName);
+		if (Ar)
+		{
+			JsonBuffer Json;
+			ExportMeshLod(Context, Lod, Verts, Json);
+			Ar->Serialize(Json.Text.GetData(), Json.Text.Num());
+			delete Ar;
+
+			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", Context.MeshName);
+			assert(Ar2);
+			Ar2->Serialize(Context.BinaryData.GetData(), Context.BinaryData.Num());
+			delete Ar2;
+		}
+	}
+	else
+	{
+		FArchive* Ar = CreateExportArchive(OriginalMesh, 0, "%s.glb", Context.MeshName);
+		if (Ar)
+		{
+			JsonBuffer Json;
+			ExportMeshLod(Context, Lod, Verts, Json);
+			WriteGLB(*Ar, Json, Context.BinaryData);
+			delete Ar;
+		}
+	}
 
 	unguard;
 }
 
-void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh)
+void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh, bool bBinary)
 {
 	guard(ExportSkeletalMeshGLTF);
 
@@ -994,25 +1203,18 @@ void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", meshName);
-		if (Ar)
-		{
-			GLTFExportContext Context;
-			Context.MeshName = meshName;
-			Context.SkelMesh = Mesh;
+		GLTFExportContext Context;
+		Context.MeshName = meshName;
+		Context.SkelMesh = Mesh;
+		Context.bBinary = bBinary;
 
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
-			delete Ar;
-			delete Ar2;
-		}
+		ExportMeshLodFiles(Context, OriginalMesh, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts);
 	}
 
 	unguard;
 }
 
-void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
+void ExportStaticMeshGLTF(const CStaticMesh* Mesh, bool bBinary)
 {
 	guard(ExportStaticMeshGLTF);
 
@@ -1025,7 +1227,6 @@ void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
 
 	int MaxLod = (GExportLods) ? Mesh->Lods.Num() : 1;
 	for (int Lod = 0; Lod < MaxLod; Lod++)
-	for (int Lod = 0; Lod < MaxLod; Lod++)
 	{
 		char suffix[32];
 		suffix[0] = 0;
@@ -1036,19 +1237,12 @@ void ExportStaticMeshGLTF(const CStaticMesh* Mesh)
 		char meshName[256];
 		appSprintf(ARRAY_ARG(meshName), "%s%s", OriginalMesh->Name, suffix);
 
-		FArchive* Ar = CreateExportArchive(OriginalMesh, FAO_TextFile, "%s.gltf", meshName);
-		if (Ar)
-		{
-			GLTFExportContext Context;
-			Context.MeshName = meshName;
-			Context.StatMesh = Mesh;
+		GLTFExportContext Context;
+		Context.MeshName = meshName;
+		Context.StatMesh = Mesh;
+		Context.bBinary = bBinary;
 
-			FArchive* Ar2 = CreateExportArchive(OriginalMesh, 0, "%s.bin", meshName);
-			assert(Ar2);
-			ExportMeshLod(Context, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts, *Ar, *Ar2);
-			delete Ar;
-			delete Ar2;
-		}
+		ExportMeshLodFiles(Context, OriginalMesh, Mesh->Lods[Lod], Mesh->Lods[Lod].Verts);
 	}
 
 	unguard;
@@ -7,6 +7,7 @@
 #include "SkeletalMesh.h"
 
 #include "Exporters.h"
+#include "Parallel.h"
 
 
 // MD5 uses right-hand coordinates, but unreal uses left-hand.
@@ -297,90 +298,148 @@ if (i == 32 || i == 34)
 }
 
 
-void ExportMd5Anim(const CAnimSet *Anim)
+// Number of md5anim files opened and written in parallel at once
+#define MD5_ANIM_BATCH		32
+
+struct CMd5AnimContext
 {
-	guard(ExportMd5Anim);
+	const CAnimSet*	Anim;
+	int				FirstSequence;
+	TArray<FArchive*> Archives;			// NULL when archive was not created
+};
+
+static void WriteMd5AnimSequence(int Index, CMd5AnimContext& Context)
+{
+	guard(WriteMd5AnimSequence);
+
+	FArchive* Ar = Context.Archives[Index];
+	if (!Ar) return;
 
+	int i;
+	const CAnimSet* Anim = Context.Anim;
+	const CAnimSequence &S = *Anim->Sequences[Context.FirstSequence + Index];
 	int numBones = Anim->TrackBoneNames.Num();
-	UObject *OriginalAnim = Anim->OriginalAnim;
 
-	for (int AnimIndex = 0; AnimIndex < Anim->Sequences.Num(); AnimIndex++)
+	Ar->Printf(
+		"MD5Version 10\n"
+		"commandline \"Created with UE Viewer\"\n"
+		"\n"
+		"numFrames %d\n"
+		"numJoints %d\n"
+		"frameRate %g\n"
+		"numAnimatedComponents %d\n"
+		"\n",
+		S.NumFrames,
+		numBones,
+		S.Rate,
+		numBones * 6
+	);
+
+	// skeleton
+	Ar->Printf("hierarchy {\n");
+	for (i = 0; i < numBones; i++)
 	{
-		int i;
-		const CAnimSequence &S = *Anim->Sequences[AnimIndex];
+		Ar->Printf("\t\"%s\" %d %d %d\n", *Anim->TrackBoneNames[i], (i == 0) ? -1 : 0, 63, i * 6);
+			// ParentIndex is unknown for UAnimSet, so always write "0"
+			// here: 6 is number of components per frame, 63 = (1<<6)-1 -- flags "all components are used"
+	}
+
+	// bounds
+	Ar->Printf("}\n\nbounds {\n");
+	for (i = 0; i < S.NumFrames; i++)
+		Ar->Printf("\t( -100 -100 -100 ) ( 100 100 100 )\n");	//!! dummy
+	Ar->Printf("}\n\n");
 
-		FArchive *Ar = CreateExportArchive(OriginalAnim, FAO_TextFile, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
-		if (!Ar)
+	// baseframe and frames
+	for (int Frame = -1; Frame < S.NumFrames; Frame++)
+	{
+		int t = Frame;
+		if (Frame == -1)
 		{
-			if (AnimIndex == 0)	// if file overwrite is disabled and file already exists, don't save animations at all
-				return;
-			// However continue export if some archive was failed to be created
-			continue;
+			Ar->Printf("baseframe {\n");
+			t = 0;
 		}
+		else
+			Ar->Printf("frame %d {\n", Frame);
 
-		Ar->Printf(
-			"MD5Version 10\n"
-			"commandline \"Created with UE Viewer\"\n"
-			"\n"
-			"numFrames %d\n"
-			"numJoints %d\n"
-			"frameRate %g\n"
-			"numAnimatedComponents %d\n"
-			"\n",
-			S.NumFrames,
-			numBones,
-			S.Rate,
-			numBones * 6
-		);
-
-		// skeleton
-		Ar->Printf("hierarchy {\n");
-		for (i = 0; i < numBones; i++)
+		for (int b = 0; b < numBones; b++)
 		{
-			Ar->Printf("\t\"%s\" %d %d %d\n", *Anim->TrackBoneNames[i], (i == 0) ? -1 : 0, 63, i * 6);
-				// ParentIndex is unknown for UAnimSet, so always write "0"
-				// here: 6 is number of components per frame, 63 = (1<<6)-1 -- flags "all components are used"
+			CVec3 BP;
+			CQuat BO;
+			S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+			if (!b) BO.Conjugate();			// root bone
+#if MIRROR_MESH
+			BO.y  *= -1;
+			BO.w  *= -1;
+			BP[1] *= -1;					// y
+#endif
+			if (BO.w < 0) BO.Negate();		// W-component of quaternion will be removed ...
+			if (Frame < 0)
+				Ar->Printf("\t( %f %f %f ) ( %.10f %.10f %.10f )\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
+			else
+				Ar->Printf("\t%f %f %f %.10f %.10f %.10f\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
 		}
-
-		// bounds
-		Ar->Printf("}\n\nbounds {\n");
-		for (i = 0; i < S.NumFrames; i++)
-			Ar->Printf("\t( -100 -100 -100 ) ( 100 100 100 )\n");	//!! dummy
 		Ar->Printf("}\n\n");
+	}
 
-		// baseframe and frames
-		for (int Frame = -1; Frame < S.NumFrames; Frame++)
-		{
-			int t = Frame;
-			if (Frame == -1)
-			{
-				Ar->Printf("baseframe {\n");
-				t = 0;
-			}
-			else
-				Ar->Printf("frame %d {\n", Frame);
+	unguardf("seq=%d", Context.FirstSequence + Index);
+}
+
+static void CloseMd5AnimArchives(CMd5AnimContext& Context)
+{
+	for (int i = 0; i < Context.Archives.Num(); i++)
+	{
+		if (Context.Archives[i]) delete Context.Archives[i];
+	}
+	Context.Archives.Reset();
+}
+
+// Write all sequences of the batch, every sequence is written to its own archive.
+// Archives are closed even if writing of some sequence failed.
+static void WriteMd5AnimBatch(CMd5AnimContext& Context)
+{
+	TRY
+	{
+		appParallelFor(Context.Archives.Num(), WriteMd5AnimSequence, Context);
+	}
+	CATCH
+	{
+		CloseMd5AnimArchives(Context);
+		THROW_AGAIN;
+	}
+	CloseMd5AnimArchives(Context);
+}
+
+void ExportMd5Anim(const CAnimSet *Anim)
+{
+	guard(ExportMd5Anim);
+
+	UObject *OriginalAnim = Anim->OriginalAnim;
 
-			for (int b = 0; b < numBones; b++)
+	CMd5AnimContext Context;
+	Context.Anim = Anim;
+
+	for (int FirstIndex = 0; FirstIndex < Anim->Sequences.Num(); FirstIndex += MD5_ANIM_BATCH)
+	{
+		int Count = min(Anim->Sequences.Num() - FirstIndex, MD5_ANIM_BATCH);
+
+		// Create archives in original order: CreateExportArchive() is not thread-safe
+		Context.FirstSequence = FirstIndex;
+		Context.Archives.Reset(Count);
+		for (int AnimIndex = FirstIndex; AnimIndex < FirstIndex + Count; AnimIndex++)
+		{
+			const CAnimSequence &S = *Anim->Sequences[AnimIndex];
+			FArchive *Ar = CreateExportArchive(OriginalAnim, FAO_TextFile, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
+			if (!Ar && AnimIndex == 0)
 			{
-				CVec3 BP;
-				CQuat BO;
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
-				if (!b) BO.Conjugate();			// root bone
-#if MIRROR_MESH
-				BO.y  *= -1;
-				BO.w  *= -1;
-				BP[1] *= -1;					// y
-#endif
-				if (BO.w < 0) BO.Negate();		// W-component of quaternion will be removed ...
-				if (Frame < 0)
-					Ar->Printf("\t( %f %f %f ) ( %.10f %.10f %.10f )\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
-				else
-					Ar->Printf("\t%f %f %f %.10f %.10f %.10f\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
+				// if file overwrite is disabled and file already exists, don't save animations at all
+				return;
 			}
-			Ar->Printf("}\n\n");
+			// However continue export if some archive was failed to be created
+			Context.Archives.Add(Ar);
 		}
 
-		delete Ar;
+		WriteMd5AnimBatch(Context);
 	}
 
 	unguard;
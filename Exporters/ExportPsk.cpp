@@ -12,6 +12,7 @@
 #include "Exporters.h"
 
 #include "UnMathTools.h"
+#include "Parallel.h"
 
 
 // PSK uses right-hand coordinates, but unreal uses left-hand.
@@ -456,6 +457,51 @@ const UObject* GetPrimaryAnimObject(const CAnimSet* Anim)
 	return Anim->OriginalAnim;
 }
 
+// Animation keys are computed in parallel, sequence by sequence, in batches limited by
+// this number of keys - so memory use doesn't depend on AnimSet size
+#define PSA_KEYS_BATCH		(1 << 20)
+
+struct CPsaKeysContext
+{
+	const CAnimSet*	Anim;
+	int				FirstSequence;
+	TArray<int>		KeyOffsets;				// position of sequence keys in Keys array
+	TArray<VQuatAnimKey> Keys;
+};
+
+static void ComputePsaKeys(int Index, CPsaKeysContext& Context)
+{
+	guard(ComputePsaKeys);
+
+	const CAnimSequence &S = *Context.Anim->Sequences[Context.FirstSequence + Index];
+	int numBones = Context.Anim->TrackBoneNames.Num();
+	VQuatAnimKey* K = Context.Keys.GetData() + Context.KeyOffsets[Index];
+
+	for (int t = 0; t < S.NumFrames; t++)
+	{
+		for (int b = 0; b < numBones; b++, K++)
+		{
+			CVec3 BP;
+			CQuat BO;
+
+			BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
+			BO.Set(0, 0, 0, 1);
+			S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
+
+			K->Position    = (FVector&) BP;
+			K->Orientation = (FQuat&)   BO;
+			K->Time        = 1;
+#if MIRROR_MESH
+			K->Orientation.Y *= -1;
+			K->Orientation.W *= -1;
+			K->Position.Y    *= -1;
+#endif
+		}
+	}
+
+	unguardf("seq=%d", Context.FirstSequence + Index);
+}
+
 void ExportPsa(const CAnimSet *Anim)
 {
 	// using 'static' here to avoid zero-filling unused fields
@@ -522,38 +568,36 @@ void ExportPsa(const CAnimSet *Anim)
 	KeyHdr.DataSize  = sizeof(VQuatAnimKey);
 	SAVE_CHUNK(KeyHdr, "ANIMKEYS");
 	bool requireConfig = false;
-	for (i = 0; i < numAnims; i++)
+	CPsaKeysContext Context;
+	Context.Anim = Anim;
+	for (i = 0; i < numAnims; /* empty */)
 	{
-		const CAnimSequence &S = *Anim->Sequences[i];
-		for (int t = 0; t < S.NumFrames; t++)
+		// collect a batch of sequences
+		Context.FirstSequence = i;
+		Context.KeyOffsets.Reset();
+		int batchKeys = 0;
+		do
 		{
-			for (int b = 0; b < numBones; b++)
+			const CAnimSequence &S = *Anim->Sequences[i];
+			Context.KeyOffsets.Add(batchKeys);
+			batchKeys += S.NumFrames * numBones;
+			// check for user error
+			if (S.NumFrames)
 			{
-				VQuatAnimKey K;
-				CVec3 BP;
-				CQuat BO;
-
-				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
-				BO.Set(0, 0, 0, 1);
-				S.Tracks[b]->GetBonePosition(t, S.NumFrames, false, BP, BO);
-
-				K.Position    = (FVector&) BP;
-				K.Orientation = (FQuat&)   BO;
-				K.Time        = 1;
-#if MIRROR_MESH
-				K.Orientation.Y *= -1;
-				K.Orientation.W *= -1;
-				K.Position.Y    *= -1;
-#endif
-
-				Ar << K;
-				keysCount--;
-
-				// check for user error
-				if ((S.Tracks[b]->KeyPos.Num() == 0) || (S.Tracks[b]->KeyQuat.Num() == 0))
-					requireConfig = true;
+				for (int b = 0; b < numBones; b++)
+					if ((S.Tracks[b]->KeyPos.Num() == 0) || (S.Tracks[b]->KeyQuat.Num() == 0))
+						requireConfig = true;
 			}
-		}
+			i++;
+		} while (i < numAnims && batchKeys < PSA_KEYS_BATCH);
+
+		// compute keys in parallel and write them in original order
+		Context.Keys.Reset(batchKeys);
+		Context.Keys.AddUninitialized(batchKeys);
+		appParallelFor(Context.KeyOffsets.Num(), ComputePsaKeys, Context);
+		for (int k = 0; k < batchKeys; k++)
+			Ar << Context.Keys[k];
+		keysCount -= batchKeys;
 	}
 	assert(keysCount == 0);
 
@@ -5,6 +5,7 @@
 #include "UnSound.h"
 
 #include "Exporters.h"
+#include "Parallel.h"
 
 
 #define XMA_EXPORT		1
@@ -263,6 +264,110 @@ void ExportSoundNodeWave(const USoundNodeWave *Snd)
 
 #if UNREAL4
 
+// Maximal amount of streamed chunk data loaded at once. Chunks are loaded in batches
+// of this size, next batch is loaded in background while current one is written.
+#define MAX_SOUND_BATCH_SIZE	(16 << 20)
+
+struct CSoundChunkBatch
+{
+	const USoundWave*	Snd;
+	int					First;
+	int					Count;
+};
+
+// Load bulk data of chunks. Package and pak readers are not thread-safe, so only one
+// batch could be loaded at a time.
+static void LoadSoundChunks(void* Param)
+{
+	const CSoundChunkBatch* Batch = (CSoundChunkBatch*)Param;
+	for (int i = Batch->First; i < Batch->First + Batch->Count; i++)
+	{
+		const FStreamedAudioChunk& Chunk = Batch->Snd->StreamingChunks[i];
+		Chunk.Data.SerializeData(Batch->Snd);
+	}
+}
+
+static void GetSoundChunkBatch(const USoundWave* Snd, int First, CSoundChunkBatch& Batch)
+{
+	Batch.Snd = Snd;
+	Batch.First = First;
+	int Size = 0;
+	int i;
+	for (i = First; i < Snd->StreamingChunks.Num(); i++)
+	{
+		int ChunkSize = Snd->StreamingChunks[i].DataSize;
+		if (i > First && Size + ChunkSize > MAX_SOUND_BATCH_SIZE) break;
+		Size += ChunkSize;
+	}
+	Batch.Count = i - First;
+}
+
+// Write loaded chunks and release their memory
+static void WriteSoundChunks(const CSoundChunkBatch& Batch, FArchive& Ar)
+{
+	guard(WriteSoundChunks);
+
+	const USoundWave* Snd = Batch.Snd;
+	for (int i = Batch.First; i < Batch.First + Batch.Count; i++)
+	{
+		const FStreamedAudioChunk& Chunk = Snd->StreamingChunks[i];
+		assert(Chunk.DataSize >= Chunk.AudioDataSize);
+		assert(Chunk.DataSize == Chunk.Data.ElementCount);
+		if (Chunk.Data.BulkData)
+			Ar.Serialize(Chunk.Data.BulkData, Chunk.AudioDataSize);
+		else
+			appPrintf("WARNING: %s: streamed chunk %d is missing\n", Snd->Name, i);
+		if (Chunk.Data.CanReloadBulk())
+			const_cast<FByteBulkData&>(Chunk.Data).ReleaseData();
+	}
+
+	unguard;
+}
+
+static void ExportStreamedChunks(const USoundWave* Snd, FArchive& Ar)
+{
+	guard(ExportStreamedChunks);
+
+	bool bUseThread = (appGetNumThreads() > 1);
+
+	CSoundChunkBatch Batch;
+	GetSoundChunkBatch(Snd, 0, Batch);
+	LoadSoundChunks(&Batch);
+
+	while (Batch.Count)
+	{
+		// start loading of the next batch
+		CSoundChunkBatch NextBatch;
+		GetSoundChunkBatch(Snd, Batch.First + Batch.Count, NextBatch);
+		void* Thread = NULL;
+		if (NextBatch.Count && bUseThread)
+			Thread = appCreateThread(LoadSoundChunks, &NextBatch);
+
+		// write current batch
+		TRY {
+			WriteSoundChunks(Batch, Ar);
+		} CATCH {
+			// the thread is loading into NextBatch, which is located on stack, so it should
+			// be finished before leaving this function
+			if (Thread) appWaitThread(Thread);
+			THROW_AGAIN;
+		}
+
+		if (Thread)
+		{
+			if (!appWaitThread(Thread))
+				appError("Failed to load streamed chunks %d..%d", NextBatch.First, NextBatch.First + NextBatch.Count - 1);
+		}
+		else if (NextBatch.Count)
+		{
+			LoadSoundChunks(&NextBatch);
+		}
+		Batch = NextBatch;
+	}
+
+	unguard;
+}
+
 void ExportSoundWave4(const USoundWave *Snd)
 {
 	// select bulk containing data
@@ -292,16 +397,7 @@ void ExportSoundWave4(const USoundWave *Snd)
 		FArchive *Ar = CreateExportArchive(Snd, 0, "%s.%s", Snd->Name, ext);
 		if (Ar)
 		{
-			for (int i = 0; i < Snd->StreamingChunks.Num(); i++)
-			{
-				const FStreamedAudioChunk& Chunk = Snd->StreamingChunks[i];
-				assert(Chunk.DataSize >= Chunk.AudioDataSize);
-				assert(Chunk.DataSize == Chunk.Data.ElementCount);
-				// Load bulk into memory
-				Chunk.Data.SerializeData(Snd);
-				// Export data
-				Ar->Serialize(Chunk.Data.BulkData, Chunk.AudioDataSize);
-			}
+			ExportStreamedChunks(Snd, *Ar);
 			delete Ar;
 		}
 		unguardf("Format=%s", *Snd->StreamedFormat);
@@ -9,6 +9,10 @@
 #include "Exporters.h"
 
 #include "UnTexturePNG.h"
+#include "Profiler.h"
+#include "Parallel.h"
+
+#include <emmintrin.h>		// SSE2 intrinsics
 
 #define TGA_SAVE_BOTTOMLEFT	1
 
@@ -42,96 +46,314 @@ bool GNoTgaCompress = false;
 bool GExportPNG = false;
 bool GExportDDS = false;
 
-//?? place this function outside (cannot place to Core - using FArchive)
+/*-----------------------------------------------------------------------------
+	TGA writer
+-----------------------------------------------------------------------------*/
 
-void WriteTGA(FArchive &Ar, int width, int height, byte *pic)
+// Image is processed in bands of scanlines, every band is encoded by a single thread.
+// RLE packets never cross scanline boundary, so bands are independent.
+#define TGA_BAND_PIXELS		65536
+// Number of bands encoded before writing them to archive, limits memory use
+#define TGA_BANDS_PER_BATCH	32
+
+struct CTgaBand
 {
-	guard(WriteTGA);
+	int		NumPackets;						// RLE: number of packets in band
+	int		NumStored;						// RLE: number of pixels stored in packets
+	uint32	AndPixels;						// all pixels combined with AND, used for alpha detection
+	int		Offset;							// position of encoded data in batch buffer
+};
 
-	int		i;
+struct CTgaContext
+{
+	const uint32*	Pic;
+	int				Width;
+	int				Height;
+	int				LinesPerBand;
+	bool			SwapRB;
+	bool			Compress;
+	int				ColorBytes;
+	int				FirstBand;				// first band of the current batch
+	byte*			Buffer;					// encoded data of the current batch
+	TArray<CTgaBand> Bands;
+};
 
-	byte *src;
-	int size = width * height;
-	// convert RGB to BGR (inplace!)
-	for (i = 0, src = pic; i < size; i++, src += 4)
-		Exchange(src[0], src[2]);
-
-	// check for 24 bit image possibility
-	int colorBytes = 3;
-	for (i = 0, src = pic + 3; i < size; i++, src += 4)
-		if (src[0] != 255)									// src initialized with offset 3
-		{
-			colorBytes = 4;
-			break;
-		}
+FORCEINLINE int CountTrailingZeros(uint32 Value)
+{
+#if _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, Value);
+	return Index;
+#else
+	return __builtin_ctz(Value);
+#endif
+}
 
-	byte *packed = (byte*)appMalloc(width * height * colorBytes + 4); // +4 for being able to put uint32 even when 3 bytes needed
-	byte *threshold = packed + width * height * colorBytes - 16; // threshold for "dst"
+FORCEINLINE uint32 SwapPixelRB(uint32 p)
+{
+	return (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+}
 
-	src = pic;
-	byte *dst = packed;
-	int column = 0;
-	byte *flag = NULL;
-	bool rle = false;
+// Set bit in EqBits for every pixel which is equal to the next one in the scanline.
+// Returns all pixels combined with AND.
+static uint32 ScanTGALine(const uint32* Src, int Width, uint32* EqBits)
+{
+	memset(EqBits, 0, ((Width + 31) / 32) * sizeof(uint32));
 
-	bool useCompression = true;
-	if (GNoTgaCompress)
-		threshold = dst;									// will break compression loop immediately
+	__m128i AndAll = _mm_set1_epi32(-1);
+	int i = 0;
+	for ( ; i + 4 < Width; i += 4)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(Src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(Src + i + 1));
+		AndAll = _mm_and_si128(AndAll, a);
+		int Mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b)));
+		EqBits[i >> 5] |= (uint32)Mask << (i & 31);	// 'i' is multiple of 4, so mask never crosses word boundary
+	}
+	uint32 Tmp[4];
+	_mm_storeu_si128((__m128i*)Tmp, AndAll);
+	uint32 Result = Tmp[0] & Tmp[1] & Tmp[2] & Tmp[3];
+	for ( ; i < Width; i++)
+	{
+		Result &= Src[i];
+		if (i < Width - 1 && Src[i] == Src[i+1])
+			EqBits[i >> 5] |= 1u << (i & 31);
+	}
+	return Result;
+}
 
-	for (i = 0; i < size; i++)
+// Find first position starting from Pos where bit differs from Value
+static int FindBitChange(const uint32* Bits, int Pos, int Width, bool Value)
+{
+	while (Pos < Width)
 	{
-		if (dst >= threshold)								// when compressed is too large, same uncompressed
+		uint32 w = Bits[Pos >> 5];
+		if (Value) w = ~w;
+		w >>= (Pos & 31);
+		if (w)
 		{
-			useCompression = false;
+			Pos += CountTrailingZeros(w);
 			break;
 		}
+		Pos = (Pos | 31) + 1;
+	}
+	return min(Pos, Width);
+}
 
-		uint32 pix = *(uint32*)src;
-		src += 4;
+// Store pixels in 24 or 32-bit BGR(A) format. Nothing is written outside of the stored
+// pixels, so bands could be encoded into adjacent memory in parallel.
+static byte* StoreTGAPixels(const uint32* Src, int Count, byte* Dst, int ColorBytes, bool SwapRB)
+{
+	if (ColorBytes == 4)
+	{
+		if (SwapRB)
+			CopySwapRedBlue((const byte*)Src, Dst, Count);
+		else
+			memcpy(Dst, Src, Count * 4);
+		return Dst + Count * 4;
+	}
+	if (!Count) return Dst;
+	// use uint32 for faster data moving, except the last pixel
+	for (int i = 0; i < Count - 1; i++, Dst += 3)
+		*(uint32*)Dst = SwapRB ? SwapPixelRB(Src[i]) : Src[i];
+	uint32 pix = SwapRB ? SwapPixelRB(Src[Count-1]) : Src[Count-1];
+	memcpy(Dst, &pix, 3);
+	return Dst + 3;
+}
 
-		if (column < width - 1 &&							// not on screen edge; NOTE: when i == size-1, col==width-1
-			pix == *(uint32*)src &&							// next pixel will be the same
-			!(rle && flag && *flag == 254))					// flag overflow
+// Encode the scanline with TGA RLE. The packet layout is the same as produced by the
+// older byte-wise encoder: runs of 2 or more equal pixels use RLE packets, other pixels
+// are grouped into raw packets, both are limited to 128 pixels. When Dst is NULL, only
+// NumPackets and NumStored are computed. LastRawCount receives number of pixels in the
+// last packet when it is raw, or 0 for RLE packet.
+static byte* CompressTGALine(const uint32* Src, int Width, const uint32* EqBits, int ColorBytes, bool SwapRB,
+	byte* Dst, int& NumPackets, int& NumStored, int* LastRawCount = NULL)
+{
+	int Pos = 0;
+	while (Pos < Width)
+	{
+		if (EqBits[Pos >> 5] & (1u << (Pos & 31)))
 		{
-			if (!rle || !flag)
+			// run of equal pixels, the last one has cleared bit
+			int End = FindBitChange(EqBits, Pos, Width, true) + 1;
+			while (End - Pos >= 2)
 			{
-				// starting new RLE sequence
-				flag = dst++;
-				*flag = 128 - 1;							// will be incremented below
-				*(uint32*)dst = pix;						// store RGBA
-				dst += colorBytes;							// increment dst by 3 or 4 bytes
+				int Count = min(End - Pos, 128);
+				NumPackets++;
+				NumStored++;
+				if (LastRawCount) *LastRawCount = 0;
+				if (Dst)
+				{
+					*Dst++ = 128 + Count - 1;
+					Dst = StoreTGAPixels(Src + Pos, 1, Dst, ColorBytes, SwapRB);
+				}
+				Pos += Count;
 			}
-			(*flag)++;										// enqueue one more texel
-			rle = true;
+			// single remaining pixel (if any) will be stored as raw
 		}
 		else
 		{
-			if (rle)
-			{
-				// previous block was RLE, and next (now: current) byte was
-				// the same - enqueue it to previous block and close block
-				(*flag)++;
-				flag = NULL;
-			}
-			else
+			// raw pixels until the next run
+			int End = FindBitChange(EqBits, Pos, Width, false);
+			if (End == Pos) End++;		// remaining pixel of the run
+			while (Pos < End)
 			{
-				if (column == 0)							// check for screen edge
-					flag = NULL;
-				if (!flag)
+				int Count = min(End - Pos, 128);
+				NumPackets++;
+				NumStored += Count;
+				if (LastRawCount) *LastRawCount = Count;
+				if (Dst)
 				{
-					// start new copy sequence
-					flag = dst++;
-					*flag = 255;
+					*Dst++ = Count - 1;
+					Dst = StoreTGAPixels(Src + Pos, Count, Dst, ColorBytes, SwapRB);
 				}
-				*(uint32*)dst = pix;						// store RGBA
-				dst += colorBytes;							// increment dst by 3 or 4 bytes
-				(*flag)++;
-				if (*flag == 127) flag = NULL;				// check for overflow
+				Pos += Count;
 			}
-			rle = false;
 		}
+	}
+	return Dst;
+}
+
+// The original byte-wise encoder compared the output size with the threshold before storing
+// every pixel, so data of the last pixel was not taken into account. Returns size of that
+// data, it is used to make the same decision about compression.
+static int GetTGALastPixelSize(const uint32* Line, int Width, int ColorBytes)
+{
+	TArray<uint32> EqBits;
+	EqBits.AddUninitialized((Width + 31) / 32);
+	ScanTGALine(Line, Width, EqBits.GetData());
+	int NumPackets = 0, NumStored = 0, LastRawCount = 0;
+	CompressTGALine(Line, Width, EqBits.GetData(), 0, false, NULL, NumPackets, NumStored, &LastRawCount);
+	if (!LastRawCount) return 0;			// RLE packet, pixel is already stored
+	return (LastRawCount == 1) ? ColorBytes + 1 : ColorBytes;
+}
+
+// First pass: alpha detection and computation of compressed size
+static void ScanTGABand(int BandIndex, CTgaContext& Context)
+{
+	guard(ScanTGABand);
+
+	CTgaBand& Band = Context.Bands[BandIndex];
+	int Width = Context.Width;
+	int FirstLine = BandIndex * Context.LinesPerBand;
+	int LastLine = min(FirstLine + Context.LinesPerBand, Context.Height);
+
+	TArray<uint32> EqBits;
+	EqBits.AddUninitialized((Width + 31) / 32);
+
+	Band.NumPackets = Band.NumStored = 0;
+	Band.AndPixels = 0xFFFFFFFF;
+	for (int Line = FirstLine; Line < LastLine; Line++)
+	{
+		const uint32* Src = Context.Pic + Line * Width;
+		if (!Context.Compress)
+		{
+			// alpha detection only
+			for (int i = 0; i < Width; i++)
+				Band.AndPixels &= Src[i];
+			continue;
+		}
+		Band.AndPixels &= ScanTGALine(Src, Width, EqBits.GetData());
+		CompressTGALine(Src, Width, EqBits.GetData(), 0, false, NULL, Band.NumPackets, Band.NumStored);
+	}
+
+	unguard;
+}
+
+// Second pass: encoding of pixel data
+static void EncodeTGABand(int Index, CTgaContext& Context)
+{
+	guard(EncodeTGABand);
+
+	int BandIndex = Context.FirstBand + Index;
+	const CTgaBand& Band = Context.Bands[BandIndex];
+	int Width = Context.Width;
+	int FirstLine = BandIndex * Context.LinesPerBand;
+	int LastLine = min(FirstLine + Context.LinesPerBand, Context.Height);
+	byte* Dst = Context.Buffer + Band.Offset;
+
+	if (!Context.Compress)
+	{
+		StoreTGAPixels(Context.Pic + FirstLine * Width, (LastLine - FirstLine) * Width, Dst, Context.ColorBytes, Context.SwapRB);
+		return;
+	}
+
+	TArray<uint32> EqBits;
+	EqBits.AddUninitialized((Width + 31) / 32);
+	int NumPackets = 0, NumStored = 0;
+	for (int Line = FirstLine; Line < LastLine; Line++)
+	{
+		const uint32* Src = Context.Pic + Line * Width;
+		ScanTGALine(Src, Width, EqBits.GetData());
+		Dst = CompressTGALine(Src, Width, EqBits.GetData(), Context.ColorBytes, Context.SwapRB, Dst, NumPackets, NumStored);
+	}
+	assert(NumPackets == Band.NumPackets && NumStored == Band.NumStored);
+
+	unguard;
+}
+
+//?? place this function outside (cannot place to Core - using FArchive)
+void WriteTGA(FArchive &Ar, int width, int height, byte *pic, bool isBGRA)
+{
+	guard(WriteTGA);
+
+	PROFILE_SCOPE("EncodeTGA");
+
+	int size = width * height;
+
+	CTgaContext Context;
+	Context.Pic          = (const uint32*)pic;
+	Context.Width        = width;
+	Context.Height       = height;
+	Context.LinesPerBand = max(TGA_BAND_PIXELS / max(width, 1), 1);
+	Context.SwapRB       = !isBGRA;			// convert RGB to BGR while encoding, source image is not modified
+	Context.Compress     = !GNoTgaCompress;
+	int NumBands = (height + Context.LinesPerBand - 1) / Context.LinesPerBand;
+	Context.Bands.AddZeroed(NumBands);
+
+	// check for 24 bit image possibility and compute size of compressed data
+	appParallelFor(NumBands, ScanTGABand, Context);
+	uint32 AndPixels = 0xFFFFFFFF;
+	int64 NumPackets = 0, NumStored = 0;
+	for (int i = 0; i < NumBands; i++)
+	{
+		const CTgaBand& Band = Context.Bands[i];
+		AndPixels  &= Band.AndPixels;
+		NumPackets += Band.NumPackets;
+		NumStored  += Band.NumStored;
+	}
+	int colorBytes = ((AndPixels >> 24) == 255) ? 3 : 4;
+	Context.ColorBytes = colorBytes;
 
-		if (++column == width) column = 0;
+	// when compressed is too large, save uncompressed
+	if (Context.Compress && size)
+	{
+		int64 CompressedSize = NumPackets + NumStored * colorBytes;
+		CompressedSize -= GetTGALastPixelSize(Context.Pic + (height - 1) * width, width, colorBytes);
+		if (CompressedSize >= (int64)size * colorBytes - 16)
+			Context.Compress = false;
+	}
+
+	// compute placement of bands in batch buffer
+	int MaxBatchSize = 0;
+	for (int FirstBand = 0; FirstBand < NumBands; FirstBand += TGA_BANDS_PER_BATCH)
+	{
+		int Offset = 0;
+		for (int i = FirstBand; i < min(FirstBand + TGA_BANDS_PER_BATCH, NumBands); i++)
+		{
+			CTgaBand& Band = Context.Bands[i];
+			Band.Offset = Offset;
+			if (Context.Compress)
+			{
+				Offset += Band.NumPackets + Band.NumStored * colorBytes;
+			}
+			else
+			{
+				int NumLines = min(Context.LinesPerBand, height - i * Context.LinesPerBand);
+				Offset += NumLines * width * colorBytes;
+			}
+		}
+		MaxBatchSize = max(MaxBatchSize, Offset);
 	}
 
 	// write header
@@ -139,53 +361,29 @@ void WriteTGA(FArchive &Ar, int width, int height, byte *pic)
 	memset(&header, 0, sizeof(header));
 	header.width  = width;
 	header.height = height;
-#if 0
-	// debug: write black/white image
-	header.pixel_size = 8;
-	header.image_type = 3;
-	fwrite(&header, 1, sizeof(header), f);
-	for (i = 0; i < width * height; i++, pic += 4)
-	{
-		int c = (pic[0]+pic[1]+pic[2]) / 3;
-		fwrite(&c, 1, 1, f);
-	}
-#else
 	header.pixel_size = colorBytes * 8;
 #if TGA_SAVE_BOTTOMLEFT
 	header.attributes = TGA_BOTLEFT;
 #else
 	header.attributes = TGA_TOPLEFT;
 #endif
-	if (useCompression)
+	header.image_type = Context.Compress ? 10 : 2;	// RLE : uncompressed
+	Ar.Serialize(&header, sizeof(header));
+
+	// encode bands in parallel and write them in original order
+	Context.Buffer = (byte*)appMalloc(max(MaxBatchSize, 1));
+	for (int FirstBand = 0; FirstBand < NumBands; FirstBand += TGA_BANDS_PER_BATCH)
 	{
-		header.image_type = 10;		// RLE
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(packed, dst - packed);
+		int Count = min(NumBands - FirstBand, TGA_BANDS_PER_BATCH);
+		Context.FirstBand = FirstBand;
+		appParallelFor(Count, EncodeTGABand, Context);
+		const CTgaBand& LastBand = Context.Bands[FirstBand + Count - 1];
+		int LastSize = Context.Compress
+			? LastBand.NumPackets + LastBand.NumStored * colorBytes
+			: min(Context.LinesPerBand, height - (FirstBand + Count - 1) * Context.LinesPerBand) * width * colorBytes;
+		Ar.Serialize(Context.Buffer, LastBand.Offset + LastSize);
 	}
-	else
-	{
-		header.image_type = 2;		// uncompressed
-		// convert to 24 bits image, when needed
-		if (colorBytes == 3)
-		{
-			// Use uint32 for faster data moving
-			dst = pic;
-			uint32* src = (uint32*)pic;
-			for (i = 0; i < size; i++)
-			{
-				uint32 pix = *src++;
-				*((uint32*)dst) = pix;
-				dst += 3;	// increment 'dst' only by 3
-			}
-		}
-		// write data
-		Ar.Serialize(&header, sizeof(header));
-		Ar.Serialize(pic, size * colorBytes);
-	}
-#endif
-
-	appFree(packed);
+	appFree(Context.Buffer);
 
 	unguard;
 }
@@ -240,6 +438,8 @@ static void WriteDDS(const CTextureData &TexData, const UUnrealMaterial* Tex)
 {
 	guard(WriteDDS);
 
+	PROFILE_SCOPE("EncodeDDS");
+
 	if (!TexData.Mips.Num()) return;
 	const CMipMap& Mip = TexData.Mips[0];
 
@@ -286,6 +486,7 @@ void ExportTexture(const UUnrealMaterial *Tex)
 	int width, height;
 
 	CTextureData TexData;
+	TexData.MaxMips = 1;			// only the first mip is exported
 	if (Tex->GetTextureData(TexData))
 	{
 		if (GExportDDS && TexData.IsDXT())
@@ -296,7 +497,8 @@ void ExportTexture(const UUnrealMaterial *Tex)
 
 		width = TexData.Mips[0].USize;
 		height = TexData.Mips[0].VSize;
-		pic = TexData.Decompress();
+		// TGA stores pixels in BGRA order, let decoder produce it directly
+		pic = TexData.Decompress(0, GExportPNG ? TPF_RGBA8 : TPF_BGRA8);
 	}
 
 	if (!pic)
@@ -350,7 +552,7 @@ void ExportTexture(const UUnrealMaterial *Tex)
 		FArchive *Ar = CreateExportArchive(Tex, 0, "%s.tga", Tex->Name);
 		if (Ar)
 		{
-			WriteTGA(*Ar, width, height, pic);
+			WriteTGA(*Ar, width, height, pic, true);
 			delete Ar;
 		}
 	}
@@ -3,14 +3,18 @@
 
 #include "UnObject.h"
 #include "UnPackage.h"		// for Package->Name
+#include "UnMaterial.h"
+#include "UnMaterial3.h"	// for UTexture2D::ReleaseTextureFileCache
 
 #include "Exporters.h"
+#include "Profiler.h"
 
 
 // configuration variables
 bool GExportScripts      = false;
 bool GExportLods         = false;
 bool GDontOverwriteFiles = false;
+bool GStreamedExport     = false;
 
 
 /*-----------------------------------------------------------------------------
@@ -39,6 +43,20 @@ void RegisterExporter(const char *ClassName, ExporterFunc_t Func)
 	unguard;
 }
 
+bool IsExportableClass(const char* ClassName)
+{
+	guard(IsExportableClass);
+	const CTypeInfo* Type = FindClassType(ClassName);
+	if (!Type) return false;
+	for (int i = 0; i < numExporters; i++)
+	{
+		if (Type->IsA(exporters[i].ClassName))
+			return true;
+	}
+	return false;
+	unguard;
+}
+
 
 // List of already exported objects
 
@@ -59,6 +77,12 @@ struct ExportedObjectEntry
 	,	HashNext(0)
 	{}
 
+	ExportedObjectEntry(const UnPackage* InPackage, int InExportIndex)
+	:	Package(InPackage)
+	,	ExportIndex(InExportIndex)
+	,	HashNext(0)
+	{}
+
 	int GetHash() const
 	{
 		return ( ((size_t)Package >> 3) ^ ExportIndex ^ (ExportIndex << 4) ) & (EXPORTED_LIST_HASH_SIZE - 1);
@@ -87,10 +111,14 @@ struct ExportContext
 	}
 
 	bool ItemExists(const UObject* Obj)
+	{
+		return ItemExists(ExportedObjectEntry(Obj));
+	}
+
+	bool ItemExists(const ExportedObjectEntry& item)
 	{
 		guard(ExportContext::ItemExists);
 
-		ExportedObjectEntry item(Obj);
 		int h = item.GetHash();
 //		appPrintf("Register: %s/%s/%s (%d) : ", Obj->Package->Name, Obj->GetClassName(), Obj->Name, ProcessedObjects.Num());
 
@@ -152,6 +180,10 @@ void EndExport(bool profile)
 	ctx.startTime = 0;
 
 	ctx.Reset();
+
+#if UNREAL3
+	UTexture2D::ReleaseTextureFileCache();
+#endif
 }
 
 // return 'false' if object already registered
@@ -173,6 +205,11 @@ bool IsObjectExported(const UObject* Obj)
 	return ctx.ItemExists(Obj);
 }
 
+bool IsObjectExported(const UnPackage* Package, int ExportIndex)
+{
+	return ctx.ItemExists(ExportedObjectEntry(Package, ExportIndex));
+}
+
 //todo: move to ExportContext and reset with ctx.Reset()?
 struct UniqueNameList
 {
@@ -210,6 +247,7 @@ bool ExportObject(const UObject *Obj)
 	guard(ExportObject);
 
 	if (!Obj) return false;
+	PROFILE_SCOPE("ExportObject");
 	if (strnicmp(Obj->Name, "Default__", 9) == 0)	// default properties object, nothing to export
 		return true;
 
@@ -284,6 +322,11 @@ void appSetBaseExportDirectory(const char *Dir)
 	strcpy(BaseExportDir, Dir);
 }
 
+const char* appGetBaseExportDirectory()
+{
+	return BaseExportDir[0] ? BaseExportDir : ".";
+}
+
 
 const char* GetExportPath(const UObject* Obj)
 {
@@ -407,6 +450,8 @@ bool CheckExportFilePresence(const UObject* Obj, const char* fmt, ...)
 }
 
 
+static void RegisterManifestFile(const char* Filename);
+
 FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const char* fmt, ...)
 {
 	guard(CreateExportArchive);
@@ -441,6 +486,9 @@ FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const ch
 		{
 			appPrintf("Export: file already exists %s\n", filename);
 			ctx.NumSkippedObjects++;
+			// existing file still belongs to the package, so it should be checked by next incremental run
+			if (GIncrementalExport)
+				RegisterManifestFile(filename);
 		}
 	}
 
@@ -455,7 +503,441 @@ FArchive* CreateExportArchive(const UObject* Obj, unsigned FileOptions, const ch
 
 	Ar->ArVer = 128;			// less than UE3 version (required at least for VJointPos structure)
 
+	if (GIncrementalExport)
+		RegisterManifestFile(filename);
+
 	return Ar;
 
 	unguard;
 }
+
+
+/*-----------------------------------------------------------------------------
+	Incremental export
+-----------------------------------------------------------------------------*/
+
+// Export manifest is a text file placed into the export directory. It contains the hash
+// of export options, and for every exported package: hash of package contents combined
+// with contents of directly imported packages, and list of files created while exporting
+// the package. When package contents and options were not changed, and all of the files
+// are still present on disk, the package could be skipped without loading. Content hash of
+// every game file is stored together with its size and modification time, so unchanged
+// files are not read again.
+
+bool GIncrementalExport = false;
+
+#define EXPORT_MANIFEST_NAME		"umodel_manifest.txt"
+#define MANIFEST_HASH_SIZE			4096
+
+struct CExportManifestEntry
+{
+	FString			PackageName;		// relative package file name
+	uint64			ContentHash;
+	TArray<FString>	Files;				// relative to export directory
+	int				HashNext;
+};
+
+struct CManifestGameFile
+{
+	FString			Name;				// relative game file name
+	uint64			Stamp;				// hash of file size and modification time, 0 when unknown
+	uint64			ContentHash;
+	int				HashNext;
+	bool			IsChecked;			// stamp was verified in this session
+};
+
+struct CExportManifest
+{
+	uint64			OptionsHash;
+	TArray<CExportManifestEntry> Entries;
+	int				Hash[MANIFEST_HASH_SIZE];
+	TArray<CManifestGameFile> GameFiles;
+	int				GameFileHash[MANIFEST_HASH_SIZE];
+	bool			IsLoaded;
+	bool			IsDirty;
+
+	// Information about currently exported package
+	uint64			PackageHash;
+	TArray<FString>	PackageFiles;
+
+	CExportManifest()
+	:	IsLoaded(false)
+	{}
+
+	static int GetNameHash(const char* Name)
+	{
+		unsigned h = 0;
+		for (const char* s = Name; *s; s++)
+		{
+			char c = tolower(*s);
+			if (c == '\\') c = '/';
+			h = (h ^ c) * 16777619;
+		}
+		return (h ^ (h >> 16)) & (MANIFEST_HASH_SIZE - 1);
+	}
+
+	void Reset()
+	{
+		Entries.Empty(1024);
+		memset(Hash, -1, sizeof(Hash));
+		GameFiles.Empty(1024);
+		memset(GameFileHash, -1, sizeof(GameFileHash));
+		PackageFiles.Empty();
+	}
+
+	CExportManifestEntry* Find(const char* PackageName)
+	{
+		for (int i = Hash[GetNameHash(PackageName)]; i >= 0; i = Entries[i].HashNext)
+		{
+			if (!stricmp(*Entries[i].PackageName, PackageName))
+				return &Entries[i];
+		}
+		return NULL;
+	}
+
+	CExportManifestEntry* FindOrAdd(const char* PackageName)
+	{
+		CExportManifestEntry* Entry = Find(PackageName);
+		if (Entry) return Entry;
+		int h = GetNameHash(PackageName);
+		int index = Entries.Num();
+		Entry = new (Entries) CExportManifestEntry;
+		Entry->PackageName = PackageName;
+		Entry->ContentHash = 0;
+		Entry->HashNext = Hash[h];
+		Hash[h] = index;
+		return Entry;
+	}
+
+	CManifestGameFile* FindOrAddGameFile(const char* Filename)
+	{
+		int h = GetNameHash(Filename);
+		for (int i = GameFileHash[h]; i >= 0; i = GameFiles[i].HashNext)
+		{
+			if (!stricmp(*GameFiles[i].Name, Filename))
+				return &GameFiles[i];
+		}
+		int index = GameFiles.Num();
+		CManifestGameFile* File = new (GameFiles) CManifestGameFile;
+		File->Name = Filename;
+		File->Stamp = 0;
+		File->ContentHash = 0;
+		File->IsChecked = false;
+		File->HashNext = GameFileHash[h];
+		GameFileHash[h] = index;
+		return File;
+	}
+};
+
+static CExportManifest Manifest;
+
+static const char* GetManifestFileName()
+{
+	static char buf[1024];
+	appSprintf(ARRAY_ARG(buf), "%s/" EXPORT_MANIFEST_NAME, BaseExportDir[0] ? BaseExportDir : ".");
+	return buf;
+}
+
+void LoadExportManifest(const char* OptionsKey)
+{
+	guard(LoadExportManifest);
+
+	if (!BaseExportDir[0])
+		appSetBaseExportDirectory(".");
+
+	Manifest.Reset();
+	Manifest.IsLoaded = true;
+	Manifest.IsDirty = false;
+
+	// Combine externally provided options with the options used by exporters
+	char OptionsBuf[1024];
+	appSprintf(ARRAY_ARG(OptionsBuf), "%s|%d%d%d%d%d%d%d", OptionsKey,
+		GExportScripts, GExportLods, GNoTgaCompress, GExportPNG, GExportDDS, GUncook, GUseGroups);
+	Manifest.OptionsHash = appMemHash64(OptionsBuf, strlen(OptionsBuf));
+
+	FILE* f = fopen(GetManifestFileName(), "r");
+	if (!f) return;
+
+	char line[2048];
+	bool bValid = false;
+	CExportManifestEntry* Entry = NULL;
+	while (fgets(line, sizeof(line), f))
+	{
+		// strip line feed
+		char* s = strchr(line, 0);
+		while (s > line && (s[-1] == '\n' || s[-1] == '\r')) *--s = 0;
+
+		if (!strncmp(line, "options ", 8))
+		{
+			uint64 value = 0;
+			bValid = (sscanf(line + 8, "%llx", &value) == 1) && (value == Manifest.OptionsHash);
+			if (!bValid) break;
+		}
+		else if (!bValid)
+		{
+			// "options" line should go first
+			break;
+		}
+		else if (!strncmp(line, "package ", 8))
+		{
+			uint64 value = 0;
+			int pos = 0;
+			if (sscanf(line + 8, "%llx %n", &value, &pos) < 1 || !pos) break;
+			Entry = Manifest.FindOrAdd(line + 8 + pos);
+			Entry->ContentHash = value;
+			Entry->Files.Empty();
+		}
+		else if (!strncmp(line, "gamefile ", 9))
+		{
+			uint64 stamp = 0, value = 0;
+			int pos = 0;
+			if (sscanf(line + 9, "%llx %llx %n", &stamp, &value, &pos) < 2 || !pos) break;
+			CManifestGameFile* File = Manifest.FindOrAddGameFile(line + 9 + pos);
+			File->Stamp = stamp;
+			File->ContentHash = value;
+		}
+		else if (!strncmp(line, "file ", 5) && Entry)
+		{
+			new (Entry->Files) FString(line + 5);
+		}
+	}
+	fclose(f);
+
+	if (!bValid)
+	{
+		appPrintf("Export options were changed, performing full export\n");
+		Manifest.Reset();
+		Manifest.IsDirty = true;		// rewrite with the new options hash
+	}
+
+	unguard;
+}
+
+void SaveExportManifest()
+{
+	guard(SaveExportManifest);
+
+	if (!Manifest.IsLoaded) return;
+	Manifest.IsLoaded = false;
+
+	if (!Manifest.IsDirty) return;
+
+	const char* filename = GetManifestFileName();
+	appMakeDirectoryForFile(filename);
+	FILE* f = fopen(filename, "w");
+	if (!f)
+	{
+		appPrintf("Error creating file \"%s\" ...\n", filename);
+		return;
+	}
+	fprintf(f, "options %016llx\n", (unsigned long long)Manifest.OptionsHash);
+	for (const CManifestGameFile& File : Manifest.GameFiles)
+	{
+		if (File.Stamp)
+			fprintf(f, "gamefile %016llx %016llx %s\n", (unsigned long long)File.Stamp, (unsigned long long)File.ContentHash, *File.Name);
+	}
+	for (const CExportManifestEntry& Entry : Manifest.Entries)
+	{
+		fprintf(f, "package %016llx %s\n", (unsigned long long)Entry.ContentHash, *Entry.PackageName);
+		for (const FString& File : Entry.Files)
+			fprintf(f, "file %s\n", *File);
+	}
+	fclose(f);
+
+	Manifest.Reset();
+
+	unguard;
+}
+
+// Hash file contents
+static uint64 HashGameFile(const CGameFileInfo* info)
+{
+	guard(HashGameFile);
+
+	uint64 Hash = 0;
+	FArchive* Ar = info->CreateReader();
+	if (!Ar) return Hash;
+
+	int64 size = Ar->GetFileSize64();
+	Hash = appMemHash64(&size, sizeof(size), Hash);
+
+	// Hash the file in fixed-size pieces, so the result doesn't depend on anything but contents
+	const int BufferSize = 1 << 20;
+	byte* Buffer = (byte*)appMalloc(BufferSize);
+	for (int64 pos = 0; pos < size; pos += BufferSize)
+	{
+		int len = (size - pos < BufferSize) ? int(size - pos) : BufferSize;
+		Ar->Serialize(Buffer, len);
+		Hash = appMemHash64(Buffer, len, Hash);
+	}
+	appFree(Buffer);
+	delete Ar;
+
+	return Hash;
+
+	unguardf("%s", *info->GetRelativeName());
+}
+
+// Get hash of file contents. File is read only when its size or modification time differs
+// from values stored in manifest.
+static uint64 GetGameFileHash(const CGameFileInfo* info)
+{
+	guard(GetGameFileHash);
+
+	FStaticString<MAX_PACKAGE_PATH> RelativeName;
+	info->GetRelativeName(RelativeName);
+	CManifestGameFile* File = Manifest.FindOrAddGameFile(*RelativeName);
+	if (File->IsChecked) return File->ContentHash;
+	File->IsChecked = true;
+
+	uint64 Stamp = 0;
+	int64 Time;
+	if (info->GetModificationTime(Time))
+	{
+		int64 Values[2] = { info->Size, Time };
+		Stamp = appMemHash64(Values, sizeof(Values));
+		if (!Stamp) Stamp = 1;				// 0 is reserved for "unknown"
+	}
+	if (Stamp && Stamp == File->Stamp)
+		return File->ContentHash;
+
+	File->Stamp = Stamp;
+	File->ContentHash = HashGameFile(info);
+	Manifest.IsDirty = true;
+	return File->ContentHash;
+
+	unguard;
+}
+
+static void HashGameFile(const char* Filename, uint64& Hash)
+{
+	const CGameFileInfo* info = appFindGameFile(Filename);
+	if (info)
+	{
+		uint64 FileHash = GetGameFileHash(info);
+		Hash = appMemHash64(&FileHash, sizeof(FileHash), Hash);
+	}
+}
+
+static uint64 GetPackageContentHash(const UnPackage* Package)
+{
+	guard(GetPackageContentHash);
+
+	uint64 Hash = 0;
+	HashGameFile(Package->Filename, Hash);
+
+#if UNREAL4
+	if (Package->Game >= GAME_UE4_BASE)
+	{
+		// Include contents of the files which are paired with package
+		static const char* additionalExtensions[] =
+		{
+			".uexp",
+			".ubulk",
+			".uptnl",
+		};
+		char buf[MAX_PACKAGE_PATH];
+		appStrncpyz(buf, Package->Filename, ARRAY_COUNT(buf));
+		char* s = strrchr(buf, '.');
+		if (!s) s = strchr(buf, 0);
+		for (int ext = 0; ext < ARRAY_COUNT(additionalExtensions); ext++)
+		{
+			appStrncpyz(s, additionalExtensions[ext], ARRAY_COUNT(buf) - (s - buf));
+			HashGameFile(buf, Hash);
+		}
+	}
+#endif // UNREAL4
+
+	// Exported objects may pull materials, textures etc from other packages, so include
+	// contents of directly imported packages
+	TArray<const char*> Imported;
+	for (int i = 0; i < Package->Summary.ImportCount; i++)
+	{
+		// find outermost package, limit depth to not hang on corrupted data
+		const FObjectImport* Imp = &Package->GetImport(i);
+		for (int Depth = 0; Imp->PackageIndex < 0 && Depth < 256; Depth++)
+			Imp = &Package->GetImport(-Imp->PackageIndex - 1);
+		if (Imp->PackageIndex != 0) continue;
+		const char* PackageName = Imp->ObjectName;
+		bool bFound = false;
+		for (int j = 0; j < Imported.Num(); j++)
+		{
+			if (!stricmp(Imported[j], PackageName))
+			{
+				bFound = true;
+				break;
+			}
+		}
+		if (bFound) continue;
+		Imported.Add(PackageName);
+		const CGameFileInfo* info = appFindGameFile(PackageName);
+		if (info && info->IsPackage)
+		{
+			uint64 FileHash = GetGameFileHash(info);
+			Hash = appMemHash64(&FileHash, sizeof(FileHash), Hash);
+		}
+	}
+
+	return Hash;
+
+	unguardf("%s", Package->Filename);
+}
+
+bool IsPackageExportUpToDate(const UnPackage* Package)
+{
+	guard(IsPackageExportUpToDate);
+
+	Manifest.PackageFiles.Empty();
+	if (!Manifest.IsLoaded) return false;
+
+	Manifest.PackageHash = GetPackageContentHash(Package);
+
+	const CExportManifestEntry* Entry = Manifest.Find(Package->Filename);
+	if (!Entry || Entry->ContentHash != Manifest.PackageHash)
+		return false;
+
+	// Package wasn't changed, verify if exported files are still present
+	for (const FString& File : Entry->Files)
+	{
+		char buf[1024];
+		appSprintf(ARRAY_ARG(buf), "%s/%s", BaseExportDir, *File);
+		if (!appFileExists(buf))
+			return false;
+	}
+
+	return true;
+
+	unguardf("%s", Package->Filename);
+}
+
+void CommitPackageExport(const UnPackage* Package)
+{
+	guard(CommitPackageExport);
+
+	if (!Manifest.IsLoaded) return;
+
+	CExportManifestEntry* Entry = Manifest.FindOrAdd(Package->Filename);
+	Entry->ContentHash = Manifest.PackageHash;
+	Exchange(Entry->Files, Manifest.PackageFiles);
+	Manifest.PackageFiles.Empty();
+	Manifest.IsDirty = true;
+
+	unguardf("%s", Package->Filename);
+}
+
+// Called by CreateExportArchive() to remember files created for the current package
+static void RegisterManifestFile(const char* Filename)
+{
+	if (!Manifest.IsLoaded) return;
+
+	// Store the name relative to export directory
+	int len = strlen(BaseExportDir);
+	if (!strncmp(Filename, BaseExportDir, len) && Filename[len] == '/')
+		Filename += len + 1;
+
+	for (const FString& File : Manifest.PackageFiles)
+	{
+		if (File == Filename) return;
+	}
+	new (Manifest.PackageFiles) FString(Filename);
+}
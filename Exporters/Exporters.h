@@ -1,11 +1,15 @@
 #ifndef __EXPORT_H__
 #define __EXPORT_H__
 
+class UnPackage;
+
 
 // registration
 typedef void (*ExporterFunc_t)(const UObject*);
 
 void RegisterExporter(const char *ClassName, ExporterFunc_t Func);
+// Returns 'true' if there's an exporter for objects of this class
+bool IsExportableClass(const char* ClassName);
 
 // wrapper to avoid typecasts to ExporterFunc_t
 // T should be an UObject-derived class
@@ -21,11 +25,14 @@ void EndExport(bool profile = false);
 
 // Returns 'true' if Obj has been already exported during current export process
 bool IsObjectExported(const UObject* Obj);
+// The same, but doesn't require object to be loaded
+bool IsObjectExported(const UnPackage* Package, int ExportIndex);
 
 bool ExportObject(const UObject *Obj);
 
 // path
 void appSetBaseExportDirectory(const char *Dir);
+const char* appGetBaseExportDirectory();
 const char* GetExportPath(const UObject *Obj);
 
 const char* GetExportFileName(const UObject *Obj, const char *fmt, ...);
@@ -36,6 +43,17 @@ bool CheckExportFilePresence(const UObject *Obj, const char *fmt, ...);
 // Function may return NULL.
 FArchive *CreateExportArchive(const UObject *Obj, unsigned FileOptions, const char *fmt, ...);
 
+// Incremental export. Manifest is stored in export directory and lists hashes of exported packages
+// contents together with files created for them. OptionsKey should describe export settings which
+// aren't visible to exporters (file formats etc), changing them will invalidate the manifest.
+void LoadExportManifest(const char* OptionsKey);
+void SaveExportManifest();
+// Returns 'true' if package contents were not changed since the previous export and all exported files
+// are present. Should be called before exporting a package.
+bool IsPackageExportUpToDate(const UnPackage* Package);
+// Record files exported for the package after successful export
+void CommitPackageExport(const UnPackage* Package);
+
 // configuration
 extern bool GExportScripts;
 extern bool GExportLods;
@@ -45,6 +63,8 @@ extern bool GExportDDS;
 extern bool GUncook;
 extern bool GUseGroups;
 extern bool GDontOverwriteFiles;
+extern bool GIncrementalExport;
+extern bool GStreamedExport;
 
 // forwards
 class UObject;
@@ -68,9 +88,9 @@ void ExportStaticMesh(const CStaticMesh *Mesh);
 // MD5Mesh
 void ExportMd5Mesh(const CSkeletalMesh *Mesh);
 void ExportMd5Anim(const CAnimSet *Anim);
-// glTF
-void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh);
-void ExportStaticMeshGLTF(const CStaticMesh* Mesh);
+// glTF, bBinary = true will produce a single glb file
+void ExportSkeletalMeshGLTF(const CSkeletalMesh* Mesh, bool bBinary = false);
+void ExportStaticMeshGLTF(const CStaticMesh* Mesh, bool bBinary = false);
 // 3D
 void Export3D(const UVertMesh *Mesh);
 // TGA, DDS
@@ -86,7 +106,7 @@ void ExportGfx(const USwfMovie *Swf);
 void ExportFaceFXAnimSet(const UFaceFXAnimSet *Fx);
 void ExportFaceFXAsset(const UFaceFXAsset *Fx);
 
-void WriteTGA(FArchive &Ar, int width, int height, byte *pic);
+void WriteTGA(FArchive &Ar, int width, int height, byte *pic, bool isBGRA = false);
 
 
 #endif // __EXPORT_H__
@@ -237,11 +237,11 @@ protected:
 	// all of the following data is resides inside "DataBlock", aligned to 16 bytes
 	struct CMeshBoneData* BoneData;
 	struct CSkinVert*	Skinned;			// soft-skinned vertices
-	struct CSkelMeshVertex* MorphedVerts;
 
 	CVec3*				InfColors;			// debug: color-by-influence for vertices
+	class CMorphEvaluator* Morpher;			// NULL when mesh has no morph targets
 	int					LastLodIndex;		// used to detect requirement to rebuild InfColors[]
-	int					LastMorphIndex;		// used to detect requirement to rebuild MorphedVerts[]
+	int					LastMorphIndex;		// used to detect requirement to update morph weights
 	// animation state
 	CAnimChan	Channels[MAX_SKELANIMCHANNELS];
 	int			MaxAnimChannel;
@@ -99,6 +99,7 @@ CSkelMeshInstance::CSkelMeshInstance()
 ,	BoneData(NULL)
 ,	Skinned(NULL)
 ,	InfColors(NULL)
+,	Morpher(NULL)
 {
 	ClearSkelAnims();
 }
@@ -108,7 +109,12 @@ CSkelMeshInstance::~CSkelMeshInstance()
 {
 	if (DataBlock) appFree(DataBlock);
 	if (InfColors) delete[] InfColors;
-	if (pMesh) pMesh->UnlockMaterials();
+	if (Morpher) delete Morpher;
+	if (pMesh)
+	{
+		pMesh->UnlockMaterials();
+		pMesh->UnlockVerts();
+	}
 }
 
 
@@ -179,6 +185,7 @@ void CSkelMeshInstance::SetMesh(CSkeletalMesh *Mesh)
 	assert(pMesh == NULL);
 	pMesh = Mesh;
 	pMesh->LockMaterials();
+	pMesh->LockVerts();
 
 	// orientation
 
@@ -203,13 +210,18 @@ void CSkelMeshInstance::SetMesh(CSkeletalMesh *Mesh)
 		delete[] InfColors;
 		InfColors = NULL;
 	}
+	if (Morpher)
+	{
+		delete Morpher;
+		Morpher = NULL;
+	}
 	// allocate data arrays in a single block
-	int NumMorphVerts = Mesh->Morphs.Num() ? NumVerts : 0;
-	int DataSize = sizeof(CMeshBoneData) * NumBones + sizeof(CSkinVert) * NumVerts + sizeof(CSkelMeshVertex) * NumMorphVerts;
+	int DataSize = sizeof(CMeshBoneData) * NumBones + sizeof(CSkinVert) * NumVerts;
 	DataBlock = appMalloc(DataSize, 16);
 	BoneData  = (CMeshBoneData*)DataBlock;
 	Skinned   = (CSkinVert*)(BoneData + NumBones);
-	MorphedVerts = Mesh->Morphs.Num() ? (CSkelMeshVertex*)(Skinned + NumVerts) : NULL;
+	if (Mesh->Morphs.Num())
+		Morpher = new CMorphEvaluator;	// will be initialized in BuildMorphVerts()
 
 	LastLodIndex = -2;
 	LastMorphIndex = -1;
@@ -1013,7 +1025,7 @@ void CSkelMeshInstance::SkinMeshVerts()
 
 	memset(Skinned, 0, sizeof(CSkinVert) * NumVerts);
 
-	const CSkelMeshVertex* MeshVerts = BuildMorphVerts() ? MorphedVerts : Mesh.Verts;
+	const CSkelMeshVertex* MeshVerts = BuildMorphVerts() ? Morpher->GetVerts() : Mesh.Verts;
 
 	for (int i = 0; i < NumVerts; i++)
 	{
@@ -1419,54 +1431,29 @@ bool CSkelMeshInstance::BuildMorphVerts()
 {
 	guard(CSkelMeshInstance::BuildMorphVerts);
 
-	if (MorphIndex < 0)
-	{
-		// Morph is inactive
-		return false;
-	}
-
-	if (LodIndex >= pMesh->Morphs[MorphIndex]->Lods.Num())
+	if (!Morpher)
 	{
-		// No morph information for this LOD
+		// Mesh has no morphs
 		return false;
 	}
 
-	if (LastMorphIndex == MorphIndex)
+	if (Morpher->GetLodIndex() != LodIndex)
 	{
-		// Already built
-		return true;
+		// Note: weights are preserved
+		Morpher->SetMesh(pMesh, LodIndex);
 	}
-	LastMorphIndex = MorphIndex;
-
-	const CSkelMeshLod& Lod = pMesh->Lods[LodIndex];
-	const TArray<CMorphVertex>& Deltas = pMesh->Morphs[MorphIndex]->Lods[LodIndex].Vertices;
-
-	// Copy unmodified vertices
-	memcpy(MorphedVerts, Lod.Verts, Lod.NumVerts * sizeof(CSkelMeshVertex));
 
-	// Apply deltas
-	for (const CMorphVertex& Delta : Deltas)
+	if (LastMorphIndex != MorphIndex)
 	{
-		CSkelMeshVertex& V = MorphedVerts[Delta.VertexIndex];
-		// Morph position
-		VectorAdd(V.Position, Delta.PositionDelta, V.Position);
-		// Morph normal
-		CVec3 Normal;
-		int8 W = V.Normal.GetW();
-		Unpack(Normal, V.Normal);
-		VectorAdd(Normal, Delta.NormalDelta, Normal);
-		Pack(V.Normal, Normal);
-		V.Normal.SetW(W);
-		// Adjust tangent vector to make basis orthonormal
-		CVec3 Tangent;
-		Unpack(Tangent, V.Tangent);
-		float shift = dot(Normal, Tangent); // it will be zero if vertices are perpendicular
-		VectorMA(Tangent, -shift, Normal);  // shift alongside the normal to make vertices perpendicular again
-		Tangent.NormalizeFast();            // ensure result is normalized
-		Pack(V.Tangent, Tangent);
+		// Viewer displays a single morph at full weight
+		Morpher->ResetWeights();
+		if (MorphIndex >= 0)
+			Morpher->SetWeight(MorphIndex, 1.0f);
+		LastMorphIndex = MorphIndex;
 	}
 
-	return true;
+	// Only vertices affected by the changed morphs are rebuilt here
+	return Morpher->Evaluate();
 
 	unguard;
 }
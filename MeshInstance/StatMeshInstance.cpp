@@ -17,7 +17,11 @@
 
 CStatMeshInstance::~CStatMeshInstance()
 {
-	if (pMesh) pMesh->UnlockMaterials();
+	if (pMesh)
+	{
+		pMesh->UnlockMaterials();
+		pMesh->UnlockVerts();
+	}
 }
 
 void CStatMeshInstance::SetMesh(CStaticMesh *Mesh)
@@ -25,6 +29,7 @@ void CStatMeshInstance::SetMesh(CStaticMesh *Mesh)
 	assert(pMesh == NULL);
 	pMesh = Mesh;
 	pMesh->LockMaterials();
+	pMesh->LockVerts();
 }
 
 void CStatMeshInstance::Draw(unsigned flags)
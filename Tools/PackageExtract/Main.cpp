@@ -2,6 +2,7 @@
 #include "UnCore.h"
 #include "UnPackage.h"
 #include "GameDatabase.h"
+#include "Parallel.h"
 
 #define MAKE_DIRS		1
 //#define DISABLE_WRITE	1		// for quick testing of extraction
@@ -74,6 +75,64 @@ static bool FilterClass(const char *ClassName)	//?? check logic: filter = pass o
 }
 
 
+/*-----------------------------------------------------------------------------
+	Writing extracted files
+-----------------------------------------------------------------------------*/
+
+// Object data is read from the package in the main thread, then files are written
+// by worker threads. Limit amount of data held in memory.
+#define MAX_BATCH_SIZE		(64 << 20)
+#define MAX_BATCH_FILES		1024
+
+struct CExtractedFile
+{
+	int			ExportIndex;
+	FString		Filename;
+	byte		*Data;
+	int			Size;
+};
+
+struct CExtractBatch
+{
+	TArray<CExtractedFile> Files;
+	int			DataSize;
+	int			ExportCount;
+};
+
+static void WriteExtractedFile(int Index, CExtractBatch& Batch)
+{
+	const CExtractedFile& File = Batch.Files[Index];
+	guard(WriteFile);
+#if !DISABLE_WRITE
+	appMakeDirectoryForFile(*File.Filename);
+	FILE *f = fopen(*File.Filename, "wb");
+	if (!f)
+	{
+		//!! note: cannot create file with name "con" (any extension)
+		appPrintf("%d/%d: unable to create file %s\n", File.ExportIndex, Batch.ExportCount, *File.Filename);
+		return;
+	}
+	fwrite(File.Data, File.Size, 1, f);
+	fclose(f);
+#endif // !DISABLE_WRITE
+	unguardf("file=%s", *File.Filename);
+}
+
+static void FlushBatch(CExtractBatch& Batch)
+{
+	guard(FlushBatch);
+	if (!Batch.Files.Num()) return;
+	appParallelFor(Batch.Files.Num(), WriteExtractedFile, Batch);
+	// notification
+	printf("Done: %d/%d ...\r", Batch.Files[Batch.Files.Num() - 1].ExportIndex, Batch.ExportCount);
+	for (int i = 0; i < Batch.Files.Num(); i++)
+		delete[] Batch.Files[i].Data;
+	Batch.Files.Empty(MAX_BATCH_FILES);
+	Batch.DataSize = 0;
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Main function
 -----------------------------------------------------------------------------*/
@@ -105,6 +164,8 @@ int main(int argc, char **argv)
 				"    -out=PATH       extract everything into PATH instead of the current directory\n"
 				"    -lzo|lzx|zlib   force compression method for fully-compressed packages\n"
 				"    -log=file       write log to the specified file\n"
+				"    -j N            number of threads used for decompression and writing\n"
+				"                    files, default is number of CPU cores\n"
 				"    -taglist        list of tags to override game autodetection\n"
 				"    -help           display this help page\n"
 				"\n"
@@ -159,6 +220,16 @@ int main(int argc, char **argv)
 		{
 			appOpenLogFile(opt+4);
 		}
+		else if (!stricmp(opt, "j"))
+		{
+			int threads = (arg + 1 < argc) ? atoi(argv[++arg]) : 0;
+			if (threads < 1)
+			{
+				appPrintf("ERROR: invalid thread count for -j option\n");
+				return 1;
+			}
+			GNumThreads = threads;
+		}
 		else if (!strnicmp(opt, "path=", 5))
 		{
 			appSetRootDirectory(opt+5);
@@ -252,6 +323,10 @@ int main(int argc, char **argv)
 	appMakeDirectoryForFile(buf2);
 	f = fopen(buf2, "w");
 	assert(f);
+	CExtractBatch Batch;
+	Batch.Files.Empty(MAX_BATCH_FILES);
+	Batch.DataSize = 0;
+	Batch.ExportCount = Package->Summary.ExportCount;
 	for (idx = 0; idx < Package->Summary.ExportCount; idx++)
 	{
 		FObjectExport &Exp = Package->ExportTable[idx];
@@ -275,33 +350,34 @@ int main(int argc, char **argv)
 		GetFullExportFileName(Exp, Package, ARRAY_ARG(objName));
 		appSprintf(ARRAY_ARG(buf2), "%s/%s/%s", BaseDir, PkgName, objName);
 #endif
-		guard(WriteFile);
-		// read data
-		byte *data = new byte[Exp.SerialSize];
-		if (Exp.SerialSize)
+		// Several exports could map to the same file, the last one should win. Files of one
+		// batch are written in parallel, so write the previous batch first.
+		for (int i = 0; i < Batch.Files.Num(); i++)
 		{
-			Package->Seek(Exp.SerialOffset);
-			Package->Serialize(data, Exp.SerialSize);
+			if (!stricmp(*Batch.Files[i].Filename, buf2))
+			{
+				FlushBatch(Batch);
+				break;
+			}
 		}
-#if !DISABLE_WRITE
-		appMakeDirectoryForFile(buf2);
-		FILE *f2 = fopen(buf2, "wb");
-		if (!f2)
+		guard(ReadObject);
+		// read data, it will be written later with the whole batch
+		CExtractedFile* File = new (Batch.Files) CExtractedFile;
+		File->ExportIndex = idx;
+		File->Filename = buf2;
+		File->Data = new byte[Exp.SerialSize];
+		File->Size = Exp.SerialSize;
+		if (Exp.SerialSize)
 		{
-			//!! note: cannot create file with name "con" (any extension)
-			printf("%d/%d: unable to create file %s\n", idx, Package->Summary.ExportCount, buf2);
-			continue;
+			Package->Seek(Exp.SerialOffset);
+			Package->Serialize(File->Data, Exp.SerialSize);
 		}
-		// write data
-		fwrite(data, Exp.SerialSize, 1, f2);
-		fclose(f2);
-#endif // !DISABLE_WRITE
-		// cleanup
-		delete data;
+		Batch.DataSize += Exp.SerialSize;
 		unguardf("file=%s", buf2);
-		// notification
-		printf("Done: %d/%d ...\r", idx, Package->Summary.ExportCount);
+		if (Batch.DataSize >= MAX_BATCH_SIZE || Batch.Files.Num() >= MAX_BATCH_FILES)
+			FlushBatch(Batch);
 	}
+	FlushBatch(Batch);
 	fclose(f);
 	printf("Done ...             \n");
 	unguard;
@@ -2,22 +2,60 @@
 #include "UnrealClasses.h"
 #include "UnPackage.h"
 #include "GameDatabase.h"
+#include "Parallel.h"
+
+#if __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#endif
 
 #define DEF_UNP_DIR		"unpacked"
 #define HOMEPAGE		"https://www.gildor.org/"
 
+// Large reads let compressed package reader to decompress many blocks in parallel
+#define COPY_BUFFER_SIZE	(1 << 20)
+
 
 static void CopyStream(FArchive *Src, FILE *Dst, int Count)
 {
-	byte buffer[16384];
+	byte *buffer = (byte*)appMalloc(COPY_BUFFER_SIZE);
 
 	while (Count > 0)
 	{
-		int Size = min(Count, sizeof(buffer));
+		int Size = min(Count, COPY_BUFFER_SIZE);
 		Src->Serialize(buffer, Size);
 		if (fwrite(buffer, Size, 1, Dst) != 1) appError("Write failed");
 		Count -= Size;
 	}
+
+	appFree(buffer);
+}
+
+// Copy the whole file without passing data through user space. Returns false if
+// this is not supported, nothing is written in this case.
+static bool CopyFileFast(const char *SrcFilename, FILE *Dst, int64 Count)
+{
+#if __linux__
+	int src = open(SrcFilename, O_RDONLY);
+	if (src < 0) return false;
+	fflush(Dst);
+	int dst = fileno(Dst);
+	off_t pos = 0;
+	while (pos < Count)
+	{
+		ssize_t done = sendfile(dst, src, &pos, Count - pos);
+		if (done <= 0) break;
+	}
+	close(src);
+	if (pos == Count) return true;
+	// failed, rewind the destination file
+	lseek(dst, 0, SEEK_SET);
+	ftruncate(dst, 0);
+	return false;
+#else
+	return false;
+#endif
 }
 
 #if UNREAL4
@@ -62,6 +100,8 @@ int main(int argc, char **argv)
 				"    -out=PATH       extract everything into PATH, default is \"" DEF_UNP_DIR "\"\n"
 				"    -lzo|lzx|zlib   force compression method for fully-compressed packages\n"
 				"    -log=file       write log to the specified file\n"
+				"    -j N            number of threads used for decompression, default is\n"
+				"                    number of CPU cores\n"
 				"    -taglist        list of tags to override game autodetection\n"
 				"    -help           display this help page\n"
 				"\n"
@@ -101,6 +141,16 @@ int main(int argc, char **argv)
 		{
 			appOpenLogFile(opt+4);
 		}
+		else if (!stricmp(opt, "j"))
+		{
+			int threads = (arg + 1 < argc) ? atoi(argv[++arg]) : 0;
+			if (threads < 1)
+			{
+				appPrintf("ERROR: invalid thread count for -j option\n");
+				return 1;
+			}
+			GNumThreads = threads;
+		}
 		else if (!strnicmp(opt, "path=", 5))
 		{
 			appSetRootDirectory(opt+5);
@@ -304,8 +354,13 @@ int main(int argc, char **argv)
 		// uncompressed package or fully compressed package
 		guard(LoadFullyCompressedPackage);
 
-		Package->Seek(0);
-		CopyStream(Package, out, uncompressedSize);
+		// uncompressed package stored in a regular file could be copied as is
+		FFileArchive *File = Package->Loader->CastTo<FFileReader>();
+		if (!File || !CopyFileFast(File->GetFilename(), out, uncompressedSize))
+		{
+			Package->Seek(0);
+			CopyStream(Package, out, uncompressedSize);
+		}
 
 		unguard;
 	}
@@ -0,0 +1,779 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "UnObject.h"
+#include "UnMaterial.h"
+#include "UnMathTools.h"		// CVertexShare
+#include "StaticMesh.h"
+#include "UnTexturePNG.h"
+
+#include "Exporters/Exporters.h"
+#include "Profiler.h"			// appCycles64
+#include "UmodelCommands.h"
+
+#if UNREAL4
+#include "GameFileSystem.h"
+#include "UnArchivePak.h"
+#endif
+
+#include <zlib.h>
+#if USE_LZ4
+#include "lz4/lz4.h"
+#endif
+#include "rijndael/rijndael.h"
+
+#if SUPPORT_ANDROID
+#include "libs/astc/astc_codec_internals.h"
+#endif
+
+/*-----------------------------------------------------------------------------
+	Built-in benchmarks
+
+	All input data is generated, so results could be compared between runs and
+	between machines. Every benchmark prints a line in the following format:
+	bench,<name>,<iterations>,<ms per iteration>,<MB/s>,<ops/s>
+	MB/s is computed for uncompressed (decoded) data size. Results are the only
+	text printed to stdout, all other messages are redirected to stderr, so the
+	output could be used as csv file.
+-----------------------------------------------------------------------------*/
+
+// Benchmark is repeated until it takes at least this number of milliseconds
+#define BENCH_MIN_TIME			1000
+#define BENCH_MAX_ITERATIONS	100
+
+// Key for pak files generated by benchmark, 32 characters for AES-256
+#define BENCH_AES_KEY			"UmodelBenchmarkAesKey0123456789!"
+
+static const char* GBenchFilter = NULL;
+static char GBenchDir[512];
+
+static bool BenchGroupEnabled(const char* Group)
+{
+	if (!GBenchFilter || !GBenchFilter[0]) return true;
+	// Filter is a comma-separated list of group names
+	int len = strlen(Group);
+	for (const char* s = GBenchFilter; s; )
+	{
+		if (!strnicmp(s, Group, len) && (s[len] == 0 || s[len] == ','))
+			return true;
+		s = strchr(s, ',');
+		if (s) s++;
+	}
+	return false;
+}
+
+typedef void (*BenchFunc_t)(void* Param);
+
+// Run the function several times and print results. Bytes and Ops are amount of work done
+// in a single call of the function.
+static void RunBenchmark(const char* Name, BenchFunc_t Func, void* Param, double Bytes, double Ops)
+{
+	guard(RunBenchmark);
+
+	int64 TotalTime = 0;
+	int Iterations = 0;
+	while (Iterations < BENCH_MAX_ITERATIONS)
+	{
+		int64 Time = appCycles64();
+		Func(Param);
+		TotalTime += appCycles64() - Time;
+		Iterations++;
+		if (appCyclesToMsec(TotalTime) >= BENCH_MIN_TIME) break;
+	}
+
+	double Msec = appCyclesToMsec(TotalTime);
+	double Sec = Msec / 1000.0;
+	if (Sec <= 0) Sec = 1e-9;
+	fprintf(stdout, "bench,%s,%d,%.3f,%.2f,%.2f\n", Name, Iterations, Msec / Iterations,
+		Bytes * Iterations / Sec / (1024 * 1024), Ops * Iterations / Sec);
+	fflush(stdout);
+
+	unguardf("%s", Name);
+}
+
+// Simple deterministic random number generator, results should not depend on platform
+struct CBenchRandom
+{
+	uint32		Seed;
+
+	CBenchRandom(uint32 InSeed)
+	:	Seed(InSeed)
+	{}
+
+	FORCEINLINE uint32 Next()
+	{
+		Seed = Seed * 1664525 + 1013904223;
+		return Seed >> 8;
+	}
+
+	void Fill(byte* Data, int Size)
+	{
+		for (int i = 0; i < Size; i++)
+			Data[i] = (byte)Next();
+	}
+};
+
+// Fill buffer with data which is compressed approximately like game assets do
+static void GenerateCompressibleData(byte* Data, int Size, CBenchRandom& Rand)
+{
+	int Pos = 0;
+	while (Pos < Size)
+	{
+		uint32 r = Rand.Next();
+		int Len = (r & 31) + 1;
+		if (Len > Size - Pos) Len = Size - Pos;
+		if ((r >> 5) & 1)
+		{
+			// run of repeated bytes
+			memset(Data + Pos, (r >> 8) & 0xFF, Len);
+		}
+		else if (Pos >= 256 && ((r >> 6) & 1))
+		{
+			// repeat previous data
+			memcpy(Data + Pos, Data + Pos - 1 - ((r >> 8) & 255), Len);
+		}
+		else
+		{
+			Rand.Fill(Data + Pos, Len);
+		}
+		Pos += Len;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	Pak files
+-----------------------------------------------------------------------------*/
+
+#if UNREAL4
+
+#define BENCH_PAK_FILES			2048
+#define BENCH_PAK_MAX_FILE_SIZE	(32 << 10)
+#define BENCH_PAK_BLOCK_SIZE	(64 << 10)
+#define BENCH_PAK_VERSION		PakFile_Version_EncryptionKeyGuid
+
+// Helper for building binary pak data in memory
+struct CPakDataWriter
+{
+	TArray<byte>	Data;
+
+	void Put(const void* Src, int Size)
+	{
+		if (Data.Num() + Size > Data.Max())
+			Data.Reserve(max(Data.Max() * 2, Data.Num() + Size));
+		memcpy(&Data[Data.AddUninitialized(Size)], Src, Size);
+	}
+	void PutByte(byte Value)     { Put(&Value, sizeof(Value)); }
+	void PutInt32(int32 Value)   { Put(&Value, sizeof(Value)); }
+	void PutInt64(int64 Value)   { Put(&Value, sizeof(Value)); }
+	void PutString(const char* Str)
+	{
+		int Len = strlen(Str) + 1;
+		PutInt32(Len);
+		Put(Str, Len);
+	}
+};
+
+// Data for building pak entry, compressed block offsets are relative to entry start
+struct CBenchPakEntry
+{
+	char		Name[64];
+	int64		Pos;
+	int64		Size;
+	int64		UncompressedSize;
+	TArray<FPakCompressedBlock> Blocks;
+};
+
+// Serialize FPakEntry in PakFile_Version_EncryptionKeyGuid format
+static void WritePakEntry(CPakDataWriter& W, const CBenchPakEntry& E, int CompressionMethod, bool bEncrypted)
+{
+	W.PutInt64(E.Pos);
+	W.PutInt64(E.Size);
+	W.PutInt64(E.UncompressedSize);
+	W.PutInt32(CompressionMethod);
+	byte Hash[20];
+	memset(Hash, 0, sizeof(Hash));
+	W.Put(Hash, sizeof(Hash));
+	if (CompressionMethod)
+	{
+		W.PutInt32(E.Blocks.Num());
+		for (const FPakCompressedBlock& B : E.Blocks)
+		{
+			W.PutInt64(B.CompressedStart);
+			W.PutInt64(B.CompressedEnd);
+		}
+	}
+	W.PutByte(bEncrypted);
+	W.PutInt32(CompressionMethod ? BENCH_PAK_BLOCK_SIZE : 0);
+}
+
+static int CompressBenchBlock(int CompressionMethod, const byte* Src, int SrcSize, byte* Dst, int DstSize)
+{
+	if (CompressionMethod == COMPRESS_ZLIB)
+	{
+		uLongf Size = DstSize;
+		if (compress2(Dst, &Size, Src, SrcSize, Z_DEFAULT_COMPRESSION) != Z_OK)
+			appError("zlib compression failed");
+		return Size;
+	}
+#if USE_LZ4
+	if (CompressionMethod == COMPRESS_LZ4)
+	{
+		int Size = LZ4_compress_default((const char*)Src, (char*)Dst, SrcSize, DstSize);
+		if (Size <= 0)
+			appError("lz4 compression failed");
+		return Size;
+	}
+#endif
+	appError("Unsupported compression method %d", CompressionMethod);
+	return 0;
+}
+
+static void EncryptBenchData(byte* Data, int Size)
+{
+	assert((Size & 15) == 0);
+	unsigned long rk[RKLENGTH(256)];
+	int nrounds = rijndaelSetupEncrypt(rk, (const byte*)BENCH_AES_KEY, 256);
+	for (int pos = 0; pos < Size; pos += 16)
+		rijndaelEncrypt(rk, nrounds, Data + pos, Data + pos);
+}
+
+// Generate pak file with compressed or encrypted files and encrypted index, returns
+// total uncompressed size of all files
+static int64 GenerateBenchPak(const char* Filename, int CompressionMethod, bool bEncryptData)
+{
+	guard(GenerateBenchPak);
+
+	CBenchRandom Rand(12345);
+	FFileWriter Ar(Filename);
+
+	TArray<CBenchPakEntry> Entries;
+	Entries.AddDefaulted(BENCH_PAK_FILES);
+
+	byte* FileData = (byte*)appMalloc(BENCH_PAK_MAX_FILE_SIZE + 16);
+	int CompressedBufferSize = BENCH_PAK_BLOCK_SIZE * 2 + 1024;
+	byte* CompressedData = (byte*)appMalloc(CompressedBufferSize);
+	int64 TotalSize = 0;
+
+	for (int i = 0; i < BENCH_PAK_FILES; i++)
+	{
+		CBenchPakEntry& E = Entries[i];
+		appSprintf(ARRAY_ARG(E.Name), "Data/Folder%02d/File%05d.uasset", i & 31, i);
+		int Size = (Rand.Next() % BENCH_PAK_MAX_FILE_SIZE) + 1;
+		GenerateCompressibleData(FileData, Size, Rand);
+		E.Pos = Ar.Tell64();
+		E.UncompressedSize = Size;
+		TotalSize += Size;
+
+		// Compute size of pak entry header, it will be written before file data
+		CPakDataWriter Header;
+		int NumBlocks = CompressionMethod ? (Size + BENCH_PAK_BLOCK_SIZE - 1) / BENCH_PAK_BLOCK_SIZE : 0;
+		E.Blocks.AddZeroed(NumBlocks);
+		WritePakEntry(Header, E, CompressionMethod, bEncryptData);
+		int HeaderSize = Header.Data.Num();
+
+		// Prepare file data
+		CPakDataWriter Contents;
+		if (CompressionMethod)
+		{
+			for (int Block = 0; Block < NumBlocks; Block++)
+			{
+				int BlockStart = Block * BENCH_PAK_BLOCK_SIZE;
+				int BlockSize = min(BENCH_PAK_BLOCK_SIZE, Size - BlockStart);
+				int CompressedSize = CompressBenchBlock(CompressionMethod, FileData + BlockStart, BlockSize, CompressedData, CompressedBufferSize);
+				int StoredSize = CompressedSize;
+				if (bEncryptData)
+				{
+					StoredSize = Align(CompressedSize, FPakFile::EncryptionAlign);
+					memset(CompressedData + CompressedSize, 0, StoredSize - CompressedSize);
+					EncryptBenchData(CompressedData, StoredSize);
+				}
+				FPakCompressedBlock& B = E.Blocks[Block];
+				B.CompressedStart = HeaderSize + Contents.Data.Num();
+				B.CompressedEnd = B.CompressedStart + CompressedSize;
+				Contents.Put(CompressedData, StoredSize);
+			}
+		}
+		else
+		{
+			int StoredSize = Size;
+			if (bEncryptData)
+			{
+				StoredSize = Align(Size, FPakFile::EncryptionAlign);
+				memset(FileData + Size, 0, StoredSize - Size);
+				EncryptBenchData(FileData, StoredSize);
+			}
+			Contents.Put(FileData, StoredSize);
+		}
+		E.Size = Contents.Data.Num();
+
+		// Write header with correct block offsets, then data
+		Header.Data.Empty();
+		WritePakEntry(Header, E, CompressionMethod, bEncryptData);
+		assert(Header.Data.Num() == HeaderSize);
+		Ar.Serialize(Header.Data.GetData(), HeaderSize);
+		Ar.Serialize(Contents.Data.GetData(), Contents.Data.Num());
+	}
+
+	appFree(FileData);
+	appFree(CompressedData);
+
+	// Build and encrypt index
+	CPakDataWriter Index;
+	Index.PutString("../../../BenchGame/Content/");
+	Index.PutInt32(BENCH_PAK_FILES);
+	for (const CBenchPakEntry& E : Entries)
+	{
+		Index.PutString(E.Name);
+		WritePakEntry(Index, E, CompressionMethod, bEncryptData);
+	}
+	int IndexSize = Align(Index.Data.Num(), FPakFile::EncryptionAlign);
+	Index.Data.AddZeroed(IndexSize - Index.Data.Num());
+	EncryptBenchData(Index.Data.GetData(), IndexSize);
+
+	int64 IndexOffset = Ar.Tell64();
+	Ar.Serialize(Index.Data.GetData(), IndexSize);
+
+	// Write FPakInfo
+	CPakDataWriter Info;
+	byte Guid[16];
+	memset(Guid, 0, sizeof(Guid));
+	Info.Put(Guid, sizeof(Guid));
+	Info.PutByte(1);						// bEncryptedIndex
+	Info.PutInt32(PAK_FILE_MAGIC);
+	Info.PutInt32(BENCH_PAK_VERSION);
+	Info.PutInt64(IndexOffset);
+	Info.PutInt64(IndexSize);
+	byte Hash[20];
+	memset(Hash, 0, sizeof(Hash));
+	Info.Put(Hash, sizeof(Hash));
+	assert(Info.Data.Num() == FPakInfo::Size);
+	Ar.Serialize(Info.Data.GetData(), Info.Data.Num());
+
+	return TotalSize;
+
+	unguardf("%s", Filename);
+}
+
+static FPakVFS* MountBenchPak(const char* Filename)
+{
+	guard(MountBenchPak);
+
+	FArchive* Reader = new FFileReader(Filename);
+	Reader->Game = GAME_UE4_BASE;
+	FPakVFS* Vfs = new FPakVFS(Filename);
+	FString Error;
+	if (!Vfs->AttachReader(Reader, Error))
+	{
+		delete Reader;
+		appError("Unable to mount %s: %s", Filename, *Error);
+	}
+	return Vfs;
+
+	unguardf("%s", Filename);
+}
+
+struct CPakBenchContext
+{
+	const char*		Filename;
+	FPakVFS*		Vfs;
+	byte*			Buffer;
+};
+
+static void BenchPakMount(void* Param)
+{
+	CPakBenchContext* Ctx = (CPakBenchContext*)Param;
+	delete MountBenchPak(Ctx->Filename);
+}
+
+static void BenchPakRead(void* Param)
+{
+	CPakBenchContext* Ctx = (CPakBenchContext*)Param;
+	for (int i = 0; i < Ctx->Vfs->NumFiles(); i++)
+	{
+		FArchive* Reader = Ctx->Vfs->CreateReader(Ctx->Vfs->FileName(i));
+		Reader->Serialize(Ctx->Buffer, Reader->GetFileSize());
+		delete Reader;
+	}
+}
+
+static void RunPakBenchmarks()
+{
+	guard(RunPakBenchmarks);
+
+	static const struct
+	{
+		const char*	Name;
+		int			CompressionMethod;
+		bool		bEncryptData;
+	} Variants[] =
+	{
+		{ "zlib",     COMPRESS_ZLIB, false },
+#if USE_LZ4
+		{ "lz4",      COMPRESS_LZ4,  false },
+#endif
+		{ "aes",      0,             true  },
+		{ "zlib_aes", COMPRESS_ZLIB, true  },
+	};
+
+	// Use own AES key for generated files
+	FString SavedAesKey = GAesKey;
+	GAesKey = BENCH_AES_KEY;
+
+	for (int i = 0; i < ARRAY_COUNT(Variants); i++)
+	{
+		char Filename[1024], Name[64];
+		appSprintf(ARRAY_ARG(Filename), "%s/bench_%s.pak", GBenchDir, Variants[i].Name);
+		int64 TotalSize = GenerateBenchPak(Filename, Variants[i].CompressionMethod, Variants[i].bEncryptData);
+
+		CPakBenchContext Ctx;
+		Ctx.Filename = Filename;
+		Ctx.Buffer = (byte*)appMalloc(BENCH_PAK_MAX_FILE_SIZE);
+
+		appSprintf(ARRAY_ARG(Name), "pak_mount_%s", Variants[i].Name);
+		RunBenchmark(Name, BenchPakMount, &Ctx, 0, BENCH_PAK_FILES);
+
+		Ctx.Vfs = MountBenchPak(Filename);
+		appSprintf(ARRAY_ARG(Name), "pak_read_%s", Variants[i].Name);
+		RunBenchmark(Name, BenchPakRead, &Ctx, (double)TotalSize, BENCH_PAK_FILES);
+		delete Ctx.Vfs;
+
+		appFree(Ctx.Buffer);
+	}
+
+	GAesKey = SavedAesKey;
+
+	unguard;
+}
+
+#endif // UNREAL4
+
+
+/*-----------------------------------------------------------------------------
+	Texture decoding
+-----------------------------------------------------------------------------*/
+
+#define BENCH_TEXTURE_SIZE		1024
+
+struct CTextureBenchContext
+{
+	CTextureData	TexData;
+};
+
+static void BenchTextureDecode(void* Param)
+{
+	CTextureBenchContext* Ctx = (CTextureBenchContext*)Param;
+	byte* pic = Ctx->TexData.Decompress(0, TPF_BGRA8);
+	delete[] pic;
+}
+
+#if SUPPORT_ANDROID
+
+// Random data is mostly invalid for ASTC, so pick only blocks which could be decoded
+static void GenerateASTCBlock(byte* Block, int BlockDim, CBenchRandom& Rand)
+{
+	while (true)
+	{
+		Rand.Fill(Block, 16);
+		physical_compressed_block pcb = *(physical_compressed_block*)Block;
+		symbolic_compressed_block scb;
+		physical_to_symbolic(BlockDim, BlockDim, 1, pcb, &scb);
+		if (!scb.error_block && scb.block_mode >= 0) break;
+	}
+}
+
+#endif // SUPPORT_ANDROID
+
+static void RunTextureBenchmarks(UObject* BenchObj)
+{
+	guard(RunTextureBenchmarks);
+
+	static const struct
+	{
+		const char*			Name;
+		ETexturePixelFormat	Format;
+		int					BlockDim;
+		int					BlockBytes;
+	} Formats[] =
+	{
+		{ "bc1",      TPF_DXT1,      4,  8 },
+		{ "bc3",      TPF_DXT5,      4, 16 },
+		{ "bc5",      TPF_BC5,       4, 16 },
+		{ "bc7",      TPF_BC7,       4, 16 },
+#if SUPPORT_ANDROID
+		{ "etc2",     TPF_ETC2_RGBA, 4, 16 },
+		{ "astc4x4",  TPF_ASTC_4x4,  4, 16 },
+		{ "astc8x8",  TPF_ASTC_8x8,  8, 16 },
+#endif
+	};
+
+	for (int i = 0; i < ARRAY_COUNT(Formats); i++)
+	{
+		CBenchRandom Rand(i + 1);
+		int BlockDim = Formats[i].BlockDim;
+		int NumBlocks = (BENCH_TEXTURE_SIZE / BlockDim) * (BENCH_TEXTURE_SIZE / BlockDim);
+		int DataSize = NumBlocks * Formats[i].BlockBytes;
+		byte* Data = (byte*)appMalloc(DataSize);
+
+		if (Formats[i].Format == TPF_BC7)
+		{
+			// Random BC7 data could contain invalid blocks (mode 8), select mode for every block
+			for (int b = 0; b < NumBlocks; b++)
+			{
+				byte* Block = Data + b * 16;
+				Rand.Fill(Block, 16);
+				int Mode = Rand.Next() & 7;
+				Block[0] = (byte)((Block[0] << (Mode + 1)) | (1 << Mode));
+			}
+		}
+#if SUPPORT_ANDROID
+		else if (Formats[i].Format == TPF_ASTC_4x4 || Formats[i].Format == TPF_ASTC_8x8)
+		{
+			// Generate a set of valid blocks and repeat it over the whole texture
+			build_quantization_mode_table();
+			const int NumUniqueBlocks = 256;
+			for (int b = 0; b < NumUniqueBlocks; b++)
+				GenerateASTCBlock(Data + b * 16, BlockDim, Rand);
+			for (int b = NumUniqueBlocks; b < NumBlocks; b++)
+				memcpy(Data + b * 16, Data + (Rand.Next() % NumUniqueBlocks) * 16, 16);
+		}
+#endif
+		else
+		{
+			Rand.Fill(Data, DataSize);
+		}
+
+		CTextureBenchContext Ctx;
+		Ctx.TexData.Format = Formats[i].Format;
+		Ctx.TexData.Obj = BenchObj;
+		CMipMap* Mip = new (Ctx.TexData.Mips) CMipMap;
+		Mip->USize = Mip->VSize = BENCH_TEXTURE_SIZE;
+		Mip->SetOwnedDataBuffer(Data, DataSize);
+
+		char Name[64];
+		appSprintf(ARRAY_ARG(Name), "texture_decode_%s", Formats[i].Name);
+		RunBenchmark(Name, BenchTextureDecode, &Ctx, BENCH_TEXTURE_SIZE * BENCH_TEXTURE_SIZE * 4, 1);
+	}
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Mesh processing and export
+-----------------------------------------------------------------------------*/
+
+// Grid of BENCH_MESH_SIZE x BENCH_MESH_SIZE quads, every triangle has its own
+// vertices, so welding reduces number of vertices approximately 6 times
+#define BENCH_MESH_SIZE			256
+
+static CStaticMesh* GenerateBenchMesh(UObject* BenchObj)
+{
+	guard(GenerateBenchMesh);
+
+	CStaticMesh* Mesh = new CStaticMesh(BenchObj);
+	CStaticMeshLod* Lod = new (Mesh->Lods) CStaticMeshLod;
+	Lod->NumTexCoords = 1;
+	Lod->HasNormals = true;
+	Lod->HasTangents = true;
+
+	int NumQuads = BENCH_MESH_SIZE * BENCH_MESH_SIZE;
+	int NumVerts = NumQuads * 6;
+	Lod->AllocateVerts(NumVerts);
+
+	CBenchRandom Rand(1);
+	CStaticMeshVertex* V = Lod->Verts;
+	static const int QuadCorners[6][2] = { {0,0}, {1,0}, {1,1}, {0,0}, {1,1}, {0,1} };
+	for (int y = 0; y < BENCH_MESH_SIZE; y++)
+	{
+		for (int x = 0; x < BENCH_MESH_SIZE; x++)
+		{
+			for (int c = 0; c < 6; c++, V++)
+			{
+				int vx = x + QuadCorners[c][0];
+				int vy = y + QuadCorners[c][1];
+				// height of the vertex depends only on its coordinates, so shared vertices are matched
+				uint32 h = (vx * 73856093) ^ (vy * 19349663);
+				V->Position[0] = vx * 10.0f;
+				V->Position[1] = vy * 10.0f;
+				V->Position[2] = (h & 255) * 0.1f;
+				V->Normal.Data = 0x7F0000 | ((h >> 8) & 0x0F0F);
+				V->Tangent.Data = 0x00007F;
+				V->UV.U = vx / (float)BENCH_MESH_SIZE;
+				V->UV.V = vy / (float)BENCH_MESH_SIZE;
+			}
+		}
+	}
+
+	TArray<uint32>& Indices = Lod->Indices.Indices32;
+	Indices.AddUninitialized(NumVerts);
+	for (int i = 0; i < NumVerts; i++)
+		Indices[i] = i;
+
+	CMeshSection* Sec = new (Lod->Sections) CMeshSection;
+	Sec->Material = NULL;
+	Sec->FirstIndex = 0;
+	Sec->NumFaces = NumVerts / 3;
+
+	Mesh->BoundingBox.Min.Set(0, 0, 0);
+	Mesh->BoundingBox.Max.Set(BENCH_MESH_SIZE * 10.0f, BENCH_MESH_SIZE * 10.0f, 25.6f);
+
+	return Mesh;
+
+	unguard;
+}
+
+static void BenchVertexWeld(void* Param)
+{
+	const CStaticMeshLod& Lod = ((CStaticMesh*)Param)->Lods[0];
+	CVertexShare* Share = new CVertexShare;
+	Share->Prepare(Lod.Verts, Lod.NumVerts, sizeof(CStaticMeshVertex));
+	for (int i = 0; i < Lod.NumVerts; i++)
+	{
+		const CStaticMeshVertex& V = Lod.Verts[i];
+		Share->AddVertex(V.Position, V.Normal);
+	}
+	delete Share;
+}
+
+static void BenchExportPsk(void* Param)
+{
+	BeginExport();
+	ExportStaticMesh((CStaticMesh*)Param);
+	EndExport();
+}
+
+static void BenchExportGltf(void* Param)
+{
+	BeginExport();
+	ExportStaticMeshGLTF((CStaticMesh*)Param, false);
+	EndExport();
+}
+
+static void BenchExportGlb(void* Param)
+{
+	BeginExport();
+	ExportStaticMeshGLTF((CStaticMesh*)Param, true);
+	EndExport();
+}
+
+static void RunMeshBenchmarks(UObject* BenchObj)
+{
+	guard(RunMeshBenchmarks);
+
+	CStaticMesh* Mesh = GenerateBenchMesh(BenchObj);
+	const CStaticMeshLod& Lod = Mesh->Lods[0];
+	double MeshBytes = Lod.NumVerts * (sizeof(CStaticMeshVertex) + sizeof(uint32));
+
+	RunBenchmark("mesh_weld", BenchVertexWeld, Mesh, Lod.NumVerts * sizeof(CStaticMeshVertex), Lod.NumVerts);
+	RunBenchmark("mesh_export_psk", BenchExportPsk, Mesh, MeshBytes, 1);
+	RunBenchmark("mesh_export_gltf", BenchExportGltf, Mesh, MeshBytes, 1);
+	RunBenchmark("mesh_export_glb", BenchExportGlb, Mesh, MeshBytes, 1);
+
+	delete Mesh;
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Image writing
+-----------------------------------------------------------------------------*/
+
+#define BENCH_IMAGE_SIZE		2048
+
+struct CImageBenchContext
+{
+	byte*			Pic;
+	char			Filename[1024];
+};
+
+static void BenchWriteTga(void* Param)
+{
+	CImageBenchContext* Ctx = (CImageBenchContext*)Param;
+	FFileWriter Ar(Ctx->Filename);
+	WriteTGA(Ar, BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, Ctx->Pic, true);
+}
+
+static void BenchWritePng(void* Param)
+{
+	CImageBenchContext* Ctx = (CImageBenchContext*)Param;
+	TArray<byte> CompressedData;
+	CompressPNG(Ctx->Pic, BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, CompressedData);
+	FFileWriter Ar(Ctx->Filename);
+	Ar.Serialize(CompressedData.GetData(), CompressedData.Num());
+}
+
+static void RunImageBenchmarks()
+{
+	guard(RunImageBenchmarks);
+
+	// Generate image with smooth areas, noise and opaque alpha - typical for diffuse textures
+	int NumPixels = BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE;
+	CImageBenchContext Ctx;
+	Ctx.Pic = (byte*)appMalloc(NumPixels * 4);
+	CBenchRandom Rand(7);
+	byte* p = Ctx.Pic;
+	for (int y = 0; y < BENCH_IMAGE_SIZE; y++)
+	{
+		for (int x = 0; x < BENCH_IMAGE_SIZE; x++, p += 4)
+		{
+			bool bNoise = ((x >> 6) + (y >> 6)) & 1;
+			uint32 r = bNoise ? Rand.Next() : 0;
+			p[0] = (byte)((x >> 3) + (r & 15));
+			p[1] = (byte)((y >> 3) + ((r >> 4) & 15));
+			p[2] = (byte)(((x + y) >> 4) + ((r >> 8) & 15));
+			p[3] = 255;
+		}
+	}
+
+	appSprintf(ARRAY_ARG(Ctx.Filename), "%s/bench.tga", GBenchDir);
+	RunBenchmark("image_write_tga", BenchWriteTga, &Ctx, NumPixels * 4, 1);
+	appSprintf(ARRAY_ARG(Ctx.Filename), "%s/bench.png", GBenchDir);
+	RunBenchmark("image_write_png", BenchWritePng, &Ctx, NumPixels * 4, 1);
+
+	appFree(Ctx.Pic);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Main function
+-----------------------------------------------------------------------------*/
+
+void RunBenchmarks(const char* Filter)
+{
+	guard(RunBenchmarks);
+
+	GBenchFilter = Filter;
+
+	// Temporary files are placed into export directory
+	appSprintf(ARRAY_ARG(GBenchDir), "%s/UmodelBench", appGetBaseExportDirectory());
+	appMakeDirectory(GBenchDir);
+
+	// Transient object used as owner for generated assets
+	UObject* BenchObj = new UObject;
+	BenchObj->Name = "UmodelBench";
+
+	// Keep stdout for results only
+	appSetConsoleStream(stderr);
+	fprintf(stdout, "bench,name,iterations,ms,MB/s,ops/s\n");
+
+#if UNREAL4
+	if (BenchGroupEnabled("pak"))
+		RunPakBenchmarks();
+#endif
+	if (BenchGroupEnabled("texture"))
+		RunTextureBenchmarks(BenchObj);
+	if (BenchGroupEnabled("mesh"))
+		RunMeshBenchmarks(BenchObj);
+	if (BenchGroupEnabled("image"))
+		RunImageBenchmarks();
+
+	delete BenchObj;
+
+	appSetConsoleStream(NULL);
+
+	unguard;
+}
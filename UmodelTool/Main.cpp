@@ -27,7 +27,11 @@
 #endif
 
 #include "GameDatabase.h"
+#include "GameFileSystem.h"
 #include "PackageUtils.h"
+#include "PackageCatalog.h"
+#include "Parallel.h"
+#include "Profiler.h"
 
 #include "UmodelApp.h"
 #include "UmodelCommands.h"
@@ -214,9 +218,11 @@ static void RegisterClasses(int game)
 -----------------------------------------------------------------------------*/
 
 
-static void CallExportSkeletalMesh(const CSkeletalMesh* Mesh)
+// Mesh is not 'const' because vertices of compact mesh should be expanded for export
+static void CallExportSkeletalMesh(CSkeletalMesh* Mesh)
 {
 	assert(Mesh);
+	Mesh->LockVerts();
 	switch (GSettings.Export.SkeletalMeshFormat)
 	{
 	case EExportMeshFormat::psk:
@@ -226,15 +232,20 @@ static void CallExportSkeletalMesh(const CSkeletalMesh* Mesh)
 	case EExportMeshFormat::gltf:
 		ExportSkeletalMeshGLTF(Mesh);
 		break;
+	case EExportMeshFormat::glb:
+		ExportSkeletalMeshGLTF(Mesh, true);
+		break;
 	case EExportMeshFormat::md5:
 		ExportMd5Mesh(Mesh);
 		break;
 	}
+	Mesh->UnlockVerts();
 }
 
-static void CallExportStaticMesh(const CStaticMesh* Mesh)
+static void CallExportStaticMesh(CStaticMesh* Mesh)
 {
 	assert(Mesh);
+	Mesh->LockVerts();
 	switch (GSettings.Export.StaticMeshFormat)
 	{
 	case EExportMeshFormat::psk:
@@ -244,7 +255,11 @@ static void CallExportStaticMesh(const CStaticMesh* Mesh)
 	case EExportMeshFormat::gltf:
 		ExportStaticMeshGLTF(Mesh);
 		break;
+	case EExportMeshFormat::glb:
+		ExportStaticMeshGLTF(Mesh, true);
+		break;
 	}
+	Mesh->UnlockVerts();
 }
 
 static void CallExportAnimation(const CAnimSet* Anim)
@@ -257,6 +272,7 @@ static void CallExportAnimation(const CAnimSet* Anim)
 		ExportPsa(Anim);
 		break;
 	case EExportMeshFormat::gltf:
+	case EExportMeshFormat::glb:
 		appPrintf("ERROR: glTF animation could be exported from mesh viewer only.\n");
 		break;
 	case EExportMeshFormat::md5:
@@ -341,8 +357,12 @@ static void PrintUsage()
 			"    -view           (default) visualize object; when no <object> specified\n"
 			"                    will load whole package\n"
 			"    -list           list contents of package\n"
+			"    -deps           list packages used by package; with -catalog, also list\n"
+			"                    packages which are using it\n"
 			"    -export         export specified object or whole package\n"
 			"    -save           save specified packages\n"
+			"    -makecatalog    scan packages (all packages when none specified) and save\n"
+			"                    their export and import tables to file set by -catalog\n"
 			"\n"
 			"Help information:\n"
 			"    -help           display this help page\n"
@@ -373,6 +393,23 @@ static void PrintUsage()
 #endif
 			"    -aes=key        provide AES decryption key for encrypted pak files,\n"
 			"                    key is ASCII or hex string (hex format is 0xAABBCCDD)\n"
+			"    -threads=N      number of threads used for data processing, default is\n"
+			"                    number of CPU cores; use 1 to disable multithreading\n"
+			"    -compactmesh=N  keep meshes with N or more vertices in compact form in\n"
+			"                    memory; saves memory, but reduces vertex precision\n"
+			"    -cache=dir      keep decompressed copies of compressed packages in dir,\n"
+			"                    so next loads of these packages will be faster\n"
+			"    -cachesize=N    maximal size of the cache in megabytes, default is 4096\n"
+			"    -catalog=file   use package catalog for -list, -pkginfo, -deps and for\n"
+			"                    finding objects; <package> is optional with -obj\n"
+			"    -profile        print time spent in different processing stages\n"
+			"    -stats[=file]   print loading time, size and memory usage per class and\n"
+			"                    per package; optionally save them to csv file\n"
+			"    -trace=file     save profiler results as Chrome trace (json) file,\n"
+			"                    implies -profile\n"
+			"    -bench[=groups] run built-in benchmarks on generated data and exit;\n"
+			"                    groups: pak,texture,mesh,image (default is all);\n"
+			"                    csv results are printed to stdout, log to stderr\n"
 			"\n"
 			"Compatibility options:\n"
 			"    -nomesh         disable loading of SkeletalMesh classes in a case of\n"
@@ -409,12 +446,17 @@ static void PrintUsage()
 			"    -psk            use ActorX format for meshes (default)\n"
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
 			"    -gltf           use glTF 2.0 format for mesh\n"
+			"    -glb            use binary glTF 2.0 format for mesh (single file)\n"
 			"    -lods           export all available mesh LOD levels\n"
 			"    -dds            export textures in DDS format whenever possible\n"
 			"    -png            export textures in PNG format instead of TGA\n"
 			"    -notgacomp      disable TGA compression\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
+			"    -incremental    skip packages which were not changed since previous export\n"
+			"                    to the same directory\n"
+			"    -stream         export packages object by object instead of loading whole\n"
+			"                    package first (reduces memory usage)\n"
 			"\n"
 			"Supported resources for export:\n"
 			"    SkeletalMesh    exported as ActorX psk file, MD5Mesh or glTF\n"
@@ -662,6 +704,161 @@ static void TestStrings()
 	exit(0);
 }
 
+// Check if catalog entry matches the game file with the same name. State caches results of
+// previous checks: 0 = not checked, 1 = up to date, 2 = changed or removed.
+static bool IsCatalogPackageUpToDate(const CPackageCatalog& Catalog, int PackageIndex, TArray<byte>& State)
+{
+	if (!State[PackageIndex])
+	{
+		const CGameFileInfo* File = appFindGameFile(Catalog.GetString(Catalog.GetPackage(PackageIndex).Name));
+		State[PackageIndex] = (File && Catalog.IsPackageUpToDate(PackageIndex, File)) ? 1 : 2;
+	}
+	return State[PackageIndex] == 1;
+}
+
+// Add all packages which are not in catalog, or were changed after catalog was built.
+// Returns number of added packages.
+static int AddOutdatedCatalogPackages(const CPackageCatalog& Catalog, TArray<const char*>& packages)
+{
+	guard(AddOutdatedCatalogPackages);
+
+	TArray<const CGameFileInfo*> Files;
+	appFindGameFiles("*", Files);
+	int numOutdated = 0;
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		const CGameFileInfo* File = Files[i];
+		if (!File->IsPackage || Catalog.FindPackage(File) >= 0)
+			continue;
+		packages.Add(appStrdup(*File->GetRelativeName()));
+		numOutdated++;
+	}
+	if (numOutdated)
+		appPrintf("WARNING: package catalog is outdated, %d package(s) will be searched directly\n", numOutdated);
+	return numOutdated;
+
+	unguard;
+}
+
+// Find packages which contain requested objects using package catalog, so only these packages
+// will be opened. Wildcards in object names are replaced with names of matching objects. When
+// packages were not specified, whole catalog is searched. Packages which were changed after
+// the catalog was built are opened and searched directly.
+static void FindObjectsInCatalog(const CPackageCatalog& Catalog, TArray<const char*>& packagesToLoad, TArray<const char*>& objectsToLoad,
+	const char* className, int& numClassObjects, const char*& attachAnimName)
+{
+	guard(FindObjectsInCatalog);
+
+	TArray<const char*> newPackages, newObjects;
+	TArray<int> candidates;
+	TArray<byte> packageState;
+	packageState.AddZeroed(Catalog.NumPackages());
+	bool allPackages = (packagesToLoad.Num() == 0);
+	bool hasUncatalogued = false;
+
+	for (int i = 0; i < packagesToLoad.Num(); i++)
+	{
+		TArray<const CGameFileInfo*> Files;
+		appFindGameFiles(packagesToLoad[i], Files);
+		if (!Files.Num())
+		{
+			// keep the name, so "unable to find package" will be reported later
+			newPackages.Add(packagesToLoad[i]);
+			hasUncatalogued = true;
+			continue;
+		}
+		for (int j = 0; j < Files.Num(); j++)
+		{
+			FString RelativeName = Files[j]->GetRelativeName();
+			int catIndex = Catalog.FindPackage(*RelativeName);
+			if (catIndex >= 0)
+			{
+				candidates.AddUnique(catIndex);
+				packageState[catIndex] = Catalog.IsPackageUpToDate(catIndex, Files[j]) ? 1 : 2;
+			}
+			if (catIndex < 0 || packageState[catIndex] != 1)
+			{
+				// this package is not in catalog or was changed, it should be opened and searched
+				newPackages.Add(appStrdup(*RelativeName));
+				hasUncatalogued = true;
+			}
+		}
+	}
+
+	// When searching in all packages, catalog entries are verified only when they're used,
+	// so game files are checked only when requested object is found in catalog. If any of
+	// objects is missing or is found in a changed package, catalog is outdated, and all
+	// packages which don't match catalog should be searched.
+	if (allPackages)
+	{
+		bool outdated = false;
+		for (int objIdx = 0; objIdx < objectsToLoad.Num() && !outdated; objIdx++)
+		{
+			TArray<int> exports;
+			Catalog.FindExports(objectsToLoad[objIdx], (objIdx < numClassObjects) ? className : NULL, exports);
+			outdated = (exports.Num() == 0);
+			for (int i = 0; i < exports.Num() && !outdated; i++)
+				outdated = !IsCatalogPackageUpToDate(Catalog, Catalog.GetExport(exports[i]).Package, packageState);
+		}
+		if (outdated && AddOutdatedCatalogPackages(Catalog, newPackages))
+			hasUncatalogued = true;
+	}
+
+	int newClassObjects = 0;
+	for (int objIdx = 0; objIdx < objectsToLoad.Num(); objIdx++)
+	{
+		const char* objName = objectsToLoad[objIdx];
+		bool isWildcard = appContainsWildcard(objName);
+		TArray<int> exports;
+		Catalog.FindExports(objName, (objIdx < numClassObjects) ? className : NULL, exports);
+
+		int found = 0;
+		for (int i = 0; i < exports.Num(); i++)
+		{
+			const FCatalogExport& Exp = Catalog.GetExport(exports[i]);
+			if (!allPackages && candidates.FindItem(Exp.Package) < 0)
+				continue;
+			// Changed package is already in the list and will be searched directly. Its
+			// catalog entry is still used to expand wildcards, names which are gone from
+			// the package will be reported as not found.
+			bool upToDate = IsCatalogPackageUpToDate(Catalog, Exp.Package, packageState);
+			if (!upToDate && !isWildcard)
+				continue;
+			found++;
+			// strings in catalog are unique, so pointers could be compared
+			if (upToDate)
+				newPackages.AddUnique(Catalog.GetString(Catalog.GetPackage(Exp.Package).Name));
+			if (isWildcard)
+			{
+				const char* name = Catalog.GetString(Exp.Name);
+				if (newObjects.FindItem(name) < 0)
+				{
+					if (objName == attachAnimName && found == 1)
+						attachAnimName = name;
+					newObjects.Add(name);
+				}
+			}
+		}
+
+		if (!found && !hasUncatalogued)
+		{
+			appPrintf("Export \"%s\" was not found in package catalog\n", objName);
+			exit(1);
+		}
+		if (!isWildcard || !found)
+			newObjects.Add(objName);
+		if (objIdx < numClassObjects)
+			newClassObjects = newObjects.Num();
+	}
+
+	appPrintf("Requested objects were found in %d package(s)\n", newPackages.Num());
+	CopyArray(packagesToLoad, newPackages);
+	CopyArray(objectsToLoad, newObjects);
+	numClassObjects = newClassObjects;
+
+	unguard;
+}
+
 #define OPT_BOOL(name,var)				{ name, (byte*)&var, true  },
 #define OPT_NBOOL(name,var)				{ name, (byte*)&var, false },
 #define OPT_VALUE(name,var,value)		{ name, (byte*)&var, value },
@@ -716,6 +913,8 @@ int main(int argc, const char **argv)
 		CMD_List,
 		CMD_Export,
 		CMD_Save,
+		CMD_Deps,
+		CMD_MakeCatalog,
 	};
 
 	static byte mainCmd = CMD_View;
@@ -723,6 +922,12 @@ int main(int argc, const char **argv)
 	TArray<const char*> packagesToLoad, objectsToLoad;
 	TArray<const char*> params;
 	const char *attachAnimName = NULL;
+	const char *statsFileName = NULL;
+	const char *benchFilter = NULL;
+	bool runBenchmarks = false;
+	const char *cacheDir = NULL;
+	int cacheSizeMb = 4096;
+	const char *catalogFile = NULL;
 	for (int arg = 1; arg < argc; arg++)
 	{
 		const char *opt = argv[arg];
@@ -743,6 +948,8 @@ int main(int argc, const char **argv)
 			OPT_VALUE("save",    mainCmd, CMD_Save)
 			OPT_VALUE("pkginfo", mainCmd, CMD_PkgInfo)
 			OPT_VALUE("list",    mainCmd, CMD_List)
+			OPT_VALUE("deps",    mainCmd, CMD_Deps)
+			OPT_VALUE("makecatalog", mainCmd, CMD_MakeCatalog)
 #if VSTUDIO_INTEGRATION
 			OPT_BOOL ("debug",   GUseDebugger)
 #endif
@@ -765,6 +972,8 @@ int main(int argc, const char **argv)
 			OPT_BOOL ("dds",     GSettings.Export.ExportDdsTexture)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
+			OPT_BOOL ("incremental", GIncrementalExport)
+			OPT_BOOL ("stream",  GStreamedExport)
 #if HAS_UI
 			OPT_BOOL ("gui",     forceUI)
 #endif
@@ -798,6 +1007,10 @@ int main(int argc, const char **argv)
 		{
 			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::gltf;
 		}
+		else if (!stricmp(opt, "glb"))
+		{
+			GSettings.Export.SkeletalMeshFormat = GSettings.Export.StaticMeshFormat = EExportMeshFormat::glb;
+		}
 		else if (!stricmp(opt, "all") && mainCmd == CMD_Dump)
 		{
 			// -all should be used only with -dump
@@ -863,6 +1076,69 @@ int main(int argc, const char **argv)
 			GAesKey.TrimStartAndEndInline();
 			CheckHexAesKey();
 		}
+		else if (!strnicmp(opt, "threads=", 8))
+		{
+			int threads = atoi(opt+8);
+			if (threads < 1)
+			{
+				appPrintf("ERROR: invalid thread count: %s\n", opt+8);
+				exit(0);
+			}
+			GNumThreads = threads;
+		}
+		else if (!strnicmp(opt, "compactmesh=", 12))
+		{
+			int verts = atoi(opt+12);
+			if (verts < 0)
+			{
+				appPrintf("ERROR: invalid vertex count: %s\n", opt+12);
+				exit(0);
+			}
+			GCompactMeshVerts = verts;
+		}
+		else if (!stricmp(opt, "stats"))
+		{
+			GCollectLoadStats = true;
+		}
+		else if (!strnicmp(opt, "stats=", 6))
+		{
+			GCollectLoadStats = true;
+			statsFileName = opt+6;
+		}
+		else if (!stricmp(opt, "profile"))
+		{
+			appStartProfiler();
+		}
+		else if (!strnicmp(opt, "trace=", 6))
+		{
+			appStartProfiler(opt+6);
+		}
+		else if (!strnicmp(opt, "cache=", 6))
+		{
+			cacheDir = opt+6;
+		}
+		else if (!strnicmp(opt, "cachesize=", 10))
+		{
+			cacheSizeMb = atoi(opt+10);
+			if (cacheSizeMb < 1)
+			{
+				appPrintf("ERROR: invalid cache size: %s\n", opt+10);
+				exit(0);
+			}
+		}
+		else if (!strnicmp(opt, "catalog=", 8))
+		{
+			catalogFile = opt+8;
+		}
+		else if (!stricmp(opt, "bench"))
+		{
+			runBenchmarks = true;
+		}
+		else if (!strnicmp(opt, "bench=", 6))
+		{
+			runBenchmarks = true;
+			benchFilter = opt+6;
+		}
 		// information commands
 		else if (!stricmp(opt, "taglist"))
 		{
@@ -905,6 +1181,38 @@ int main(int argc, const char **argv)
 			argPkgName, argObjName, argClassName);
 	}
 
+	if (runBenchmarks)
+	{
+		// benchmarks are using generated data, so game files are not needed
+		GSettings.Export.Apply();
+		RunBenchmarks(benchFilter);
+		return 0;
+	}
+
+	// open package catalog; it provides the game path unless a package file was specified
+	CPackageCatalog Catalog;
+	if (mainCmd == CMD_MakeCatalog)
+	{
+		if (!catalogFile)
+			CommandLineError("catalog file was not specified, use -catalog=file");
+	}
+	else if (catalogFile)
+	{
+		if (!Catalog.Open(catalogFile))
+		{
+			appPrintf("WARNING: unable to open package catalog %s\n", catalogFile);
+		}
+		else if (!hasRootDir)
+		{
+			const char* firstPackage = argPkgName ? argPkgName : (packagesToLoad.Num() ? packagesToLoad[0] : NULL);
+			if (!firstPackage || appGetFileType(firstPackage) != FS_FILE)
+			{
+				GSettings.Startup.SetPath(Catalog.GetRootDirectory());
+				hasRootDir = true;
+			}
+		}
+	}
+
 #if HAS_UI
 	if (argPkgName && !argObjName && !argClassName && !hasRootDir)
 	{
@@ -935,6 +1243,8 @@ int main(int argc, const char **argv)
 	GForcePlatform = GSettings.Startup.Platform;
 	GForceCompMethod = GSettings.Startup.PackageCompression;
 	GSettings.Export.Apply();
+	if (cacheDir)
+		appSetFileCacheDirectory(cacheDir, cacheSizeMb);
 
 	TArray<UnPackage*> Packages;
 	TArray<UObject*> Objects;
@@ -951,7 +1261,8 @@ int main(int argc, const char **argv)
 	}
 
 #if !HAS_UI
-	if (!packagesToLoad.Num() || !params.Num())
+	bool packageOptional = (mainCmd == CMD_MakeCatalog) || (Catalog.IsOpen() && objectsToLoad.Num());
+	if ((!packagesToLoad.Num() || !params.Num()) && !packageOptional)
 	{
 		CommandLineError("package name was not specified.");
 	}
@@ -982,8 +1293,33 @@ int main(int argc, const char **argv)
 		appSetRootDirectory(".");			// scan for packages
 	}
 
+	if (mainCmd == CMD_MakeCatalog)
+	{
+		// catalog all packages when nothing was specified
+		if (!packagesToLoad.Num())
+			packagesToLoad.Add("*");
+		TArray<const CGameFileInfo*> CatalogFiles;
+		for (int i = 0; i < packagesToLoad.Num(); i++)
+		{
+			TArray<const CGameFileInfo*> Files;
+			appFindGameFiles(packagesToLoad[i], Files);
+			if (!Files.Num())
+				appPrintf("WARNING: unable to find package %s\n", packagesToLoad[i]);
+			for (int j = 0; j < Files.Num(); j++)
+				CatalogFiles.Add(Files[j]);
+		}
+		return BuildPackageCatalog(catalogFile, CatalogFiles) ? 0 : 1;
+	}
+
+	// number of objectsToLoad items which are filtered by argClassName
+	int numClassObjects = 1;
+	bool bUseCatalogTables = Catalog.IsOpen() && (mainCmd == CMD_List || mainCmd == CMD_PkgInfo || mainCmd == CMD_Deps);
+	if (Catalog.IsOpen() && objectsToLoad.Num() && !bUseCatalogTables && mainCmd != CMD_Save)
+		FindObjectsInCatalog(Catalog, packagesToLoad, objectsToLoad, argClassName, numClassObjects, attachAnimName);
+
 	bool bShouldLoadPackages = (mainCmd != CMD_Save);
 	TArray<const CGameFileInfo*> GameFiles;
+	TArray<int> CatalogPackages;
 
 	// Try to load all packages first.
 	// Note: in this code, packages will be loaded without creating any exported objects.
@@ -1000,6 +1336,17 @@ int main(int argc, const char **argv)
 		{
 			for (int j = 0; j < Files.Num(); j++)
 			{
+				if (bUseCatalogTables)
+				{
+					// package tables are available without opening the package
+					int catIndex = Catalog.FindPackage(Files[j]);
+					if (catIndex >= 0)
+					{
+						CatalogPackages.AddUnique(catIndex);
+						GameFiles.Add(Files[j]);
+						continue;
+					}
+				}
 				bool failed = false;
 				if (bShouldLoadPackages)
 				{
@@ -1046,10 +1393,20 @@ int main(int argc, const char **argv)
 	if (mainCmd == CMD_List)
 	{
 		guard(List);
+		int numListed = Packages.Num() + CatalogPackages.Num();
+		for (int packageIndex = 0; packageIndex < CatalogPackages.Num(); packageIndex++)
+		{
+			int catIndex = CatalogPackages[packageIndex];
+			if (numListed > 1)
+			{
+				appPrintf("\n%s\n", Catalog.GetString(Catalog.GetPackage(catIndex).Name));
+			}
+			ListCatalogPackage(Catalog, catIndex);
+		}
 		for (int packageIndex = 0; packageIndex < Packages.Num(); packageIndex++)
 		{
 			UnPackage* Package = Packages[packageIndex];
-			if (Packages.Num() > 1)
+			if (numListed > 1)
 			{
 				appPrintf("\n%s\n", Package->Filename);
 			}
@@ -1070,32 +1427,41 @@ int main(int argc, const char **argv)
 		return 0;
 	}
 
-	// register exporters and classes
-	InitClassAndExportSystems(Packages[0]->Game);
-
 	if (mainCmd == CMD_PkgInfo)
 	{
-		DisplayPackageStats(Packages);
+		DisplayPackageStats(Packages, &Catalog, &CatalogPackages);
 		return 0;					// already displayed when loaded package; extend it?
 	}
 
+	if (mainCmd == CMD_Deps)
+	{
+		DisplayPackageDependencies(Packages, &Catalog, &CatalogPackages);
+		return 0;
+	}
+
+	// register exporters and classes
+	InitClassAndExportSystems(Packages[0]->Game);
+
 	bool bShouldLoadObjects = (mainCmd != CMD_Export) || (objectsToLoad.Num() > 0);
 
-	// load requested objects if any, or fully load everything
-	UObject::BeginLoad();
+	// selectively load objects: find them first
+	struct ObjectToLoad
+	{
+		UnPackage*	Package;
+		int			ExportIndex;
+		bool		IsAnimSet;
+	};
+	TArray<ObjectToLoad> FoundObjects;
 	if (objectsToLoad.Num())
 	{
-		// selectively load objects
-		int totalFound = 0;
 		for (int objIdx = 0; objIdx < objectsToLoad.Num(); objIdx++)
 		{
 			const char *objName   = objectsToLoad[objIdx];
-			const char *className = (objIdx == 0) ? argClassName : NULL;
+			const char *className = (objIdx < numClassObjects) ? argClassName : NULL;
 			int found = 0;
 			for (int pkg = 0; pkg < Packages.Num(); pkg++)
 			{
 				UnPackage *Package2 = Packages[pkg];
-				// load specific object(s)
 				int idx = -1;
 				while (true)
 				{
@@ -1103,17 +1469,11 @@ int main(int argc, const char **argv)
 					if (idx == INDEX_NONE) break;		// not found in this package
 
 					found++;
-					totalFound++;
 					appPrintf("Export \"%s\" was found in package \"%s\"\n", objName, Package2->Filename);
-
-					// create object from package
-					UObject *Obj = Package2->CreateExport(idx);
-					if (Obj)
-					{
-						Objects.Add(Obj);
-						if (objName == attachAnimName && (Obj->IsA("MeshAnimation") || Obj->IsA("AnimSet")))
-							GForceAnimSet = Obj;
-					}
+					ObjectToLoad* O = new (FoundObjects) ObjectToLoad;
+					O->Package     = Package2;
+					O->ExportIndex = idx;
+					O->IsAnimSet   = (objName == attachAnimName);
 				}
 				if (found) break;
 			}
@@ -1123,7 +1483,36 @@ int main(int argc, const char **argv)
 				exit(1);
 			}
 		}
-		appPrintf("Found %d object(s)\n", totalFound);
+		appPrintf("Found %d object(s)\n", FoundObjects.Num());
+
+		// open packages required for loading these objects before loading starts
+		TArray<CExportRef> FoundExports;
+		FoundExports.Empty(FoundObjects.Num());
+		for (int i = 0; i < FoundObjects.Num(); i++)
+		{
+			CExportRef* Ref = new (FoundExports) CExportRef;
+			Ref->Package = FoundObjects[i].Package;
+			Ref->Index   = FoundObjects[i].ExportIndex;
+		}
+		OpenImportClosure(FoundExports);
+	}
+
+	// load requested objects if any, or fully load everything
+	UObject::BeginLoad();
+	if (objectsToLoad.Num())
+	{
+		// create objects; these will be serialized by EndLoad() sorted by package and file offset
+		for (int i = 0; i < FoundObjects.Num(); i++)
+		{
+			const ObjectToLoad& O = FoundObjects[i];
+			UObject *Obj = O.Package->CreateExport(O.ExportIndex);
+			if (Obj)
+			{
+				Objects.Add(Obj);
+				if (O.IsAnimSet && (Obj->IsA("MeshAnimation") || Obj->IsA("AnimSet")))
+					GForceAnimSet = Obj;
+			}
+		}
 	}
 	else if (bShouldLoadObjects)
 	{
@@ -1150,6 +1539,9 @@ int main(int argc, const char **argv)
 	appPrintProfiler();
 #endif
 
+	if (GCollectLoadStats && mainCmd != CMD_Export)
+		DisplayLoadStats(statsFileName);
+
 	if (mainCmd == CMD_Export)
 	{
 		// If we have list of objects, the process only those ones. Otherwise, process full packages.
@@ -1163,6 +1555,8 @@ int main(int argc, const char **argv)
 		{
 			ExportPackages(Packages);
 		}
+		if (GCollectLoadStats)
+			DisplayLoadStats(statsFileName);
 		if (!GApplication.GuiShown)
 			return 0;
 		// switch to a viewer in GUI mode
@@ -10,6 +10,7 @@
 #include "UnMesh2.h"
 #include "UnMesh3.h"
 #include "UnMesh4.h"
+#include "UnMaterial3.h"
 
 #include "UmodelApp.h"
 #include "UmodelCommands.h"
@@ -113,6 +114,9 @@ void CUmodelApp::ReleaseViewerAndObjects()
 	Viewer = NULL;
 
 	ReleaseAllObjects();
+#if UNREAL3
+	UTexture2D::ReleaseTextureFileCache();
+#endif
 }
 
 
@@ -3,10 +3,14 @@
 
 #include "UnObject.h"
 #include "UnPackage.h"
+#include "MeshCommon.h"			// for GCompactMeshVerts
 
 #include "PackageUtils.h"
+#include "PackageCatalog.h"
+#include "Profiler.h"			// for appCyclesToMsec
 #include "Exporters/Exporters.h"
 #include "UmodelApp.h"
+#include "UmodelSettings.h"
 
 
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
@@ -22,13 +26,24 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 	UnPackage* notifyPackage = NULL;
 	bool hasObjectList = (Objects != NULL) && Objects->Num();
 
-	//?? when 'Objects' passed, probably iterate over that list instead of GObjObjects
-	for (UObject* ExpObj : UObject::GObjObjects)
+	// When object list is provided, export objects in order of their location in package files,
+	// so data which is read during export (bulk data etc) is accessed sequentially. Otherwise
+	// all loaded objects are exported in order of loading.
+	TArray<UObject*> SortedObjects;
+	if (hasObjectList)
+	{
+		CopyArray(SortedObjects, *Objects);
+		SortObjectsByLocation(SortedObjects);
+	}
+	const TArray<UObject*>& ExportList = hasObjectList ? SortedObjects : UObject::GObjObjects;
+
+	for (int i = 0; i < ExportList.Num(); i++)
 	{
 		if (progress && !progress->Tick()) return false;
-		bool objectSelected = !hasObjectList || (Objects->FindItem(ExpObj) >= 0);
 
-		if (!objectSelected) continue;
+		UObject* ExpObj = ExportList[i];
+		// the same object could be listed several times, sorting puts duplicates together
+		if (i > 0 && ExpObj == ExportList[i-1]) continue;
 
 		if (notifyPackage != ExpObj->Package)
 		{
@@ -51,6 +66,169 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 }
 
 
+// When streamed export is used, loaded objects are released when memory allocated after the
+// previous release exceeds this limit
+#define STREAMED_EXPORT_MEMORY_LIMIT	(256 << 20)
+
+#if UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS
+
+static UnPackage* FindOpenedPackage(const char* Name)
+{
+	for (UnPackage* Package : UnPackage::GetPackageMap())
+	{
+		if (!stricmp(Package->Name, Name))
+			return Package;
+	}
+	return NULL;
+}
+
+static void AddExportRef(UnPackage* Package, int Index, TArray<CExportRef>& Refs)
+{
+	for (const CExportRef& Ref : Refs)
+	{
+		if (Ref.Package == Package && Ref.Index == Index) return;
+	}
+	CExportRef* Ref = new (Refs) CExportRef;
+	Ref->Package = Package;
+	Ref->Index = Index;
+}
+
+// Add an object referenced with package index (positive for export, negative for import)
+static void AddObjectRef(UnPackage* Package, int PackageIndex, TArray<CExportRef>& Refs)
+{
+	if (PackageIndex > 0)
+	{
+		AddExportRef(Package, PackageIndex - 1, Refs);
+		return;
+	}
+	if (PackageIndex == 0) return;
+
+	const FObjectImport& Imp = Package->GetImport(-PackageIndex - 1);
+	const FObjectImport* Outer = &Imp;
+	for (int Depth = 0; Outer->PackageIndex < 0 && Depth < 256; Depth++)
+		Outer = &Package->GetImport(-Outer->PackageIndex - 1);
+	if (Outer == &Imp || Outer->PackageIndex != 0) return;
+
+	// Objects of a package which is not opened yet were not loaded
+	UnPackage* Other = FindOpenedPackage(Outer->ObjectName);
+	if (!Other) return;
+	// Object path is not verified, so keep all objects with this name
+	for (int Index = Other->FindExport(Imp.ObjectName, Imp.ClassName); Index != INDEX_NONE;
+		Index = Other->FindExport(Imp.ObjectName, Imp.ClassName, Index + 1))
+	{
+		AddExportRef(Other, Index, Refs);
+	}
+}
+
+// Find loaded objects which could be referenced by the export when it is loaded. Walks UE3
+// dependency tables, returns false when they are not available.
+static bool CollectLoadedDependencies(UnPackage* Package, int ExportIndex, TArray<UObject*>& OutObjects)
+{
+	guard(CollectLoadedDependencies);
+
+	TArray<CExportRef> Refs;
+	AddExportRef(Package, ExportIndex, Refs);
+	for (int i = 0; i < Refs.Num(); i++)
+	{
+		UnPackage* RefPackage = Refs[i].Package;
+		int RefIndex = Refs[i].Index;
+		if (!RefPackage->DependsTable) return false;
+
+		const FObjectExport& Exp = RefPackage->GetExport(RefIndex);
+		if (Exp.Object) OutObjects.Add(Exp.Object);
+
+		AddObjectRef(RefPackage, Exp.ClassIndex, Refs);
+		AddObjectRef(RefPackage, Exp.SuperIndex, Refs);
+		AddObjectRef(RefPackage, Exp.PackageIndex, Refs);
+		AddObjectRef(RefPackage, Exp.Archetype, Refs);
+		const TArray<int>& Depends = RefPackage->DependsTable[RefIndex].Objects;
+		for (int j = 0; j < Depends.Num(); j++)
+			AddObjectRef(RefPackage, Depends[j], Refs);
+	}
+	return true;
+
+	unguard;
+}
+
+#endif // UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS
+
+// Release loaded objects before loading the specified export. Objects which the export depends
+// on are kept when this information is available, so shared materials and textures are not
+// loaded again. Otherwise everything is released.
+static void ReleaseObjectsBeforeExport(UnPackage* Package, int ExportIndex)
+{
+	guard(ReleaseObjectsBeforeExport);
+
+#if UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS
+	TArray<UObject*> Keep;
+	if (CollectLoadedDependencies(Package, ExportIndex, Keep))
+	{
+		for (int i = UObject::GObjObjects.Num() - 1; i >= 0; i--)
+		{
+			UObject* Obj = UObject::GObjObjects[i];
+			if (Keep.FindItem(Obj) < 0)
+				delete Obj;
+		}
+		GFullyLoadedPackages.Empty();
+		return;
+	}
+#endif // UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS
+
+	ReleaseAllObjects();
+
+	unguard;
+}
+
+// Export package without loading it entirely: iterate over exports in file order, load every exportable
+// object with its dependencies and export it. Previously loaded objects are reused until memory allocated
+// after the last release exceeds the limit, so objects shared by several exports are usually loaded only once.
+static bool ExportPackageStreamed(UnPackage* Package, IProgressCallback* Progress)
+{
+	guard(ExportPackageStreamed);
+
+	appSetNotifyHeader(Package->Filename);
+
+	// Memory used by name tables, opened packages etc is not counted
+	size_t BaseMemory = GTotalAllocationSize;
+
+	for (int idx = 0; idx < Package->Summary.ExportCount; idx++)
+	{
+		if (Progress && !Progress->Tick()) return false;
+
+		const FObjectExport& Exp = Package->GetExport(idx);
+		if (!IsExportableClass(Package->GetObjectName(Exp.ClassIndex)))
+			continue;
+		// The object could be already exported as a dependency of another object
+		if (IsObjectExported(Package, idx))
+			continue;
+
+		if (GTotalAllocationSize > BaseMemory + STREAMED_EXPORT_MEMORY_LIMIT)
+		{
+			ReleaseObjectsBeforeExport(Package, idx);
+			BaseMemory = GTotalAllocationSize;
+		}
+
+		// Load the object, its dependencies will be loaded too
+		int FirstNewObject = UObject::GObjObjects.Num();
+		UObject::BeginLoad();
+		UObject* Obj = Package->CreateExport(idx);
+		UObject::EndLoad();
+		if (!Obj) continue;
+
+		// Export the object and all newly loaded objects, the same way as ExportObjects() does
+		for (int i = FirstNewObject; i < UObject::GObjObjects.Num(); i++)
+		{
+			UObject* ExpObj = UObject::GObjObjects[i];
+			if (!IsObjectExported(ExpObj))
+				ExportObject(ExpObj);
+		}
+	}
+
+	return true;
+
+	unguardf("%s", Package->Name);
+}
+
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress)
 {
 	guard(ExportPackages);
@@ -65,16 +243,29 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 
 	bool cancelled = false;
 
-#if PROFILE
-//	appResetProfiler(); -- there's nested appResetProfiler/appPrintProfiler calls, which are not supported
-#endif
+	PROFILE_SCOPE("ExportPackages");
 
 	BeginExport();
 
+	if (GIncrementalExport)
+	{
+		// Settings which are not visible to exporters
+		const CStartupSettings& Startup = GSettings.Startup;
+		LoadExportManifest(va("%d %d %d %d %d %d %d %d %d%d%d%d%d%d%d%d%d%d",
+			GSettings.Export.SkeletalMeshFormat, GSettings.Export.StaticMeshFormat,
+			Startup.GameOverride, Startup.Platform, Startup.PackageCompression, GForcePackageVersion,
+			GCompactMeshVerts, GStreamedExport,
+			Startup.UseSkeletalMesh, Startup.UseAnimation, Startup.UseStaticMesh, Startup.UseTexture,
+			Startup.UseMorphTarget, Startup.UseLightmapTexture, Startup.UseSound, Startup.UseScaleForm,
+			Startup.UseFaceFx));
+	}
+	int numUpToDate = 0;
+
 	// For each package: load a package, export, then release
 	for (int i = 0; i < Packages.Num(); i++)
 	{
 		UnPackage* package = Packages[i];
+		PROFILE_SCOPE("Package");
 
 		// Update progress dialog
 		if (Progress && !Progress->Progress(package->Name, i, Packages.Num()))
@@ -82,29 +273,51 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 			cancelled = true;
 			break;
 		}
-		// Load
-		if (!LoadWholePackage(package, Progress))
+		// Skip package when it was not changed since previous export
+		if (GIncrementalExport && IsPackageExportUpToDate(package))
 		{
-			cancelled = true;
-			break;
+			numUpToDate++;
+			continue;
 		}
-		// Export
-		if (!ExportObjects(NULL, Progress))
+		if (GStreamedExport)
 		{
-			cancelled = true;
-			break;
+			// Load and export objects one by one
+			if (!ExportPackageStreamed(package, Progress))
+			{
+				cancelled = true;
+				break;
+			}
+		}
+		else
+		{
+			// Load
+			if (!LoadWholePackage(package, Progress))
+			{
+				cancelled = true;
+				break;
+			}
+			// Export
+			if (!ExportObjects(NULL, Progress))
+			{
+				cancelled = true;
+				break;
+			}
 		}
+		if (GIncrementalExport)
+			CommitPackageExport(package);
 		// Release
+		PROFILE_SCOPE("Release");
 		ReleaseAllObjects();
 	}
 
 	// Cleanup
+	if (GIncrementalExport)
+	{
+		SaveExportManifest();
+		appPrintf("%d/%d packages were not changed since previous export\n", numUpToDate, Packages.Num());
+	}
 	EndExport(true);
 
-#if PROFILE
-//	appPrintProfiler();
-#endif
-
 	if (cancelled)
 	{
 		ReleaseAllObjects();
@@ -118,9 +331,10 @@ bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progr
 }
 
 
-void DisplayPackageStats(const TArray<UnPackage*> &Packages)
+void DisplayPackageStats(const TArray<UnPackage*> &Packages, const CPackageCatalog* Catalog, const TArray<int>* CatalogPackages)
 {
-	if (Packages.Num() == 0)
+	int numCatalogPackages = CatalogPackages ? CatalogPackages->Num() : 0;
+	if (Packages.Num() == 0 && numCatalogPackages == 0)
 	{
 		appPrintf("Nothing has been loaded\n");
 		return;
@@ -128,12 +342,197 @@ void DisplayPackageStats(const TArray<UnPackage*> &Packages)
 	TArray<ClassStats> stats;
 	CollectPackageStats(Packages, stats);
 
+	if (numCatalogPackages)
+	{
+		// merge class counts of packages which were not opened
+		for (int i = 0; i < numCatalogPackages; i++)
+		{
+			const FCatalogPackage& P = Catalog->GetPackage((*CatalogPackages)[i]);
+			for (int j = 0; j < P.NumExports; j++)
+			{
+				const char* className = Catalog->GetString(Catalog->GetExport(P.FirstExport + j).ClassName);
+				ClassStats* found = NULL;
+				for (int k = 0; k < stats.Num(); k++)
+				{
+					if (!stricmp(stats[k].Name, className))
+					{
+						found = &stats[k];
+						break;
+					}
+				}
+				if (!found)
+					found = new (stats) ClassStats(className);
+				found->Count++;
+			}
+		}
+		stats.Sort([](const ClassStats& p1, const ClassStats& p2) -> int
+			{
+				return stricmp(p1.Name, p2.Name);
+			});
+	}
+
 	appPrintf("Class statistics:\n");
 	for (int i = 0; i < stats.Num(); i++)
 		appPrintf("%5d %s\n", stats[i].Count, stats[i].Name);
 }
 
 
+void ListCatalogPackage(const CPackageCatalog& Catalog, int PackageIndex)
+{
+	guard(ListCatalogPackage);
+
+	// same format as export table dump of loaded package
+	const FCatalogPackage& P = Catalog.GetPackage(PackageIndex);
+	for (int i = 0; i < P.NumExports; i++)
+	{
+		const FCatalogExport& Exp = Catalog.GetExport(P.FirstExport + i);
+		appPrintf("%4d %8X %8X %s %s\n", i, Exp.SerialOffset, Exp.SerialSize, Catalog.GetString(Exp.ClassName), Catalog.GetString(Exp.Name));
+	}
+
+	unguard;
+}
+
+static void PrintDependency(const char* PackageName)
+{
+	const CGameFileInfo* File = appFindGameFile(PackageName);
+	if (File && File->IsPackage)
+		appPrintf("    %s\n", *File->GetRelativeName());
+	else
+		appPrintf("    %s (missing)\n", PackageName);
+}
+
+void DisplayPackageDependencies(const TArray<UnPackage*>& Packages, const CPackageCatalog* Catalog, const TArray<int>* CatalogPackages)
+{
+	guard(DisplayPackageDependencies);
+
+	// opened packages: use outermost imports
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		const UnPackage* Package = Packages[i];
+		appPrintf("%s\n  depends on:\n", Package->Filename);
+		for (int j = 0; j < Package->Summary.ImportCount; j++)
+		{
+			const FObjectImport& Imp = Package->ImportTable[j];
+			if (Imp.PackageIndex != 0) continue;
+			bool duplicate = false;
+			for (int k = 0; k < j; k++)
+			{
+				const FObjectImport& Imp2 = Package->ImportTable[k];
+				if (Imp2.PackageIndex == 0 && !stricmp(Imp2.ObjectName, Imp.ObjectName))
+				{
+					duplicate = true;
+					break;
+				}
+			}
+			if (!duplicate)
+				PrintDependency(Imp.ObjectName);
+		}
+	}
+
+	// catalog has dependencies in both directions
+	int numCatalogPackages = CatalogPackages ? CatalogPackages->Num() : 0;
+	for (int i = 0; i < numCatalogPackages; i++)
+	{
+		int PackageIndex = (*CatalogPackages)[i];
+		const FCatalogPackage& P = Catalog->GetPackage(PackageIndex);
+		appPrintf("%s\n  depends on:\n", Catalog->GetString(P.Name));
+		for (int j = 0; j < P.NumDepends; j++)
+		{
+			const FCatalogDepend& Dep = Catalog->GetDepend(P.FirstDepend + j);
+			if (Dep.Package >= 0)
+				appPrintf("    %s\n", Catalog->GetString(Catalog->GetPackage(Dep.Package).Name));
+			else
+				appPrintf("    %s (missing)\n", Catalog->GetString(Dep.Name));
+		}
+		TArray<int> Users;
+		Catalog->FindDependentPackages(PackageIndex, Users);
+		appPrintf("  used by:\n");
+		for (int j = 0; j < Users.Num(); j++)
+			appPrintf("    %s\n", Catalog->GetString(Catalog->GetPackage(Users[j]).Name));
+	}
+
+	unguard;
+}
+
+
+// Maximal number of packages displayed in load statistics, all packages are saved to csv
+#define MAX_DISPLAYED_PACKAGE_STATS		20
+
+static void SortLoadStats(TArray<CObjectLoadStats>& Stats)
+{
+	// Slowest first
+	Stats.Sort([](const CObjectLoadStats& A, const CObjectLoadStats& B) -> int
+		{
+			int64 TimeA = A.SerializeTime + A.PostLoadTime;
+			int64 TimeB = B.SerializeTime + B.PostLoadTime;
+			if (TimeA != TimeB)
+				return TimeA > TimeB ? -1 : 1;
+			return stricmp(A.Name, B.Name);
+		});
+}
+
+static void PrintLoadStats(const char* Title, const TArray<CObjectLoadStats>& Stats, int MaxLines)
+{
+	appPrintf("\n%s:\n", Title);
+	appPrintf("%-32s %7s %12s %12s %10s %10s %10s %8s\n",
+		"Name", "Count", "Serialize ms", "PostLoad ms", "Data KB", "Read KB", "Memory KB", "Blocks");
+	int Count = min(Stats.Num(), MaxLines);
+	for (int i = 0; i < Count; i++)
+	{
+		const CObjectLoadStats& S = Stats[i];
+		appPrintf("%-32s %7d %12.2f %12.2f %10d %10d %10d %8d\n",
+			S.Name, S.Count, appCyclesToMsec(S.SerializeTime), appCyclesToMsec(S.PostLoadTime),
+			int(S.SerialBytes >> 10), int(S.FileBytes >> 10), int(S.MemoryBytes >> 10), S.MemoryBlocks);
+	}
+	if (Count < Stats.Num())
+		appPrintf("... %d more\n", Stats.Num() - Count);
+}
+
+static void SaveLoadStatsCsv(FArchive& Ar, const char* Type, const TArray<CObjectLoadStats>& Stats)
+{
+	for (int i = 0; i < Stats.Num(); i++)
+	{
+		const CObjectLoadStats& S = Stats[i];
+		Ar.Printf("%s,\"%s\",%d,%.3f,%.3f,%lld,%lld,%lld,%d\n",
+			Type, S.Name, S.Count, appCyclesToMsec(S.SerializeTime), appCyclesToMsec(S.PostLoadTime),
+			S.SerialBytes, S.FileBytes, S.MemoryBytes, S.MemoryBlocks);
+	}
+}
+
+void DisplayLoadStats(const char* CsvFilename)
+{
+	guard(DisplayLoadStats);
+
+	if (!GClassLoadStats.Num())
+	{
+		appPrintf("No objects were loaded\n");
+		return;
+	}
+
+	SortLoadStats(GClassLoadStats);
+	SortLoadStats(GPackageLoadStats);
+
+	PrintLoadStats("Load statistics by class", GClassLoadStats, GClassLoadStats.Num());
+	PrintLoadStats("Load statistics by package", GPackageLoadStats, MAX_DISPLAYED_PACKAGE_STATS);
+
+	if (CsvFilename && CsvFilename[0])
+	{
+		FFileWriter Ar(CsvFilename, FAO_TextFile | FAO_NoOpenError);
+		if (!Ar.IsOpen())
+		{
+			appPrintf("Unable to create %s\n", CsvFilename);
+			return;
+		}
+		Ar.Printf("Type,Name,Count,SerializeMs,PostLoadMs,DataBytes,ReadBytes,MemoryBytes,MemoryBlocks\n");
+		SaveLoadStatsCsv(Ar, "class", GClassLoadStats);
+		SaveLoadStatsCsv(Ar, "package", GPackageLoadStats);
+		appPrintf("Load statistics saved to %s\n", CsvFilename);
+	}
+
+	unguard;
+}
+
+
 static void CopyStream(FArchive *Src, FILE *Dst, int Count)
 {
 	guard(CopyStream);
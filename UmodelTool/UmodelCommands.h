@@ -3,6 +3,7 @@
 
 class UnPackage;
 class IProgressCallback;
+class CPackageCatalog;
 
 // Export all loaded objects.
 bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress = NULL);
@@ -10,7 +11,21 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress
 // Export everything from provided package list.
 bool ExportPackages(const TArray<UnPackage*>& Packages, IProgressCallback* Progress = NULL);
 
-void DisplayPackageStats(const TArray<UnPackage*> &Packages);
+// Display class statistics for opened packages and, optionally, for packages from catalog
+void DisplayPackageStats(const TArray<UnPackage*> &Packages, const CPackageCatalog* Catalog = NULL, const TArray<int>* CatalogPackages = NULL);
+
+// Display export table of a catalog package in the same format as "-list" does for opened package
+void ListCatalogPackage(const CPackageCatalog& Catalog, int PackageIndex);
+
+// Display packages which are used by provided packages. For catalog packages, also display
+// packages which are using them.
+void DisplayPackageDependencies(const TArray<UnPackage*>& Packages, const CPackageCatalog* Catalog = NULL, const TArray<int>* CatalogPackages = NULL);
+
+// Display statistics collected with GCollectLoadStats, optionally save it to csv file
+void DisplayLoadStats(const char* CsvFilename = NULL);
+
+// Run built-in benchmarks, Filter is a comma-separated list of groups (NULL for all)
+void RunBenchmarks(const char* Filter);
 
 void SavePackages(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL);
 
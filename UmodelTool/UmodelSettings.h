@@ -56,6 +56,7 @@ enum class EExportMeshFormat : int
 	psk,
 	md5,
 	gltf,
+	glb,
 };
 
 enum class ETextureExportFormat : int
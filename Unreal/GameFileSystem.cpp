@@ -8,9 +8,13 @@
 // includes for file enumeration
 #if _WIN32
 #	include <io.h>					// for findfirst() set
+#	include <process.h>				// for _getpid()
+#	include <sys/utime.h>			// for _utime()
 #else
 #	include <dirent.h>				// for opendir() etc
 #	include <sys/stat.h>			// for stat()
+#	include <utime.h>				// for utime()
+#	include <unistd.h>				// for getpid()
 #endif
 
 
@@ -914,7 +918,7 @@ const char *appSkipRootDir(const char *Filename)
 }
 
 
-FArchive* CGameFileInfo::CreateReader() const
+FArchive* CGameFileInfo::CreateReader(bool bUseCache) const
 {
 	if (!FileSystem)
 	{
@@ -926,10 +930,32 @@ FArchive* CGameFileInfo::CreateReader() const
 	else
 	{
 		// file from virtual file system
+		FString CacheKey;
+		if (bUseCache && appFileCacheEnabled() && FileSystem->GetCacheKey(RelativeName, CacheKey))
+		{
+			FArchive* CachedReader = appOpenCachedFile(*CacheKey, false);
+			if (CachedReader) return CachedReader;
+			FArchive* Reader = FileSystem->CreateReader(RelativeName);
+			if (!Reader) return NULL;
+			// Data will be cached when it is really needed, see UnPackage::SetupReader()
+			return new FDeferredCacheReader(Reader, *CacheKey, false);
+		}
 		return FileSystem->CreateReader(RelativeName);
 	}
 }
 
+bool CGameFileInfo::GetModificationTime(int64& OutTime) const
+{
+	if (!FileSystem)
+	{
+		char buf[MAX_PACKAGE_PATH];
+		appSprintf(ARRAY_ARG(buf), "%s/%s", GRootDirectory, RelativeName);
+		int64 FileSize;
+		return appGetFileStamp(buf, FileSize, OutTime);
+	}
+	return FileSystem->GetFileTime(RelativeName, OutTime);
+}
+
 
 void CGameFileInfo::GetRelativeName(FString& OutName) const
 {
@@ -985,3 +1011,320 @@ void appEnumGameFilesWorker(bool (*Callback)(const CGameFileInfo*, void*), const
 		if (!Callback(info, Param)) break;
 	}
 }
+
+
+/*-----------------------------------------------------------------------------
+	Decompressed file cache
+-----------------------------------------------------------------------------*/
+
+#define FILE_CACHE_TAG			0x46434D55		// 'UMCF'
+#define FILE_CACHE_VERSION		1
+#define FILE_CACHE_COPY_SIZE	(1 << 20)
+
+// Header of cached file, followed by the key string and data
+struct FFileCacheHeader
+{
+	uint32		Tag;
+	int32		Version;
+	int32		KeyLength;
+	int32		DataSize;
+};
+
+// Reader for cached data, skips the cache header
+class FCachedFileReader : public FReaderWrapper
+{
+	DECLARE_ARCHIVE(FCachedFileReader, FReaderWrapper);
+public:
+	FCachedFileReader(FArchive* File, int HeaderSize, bool bCompressed)
+	:	FReaderWrapper(File, HeaderSize)
+	,	bCompressedSource(bCompressed)
+	{
+		IsLoading = true;
+		Seek(0);
+	}
+
+	// Some code depends on whether the package was compressed (for example, UE4 bulk data)
+	virtual bool IsCompressed() const
+	{
+		return bCompressedSource;
+	}
+
+protected:
+	bool		bCompressedSource;
+};
+
+static char  GFileCacheDir[MAX_PACKAGE_PATH];
+static int64 GFileCacheMaxSize = 0;
+static int64 GFileCacheSize = -1;			// total size of cached files, -1 when directory was not scanned yet
+
+void appSetFileCacheDirectory(const char* Dir, int MaxSizeMb)
+{
+	appStrncpyz(GFileCacheDir, Dir, ARRAY_COUNT(GFileCacheDir));
+	GFileCacheMaxSize = (int64)MaxSizeMb << 20;
+	if (GFileCacheDir[0])
+		appMakeDirectory(GFileCacheDir);
+}
+
+bool appFileCacheEnabled()
+{
+	return GFileCacheDir[0] != 0;
+}
+
+bool appGetFileStamp(const char* Filename, int64& Size, int64& Time)
+{
+#if _WIN32
+	struct _stati64 buf;
+	if (_stati64(Filename, &buf) != 0) return false;
+#else
+	struct stat64 buf;
+	if (stat64(Filename, &buf) != 0) return false;
+#endif
+	Size = buf.st_size;
+	Time = buf.st_mtime;
+	return true;
+}
+
+bool appMakeFileCacheKey(const char* SourceFilename, const char* Suffix, FString& OutKey)
+{
+	int64 Size, Time;
+	if (!appGetFileStamp(SourceFilename, Size, Time))
+		return false;
+	char buf[MAX_PACKAGE_PATH * 2];
+	appSprintf(ARRAY_ARG(buf), "%s|%lld|%lld|game=%X,ver=%d,plat=%d,comp=%d|%s", SourceFilename, Size, Time,
+		GForceGame, GForcePackageVersion, GForcePlatform, GForceCompMethod, Suffix);
+	OutKey = buf;
+	return true;
+}
+
+static void GetCacheFilename(const char* Key, char* Filename, int FilenameSize)
+{
+	appSprintf(Filename, FilenameSize, "%s/%016llX.bin", GFileCacheDir, appMemHash64(Key, strlen(Key)));
+}
+
+FArchive* appOpenCachedFile(const char* Key, bool bCompressedSource)
+{
+	guard(appOpenCachedFile);
+
+	char Filename[MAX_PACKAGE_PATH];
+	GetCacheFilename(Key, ARRAY_ARG(Filename));
+	FFileReader* Reader = new FFileReader(Filename, FAO_NoOpenError);
+	if (!Reader->IsOpen())
+	{
+		delete Reader;
+		return NULL;
+	}
+
+	// Validate the file: it could be incomplete or could have a different key with the same hash
+	int KeyLength = strlen(Key);
+	bool bValid = false;
+	FFileCacheHeader Header;
+	if (Reader->GetFileSize64() >= sizeof(Header) + KeyLength)
+	{
+		Reader->Serialize(&Header, sizeof(Header));
+		if (Header.Tag == FILE_CACHE_TAG && Header.Version == FILE_CACHE_VERSION && Header.KeyLength == KeyLength &&
+			Reader->GetFileSize64() == sizeof(Header) + KeyLength + Header.DataSize)
+		{
+			char* StoredKey = (char*)appMalloc(KeyLength);
+			Reader->Serialize(StoredKey, KeyLength);
+			bValid = (memcmp(StoredKey, Key, KeyLength) == 0);
+			appFree(StoredKey);
+		}
+	}
+	if (!bValid)
+	{
+		delete Reader;
+		return NULL;
+	}
+
+	// Update modification time, it is used for removing least recently used files
+#if _WIN32
+	_utime(Filename, NULL);
+#else
+	utime(Filename, NULL);
+#endif
+
+	return new FCachedFileReader(Reader, sizeof(Header) + KeyLength, bCompressedSource);
+
+	unguardf("%s", Key);
+}
+
+// Note: this function shouldn't have local objects with destructors because of TRY/CATCH
+static bool WriteCacheFile(const char* Filename, const char* Key, FArchive* Source)
+{
+	FArchive* Writer = new FFileWriter(Filename, FAO_NoOpenError);
+	if (!Writer->IsOpen())
+	{
+		delete Writer;
+		return false;
+	}
+	byte* Buffer = (byte*)appMalloc(FILE_CACHE_COPY_SIZE);
+
+	bool bOk = false;
+	TRY
+	{
+		FFileCacheHeader Header;
+		Header.Tag       = FILE_CACHE_TAG;
+		Header.Version   = FILE_CACHE_VERSION;
+		Header.KeyLength = strlen(Key);
+		Header.DataSize  = Source->GetFileSize();
+		Writer->Serialize(&Header, sizeof(Header));
+		Writer->Serialize(const_cast<char*>(Key), Header.KeyLength);
+		// Copy data
+		for (int Pos = 0; Pos < Header.DataSize; Pos += FILE_CACHE_COPY_SIZE)
+		{
+			int Size = min(Header.DataSize - Pos, FILE_CACHE_COPY_SIZE);
+			Source->Seek(Pos);
+			Source->Serialize(Buffer, Size);
+			Writer->Serialize(Buffer, Size);
+		}
+		bOk = true;
+	}
+	CATCH
+	{
+		// Source data is broken, don't cache it
+	}
+
+	appFree(Buffer);
+	delete Writer;
+	Source->Seek(0);
+	return bOk;
+}
+
+struct CCachedFileInfo
+{
+	char		Name[32];
+	int64		Size;
+	int64		Time;
+};
+
+// Scan cache directory and remove least recently used files when cache size exceeds the limit
+static void TrimFileCache()
+{
+	guard(TrimFileCache);
+
+	TArray<CCachedFileInfo> Files;
+	int64 TotalSize = 0;
+
+	char Path[MAX_PACKAGE_PATH];
+#if _WIN32
+	appSprintf(ARRAY_ARG(Path), "%s/*.bin", GFileCacheDir);
+	_finddatai64_t found;
+	intptr_t hFind = _findfirsti64(Path, &found);
+	if (hFind == -1) return;
+	do
+	{
+		if (found.attrib & _A_SUBDIR) continue;
+		CCachedFileInfo* File = new (Files) CCachedFileInfo;
+		appStrncpyz(File->Name, found.name, ARRAY_COUNT(File->Name));
+		File->Size = found.size;
+		File->Time = found.time_write;
+		TotalSize += File->Size;
+	} while (_findnexti64(hFind, &found) != -1);
+	_findclose(hFind);
+#else
+	DIR *find = opendir(GFileCacheDir);
+	if (!find) return;
+	struct dirent *ent;
+	while ((ent = readdir(find)))
+	{
+		const char* ext = strrchr(ent->d_name, '.');
+		if (!ext || strcmp(ext, ".bin") != 0) continue;
+		appSprintf(ARRAY_ARG(Path), "%s/%s", GFileCacheDir, ent->d_name);
+		struct stat64 buf;
+		if (stat64(Path, &buf) < 0 || !S_ISREG(buf.st_mode)) continue;
+		CCachedFileInfo* File = new (Files) CCachedFileInfo;
+		appStrncpyz(File->Name, ent->d_name, ARRAY_COUNT(File->Name));
+		File->Size = buf.st_size;
+		File->Time = buf.st_mtime;
+		TotalSize += File->Size;
+	}
+	closedir(find);
+#endif
+
+	GFileCacheSize = TotalSize;
+	if (TotalSize <= GFileCacheMaxSize) return;
+
+	// Oldest files first
+	Files.Sort([](const CCachedFileInfo& A, const CCachedFileInfo& B) -> int
+		{
+			return (A.Time < B.Time) ? -1 : ((A.Time > B.Time) ? 1 : 0);
+		});
+
+	for (int i = 0; i < Files.Num() && TotalSize > GFileCacheMaxSize; i++)
+	{
+		appSprintf(ARRAY_ARG(Path), "%s/%s", GFileCacheDir, Files[i].Name);
+		if (remove(Path) == 0)
+			TotalSize -= Files[i].Size;
+	}
+	GFileCacheSize = TotalSize;
+
+	unguard;
+}
+
+FArchive* appCacheFileData(const char* Key, FArchive* Source, bool bCompressedSource)
+{
+	guard(appCacheFileData);
+
+	int DataSize = Source->GetFileSize();
+	if (DataSize <= 0 || (GFileCacheMaxSize && DataSize > GFileCacheMaxSize))
+		return NULL;
+
+	// Write to a temporary file, then rename it, so other process will never see incomplete file.
+	// Process id is a part of the name, so processes caching the same file won't conflict.
+	char Filename[MAX_PACKAGE_PATH], TempFilename[MAX_PACKAGE_PATH];
+	GetCacheFilename(Key, ARRAY_ARG(Filename));
+#if _WIN32
+	int Pid = _getpid();
+#else
+	int Pid = getpid();
+#endif
+	appSprintf(ARRAY_ARG(TempFilename), "%s.%d.tmp", Filename, Pid);
+	if (!WriteCacheFile(TempFilename, Key, Source))
+	{
+		remove(TempFilename);
+		return NULL;
+	}
+	// When the file is replaced, its old size should not be counted twice
+	int64 OldSize = 0, OldTime;
+	if (!appGetFileStamp(Filename, OldSize, OldTime))
+		OldSize = 0;
+	remove(Filename);
+	if (rename(TempFilename, Filename) != 0)
+	{
+		remove(TempFilename);
+		return NULL;
+	}
+
+	// Directory is scanned only when the size of cache exceeds the limit. Other processes could
+	// change the cache too, so the size is updated with every scan.
+	if (GFileCacheMaxSize)
+	{
+		if (GFileCacheSize >= 0)
+			GFileCacheSize += sizeof(FFileCacheHeader) + strlen(Key) + DataSize - OldSize;
+		if (GFileCacheSize < 0 || GFileCacheSize > GFileCacheMaxSize)
+			TrimFileCache();
+	}
+
+	return appOpenCachedFile(Key, bCompressedSource);
+
+	unguardf("%s", Key);
+}
+
+void FDeferredCacheReader::StartCaching()
+{
+	guard(FDeferredCacheReader::StartCaching);
+
+	if (!bPending) return;
+	bPending = false;
+
+	int Pos = Reader->Tell();
+	FArchive* CachedReader = appCacheFileData(*Key, Reader, bCompressedSource);
+	if (!CachedReader) return;				// continue reading from the source
+
+	CachedReader->SetupFrom(*Reader);
+	delete Reader;
+	Reader = CachedReader;
+	Reader->Seek(Pos);
+
+	unguardf("%s", *Key);
+}
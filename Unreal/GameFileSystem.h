@@ -18,9 +18,77 @@ public:
 	virtual int NumFiles() const = 0;
 	virtual const char* FileName(int i) = 0;
 	virtual int GetFileSize(const char* name) = 0;
+
+	// Make a string which identifies file's data for the decompressed file cache. Returns
+	// false when file is stored without compression and encryption, so it's not worth caching.
+	virtual bool GetCacheKey(const char* name, FString& OutKey)
+	{
+		return false;
+	}
+	// Get modification time of the file. Usually this is a time of VFS container file.
+	virtual bool GetFileTime(const char* name, int64& OutTime)
+	{
+		return false;
+	}
 };
 
 void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs = NULL);
 
 
+/*-----------------------------------------------------------------------------
+	Decompressed file cache
+-----------------------------------------------------------------------------*/
+
+// Files which require decompression or decryption could be stored in the cache directory
+// after the first access, so later they will be read without any processing. Cache is
+// disabled when directory is not set. When total size of cached files exceeds MaxSizeMb,
+// least recently used files are removed.
+void appSetFileCacheDirectory(const char* Dir, int MaxSizeMb);
+bool appFileCacheEnabled();
+
+// Get size and modification time of OS file
+bool appGetFileStamp(const char* Filename, int64& Size, int64& Time);
+
+// Make a cache key from identity of source file (name, size and modification time), current
+// game and version overrides and Suffix, which identifies data inside the source file.
+// Returns false if source file doesn't exist.
+bool appMakeFileCacheKey(const char* SourceFilename, const char* Suffix, FString& OutKey);
+
+// Open cached data, returns NULL when there's no data for this key
+FArchive* appOpenCachedFile(const char* Key, bool bCompressedSource);
+// Copy all data of Source archive to the cache and return reader for the cached copy. Returns
+// NULL in a case of error. Source archive is not deleted.
+FArchive* appCacheFileData(const char* Key, FArchive* Source, bool bCompressedSource);
+
+// Reader which serves data from Source until StartCaching() is called. After that, all data
+// is copied to the cache and further reads are served from the cached copy. This way files
+// which were opened only for reading headers (listing, scanning) are not put to the cache.
+class FDeferredCacheReader : public FReaderWrapper
+{
+	DECLARE_ARCHIVE(FDeferredCacheReader, FReaderWrapper);
+public:
+	FDeferredCacheReader(FArchive* Source, const char* InKey, bool bCompressed)
+	:	FReaderWrapper(Source)
+	,	Key(InKey)
+	,	bCompressedSource(bCompressed)
+	,	bPending(true)
+	{
+		IsLoading = true;
+	}
+
+	// Report the same value before and after switching to the cached copy
+	virtual bool IsCompressed() const
+	{
+		return bCompressedSource;
+	}
+
+	void StartCaching();
+
+protected:
+	FString		Key;
+	bool		bCompressedSource;
+	bool		bPending;
+};
+
+
 #endif // __GAME_FILE_SYSTEM_H__
@@ -170,6 +170,192 @@ void BuildTangentsCommon(CMeshVertex *Verts, int VertexSize, const CIndexBuffer
 	unguard;
 }
 
+
+/*-----------------------------------------------------------------------------
+	Compact vertex storage
+-----------------------------------------------------------------------------*/
+
+int GCompactMeshVerts = 0;
+
+// Layout of compact vertex (Stride bytes, aligned to 4):
+//	CPackedNormal	Normal, Tangent
+//	byte			Extra[ExtraSize]			- data of derived vertex class
+//	uint16			Position[3]
+//	uint16			UV[NumUVs][2]				- base UV followed by ExtraUV[]
+struct CCompactVertexData
+{
+	CVec3					PositionOrigin;
+	CVec3					PositionScale;
+	CMeshUVFloat			UVOrigin[MAX_MESH_UV_SETS];
+	CMeshUVFloat			UVScale[MAX_MESH_UV_SETS];
+	int						NumUVs;
+	int						ExtraSize;
+	int						Stride;
+	byte*					Data;
+};
+
+#define COMPACT_RANGE		65535.0f
+
+FORCEINLINE void SetupQuantization(float Min, float Max, float& Origin, float& Scale)
+{
+	Origin = Min;
+	Scale  = (Max > Min) ? (Max - Min) / COMPACT_RANGE : 0.0f;
+}
+
+FORCEINLINE uint16 Quantize(float Value, float Origin, float InvScale)
+{
+	int Q = appRound((Value - Origin) * InvScale);
+	return bound(Q, 0, 0xFFFF);
+}
+
+void CBaseMeshLod::CompactVertsCommon(const CMeshVertex *Verts, int VertexSize, int ExtraSize)
+{
+	guard(CBaseMeshLod::CompactVertsCommon);
+
+	int i, j, k;
+
+	assert(!CompactData && NumVerts > 0);
+	assert((ExtraSize & 1) == 0 && sizeof(CMeshVertex) + ExtraSize <= VertexSize);
+
+	CCompactVertexData* C = new CCompactVertexData;
+	C->NumUVs    = max(NumTexCoords, 1);
+	C->ExtraSize = ExtraSize;
+	C->Stride    = Align(sizeof(CPackedNormal) * 2 + ExtraSize + sizeof(uint16) * (3 + C->NumUVs * 2), 4);
+	C->Data      = (byte*)appMalloc(C->Stride * NumVerts);
+
+	// compute bounds of positions and UVs
+	CVec3 Mins, Maxs;
+	CMeshUVFloat UVMins[MAX_MESH_UV_SETS], UVMaxs[MAX_MESH_UV_SETS];
+	Mins = Maxs = (CVec3&)VERT(0)->Position;
+	for (j = 0; j < C->NumUVs; j++)
+		UVMins[j] = UVMaxs[j] = (j == 0) ? VERT(0)->UV : ExtraUV[j-1][0];
+	for (i = 1; i < NumVerts; i++)
+	{
+		const CMeshVertex* V = VERT(i);
+		for (k = 0; k < 3; k++)
+		{
+			float Value = V->Position.v[k];
+			if (Value < Mins[k]) Mins[k] = Value;
+			if (Value > Maxs[k]) Maxs[k] = Value;
+		}
+		for (j = 0; j < C->NumUVs; j++)
+		{
+			const CMeshUVFloat& UV = (j == 0) ? V->UV : ExtraUV[j-1][i];
+			if (UV.U < UVMins[j].U) UVMins[j].U = UV.U;
+			if (UV.U > UVMaxs[j].U) UVMaxs[j].U = UV.U;
+			if (UV.V < UVMins[j].V) UVMins[j].V = UV.V;
+			if (UV.V > UVMaxs[j].V) UVMaxs[j].V = UV.V;
+		}
+	}
+
+	CVec3 InvScale;
+	CMeshUVFloat UVInvScale[MAX_MESH_UV_SETS];
+	for (k = 0; k < 3; k++)
+	{
+		SetupQuantization(Mins[k], Maxs[k], C->PositionOrigin[k], C->PositionScale[k]);
+		InvScale[k] = C->PositionScale[k] ? 1.0f / C->PositionScale[k] : 0.0f;
+	}
+	for (j = 0; j < C->NumUVs; j++)
+	{
+		SetupQuantization(UVMins[j].U, UVMaxs[j].U, C->UVOrigin[j].U, C->UVScale[j].U);
+		SetupQuantization(UVMins[j].V, UVMaxs[j].V, C->UVOrigin[j].V, C->UVScale[j].V);
+		UVInvScale[j].U = C->UVScale[j].U ? 1.0f / C->UVScale[j].U : 0.0f;
+		UVInvScale[j].V = C->UVScale[j].V ? 1.0f / C->UVScale[j].V : 0.0f;
+	}
+
+	// pack vertices
+	for (i = 0; i < NumVerts; i++)
+	{
+		const CMeshVertex* V = VERT(i);
+		byte* D = C->Data + i * C->Stride;
+		CPackedNormal* N = (CPackedNormal*)D;
+		N[0] = V->Normal;
+		N[1] = V->Tangent;
+		if (ExtraSize) memcpy(N + 2, V + 1, ExtraSize);
+		uint16* Q = (uint16*)(D + sizeof(CPackedNormal) * 2 + ExtraSize);
+		for (k = 0; k < 3; k++)
+			*Q++ = Quantize(V->Position.v[k], C->PositionOrigin[k], InvScale[k]);
+		for (j = 0; j < C->NumUVs; j++)
+		{
+			const CMeshUVFloat& UV = (j == 0) ? V->UV : ExtraUV[j-1][i];
+			*Q++ = Quantize(UV.U, C->UVOrigin[j].U, UVInvScale[j].U);
+			*Q++ = Quantize(UV.V, C->UVOrigin[j].V, UVInvScale[j].V);
+		}
+	}
+
+	// release uncompressed data
+	for (j = 0; j < NumTexCoords-1; j++)
+	{
+		appFree(ExtraUV[j]);
+		ExtraUV[j] = NULL;
+	}
+	CompactData = C;
+
+	unguard;
+}
+
+void CBaseMeshLod::ExpandVertsCommon(CMeshVertex *Verts, int VertexSize)
+{
+	guard(CBaseMeshLod::ExpandVertsCommon);
+
+	const CCompactVertexData* C = CompactData;
+	AllocateUVBuffers();
+
+	for (int i = 0; i < NumVerts; i++)
+	{
+		CMeshVertex* V = VERT(i);
+		const byte* S = C->Data + i * C->Stride;
+		const CPackedNormal* N = (const CPackedNormal*)S;
+		V->Normal  = N[0];
+		V->Tangent = N[1];
+		if (C->ExtraSize) memcpy(V + 1, N + 2, C->ExtraSize);
+		const uint16* Q = (const uint16*)(S + sizeof(CPackedNormal) * 2 + C->ExtraSize);
+		for (int k = 0; k < 3; k++)
+			V->Position.v[k] = C->PositionOrigin[k] + *Q++ * C->PositionScale[k];
+#if USE_SSE
+		V->Position.v[3] = 0;
+#endif
+		for (int j = 0; j < C->NumUVs; j++)
+		{
+			CMeshUVFloat& UV = (j == 0) ? V->UV : ExtraUV[j-1][i];
+			UV.U = C->UVOrigin[j].U + Q[0] * C->UVScale[j].U;
+			UV.V = C->UVOrigin[j].V + Q[1] * C->UVScale[j].V;
+			Q += 2;
+		}
+	}
+
+	unguard;
+}
+
+void CBaseMeshLod::ReleaseVertsCommon(const CMeshVertex *Verts, int VertexSize)
+{
+	guard(CBaseMeshLod::ReleaseVertsCommon);
+
+	const CCompactVertexData* C = CompactData;
+	for (int i = 0; i < NumVerts; i++)
+	{
+		const CMeshVertex* V = VERT(i);
+		CPackedNormal* N = (CPackedNormal*)(C->Data + i * C->Stride);
+		N[0] = V->Normal;
+		N[1] = V->Tangent;
+	}
+	for (int j = 0; j < NumTexCoords-1; j++)
+	{
+		appFree(ExtraUV[j]);
+		ExtraUV[j] = NULL;
+	}
+
+	unguard;
+}
+
+void CBaseMeshLod::FreeCompactData()
+{
+	appFree(CompactData->Data);
+	delete CompactData;
+	CompactData = NULL;
+}
+
+
 #if RENDERING
 void CBaseMeshLod::LockMaterials()
 {
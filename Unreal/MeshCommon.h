@@ -18,6 +18,11 @@ typedef CVec3 CVecT;
 
 #define MAX_MESH_UV_SETS			8
 
+// Meshes with this or larger number of vertices (sum for all LODs) are kept in memory
+// in compact form, see CBaseMeshLod::CompactVertsCommon(). 0 disables compaction. Set
+// with "-compactmesh=N" command line option.
+extern int GCompactMeshVerts;
+
 
 struct CIndexBuffer
 {
@@ -162,6 +167,8 @@ struct CMeshSection
 };
 
 
+struct CCompactVertexData;
+
 struct CBaseMeshLod
 {
 	// generic properties
@@ -174,6 +181,9 @@ struct CBaseMeshLod
 	CMeshUVFloat*			ExtraUV[MAX_MESH_UV_SETS-1];
 	FColor*					VertexColors;
 	CIndexBuffer			Indices;
+	// compact vertex storage, NULL when vertices are stored in Verts
+	CCompactVertexData*		CompactData;
+	int						VertsLockCount;
 
 	CBaseMeshLod()
 	{
@@ -183,9 +193,11 @@ struct CBaseMeshLod
 	~CBaseMeshLod()
 	{
 		for (int i = 0; i < NumTexCoords-1; i++)
-			appFree(ExtraUV[i]);
+			if (ExtraUV[i]) appFree(ExtraUV[i]);
 		if (VertexColors)
 			appFree(VertexColors);
+		if (CompactData)
+			FreeCompactData();
 	}
 
 	void AllocateUVBuffers()
@@ -203,6 +215,17 @@ struct CBaseMeshLod
 	void LockMaterials();
 	void UnlockMaterials();
 #endif
+
+protected:
+	// Compact vertex storage. Positions and UVs are quantized to 16 bits relative to their
+	// bounds, normals and ExtraSize bytes following CMeshVertex in the derived vertex structure
+	// are copied as is. ExtraUV buffers are released by CompactVertsCommon() and allocated
+	// again by ExpandVertsCommon(). ReleaseVertsCommon() saves normals and tangents (they
+	// could be rebuilt while vertices are expanded) and releases ExtraUV.
+	void CompactVertsCommon(const CMeshVertex *Verts, int VertexSize, int ExtraSize);
+	void ExpandVertsCommon(CMeshVertex *Verts, int VertexSize);
+	void ReleaseVertsCommon(const CMeshVertex *Verts, int VertexSize);
+	void FreeCompactData();
 };
 
 void BuildNormalsCommon(CMeshVertex *Verts, int VertexSize, int NumVerts, const CIndexBuffer &Indices);
@@ -0,0 +1,530 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "UnObject.h"
+#include "UnPackage.h"
+
+#include "PackageUtils.h"
+#include "PackageCatalog.h"
+#include "Profiler.h"
+
+// Size of hash table used for string pool deduplication
+#define CATALOG_STRING_HASH		(1 << 18)
+
+// Case-insensitive hash, export lookup uses stricmp() as UnPackage::FindExport() does
+static uint32 GetCatalogNameHash(const char* Name)
+{
+	uint32 Hash = 2166136261u;
+	while (char c = *Name++)
+	{
+		Hash ^= (byte)tolower((byte)c);
+		Hash *= 16777619u;
+	}
+	return Hash;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Catalog builder
+-----------------------------------------------------------------------------*/
+
+class CCatalogStringPool
+{
+public:
+	TArray<char>	Data;
+
+	CCatalogStringPool()
+	{
+		Buckets.Init(INDEX_NONE, CATALOG_STRING_HASH);
+	}
+
+	uint32 Add(const char* Str)
+	{
+		int Len = strlen(Str);
+		int Hash = (int)(appMemHash64(Str, Len) & (CATALOG_STRING_HASH - 1));
+		for (int i = Buckets[Hash]; i != INDEX_NONE; i = Next[i])
+		{
+			uint32 Offset = Offsets[i];
+			if (!strcmp(&Data[Offset], Str)) return Offset;
+		}
+		uint32 Offset = Data.Num();
+		Data.AddUninitialized(Len + 1);
+		memcpy(&Data[Offset], Str, Len + 1);
+		Next.Add(Buckets[Hash]);
+		Buckets[Hash] = Offsets.Add(Offset);
+		return Offset;
+	}
+
+protected:
+	TArray<int32>	Buckets;
+	TArray<int32>	Next;
+	TArray<uint32>	Offsets;
+};
+
+struct CCatalogPackageInfo
+{
+	TArray<uint32>	ExportHashes;
+	TArray<const char*> ImportPackages;		// outermost package name for every import
+	TArray<const char*> Depends;			// unique names of imported packages
+	TArray<int32>	DependIndices;			// index of every imported package in catalog
+};
+
+// Find a file in sorted list, returns INDEX_NONE if not found
+static int FindCatalogFile(const TArray<const CGameFileInfo*>& Files, const CGameFileInfo* File)
+{
+	int Lo = 0, Hi = Files.Num() - 1;
+	while (Lo <= Hi)
+	{
+		int Mid = (Lo + Hi) / 2;
+		int Cmp = CGameFileInfo::CompareNames(*File, *Files[Mid]);
+		if (Cmp == 0) return Mid;
+		if (Cmp < 0)
+			Hi = Mid - 1;
+		else
+			Lo = Mid + 1;
+	}
+	return INDEX_NONE;
+}
+
+// Files is the list of all packages which are put to catalog, sorted by name
+static void ExtractPackageInfo(const UnPackage* Package, const TArray<const CGameFileInfo*>& Files, CCatalogPackageInfo& Info)
+{
+	guard(ExtractPackageInfo);
+
+	int NumExports = Package->Summary.ExportCount;
+	Info.ExportHashes.Empty(NumExports);
+	for (int i = 0; i < NumExports; i++)
+		Info.ExportHashes.Add(GetCatalogNameHash(Package->ExportTable[i].ObjectName));
+
+	int NumImports = Package->Summary.ImportCount;
+	Info.ImportPackages.Empty(NumImports);
+	for (int i = 0; i < NumImports; i++)
+	{
+		// walk up to the outermost package, limit depth to not hang on corrupted data
+		const FObjectImport* Imp = &Package->GetImport(i);
+		for (int Depth = 0; Imp->PackageIndex < 0 && Depth < 256; Depth++)
+			Imp = &Package->GetImport(-Imp->PackageIndex - 1);
+
+		if (Imp->PackageIndex != 0)
+		{
+			// UE3 forced export or broken chain, the object belongs to this package
+			Info.ImportPackages.Add(Package->Name);
+			continue;
+		}
+
+		const char* PackageName = Imp->ObjectName;
+		Info.ImportPackages.Add(PackageName);
+
+		bool bFound = false;
+		for (int j = 0; j < Info.Depends.Num(); j++)
+		{
+			if (!stricmp(Info.Depends[j], PackageName))
+			{
+				bFound = true;
+				break;
+			}
+		}
+		if (bFound) continue;
+
+		Info.Depends.Add(PackageName);
+		const CGameFileInfo* DepFile = appFindGameFile(PackageName);
+		Info.DependIndices.Add((DepFile && DepFile->IsPackage) ? FindCatalogFile(Files, DepFile) : INDEX_NONE);
+	}
+
+	unguardf("%s", Package->Filename);
+}
+
+static bool AppendCatalogSection(TArray<byte>& Dst, const void* Src, int Size, uint32& OutOffset, int BaseOffset)
+{
+	OutOffset = BaseOffset + Dst.Num();
+	int Pos = Dst.AddUninitialized(Size);
+	if (Size) memcpy(&Dst[Pos], Src, Size);
+	return (int64)BaseOffset + Dst.Num() < 0x7FFFFFFF;
+}
+
+bool BuildPackageCatalog(const char* Filename, const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress)
+{
+	guard(BuildPackageCatalog);
+
+	PROFILE_SCOPE("BuildPackageCatalog");
+
+	// Sort packages by name for binary search, and remove duplicates
+	TArray<const CGameFileInfo*> Files;
+	Files.Reserve(Packages.Num());
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		if (Packages[i]->IsPackage)
+			Files.Add(Packages[i]);
+	}
+	Files.Sort([](const CGameFileInfo* const& A, const CGameFileInfo* const& B) -> int
+		{
+			return CGameFileInfo::CompareNames(*A, *B);
+		});
+	for (int i = Files.Num() - 1; i > 0; i--)
+	{
+		if (Files[i] == Files[i-1])
+			Files.RemoveAt(i);
+	}
+
+	TArray<FCatalogPackage> CatPackages;
+	TArray<FCatalogExport> CatExports;
+	TArray<FCatalogImport> CatImports;
+	TArray<FCatalogDepend> CatDepends;
+	TArray<uint32> ExportHashes;
+	CCatalogStringPool Strings;
+	CatPackages.Empty(Files.Num());
+
+	// Packages are opened one by one: package loader shares name pool, package map and
+	// archive readers, so it could not be used from several threads
+	int NumFailed = 0;
+	for (int FileIndex = 0; FileIndex < Files.Num(); FileIndex++)
+	{
+		const CGameFileInfo* File = Files[FileIndex];
+		FStaticString<MAX_PACKAGE_PATH> RelativeName;
+		File->GetRelativeName(RelativeName);
+		if (Progress && !Progress->Progress(*RelativeName, FileIndex, Files.Num()))
+			return false;
+
+		bool bUnload = (File->Package == NULL);	// package is opened only for building the catalog
+		UnPackage* Package = UnPackage::LoadPackage(*RelativeName, /*silent=*/ true);
+		int PackageIndex = CatPackages.Num();
+
+		FCatalogPackage* P = new (CatPackages) FCatalogPackage;
+		memset(P, 0, sizeof(FCatalogPackage));
+		P->Name        = Strings.Add(*RelativeName);
+		P->FirstExport = CatExports.Num();
+		P->FirstImport = CatImports.Num();
+		P->FirstDepend = CatDepends.Num();
+		P->FileSize      = File->Size;
+		P->ExtraSizeInKb = File->ExtraSizeInKb;
+		if (!File->GetModificationTime(P->FileTime))
+			P->FileTime = 0;
+		if (!Package)
+		{
+			// keep an empty entry, so package indices are the same as in Files array
+			NumFailed++;
+			continue;
+		}
+
+		// Resolve imports and dependencies
+		CCatalogPackageInfo Info;
+		ExtractPackageInfo(Package, Files, Info);
+
+		P->FileVersion     = Package->Summary.FileVersion;
+		P->LicenseeVersion = Package->Summary.LicenseeVersion;
+		P->NumExports      = Package->Summary.ExportCount;
+		P->NumImports      = Package->Summary.ImportCount;
+		P->NumDepends      = Info.Depends.Num();
+
+		for (int j = 0; j < Package->Summary.ExportCount; j++)
+		{
+			const FObjectExport& Exp = Package->ExportTable[j];
+			FCatalogExport* E = new (CatExports) FCatalogExport;
+			E->Name         = Strings.Add(Exp.ObjectName);
+			E->ClassName    = Strings.Add(Package->GetObjectName(Exp.ClassIndex));
+			E->Package      = PackageIndex;
+			E->SerialOffset = Exp.SerialOffset;
+			E->SerialSize   = Exp.SerialSize;
+			E->HashNext     = INDEX_NONE;
+		}
+		int HashPos = ExportHashes.AddUninitialized(Info.ExportHashes.Num());
+		memcpy(&ExportHashes[HashPos], Info.ExportHashes.GetData(), Info.ExportHashes.Num() * sizeof(uint32));
+
+		for (int j = 0; j < Package->Summary.ImportCount; j++)
+		{
+			const FObjectImport& Imp = Package->ImportTable[j];
+			FCatalogImport* I = new (CatImports) FCatalogImport;
+			I->Name        = Strings.Add(Imp.ObjectName);
+			I->ClassName   = Strings.Add(Imp.ClassName);
+			I->PackageName = Strings.Add(Info.ImportPackages[j]);
+		}
+
+		for (int j = 0; j < Info.Depends.Num(); j++)
+		{
+			FCatalogDepend* D = new (CatDepends) FCatalogDepend;
+			D->Name    = Strings.Add(Info.Depends[j]);
+			D->Package = Info.DependIndices[j];
+		}
+
+		// Close package if it wasn't loaded before
+		if (bUnload)
+			UnPackage::UnloadPackage(Package);
+	}
+
+	// Build export name hash. Fill chains in reverse order, so exports in every chain
+	// are sorted by index.
+	int NumHashBuckets = 256;
+	while (NumHashBuckets < CatExports.Num())
+		NumHashBuckets <<= 1;
+	TArray<int32> HashTable;
+	HashTable.Init(INDEX_NONE, NumHashBuckets);
+	for (int i = CatExports.Num() - 1; i >= 0; i--)
+	{
+		int Bucket = ExportHashes[i] & (NumHashBuckets - 1);
+		CatExports[i].HashNext = HashTable[Bucket];
+		HashTable[Bucket] = i;
+	}
+
+	// Combine file contents
+	FCatalogHeader Hdr;
+	memset(&Hdr, 0, sizeof(Hdr));
+	Hdr.Tag            = CATALOG_TAG;
+	Hdr.Version        = CATALOG_VERSION;
+	Hdr.RootDirectory  = Strings.Add(appGetRootDirectory());
+	Hdr.NumPackages    = CatPackages.Num();
+	Hdr.NumExports     = CatExports.Num();
+	Hdr.NumImports     = CatImports.Num();
+	Hdr.NumDepends     = CatDepends.Num();
+	Hdr.NumHashBuckets = NumHashBuckets;
+	Hdr.StringsSize    = Strings.Data.Num();
+
+	TArray<byte> Tables;
+	bool bFits = true;
+	bFits &= AppendCatalogSection(Tables, CatPackages.GetData(), CatPackages.Num() * sizeof(FCatalogPackage), Hdr.PackagesOffset, sizeof(Hdr));
+	bFits &= AppendCatalogSection(Tables, CatExports.GetData(), CatExports.Num() * sizeof(FCatalogExport), Hdr.ExportsOffset, sizeof(Hdr));
+	bFits &= AppendCatalogSection(Tables, CatImports.GetData(), CatImports.Num() * sizeof(FCatalogImport), Hdr.ImportsOffset, sizeof(Hdr));
+	bFits &= AppendCatalogSection(Tables, CatDepends.GetData(), CatDepends.Num() * sizeof(FCatalogDepend), Hdr.DependsOffset, sizeof(Hdr));
+	bFits &= AppendCatalogSection(Tables, HashTable.GetData(), HashTable.Num() * sizeof(int32), Hdr.HashOffset, sizeof(Hdr));
+	Hdr.StringsOffset = sizeof(Hdr) + Tables.Num();
+	if (!bFits || (int64)Hdr.StringsOffset + Hdr.StringsSize >= 0x7FFFFFFF)
+		appError("Package catalog is too large");
+
+	FFileWriter Ar(Filename, FAO_NoOpenError);
+	if (!Ar.IsOpen())
+	{
+		appPrintf("ERROR: unable to create %s\n", Filename);
+		return false;
+	}
+	Ar.Serialize(&Hdr, sizeof(Hdr));
+	Ar.Serialize(Tables.GetData(), Tables.Num());
+	Ar.Serialize(Strings.Data.GetData(), Strings.Data.Num());
+
+	appPrintf("Catalog %s: %d packages, %d exports, %d imports, %d KB\n",
+		Filename, Hdr.NumPackages, Hdr.NumExports, Hdr.NumImports, (Hdr.StringsOffset + Hdr.StringsSize) >> 10);
+	if (NumFailed)
+		appPrintf("WARNING: %d package(s) failed to load\n", NumFailed);
+
+	return true;
+
+	unguardf("%s", Filename);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Catalog reader
+-----------------------------------------------------------------------------*/
+
+static bool CheckCatalogSection(uint32 Offset, int Count, int ItemSize, size_t FileSize)
+{
+	return Count >= 0 && Offset >= sizeof(FCatalogHeader) && (uint64)Offset + (uint64)Count * ItemSize <= FileSize;
+}
+
+bool CPackageCatalog::Open(const char* Filename)
+{
+	guard(CPackageCatalog::Open);
+
+	Close();
+
+	size_t Size;
+	const void* Mem = appMapFile(Filename, Size);
+	if (!Mem) return false;
+
+	const FCatalogHeader* H = (const FCatalogHeader*)Mem;
+	if (Size < sizeof(FCatalogHeader) || H->Tag != CATALOG_TAG || H->Version != CATALOG_VERSION ||
+		!CheckCatalogSection(H->PackagesOffset, H->NumPackages, sizeof(FCatalogPackage), Size) ||
+		!CheckCatalogSection(H->ExportsOffset, H->NumExports, sizeof(FCatalogExport), Size) ||
+		!CheckCatalogSection(H->ImportsOffset, H->NumImports, sizeof(FCatalogImport), Size) ||
+		!CheckCatalogSection(H->DependsOffset, H->NumDepends, sizeof(FCatalogDepend), Size) ||
+		!CheckCatalogSection(H->HashOffset, H->NumHashBuckets, sizeof(int32), Size) ||
+		!CheckCatalogSection(H->StringsOffset, H->StringsSize, 1, Size) ||
+		H->NumHashBuckets <= 0 || (H->NumHashBuckets & (H->NumHashBuckets - 1)))
+	{
+		appUnmapFile(Mem, Size);
+		return false;
+	}
+
+	Data     = (const byte*)Mem;
+	DataSize = Size;
+	Hdr      = H;
+	if (!ValidateTables())
+	{
+		Close();
+		return false;
+	}
+	return true;
+
+	unguardf("%s", Filename);
+}
+
+// Check all indices and string references, so queries could access tables without checks
+bool CPackageCatalog::ValidateTables() const
+{
+	guard(CPackageCatalog::ValidateTables);
+
+	// every string should be terminated inside the string pool
+	if (!Hdr->StringsSize || Data[Hdr->StringsOffset + Hdr->StringsSize - 1] != 0)
+		return false;
+#define CHECK_STRING(Offset)	if ((Offset) >= Hdr->StringsSize) return false;
+#define CHECK_RANGE(First, Count, Total) \
+		if ((First) < 0 || (Count) < 0 || (int64)(First) + (Count) > (Total)) return false;
+
+	CHECK_STRING(Hdr->RootDirectory);
+
+	for (int i = 0; i < Hdr->NumPackages; i++)
+	{
+		const FCatalogPackage& P = GetPackage(i);
+		CHECK_STRING(P.Name);
+		CHECK_RANGE(P.FirstExport, P.NumExports, Hdr->NumExports);
+		CHECK_RANGE(P.FirstImport, P.NumImports, Hdr->NumImports);
+		CHECK_RANGE(P.FirstDepend, P.NumDepends, Hdr->NumDepends);
+	}
+
+	for (int i = 0; i < Hdr->NumExports; i++)
+	{
+		const FCatalogExport& E = GetExport(i);
+		CHECK_STRING(E.Name);
+		CHECK_STRING(E.ClassName);
+		CHECK_RANGE(E.Package, 1, Hdr->NumPackages);
+		// hash chains are sorted by export index, so they can't have loops
+		if (E.HashNext != INDEX_NONE && (E.HashNext <= i || E.HashNext >= Hdr->NumExports))
+			return false;
+	}
+
+	for (int i = 0; i < Hdr->NumImports; i++)
+	{
+		const FCatalogImport& I = GetImport(i);
+		CHECK_STRING(I.Name);
+		CHECK_STRING(I.ClassName);
+		CHECK_STRING(I.PackageName);
+	}
+
+	for (int i = 0; i < Hdr->NumDepends; i++)
+	{
+		const FCatalogDepend& D = GetDepend(i);
+		CHECK_STRING(D.Name);
+		if (D.Package != INDEX_NONE)
+			CHECK_RANGE(D.Package, 1, Hdr->NumPackages);
+	}
+
+	const int32* HashTable = (const int32*)(Data + Hdr->HashOffset);
+	for (int i = 0; i < Hdr->NumHashBuckets; i++)
+	{
+		if (HashTable[i] != INDEX_NONE)
+			CHECK_RANGE(HashTable[i], 1, Hdr->NumExports);
+	}
+
+#undef CHECK_STRING
+#undef CHECK_RANGE
+	return true;
+
+	unguard;
+}
+
+void CPackageCatalog::Close()
+{
+	if (!Data) return;
+	appUnmapFile(Data, DataSize);
+	Data     = NULL;
+	DataSize = 0;
+	Hdr      = NULL;
+}
+
+int CPackageCatalog::FindPackage(const char* RelativeName) const
+{
+	guard(CPackageCatalog::FindPackage);
+
+	int Lo = 0, Hi = Hdr->NumPackages - 1;
+	while (Lo <= Hi)
+	{
+		int Mid = (Lo + Hi) / 2;
+		int Cmp = stricmp(RelativeName, GetString(GetPackage(Mid).Name));
+		if (Cmp == 0) return Mid;
+		if (Cmp < 0)
+			Hi = Mid - 1;
+		else
+			Lo = Mid + 1;
+	}
+	return INDEX_NONE;
+
+	unguardf("%s", RelativeName);
+}
+
+int CPackageCatalog::FindPackage(const CGameFileInfo* File) const
+{
+	guard(CPackageCatalog::FindPackage);
+
+	FStaticString<MAX_PACKAGE_PATH> RelativeName;
+	File->GetRelativeName(RelativeName);
+	int PackageIndex = FindPackage(*RelativeName);
+	if (PackageIndex >= 0 && !IsPackageUpToDate(PackageIndex, File))
+		return INDEX_NONE;
+	return PackageIndex;
+
+	unguard;
+}
+
+bool CPackageCatalog::IsPackageUpToDate(int PackageIndex, const CGameFileInfo* File) const
+{
+	const FCatalogPackage& P = GetPackage(PackageIndex);
+	if (P.FileSize != File->Size || P.ExtraSizeInKb != File->ExtraSizeInKb)
+		return false;
+	// time could be unavailable for some file systems; size check only is used then
+	int64 FileTime;
+	if (P.FileTime && File->GetModificationTime(FileTime) && FileTime != P.FileTime)
+		return false;
+	return true;
+}
+
+void CPackageCatalog::FindExports(const char* ObjectName, const char* ClassName, TArray<int>& OutExports) const
+{
+	guard(CPackageCatalog::FindExports);
+
+	if (!appContainsWildcard(ObjectName))
+	{
+		const int32* HashTable = (const int32*)(Data + Hdr->HashOffset);
+		int Bucket = GetCatalogNameHash(ObjectName) & (Hdr->NumHashBuckets - 1);
+		for (int i = HashTable[Bucket]; i != INDEX_NONE; i = GetExport(i).HashNext)
+		{
+			const FCatalogExport& Exp = GetExport(i);
+			if (stricmp(GetString(Exp.Name), ObjectName) != 0)
+				continue;
+			if (ClassName && stricmp(GetString(Exp.ClassName), ClassName) != 0)
+				continue;
+			OutExports.Add(i);
+		}
+		return;
+	}
+
+	// wildcard: check all exports
+	for (int i = 0; i < Hdr->NumExports; i++)
+	{
+		const FCatalogExport& Exp = GetExport(i);
+		if (!appMatchWildcard(GetString(Exp.Name), ObjectName, /*ignoreCase=*/ true))
+			continue;
+		if (ClassName && stricmp(GetString(Exp.ClassName), ClassName) != 0)
+			continue;
+		OutExports.Add(i);
+	}
+
+	unguardf("%s", ObjectName);
+}
+
+void CPackageCatalog::FindDependentPackages(int PackageIndex, TArray<int>& OutPackages) const
+{
+	guard(CPackageCatalog::FindDependentPackages);
+
+	for (int i = 0; i < Hdr->NumPackages; i++)
+	{
+		const FCatalogPackage& P = GetPackage(i);
+		for (int j = 0; j < P.NumDepends; j++)
+		{
+			if (GetDepend(P.FirstDepend + j).Package == PackageIndex)
+			{
+				OutPackages.Add(i);
+				break;
+			}
+		}
+	}
+
+	unguard;
+}
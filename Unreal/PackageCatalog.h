@@ -0,0 +1,167 @@
+#ifndef __PACKAGE_CATALOG_H__
+#define __PACKAGE_CATALOG_H__
+
+/*-----------------------------------------------------------------------------
+	Package catalog
+-----------------------------------------------------------------------------*/
+
+// Catalog is a binary file holding export, import and dependency tables of many
+// packages. It is created once with BuildPackageCatalog() and memory-mapped by
+// CPackageCatalog on later runs, so object and dependency queries are resolved
+// without opening packages. All offsets are relative to the beginning of the file,
+// string references are offsets in the string pool, every string is stored once.
+
+#define CATALOG_TAG				0x54414355		// 'UCAT'
+#define CATALOG_VERSION			2
+
+struct FCatalogHeader
+{
+	uint32		Tag;
+	int32		Version;
+	uint32		RootDirectory;			// string; game directory used when catalog was built
+	int32		NumPackages;
+	int32		NumExports;
+	int32		NumImports;
+	int32		NumDepends;
+	int32		NumHashBuckets;			// power of 2
+	uint32		PackagesOffset;
+	uint32		ExportsOffset;
+	uint32		ImportsOffset;
+	uint32		DependsOffset;
+	uint32		HashOffset;
+	uint32		StringsOffset;
+	uint32		StringsSize;
+	uint32		Reserved;				// keeps package table 8-byte aligned
+};
+
+// Packages are sorted by name, so they could be found with binary search. File size and
+// time are used to detect packages which were changed after the catalog was built.
+struct FCatalogPackage
+{
+	uint32		Name;					// string; file name relative to the root directory
+	int32		ExtraSizeInKb;			// size of additional non-package files (ubulk, uexp etc)
+	int64		FileSize;
+	int64		FileTime;				// 0 if unknown
+	uint16		FileVersion;
+	uint16		LicenseeVersion;
+	int32		FirstExport;
+	int32		NumExports;
+	int32		FirstImport;
+	int32		NumImports;
+	int32		FirstDepend;
+	int32		NumDepends;
+};
+
+struct FCatalogExport
+{
+	uint32		Name;					// string
+	uint32		ClassName;				// string
+	int32		Package;				// index in package table
+	int32		SerialOffset;
+	int32		SerialSize;
+	int32		HashNext;				// next export in the same hash bucket, or INDEX_NONE
+};
+
+struct FCatalogImport
+{
+	uint32		Name;					// string
+	uint32		ClassName;				// string
+	uint32		PackageName;			// string; outermost package of the imported object
+};
+
+struct FCatalogDepend
+{
+	uint32		Name;					// string; short package name
+	int32		Package;				// index in package table, INDEX_NONE if it is not in catalog
+};
+
+
+class IProgressCallback;
+
+// Scan provided packages and write catalog file. Returns false if file could not be
+// created or operation was cancelled.
+bool BuildPackageCatalog(const char* Filename, const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress = NULL);
+
+
+class CPackageCatalog
+{
+public:
+	CPackageCatalog()
+	:	Data(NULL)
+	,	DataSize(0)
+	,	Hdr(NULL)
+	{}
+
+	~CPackageCatalog()
+	{
+		Close();
+	}
+
+	// Map catalog file into memory. Returns false if file doesn't exist or has wrong format.
+	bool Open(const char* Filename);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return Data != NULL;
+	}
+
+	const char* GetString(uint32 Offset) const
+	{
+		return (const char*)(Data + Hdr->StringsOffset + Offset);
+	}
+
+	const char* GetRootDirectory() const
+	{
+		return GetString(Hdr->RootDirectory);
+	}
+
+	int NumPackages() const
+	{
+		return Hdr->NumPackages;
+	}
+
+	const FCatalogPackage& GetPackage(int Index) const
+	{
+		return ((const FCatalogPackage*)(Data + Hdr->PackagesOffset))[Index];
+	}
+
+	const FCatalogExport& GetExport(int Index) const
+	{
+		return ((const FCatalogExport*)(Data + Hdr->ExportsOffset))[Index];
+	}
+
+	const FCatalogImport& GetImport(int Index) const
+	{
+		return ((const FCatalogImport*)(Data + Hdr->ImportsOffset))[Index];
+	}
+
+	const FCatalogDepend& GetDepend(int Index) const
+	{
+		return ((const FCatalogDepend*)(Data + Hdr->DependsOffset))[Index];
+	}
+
+	// Find package using its file name relative to the root directory. Returns INDEX_NONE
+	// if package is not in catalog.
+	int FindPackage(const char* RelativeName) const;
+	// Find package for the game file. Returns INDEX_NONE if package is not in catalog, or if
+	// file was changed after the catalog was built.
+	int FindPackage(const CGameFileInfo* File) const;
+	// Check if catalog entry matches the current file size and time.
+	bool IsPackageUpToDate(int PackageIndex, const CGameFileInfo* File) const;
+	// Find exports by object name, which may contain wildcards, and optional class name.
+	// Indices in export table are appended to OutExports in ascending order.
+	void FindExports(const char* ObjectName, const char* ClassName, TArray<int>& OutExports) const;
+	// Find packages which import objects from the specified package.
+	void FindDependentPackages(int PackageIndex, TArray<int>& OutPackages) const;
+
+protected:
+	bool ValidateTables() const;
+
+	const byte*	Data;
+	size_t		DataSize;
+	const FCatalogHeader* Hdr;
+};
+
+
+#endif // __PACKAGE_CATALOG_H__
@@ -5,6 +5,7 @@
 #include "UnPackage.h"
 
 #include "PackageUtils.h"
+#include "Profiler.h"
 
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
@@ -18,9 +19,7 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 
 	if (GFullyLoadedPackages.FindItem(Package) >= 0) return true;	// already loaded
 
-#if 0 // PROFILE -- disabled, appears useless - always says "0.00 MBytes serialized in 0 calls"
-	appResetProfiler();
-#endif
+	PROFILE_SCOPE("LoadWholePackage");
 
 	UObject::BeginLoad();
 	for (int idx = 0; idx < Package->Summary.ExportCount; idx++)
@@ -33,10 +32,6 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress)
 	UObject::EndLoad();
 	GFullyLoadedPackages.Add(Package);
 
-#if 0 // PROFILE
-	appPrintProfiler("Full package loaded");
-#endif
-
 	return true;
 
 	unguardf("%s", Package->Name);
@@ -75,6 +70,88 @@ void ReleaseAllObjects()
 }
 
 
+/*-----------------------------------------------------------------------------
+	Load planner
+-----------------------------------------------------------------------------*/
+
+static void AddClosureExport(UnPackage* Package, int Index, TArray<CExportRef>& Refs)
+{
+	for (int i = 0; i < Refs.Num(); i++)
+	{
+		if (Refs[i].Package == Package && Refs[i].Index == Index) return;
+	}
+	// objects of unsupported classes are never loaded, so don't follow their references
+	if (!IsKnownClass(Package->GetObjectName(Package->GetExport(Index).ClassIndex))) return;
+	CExportRef* Ref = new (Refs) CExportRef;
+	Ref->Package = Package;
+	Ref->Index   = Index;
+}
+
+// Add an object referenced with package index (positive for export, negative for import). Package
+// of the imported object is opened the same way as UnPackage::CreateImport() does.
+static void AddClosureRef(UnPackage* Package, int PackageIndex, TArray<CExportRef>& Refs)
+{
+	if (PackageIndex > 0)
+	{
+		AddClosureExport(Package, PackageIndex - 1, Refs);
+		return;
+	}
+	if (PackageIndex == 0) return;
+
+	int ImportIndex = -PackageIndex - 1;
+	const FObjectImport& Imp = Package->GetImport(ImportIndex);
+	if (Imp.Missing || !IsKnownClass(Imp.ClassName)) return;
+	const char* PackageName = Package->GetObjectPackageName(Imp.PackageIndex);
+	if (!PackageName) return;
+	// UE3 cooked packages could have imports with no package file, these are resolved when loading
+	UnPackage* Other = UnPackage::LoadPackage(PackageName, /*silent=*/ true);
+	if (!Other) return;
+	int Index = Other->FindExportForImport(Imp.ObjectName, Imp.ClassName, Package, ImportIndex);
+	if (Index != INDEX_NONE)
+		AddClosureExport(Other, Index, Refs);
+}
+
+int OpenImportClosure(const TArray<CExportRef>& Exports)
+{
+	guard(OpenImportClosure);
+
+	PROFILE_SCOPE("OpenImportClosure");
+
+	int NumPackages = UnPackage::GetPackageMap().Num();
+
+	// Closure grows while it is iterated
+	TArray<CExportRef> Refs;
+	CopyArray(Refs, Exports);
+	for (int i = 0; i < Refs.Num(); i++)
+	{
+		UnPackage* Package = Refs[i].Package;
+		int Index = Refs[i].Index;
+		const FObjectExport& Exp = Package->GetExport(Index);
+		AddClosureRef(Package, Exp.ClassIndex, Refs);
+		AddClosureRef(Package, Exp.PackageIndex, Refs);
+#if !USE_COMPACT_PACKAGE_STRUCTS
+		AddClosureRef(Package, Exp.SuperIndex, Refs);
+	#if UNREAL3
+		AddClosureRef(Package, Exp.Archetype, Refs);
+		if (Package->DependsTable)
+		{
+			const TArray<int>& Depends = Package->DependsTable[Index].Objects;
+			for (int j = 0; j < Depends.Num(); j++)
+				AddClosureRef(Package, Depends[j], Refs);
+		}
+	#endif // UNREAL3
+#endif // USE_COMPACT_PACKAGE_STRUCTS
+	}
+
+	int NumOpened = UnPackage::GetPackageMap().Num() - NumPackages;
+	if (NumOpened > 0)
+		appPrintf("Opened %d imported package(s)\n", NumOpened);
+	return NumOpened;
+
+	unguard;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Package version scanner
 -----------------------------------------------------------------------------*/
@@ -25,6 +25,21 @@ bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress = NULL);
 void ReleaseAllObjects();
 
 
+// Load planner
+
+struct CExportRef
+{
+	UnPackage*	Package;
+	int			Index;		// export index
+};
+
+// Open packages which will be required for loading the specified exports, so they're opened
+// once before loading. Starts with references of these exports and follows only imports
+// referenced by visited objects: class, outer, super and archetype, and UE3 dependency table
+// when available. Returns number of opened packages.
+int OpenImportClosure(const TArray<CExportRef>& Exports);
+
+
 // Package scanner
 
 struct FileInfo
@@ -2,6 +2,9 @@
 #include "UnCore.h"
 #include "UnObject.h"		// for typeinfo
 #include "SkeletalMesh.h"
+#include "Parallel.h"
+
+#include <emmintrin.h>		// SSE2 intrinsics
 
 
 /*-----------------------------------------------------------------------------
@@ -272,6 +275,186 @@ void CSkeletalMesh::FinalizeMesh()
 	}
 
 	if (NumFixedVerts) appPrintf("INFO: fixed %d vertices\n", NumFixedVerts);
+
+	if (GCompactMeshVerts > 0)
+	{
+		int TotalVerts = 0;
+		for (int lod = 0; lod < Lods.Num(); lod++)
+			TotalVerts += Lods[lod].NumVerts;
+		if (TotalVerts >= GCompactMeshVerts)
+		{
+			for (int lod = 0; lod < Lods.Num(); lod++)
+				Lods[lod].CompactVerts();
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	CMorphEvaluator
+-----------------------------------------------------------------------------*/
+
+CMorphEvaluator::CMorphEvaluator()
+:	Mesh(NULL)
+,	LodIndex(-1)
+,	NumVerts(0)
+,	NumActiveMorphs(0)
+,	Verts(NULL)
+,	NormalDeltas(NULL)
+{}
+
+CMorphEvaluator::~CMorphEvaluator()
+{
+	if (Verts) appFree(Verts);
+	if (NormalDeltas) appFree(NormalDeltas);
+}
+
+void CMorphEvaluator::SetMesh(const CSkeletalMesh* InMesh, int InLodIndex)
+{
+	guard(CMorphEvaluator::SetMesh);
+
+	const CSkelMeshLod& Lod = InMesh->Lods[InLodIndex];
+	assert(Lod.Verts);
+
+	if (InMesh != Mesh)
+	{
+		// weights are kept when only LOD is changed
+		Weights.Empty(InMesh->Morphs.Num());
+		Weights.AddZeroed(InMesh->Morphs.Num());
+	}
+	Mesh     = InMesh;
+	LodIndex = InLodIndex;
+
+	if (Lod.NumVerts != NumVerts)
+	{
+		if (Verts) appFree(Verts);
+		if (NormalDeltas) appFree(NormalDeltas);
+		NumVerts     = Lod.NumVerts;
+		Verts        = (CSkelMeshVertex*)appMalloc(sizeof(CSkelMeshVertex) * NumVerts, 16);
+		NormalDeltas = (CVec4*)appMalloc(sizeof(CVec4) * NumVerts, 16);
+		VertSlot.Init(-1, NumVerts);
+		DirtyVerts.Empty(NumVerts);
+		Touched.Empty(NumVerts);
+	}
+
+	// start with unmodified vertices, everything will be applied on the next Evaluate()
+	memcpy(Verts, Lod.Verts, sizeof(CSkelMeshVertex) * NumVerts);
+	AppliedWeights.Empty(Weights.Num());
+	AppliedWeights.AddZeroed(Weights.Num());
+	NumActiveMorphs = 0;
+
+	unguard;
+}
+
+void CMorphEvaluator::ResetWeights()
+{
+	for (int i = 0; i < Weights.Num(); i++)
+		Weights[i] = 0;
+}
+
+bool CMorphEvaluator::Evaluate()
+{
+	guard(CMorphEvaluator::Evaluate);
+
+	assert(Mesh);
+	const CSkelMeshVertex* BaseVerts = Mesh->Lods[LodIndex].Verts;
+	int NumMorphs = Weights.Num();
+	int MorphIndex;
+
+	// Collect vertices affected by morphs with changed weights. Everything else
+	// in Verts[] is already up to date.
+	NumActiveMorphs = 0;
+	for (MorphIndex = 0; MorphIndex < NumMorphs; MorphIndex++)
+	{
+		const CMorphTarget* Morph = Mesh->Morphs[MorphIndex];
+		if (LodIndex >= Morph->Lods.Num()) continue;		// no morph information for this LOD
+		if (Weights[MorphIndex] != 0) NumActiveMorphs++;
+		if (Weights[MorphIndex] == AppliedWeights[MorphIndex]) continue;
+		AppliedWeights[MorphIndex] = Weights[MorphIndex];
+
+		for (const CMorphVertex& Delta : Morph->Lods[LodIndex].Vertices)
+		{
+			unsigned VertIndex = Delta.VertexIndex;
+			if (VertIndex >= (unsigned)NumVerts) continue;	// bad data
+			if (VertSlot[VertIndex] < 0)
+				VertSlot[VertIndex] = DirtyVerts.Add(VertIndex);
+		}
+	}
+
+	int NumDirty = DirtyVerts.Num();
+	if (!NumDirty) return NumActiveMorphs > 0;
+
+	// Restore dirty vertices
+	Touched.Reset(NumDirty);
+	Touched.AddZeroed(NumDirty);
+	for (int Slot = 0; Slot < NumDirty; Slot++)
+	{
+		int VertIndex = DirtyVerts[Slot];
+		Verts[VertIndex] = BaseVerts[VertIndex];
+		NormalDeltas[Slot].mm = _mm_setzero_ps();
+	}
+
+	// Merge delta lists of all active morphs. Positions are accumulated directly in
+	// Verts[], normals are accumulated separately because they are stored packed.
+	// CMorphVertex is 28 bytes long: PositionDelta is loaded together with NormalDelta.X,
+	// and NormalDelta with VertexIndex, so the 4th component is masked out.
+	const __m128 Mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	for (MorphIndex = 0; MorphIndex < NumMorphs; MorphIndex++)
+	{
+		float Weight = AppliedWeights[MorphIndex];
+		const CMorphTarget* Morph = Mesh->Morphs[MorphIndex];
+		if (Weight == 0 || LodIndex >= Morph->Lods.Num()) continue;
+
+		__m128 W = _mm_set1_ps(Weight);
+		for (const CMorphVertex& Delta : Morph->Lods[LodIndex].Vertices)
+		{
+			unsigned VertIndex = Delta.VertexIndex;
+			if (VertIndex >= (unsigned)NumVerts) continue;
+			int Slot = VertSlot[VertIndex];
+			if (Slot < 0) continue;							// vertex is up to date
+			Touched[Slot] = 1;
+			__m128 DeltaPos  = _mm_and_ps(_mm_loadu_ps(Delta.PositionDelta.v), Mask);
+			__m128 DeltaNorm = _mm_and_ps(_mm_loadu_ps(Delta.NormalDelta.v), Mask);
+			CVecT& Pos = Verts[VertIndex].Position;
+#if USE_SSE
+			Pos.mm = _mm_add_ps(Pos.mm, _mm_mul_ps(DeltaPos, W));
+#else
+			CVec4 Tmp;
+			Tmp.mm = _mm_mul_ps(DeltaPos, W);
+			VectorAdd(Pos, Tmp.xyz, Pos);
+#endif
+			NormalDeltas[Slot].mm = _mm_add_ps(NormalDeltas[Slot].mm, _mm_mul_ps(DeltaNorm, W));
+		}
+	}
+
+	// Update normals of affected vertices, and reset slots for the next call
+	for (int Slot = 0; Slot < NumDirty; Slot++)
+	{
+		int VertIndex = DirtyVerts[Slot];
+		VertSlot[VertIndex] = -1;
+		if (!Touched[Slot]) continue;						// no active morphs for this vertex, keep original
+
+		CSkelMeshVertex& V = Verts[VertIndex];
+		// Morph normal, keep binormal sign in W
+		CVec3 Normal;
+		uint32 W = V.Normal.Data & 0xFF000000;
+		Unpack(Normal, V.Normal);
+		VectorAdd(Normal, NormalDeltas[Slot].xyz, Normal);
+		Pack(V.Normal, Normal);
+		V.Normal.Data |= W;
+		// Adjust tangent vector to make basis orthonormal
+		CVec3 Tangent;
+		Unpack(Tangent, V.Tangent);
+		float shift = dot(Normal, Tangent); // it will be zero if vertices are perpendicular
+		VectorMA(Tangent, -shift, Normal);  // shift alongside the normal to make vertices perpendicular again
+		Tangent.NormalizeFast();            // ensure result is normalized
+		Pack(V.Tangent, Tangent);
+	}
+	DirtyVerts.Reset(NumDirty);
+
+	return NumActiveMorphs > 0;
+
+	unguard;
 }
 
 
@@ -474,3 +657,312 @@ void CAnimTrack::CopyFrom(const CAnimTrack &Src)
 	CopyArray(KeyQuatTime, Src.KeyQuatTime);
 	CopyArray(KeyPosTime,  Src.KeyPosTime );
 }
+
+
+/*-----------------------------------------------------------------------------
+	CPoseEvaluator
+-----------------------------------------------------------------------------*/
+
+// Number of frames computed by a single appParallelFor() job
+#define POSE_FRAMES_PER_JOB		8
+
+CPoseEvaluator::CPoseEvaluator()
+:	Mesh(NULL)
+,	Anim(NULL)
+,	NumBones(0)
+,	NumBonesAligned(0)
+,	NumFrames(0)
+,	MaxFrames(0)
+,	Locals(NULL)
+,	Coords(NULL)
+{}
+
+CPoseEvaluator::~CPoseEvaluator()
+{
+	if (Locals) appFree(Locals);
+	if (Coords) appFree(Coords);
+}
+
+void CPoseEvaluator::SetSkeleton(const CSkeletalMesh* InMesh, const CAnimSet* InAnim, EAnimRotationOnly InRotationMode)
+{
+	guard(CPoseEvaluator::SetSkeleton);
+
+	Mesh = InMesh;
+	Anim = InAnim;
+	NumBones = Mesh->RefSkeleton.Num();
+	NumBonesAligned = Align(NumBones, 4);
+
+	// buffers depend on bone count, will be allocated in Evaluate()
+	if (Locals) appFree(Locals);
+	if (Coords) appFree(Coords);
+	Locals = NULL;
+	Coords = NULL;
+	NumFrames = MaxFrames = 0;
+
+	// map mesh bones to animation tracks, the same way as CSkelMeshInstance::SetAnim() does
+	BoneMap.Init(INDEX_NONE, NumBones);
+	AnimateTranslation.Init(true, NumBones);
+	if (Anim)
+	{
+		for (int i = 0; i < NumBones; i++)
+		{
+			const CSkelMeshBone &B = Mesh->RefSkeleton[i];
+			for (int j = 0; j < Anim->TrackBoneNames.Num(); j++)
+			{
+				if (!stricmp(B.Name, Anim->TrackBoneNames[j]))
+				{
+					BoneMap[i] = j;
+					AnimateTranslation[i] = Anim->ShouldAnimateTranslation(j, InRotationMode);
+					break;
+				}
+			}
+		}
+	}
+
+	unguard;
+}
+
+struct CPoseEvaluatorContext
+{
+	CPoseEvaluator*			Evaluator;
+	const CAnimSequence*	Seq;
+	const float*			Times;
+	int						NumFrames;
+	bool					Looped;
+};
+
+static void EvaluatePoses(int JobIndex, CPoseEvaluatorContext& Context)
+{
+	guard(EvaluatePoses);
+
+	int First = JobIndex * POSE_FRAMES_PER_JOB;
+	int Last  = min(First + POSE_FRAMES_PER_JOB, Context.NumFrames);
+	for (int Frame = First; Frame < Last; Frame++)
+		Context.Evaluator->EvaluateFrame(Context.Seq, Context.Times[Frame], Context.Looped, Frame);
+
+	unguard;
+}
+
+#if MAX_DEBUG
+
+// Compare results of SSE code with the scalar math used by the viewer: CQuat::ToAxis()
+// and CCoords::UnTransformCoords()
+static void VerifyPose(const CPoseEvaluator& Evaluator, const CSkeletalMesh* Mesh, int Frame)
+{
+	guard(VerifyPose);
+
+	int NumBones = Evaluator.GetNumBones();
+	TArray<CCoords> RefCoords;
+	RefCoords.AddZeroed(NumBones);
+	const CCoords4* Coords = Evaluator.GetBoneCoords(Frame);
+	for (int i = 0; i < NumBones; i++)
+	{
+		CVec3 BP;
+		CQuat BO;
+		Evaluator.GetLocalTransform(Frame, i, BP, BO);
+		if (!i) BO.Conjugate();
+		CCoords& BC = RefCoords[i];
+		BC.origin = BP;
+		BO.ToAxis(BC.axis);
+		int ParentIndex = Mesh->RefSkeleton[i].ParentIndex;
+		if (i && ParentIndex >= 0 && ParentIndex < i)
+			RefCoords[ParentIndex].UnTransformCoords(BC, BC);
+
+		CCoords Result;
+		Coords[i].Get(Result);
+		const float* A = (const float*)&BC;
+		const float* B = (const float*)&Result;
+		for (int j = 0; j < sizeof(CCoords) / sizeof(float); j++)
+		{
+			if (fabs(A[j] - B[j]) > 0.001f * (1.0f + fabs(A[j])))
+				appError("frame %d, bone %d: value[%d] is %g, expected %g", Frame, i, j, B[j], A[j]);
+		}
+	}
+
+	unguard;
+}
+
+#endif // MAX_DEBUG
+
+void CPoseEvaluator::Evaluate(const CAnimSequence* Seq, const float* InTimes, int InNumFrames, bool Looped)
+{
+	guard(CPoseEvaluator::Evaluate);
+
+	assert(Mesh);
+	if (InNumFrames > MaxFrames)
+	{
+		if (Locals) appFree(Locals);
+		if (Coords) appFree(Coords);
+		MaxFrames = InNumFrames;
+		Locals = (float*)appMalloc(sizeof(float) * 7 * NumBonesAligned * MaxFrames + 16, 16);
+		Coords = (CCoords4*)appMalloc(sizeof(CCoords4) * NumBones * MaxFrames + 16, 16);
+	}
+	NumFrames = InNumFrames;
+
+	CPoseEvaluatorContext Context;
+	Context.Evaluator = this;
+	Context.Seq       = Seq;
+	Context.Times     = InTimes;
+	Context.NumFrames = NumFrames;
+	Context.Looped    = Looped;
+	appParallelFor((NumFrames + POSE_FRAMES_PER_JOB - 1) / POSE_FRAMES_PER_JOB, EvaluatePoses, Context);
+
+#if MAX_DEBUG
+	for (int Frame = 0; Frame < NumFrames; Frame++)
+		VerifyPose(*this, Mesh, Frame);
+#endif
+
+	unguard;
+}
+
+int CPoseEvaluator::EvaluateFixedRate(const CAnimSequence* Seq, float SampleRate, bool Looped)
+{
+	guard(CPoseEvaluator::EvaluateFixedRate);
+
+	int Count = 1;
+	float Step = 0;
+	if (Seq && Seq->NumFrames > 1 && Seq->Rate > 0 && SampleRate > 0)
+	{
+		Step  = Seq->Rate / SampleRate;			// sequence frames per sample
+		Count = appFloor((Seq->NumFrames - 1) / Step + 0.001f) + 1;
+	}
+
+	Times.Empty(Count);
+	for (int i = 0; i < Count; i++)
+		Times.Add(i * Step);
+	Evaluate(Seq, Times.GetData(), Count, Looped);
+	return Count;
+
+	unguard;
+}
+
+void CPoseEvaluator::GetLocalTransform(int Frame, int BoneIndex, CVec3& Pos, CQuat& Quat) const
+{
+	const float* Src = Locals + Frame * 7 * NumBonesAligned + BoneIndex;
+	int Stride = NumBonesAligned;
+	Pos.Set(Src[0], Src[Stride], Src[Stride*2]);
+	Quat.Set(Src[Stride*3], Src[Stride*4], Src[Stride*5], Src[Stride*6]);
+	if (!BoneIndex) Quat.Conjugate();			// return orientation as stored in animation track
+}
+
+void CPoseEvaluator::EvaluateFrame(const CAnimSequence* Seq, float Time, bool Looped, int Frame)
+{
+	guard(CPoseEvaluator::EvaluateFrame);
+
+	int i;
+	int Stride = NumBonesAligned;
+	float* PosX  = Locals + Frame * 7 * Stride;
+	float* PosY  = PosX + Stride;
+	float* PosZ  = PosX + Stride * 2;
+	float* QuatX = PosX + Stride * 3;
+	float* QuatY = PosX + Stride * 4;
+	float* QuatZ = PosX + Stride * 5;
+	float* QuatW = PosX + Stride * 6;
+
+	// Sample animation tracks. This part is scalar: key lookup depends on track.
+	for (i = 0; i < NumBones; i++)
+	{
+		const CSkelMeshBone &Bone = Mesh->RefSkeleton[i];
+		CVec3 BP = Bone.Position;				// default position - from bind pose
+		CQuat BO = Bone.Orientation;
+		int TrackIndex = BoneMap[i];
+		if (Seq && TrackIndex != INDEX_NONE && TrackIndex < Seq->Tracks.Num())
+		{
+			Seq->Tracks[TrackIndex]->GetBonePosition(Time, Seq->NumFrames, Looped, BP, BO);
+			if (!AnimateTranslation[i])
+				BP = Bone.Position;
+		}
+		if (!i) BO.Conjugate();					// the same as in CSkelMeshInstance::UpdateSkeleton()
+		PosX[i]  = BP[0];
+		PosY[i]  = BP[1];
+		PosZ[i]  = BP[2];
+		QuatX[i] = BO.x;
+		QuatY[i] = BO.y;
+		QuatZ[i] = BO.z;
+		QuatW[i] = BO.w;
+	}
+	// fill padding with identity transform
+	for (/* empty */; i < Stride; i++)
+	{
+		PosX[i] = PosY[i] = PosZ[i] = 0;
+		QuatX[i] = QuatY[i] = QuatZ[i] = 0;
+		QuatW[i] = 1;
+	}
+
+	// Convert quaternions to matrices, 4 bones at a time. Math is the same as in CQuat::ToAxis().
+	CCoords4* Dst = Coords + Frame * NumBones;
+	const __m128 one  = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	for (i = 0; i < NumBones; i += 4)
+	{
+		__m128 x = _mm_load_ps(QuatX + i);
+		__m128 y = _mm_load_ps(QuatY + i);
+		__m128 z = _mm_load_ps(QuatZ + i);
+		__m128 w = _mm_load_ps(QuatW + i);
+		__m128 x2 = _mm_add_ps(x, x);
+		__m128 y2 = _mm_add_ps(y, y);
+		__m128 z2 = _mm_add_ps(z, z);
+		__m128 xx = _mm_mul_ps(x, x2);
+		__m128 xy = _mm_mul_ps(x, y2);
+		__m128 xz = _mm_mul_ps(x, z2);
+		__m128 yy = _mm_mul_ps(y, y2);
+		__m128 yz = _mm_mul_ps(y, z2);
+		__m128 zz = _mm_mul_ps(z, z2);
+		__m128 wx = _mm_mul_ps(w, x2);
+		__m128 wy = _mm_mul_ps(w, y2);
+		__m128 wz = _mm_mul_ps(w, z2);
+
+		// rows of axis matrix, component per bone
+		__m128 a0 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+		__m128 a1 = _mm_sub_ps(xy, wz);
+		__m128 a2 = _mm_add_ps(xz, wy);
+		__m128 a3 = zero;
+		__m128 b0 = _mm_add_ps(xy, wz);
+		__m128 b1 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+		__m128 b2 = _mm_sub_ps(yz, wx);
+		__m128 b3 = zero;
+		__m128 c0 = _mm_sub_ps(xz, wy);
+		__m128 c1 = _mm_add_ps(yz, wx);
+		__m128 c2 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+		__m128 c3 = zero;
+		__m128 o0 = _mm_load_ps(PosX + i);
+		__m128 o1 = _mm_load_ps(PosY + i);
+		__m128 o2 = _mm_load_ps(PosZ + i);
+		__m128 o3 = zero;
+		// convert to vector per bone
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_MM_TRANSPOSE4_PS(o0, o1, o2, o3);
+
+		CCoords4 Tmp[4];
+		Tmp[0].mm[0] = a0; Tmp[0].mm[1] = b0; Tmp[0].mm[2] = c0; Tmp[0].mm[3] = o0;
+		Tmp[1].mm[0] = a1; Tmp[1].mm[1] = b1; Tmp[1].mm[2] = c1; Tmp[1].mm[3] = o1;
+		Tmp[2].mm[0] = a2; Tmp[2].mm[1] = b2; Tmp[2].mm[2] = c2; Tmp[2].mm[3] = o2;
+		Tmp[3].mm[0] = a3; Tmp[3].mm[1] = b3; Tmp[3].mm[2] = c3; Tmp[3].mm[3] = o3;
+		int Count = min(NumBones - i, 4);
+		for (int k = 0; k < Count; k++)
+			Dst[i + k] = Tmp[k];
+	}
+
+	// Transform bones using skeleton hierarchy: Coords = Parent.UnTransformCoords(Local).
+	// Parent bones are always placed before children, so this could be done in-place.
+	for (i = 1; i < NumBones; i++)
+	{
+		int ParentIndex = Mesh->RefSkeleton[i].ParentIndex;
+		if (ParentIndex < 0 || ParentIndex >= i) continue;
+		const CCoords4& P = Dst[ParentIndex];
+		CCoords4& C = Dst[i];
+		for (int r = 0; r < 4; r++)
+		{
+			__m128 s = C.mm[r];
+			__m128 v = _mm_mul_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(0,0,0,0)), P.mm[0]);
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(1,1,1,1)), P.mm[1]));
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_shuffle_ps(s, s, _MM_SHUFFLE(2,2,2,2)), P.mm[2]));
+			if (r == 3) v = _mm_add_ps(v, P.mm[3]);	// origin
+			C.mm[r] = v;
+		}
+	}
+
+	unguardf("frame=%d", Frame);
+}
@@ -85,6 +85,32 @@ struct CSkelMeshLod : public CBaseMeshLod
 		unguard;
 	}
 
+	// Convert vertices to compact form, Verts will be NULL until LockVerts() call
+	void CompactVerts()
+	{
+		if (CompactData || !NumVerts) return;
+		// bone influences are stored without compression
+		CompactVertsCommon(Verts, sizeof(CSkelMeshVertex), sizeof(uint32) + sizeof(int16) * NUM_INFLUENCES);
+		appFree(Verts);
+		Verts = NULL;
+	}
+
+	// Every LockVerts() call should be paired with UnlockVerts()
+	void LockVerts()
+	{
+		if (!CompactData || VertsLockCount++) return;
+		Verts = (CSkelMeshVertex*)appMalloc(sizeof(CSkelMeshVertex) * NumVerts, 16);
+		ExpandVertsCommon(Verts, sizeof(CSkelMeshVertex));
+	}
+
+	void UnlockVerts()
+	{
+		if (!CompactData || --VertsLockCount) return;
+		ReleaseVertsCommon(Verts, sizeof(CSkelMeshVertex));
+		appFree(Verts);
+		Verts = NULL;
+	}
+
 #if DECLARE_VIEWER_PROPS
 	DECLARE_STRUCT(CSkelMeshLod)
 	BEGIN_PROP_TABLE
@@ -167,6 +193,19 @@ public:
 
 	void FinalizeMesh();
 
+	// Expand vertices of compact mesh, should be used around code which accesses Verts
+	void LockVerts()
+	{
+		for (int i = 0; i < Lods.Num(); i++)
+			Lods[i].LockVerts();
+	}
+
+	void UnlockVerts()
+	{
+		for (int i = 0; i < Lods.Num(); i++)
+			Lods[i].UnlockVerts();
+	}
+
 #if RENDERING
 	void LockMaterials()
 	{
@@ -204,6 +243,60 @@ private:
 };
 
 
+/*-----------------------------------------------------------------------------
+	Morph target evaluator
+-----------------------------------------------------------------------------*/
+
+// Applies a weighted set of morph targets to a single mesh LOD. Result is kept in
+// a persistent vertex buffer; Evaluate() rebuilds only vertices affected by morphs
+// whose weights were changed since the previous call. Doesn't depend on renderer,
+// so could be used for baking morphed poses. Mesh vertices should be locked (see
+// CSkeletalMesh::LockVerts) while evaluator is used.
+class CMorphEvaluator
+{
+public:
+	CMorphEvaluator();
+	~CMorphEvaluator();
+
+	void SetMesh(const CSkeletalMesh* InMesh, int InLodIndex);
+	int GetLodIndex() const
+	{
+		return LodIndex;
+	}
+
+	void SetWeight(int MorphIndex, float Weight)
+	{
+		Weights[MorphIndex] = Weight;
+	}
+	float GetWeight(int MorphIndex) const
+	{
+		return Weights[MorphIndex];
+	}
+	void ResetWeights();
+
+	// Returns false when there are no active morphs, GetVerts() result should not be used then
+	bool Evaluate();
+	const CSkelMeshVertex* GetVerts() const
+	{
+		return Verts;
+	}
+
+protected:
+	const CSkeletalMesh*	Mesh;
+	int						LodIndex;
+	int						NumVerts;
+	int						NumActiveMorphs;
+	CSkelMeshVertex*		Verts;					// morphed copy of Lod.Verts
+	TArray<float>			Weights;				// weights set by SetWeight()
+	TArray<float>			AppliedWeights;			// weights used to build Verts
+	// temporary data, allocated once
+	TArray<int>				VertSlot;				// vertex index -> index in DirtyVerts or -1
+	TArray<int>				DirtyVerts;
+	TArray<byte>			Touched;				// per-slot flag: vertex is affected by active morph
+	CVec4*					NormalDeltas;			// per-slot accumulated normal delta
+};
+
+
 /*-----------------------------------------------------------------------------
 	CAnimSet class, common for UMeshAnimation (UE2) and UAnimSet (UE3)
 -----------------------------------------------------------------------------*/
@@ -330,6 +423,65 @@ public:
 };
 
 
+/*-----------------------------------------------------------------------------
+	CPoseEvaluator class
+-----------------------------------------------------------------------------*/
+
+// Computes skeleton poses of CSkeletalMesh animated with CAnimSet sequence for many
+// frames at once, without CSkelMeshInstance. Uses the same rules as the mesh viewer
+// (bone mapping by name, AnimRotationOnly), but bone transforms are stored as structure
+// of arrays and converted with SSE, 4 bones at a time. Frames are evaluated in parallel.
+// Resulting poses are in mesh space, MeshOrigin/RotOrigin/MeshScale are not applied.
+class CPoseEvaluator
+{
+public:
+	CPoseEvaluator();
+	~CPoseEvaluator();
+
+	void SetSkeleton(const CSkeletalMesh* InMesh, const CAnimSet* InAnim, EAnimRotationOnly InRotationMode = EARO_AnimSet);
+
+	// Evaluate poses at specified times (in frames of Seq). Seq may be NULL, reference pose
+	// will be used then.
+	void Evaluate(const CAnimSequence* Seq, const float* Times, int InNumFrames, bool Looped = false);
+	// Evaluate poses with SampleRate frames per second, from the first to the last sequence
+	// frame. Returns number of evaluated frames.
+	int EvaluateFixedRate(const CAnimSequence* Seq, float SampleRate, bool Looped = false);
+
+	int GetNumBones() const
+	{
+		return NumBones;
+	}
+	int GetNumFrames() const
+	{
+		return NumFrames;
+	}
+	// Model-space transforms of all bones for the frame
+	const CCoords4* GetBoneCoords(int Frame) const
+	{
+		return Coords + Frame * NumBones;
+	}
+	// Parent-space transform of the bone
+	void GetLocalTransform(int Frame, int BoneIndex, CVec3& Pos, CQuat& Quat) const;
+
+	// Compute single frame, called from worker threads by Evaluate()
+	void EvaluateFrame(const CAnimSequence* Seq, float Time, bool Looped, int Frame);
+
+protected:
+	const CSkeletalMesh*	Mesh;
+	const CAnimSet*			Anim;
+	int						NumBones;
+	int						NumBonesAligned;		// NumBones rounded up to 4
+	TArray<int>				BoneMap;				// mesh bone -> animation track, or -1
+	TArray<bool>			AnimateTranslation;
+	int						NumFrames;
+	int						MaxFrames;
+	// per frame: 7 arrays of NumBonesAligned values - position X,Y,Z, quaternion X,Y,Z,W
+	float*					Locals;
+	CCoords4*				Coords;					// NumBones per frame
+	TArray<float>			Times;					// used by EvaluateFixedRate()
+};
+
+
 #define REGISTER_SKELMESH_VCLASSES \
 	REGISTER_CLASS(CMeshSection) \
 	REGISTER_CLASS(CSkelMeshLod) \
@@ -50,6 +50,31 @@ struct CStaticMeshLod : public CBaseMeshLod
 		unguard;
 	}
 
+	// Convert vertices to compact form, Verts will be NULL until LockVerts() call
+	void CompactVerts()
+	{
+		if (CompactData || !NumVerts) return;
+		CompactVertsCommon(Verts, sizeof(CStaticMeshVertex), 0);
+		appFree(Verts);
+		Verts = NULL;
+	}
+
+	// Every LockVerts() call should be paired with UnlockVerts()
+	void LockVerts()
+	{
+		if (!CompactData || VertsLockCount++) return;
+		Verts = (CStaticMeshVertex*)appMalloc(sizeof(CStaticMeshVertex) * NumVerts, 16);
+		ExpandVertsCommon(Verts, sizeof(CStaticMeshVertex));
+	}
+
+	void UnlockVerts()
+	{
+		if (!CompactData || --VertsLockCount) return;
+		ReleaseVertsCommon(Verts, sizeof(CStaticMeshVertex));
+		appFree(Verts);
+		Verts = NULL;
+	}
+
 #if DECLARE_VIEWER_PROPS
 	DECLARE_STRUCT(CStaticMeshLod)
 	BEGIN_PROP_TABLE
@@ -78,6 +103,30 @@ public:
 	{
 		for (int i = 0; i < Lods.Num(); i++)
 			Lods[i].BuildNormals();
+		if (GCompactMeshVerts > 0)
+		{
+			int TotalVerts = 0;
+			for (int i = 0; i < Lods.Num(); i++)
+				TotalVerts += Lods[i].NumVerts;
+			if (TotalVerts >= GCompactMeshVerts)
+			{
+				for (int i = 0; i < Lods.Num(); i++)
+					Lods[i].CompactVerts();
+			}
+		}
+	}
+
+	// Expand vertices of compact mesh, should be used around code which accesses Verts
+	void LockVerts()
+	{
+		for (int i = 0; i < Lods.Num(); i++)
+			Lods[i].LockVerts();
+	}
+
+	void UnlockVerts()
+	{
+		for (int i = 0; i < Lods.Num(); i++)
+			Lods[i].UnlockVerts();
 	}
 
 #if RENDERING
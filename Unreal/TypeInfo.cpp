@@ -260,7 +260,7 @@ private:
 	void PrintTo(FString& Dst, const char *fmt, va_list argptr)
 	{
 		char buffer[1024];
-		vsnprintf(ARRAY_ARG(buffer), fmt, argptr);
+		appFormatV(ARRAY_ARG(buffer), fmt, argptr);
 		Dst += buffer;
 	}
 };
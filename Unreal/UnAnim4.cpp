@@ -9,6 +9,7 @@
 
 #include "SkeletalMesh.h"
 #include "TypeConvert.h"
+#include "Parallel.h"
 
 //#define DEBUG_DECOMPRESS	1
 //#define DEBUG_SKELMESH	1
@@ -506,6 +507,7 @@ void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 	{
 		appNotify("AnimSequence %s has wrong CompressedTrackOffsets size (has %d, expected %d), removing track",
 			Seq->Name, Seq->CompressedTrackOffsets.Num(), NumTracks * offsetsPerBone);
+		Seq->ReleaseAnimData();
 		return;
 	}
 
@@ -517,6 +519,66 @@ void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 	Dst->Rate      = Seq->NumFrames / Seq->SequenceLength * Seq->RateScale;
 	Dst->bAdditive = Seq->AdditiveAnimType != AAT_None;
 
+	if (GObjBeginLoadCount)
+	{
+		// Called from PostLoad(): defer decoding to PostLoadBatch(), so all sequences
+		// of this skeleton loaded together will be decoded in parallel
+		if (GObjPostLoadBatch.FindItem(this) < 0)
+		{
+			// pending lists could be left here by EndLoad() which failed
+			PendingAnims.Empty();
+			PendingSequences.Empty();
+			GObjPostLoadBatch.Add(this);
+		}
+		PendingAnims.Add(Seq);
+		PendingSequences.Add(Dst);
+		return;
+	}
+
+	DecodeSequence(Seq, Dst);
+	Seq->ReleaseAnimData();
+
+	unguardf("Skel=%s Anim=%s", Name, Seq->Name);
+}
+
+struct CAnimDecodeContext4
+{
+	USkeleton*		Skeleton;
+};
+
+static void DecodeAnimSequence4(int Index, CAnimDecodeContext4& Context)
+{
+	guard(DecodeAnimSequence4);
+	USkeleton* Skel = Context.Skeleton;
+	Skel->DecodeSequence(Skel->PendingAnims[Index], Skel->PendingSequences[Index]);
+	unguard;
+}
+
+void USkeleton::PostLoadBatch()
+{
+	guard(USkeleton::PostLoadBatch);
+
+	CAnimDecodeContext4 Context;
+	Context.Skeleton = this;
+	appParallelFor(PendingAnims.Num(), DecodeAnimSequence4, Context);
+
+	for (int i = 0; i < PendingAnims.Num(); i++)
+		PendingAnims[i]->ReleaseAnimData();
+	PendingAnims.Empty();
+	PendingSequences.Empty();
+
+	unguardf("Skel=%s", Name);
+}
+
+// Decode compressed data of a single sequence. Could be called from multiple threads
+// for different sequences.
+void USkeleton::DecodeSequence(const UAnimSequence4* Seq, CAnimSequence* Dst)
+{
+	guard(USkeleton::DecodeSequence);
+
+	int NumTracks = Seq->GetNumTracks();
+	int offsetsPerBone = (Seq->KeyEncodingFormat == AKF_PerTrackCompression) ? 2 : 4;
+
 	// bone tracks ...
 	Dst->Tracks.Empty(NumTracks);
 
@@ -1264,13 +1326,15 @@ void UAnimSequence4::PostLoad()
 	guard(UAnimSequence4::PostLoad);
 	if (!Skeleton) return;		// missing package etc
 	Skeleton->ConvertAnims(this);
+	unguard;
+}
 
+void UAnimSequence4::ReleaseAnimData()
+{
 	// Release original animation data to save memory
 	RawAnimationData.Empty();
 	CompressedByteStream.Empty();
 	CompressedTrackOffsets.Empty();
-
-	unguard;
 }
 
 // WARNING: the following functions uses some logic to use either CompressedTrackToSkeletonMapTable or TrackToSkeletonMapTable.
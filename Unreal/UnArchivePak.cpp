@@ -1,6 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
 #include "GameFileSystem.h"
+#include "Profiler.h"
 
 #include "UnArchivePak.h"
 
@@ -273,6 +274,7 @@ void FPakFile::Serialize(void *data, int size)
 			if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Info->CompressionBlockSize))
 			{
 				// buffer is not ready
+				PROFILE_SCOPE("PakReadBlock");
 				if (UncompressedBuffer == NULL)
 				{
 					UncompressedBuffer = (byte*)appMalloc((int)Info->CompressionBlockSize); // size of uncompressed block
@@ -336,6 +338,7 @@ void FPakFile::Serialize(void *data, int size)
 			if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + EncryptedBufferSize))
 			{
 				// Should fetch block and decrypt it.
+				PROFILE_SCOPE("PakReadBlock");
 				// Note: AES is block encryption, so we should always align read requests for correct decryption.
 				UncompressedBufferPos = ArPos & ~(EncryptionAlign - 1);
 				Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
@@ -940,4 +943,21 @@ const FPakEntry* FPakVFS::FindFile(const char* name)
 	return NULL;
 }
 
+bool FPakVFS::GetCacheKey(const char* name, FString& OutKey)
+{
+	const FPakEntry* info = FindFile(name);
+	if (!info || (!info->CompressionMethod && !info->bEncrypted)) return false;
+	// Encrypted data depends on the key, so include its hash
+	uint64 KeyHash = info->bEncrypted ? appMemHash64(*GAesKey, GAesKey.Len()) : 0;
+	char Suffix[MAX_PACKAGE_PATH + 64];
+	appSprintf(ARRAY_ARG(Suffix), "pak,pos=%llX,size=%llX,aes=%llX|%s", info->Pos, info->Size, KeyHash, name);
+	return appMakeFileCacheKey(*Filename, Suffix, OutKey);
+}
+
+bool FPakVFS::GetFileTime(const char* name, int64& OutTime)
+{
+	int64 PakSize;
+	return appGetFileStamp(*Filename, PakSize, OutTime);
+}
+
 #endif // UNREAL4
@@ -211,6 +211,9 @@ public:
 		return new FPakFile(info, Reader);
 	}
 
+	virtual bool GetCacheKey(const char* name, FString& OutKey);
+	virtual bool GetFileTime(const char* name, int64& OutTime);
+
 protected:
 	enum { HASH_SIZE = 1024 };
 	enum { HASH_MASK = HASH_SIZE - 1 };
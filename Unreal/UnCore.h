@@ -62,6 +62,9 @@ class UnPackage;
 #define PACKAGE_FILE_TAG		0x9E2A83C1
 #define PACKAGE_FILE_TAG_REV	0xC1832A9E
 
+// Number of bytes read from disk with FFileReader
+extern int64 GFileBytesRead;
+
 #if PROFILE
 extern int GNumSerialize;
 extern int GSerializeBytes;
@@ -127,7 +130,12 @@ public:
 	uint16		NumAnimations;
 	uint16		NumTextures;
 
-	FArchive* CreateReader() const;
+	// When bUseCache is true, data of compressed or encrypted file may be served from
+	// the decompressed file cache (see appSetFileCacheDirectory)
+	FArchive* CreateReader(bool bUseCache = false) const;
+	// Get modification time of the file, for files inside virtual file system this is a time
+	// of the container. Returns false when the time is not known.
+	bool GetModificationTime(int64& OutTime) const;
 
 	const char* GetExtension() const
 	{
@@ -522,6 +530,13 @@ public:
 		return false;
 	}
 
+	// Returns true when archive reads objects from a package file, so data placed in this file
+	// could be loaded later using object's package (for example, deferred bulk data).
+	virtual bool IsPackageReader() const
+	{
+		return false;
+	}
+
 #if UNREAL4
 	virtual bool ContainsEditorData() const
 	{
@@ -769,6 +784,11 @@ public:
 	virtual bool IsOpen() const;
 	virtual void Close();
 
+	const char* GetFilename() const
+	{
+		return FullName;
+	}
+
 protected:
 	FILE		*f;
 	unsigned	Options;
@@ -2376,6 +2396,33 @@ struct FCompressedChunkHeader
 	friend FArchive& operator<<(FArchive &Ar, FCompressedChunkHeader &H);
 };
 
+// Decompressor for a sequence of blocks. Compressed blocks are stored in memory one after
+// another, uncompressed data is placed contiguously into the destination buffer. Blocks
+// are independent, so they're decompressed in parallel.
+struct FBlockDecompressor
+{
+	const FCompressedChunkBlock* Blocks;
+	int			NumBlocks;
+	byte*		CompressedData;
+	byte*		UncompressedData;
+	int			CompressionFlags;			// 0 means that data is stored without compression
+	TArray<int>	CompressedOffsets;
+	TArray<int>	UncompressedOffsets;
+	volatile int NextBlock;
+
+	// Compute block offsets, returns total size of uncompressed data
+	int Setup(const FCompressedChunkBlock* InBlocks, int InNumBlocks, byte* InCompressedData, byte* InUncompressedData, int InCompressionFlags);
+	// Decompress all remaining blocks using all available threads
+	void Decompress();
+	// Decompress blocks one by one in the current thread. Could be executed in a background
+	// thread simultaneously with Decompress(), blocks are distributed between threads.
+	void DecompressInThisThread();
+
+private:
+	void DecompressNextBlock();
+	static void DecompressBlockWorker(int Index, FBlockDecompressor& Decompressor);
+};
+
 void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int CompressionFlags);
 
 
@@ -2427,10 +2474,12 @@ struct FByteBulkData //?? separate FUntypedBulkData
 #if UNREAL4
 	bool	bIsUE4Data;					// indicates how to treat BulkDataFlags, as these constants aren't compatible between UE3 and UE4
 #endif
+	bool	bDeferredLoad;				// data is stored in the package file, but not loaded yet, see Serialize()
 
 	FByteBulkData()
 	:	BulkData(NULL)
 	,	BulkDataOffsetInFile(0)
+	,	bDeferredLoad(false)
 #if UNREAL4
 	,	bIsUE4Data(false)
 #endif
@@ -2454,6 +2503,7 @@ struct FByteBulkData //?? separate FUntypedBulkData
 
 	bool CanReloadBulk() const
 	{
+		if (bDeferredLoad) return true;
 #if UNREAL4
 		if (bIsUE4Data)
 		{
@@ -2466,12 +2516,17 @@ struct FByteBulkData //?? separate FUntypedBulkData
 	// support functions
 	void SerializeHeader(FArchive &Ar);
 	void SerializeData(FArchive &Ar);
+	// Load data which is located in a separate file (UE4 .ubulk). Will use MainObj's package.
 	bool SerializeData(const UObject* MainObj) const;
+	// Load data deferred by Serialize(). Ar is the opened archive which was used for Serialize()
+	// call, i.e. the object's package.
+	void LoadDeferredData(FArchive& Ar);
 	// main functions
-	void Serialize(FArchive &Ar);
+	// When bAllowDeferred is set, data located in the same package will not be loaded,
+	// it should be loaded later with LoadDeferredData() call.
+	void Serialize(FArchive &Ar, bool bAllowDeferred = false);
 	void Skip(FArchive &Ar);
-
-protected:
+	// Serialize data block at the current archive position
 	void SerializeDataChunk(FArchive &Ar);
 };
 
@@ -2532,6 +2587,10 @@ inline void appDecryptAES(byte* Data, int Size)
 	appDecryptAES(Data, Size, *GAesKey, GAesKey.Len());
 }
 
+// XOR data with a repeating key. KeyOffset is the index of the key byte used for
+// the first byte of data. Used by licensee games with simple package encryption.
+void appXorWithKey(byte* Data, int Size, const byte* Key, int KeyLength, int KeyOffset = 0);
+
 // Callback called when encrypted pak file is attempted to load
 bool UE4EncryptedPak();
 
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Profiler.h"
 
 // includes for package decompression
 #include "lzo/lzo1x.h"
@@ -200,6 +201,8 @@ int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *Uncompressed
 
 	guard(appDecompress);
 
+	PROFILE_SCOPE("Decompress");
+
 #if BLADENSOUL
 	if (GForceGame == GAME_BladeNSoul && Flags == COMPRESS_LZO_ENC_BNS)	// note: GForceGame is required (to not pass 'Game' here)
 	{
@@ -376,6 +379,8 @@ void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
 {
 	guard(appDecryptAES);
 
+	PROFILE_SCOPE("DecryptAES");
+
 	if (KeyLen <= 0)
 	{
 		KeyLen = strlen(Key);
@@ -1,4 +1,57 @@
 #include "Core.h"
+#include "UnCore.h"
+
+#include <emmintrin.h>			// SSE2 intrinsics
+
+
+/*-----------------------------------------------------------------------------
+	XOR with repeating key
+-----------------------------------------------------------------------------*/
+
+void appXorWithKey(byte* Data, int Size, const byte* Key, int KeyLength, int KeyOffset)
+{
+	guard(appXorWithKey);
+
+	assert(KeyLength > 0);
+	int KeyPos = KeyOffset % KeyLength;
+
+	if (Size < 32)
+	{
+		// Small buffer
+		for (int i = 0; i < Size; i++)
+		{
+			Data[i] ^= Key[KeyPos];
+			if (++KeyPos == KeyLength) KeyPos = 0;
+		}
+		return;
+	}
+
+	// Make the key longer by 16 bytes, so 16 bytes could be loaded starting from any key position
+	byte LocalKey[1024];
+	int ExtKeyLength = KeyLength + 16;
+	byte* ExtKey = (ExtKeyLength <= ARRAY_COUNT(LocalKey)) ? LocalKey : (byte*)appMalloc(ExtKeyLength);
+	for (int i = 0; i < ExtKeyLength; i++)
+		ExtKey[i] = Key[i % KeyLength];
+
+	int Step = 16 % KeyLength;
+	int i = 0;
+	for ( ; i + 16 <= Size; i += 16)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(Data + i));
+		__m128i k = _mm_loadu_si128((const __m128i*)(ExtKey + KeyPos));
+		_mm_storeu_si128((__m128i*)(Data + i), _mm_xor_si128(d, k));
+		KeyPos += Step;
+		if (KeyPos >= KeyLength) KeyPos -= KeyLength;
+	}
+	// Remaining bytes, less than 16
+	for ( ; i < Size; i++)
+		Data[i] ^= ExtKey[KeyPos++];
+
+	if (ExtKey != LocalKey) appFree(ExtKey);
+
+	unguard;
+}
+
 
 #if BLADENSOUL
 
@@ -7,8 +60,7 @@ void DecryptBladeAndSoul(byte* CompressedBuffer, int CompressedSize)
 	if (CompressedSize >= 32)
 	{
 		static const char *key = "qiffjdlerdoqymvketdcl0er2subioxq";
-		for (int i = 0; i < CompressedSize; i++)
-			CompressedBuffer[i] ^= key[i % 32];
+		appXorWithKey(CompressedBuffer, CompressedSize, (const byte*)key, 32);
 	}
 }
 
@@ -23,8 +75,7 @@ void DecryptTaoYuan(byte* CompressedBuffer, int CompressedSize)
 		137, 35, 95, 142, 69, 136, 243, 119, 25, 35, 111, 94, 101, 136, 243, 204,
 		243, 67, 95, 158, 69, 106, 107, 187, 237, 35, 103, 142, 72, 142, 243
 	};
-	for (int i = 0; i < CompressedSize; i++)
-		CompressedBuffer[i] ^= key[i % 31];		// note: "N % 31" is not the same as "N & 0x1F"
+	appXorWithKey(CompressedBuffer, CompressedSize, key, ARRAY_COUNT(key));
 }
 
 #endif // TAO_YUAN
@@ -85,12 +136,9 @@ void DecryptDevlsThird(byte* CompressedBuffer, int CompressedSize)
 		220, 169, 141,   1, 131,  82,  44,  91, 172,
 	};
 	static_assert(ARRAY_COUNT(key) == 761, "Bad key");
+	// Key is used sequentially, starting from position which depends on data size
 	uint32 XorIndex = 244109 * CompressedSize + 240169;
-    for (int i = 0; i < CompressedSize; i++)
-	{
-		CompressedBuffer[i] ^= key[XorIndex % 761];
-		XorIndex = XorIndex % 761 + 1;
-	}
+	appXorWithKey(CompressedBuffer, CompressedSize, key, ARRAY_COUNT(key), XorIndex % 761);
 }
 
 #endif // DEVILS_THIRD
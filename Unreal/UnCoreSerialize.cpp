@@ -1,5 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Profiler.h"
+#include "Parallel.h"
 
 #if UNREAL4
 #include "UnObject.h"
@@ -455,7 +457,7 @@ void FArchive::Printf(const char *fmt, ...)
 	va_list	argptr;
 	va_start(argptr, fmt);
 	char buf[4096];
-	int len = vsnprintf(ARRAY_ARG(buf), fmt, argptr);
+	int len = appFormatV(ARRAY_ARG(buf), fmt, argptr);
 	va_end(argptr);
 	if (len < 0 || len >= sizeof(buf) - 1) exit(1);
 	Serialize(buf, len);
@@ -567,6 +569,8 @@ bool FFileArchive::OpenFile()
 	unguard;
 }
 
+int64 GFileBytesRead = 0;
+
 FFileReader::FFileReader(const char *Filename, unsigned InOptions)
 :	FFileArchive(Filename, InOptions)
 ,	SeekPos(-1)
@@ -626,6 +630,7 @@ void FFileReader::Serialize(void *data, int size)
 		else
 		{
 			// Buffer is empty
+			PROFILE_SCOPE("FileRead");
 			if (SeekPos >= 0)
 			{
 				// Seek to desired position
@@ -649,6 +654,7 @@ void FFileReader::Serialize(void *data, int size)
 				int res = fread(data, size, 1, f);
 				if (res != 1)
 					appError("Unable to read %d bytes at pos=0x%llX", size, FilePos);
+				GFileBytesRead += size;
 			#if PROFILE
 				GNumSerialize++;
 				GSerializeBytes += size;
@@ -666,6 +672,7 @@ void FFileReader::Serialize(void *data, int size)
 //			appPrintf("read: %d+%d -> %d\n", (int)FilePos, ReadBytes, (int)FilePos + ReadBytes);
 			if (ReadBytes == 0)
 				appError("Unable to read %d bytes at pos=0x%llX", 1, FilePos);
+			GFileBytesRead += ReadBytes;
 		#if PROFILE
 			GNumSerialize++;
 			GSerializeBytes += ReadBytes;
@@ -806,6 +813,7 @@ void FFileWriter::Serialize(void *data, int size)
 			if (size >= FILE_BUFFER_SIZE)
 			{
 				// large block, write directly to file
+				PROFILE_SCOPE("FileWrite");
 				if (ArPos64 != FilePos)
 				{
 					if (fseeko64(f, ArPos64, SEEK_SET) != 0)
@@ -866,6 +874,7 @@ void FFileWriter::FlushBuffer()
 {
 	if (BufferSize > 0)
 	{
+		PROFILE_SCOPE("FileWrite");
 		if (BufferPos != FilePos)
 		{
 			int ret = fseeko64(f, BufferPos, SEEK_SET);
@@ -1038,7 +1047,78 @@ summary:
 	unguardf("pos=%X", Ar.Tell());
 }
 
-// code is similar to FUE3ArchiveReader::PrepareBuffer()
+int FBlockDecompressor::Setup(const FCompressedChunkBlock* InBlocks, int InNumBlocks, byte* InCompressedData, byte* InUncompressedData, int InCompressionFlags)
+{
+	guard(FBlockDecompressor::Setup);
+
+	Blocks           = InBlocks;
+	NumBlocks        = InNumBlocks;
+	CompressedData   = InCompressedData;
+	UncompressedData = InUncompressedData;
+	CompressionFlags = InCompressionFlags;
+	NextBlock        = 0;
+
+	CompressedOffsets.Empty(NumBlocks);
+	UncompressedOffsets.Empty(NumBlocks);
+	int CompressedPos = 0, UncompressedPos = 0;
+	for (int i = 0; i < NumBlocks; i++)
+	{
+		CompressedOffsets.Add(CompressedPos);
+		UncompressedOffsets.Add(UncompressedPos);
+		CompressedPos   += Blocks[i].CompressedSize;
+		UncompressedPos += Blocks[i].UncompressedSize;
+	}
+	return UncompressedPos;
+
+	unguard;
+}
+
+void FBlockDecompressor::DecompressNextBlock()
+{
+	int Index = appInterlockedIncrement(&NextBlock) - 1;
+	if (Index >= NumBlocks) return;
+
+	guard(DecompressBlock);
+	const FCompressedChunkBlock& Block = Blocks[Index];
+	byte* Src = CompressedData + CompressedOffsets[Index];
+	byte* Dst = UncompressedData + UncompressedOffsets[Index];
+	if (CompressionFlags)
+	{
+		appDecompress(Src, Block.CompressedSize, Dst, Block.UncompressedSize, CompressionFlags);
+	}
+	else
+	{
+		assert(Block.CompressedSize == Block.UncompressedSize);
+		memcpy(Dst, Src, Block.UncompressedSize);
+	}
+	unguardf("block=%d/%d", Index, NumBlocks);
+}
+
+void FBlockDecompressor::DecompressBlockWorker(int Index, FBlockDecompressor& Decompressor)
+{
+	// 'Index' is ignored: blocks could be taken by DecompressInThisThread() running in other thread
+	Decompressor.DecompressNextBlock();
+}
+
+void FBlockDecompressor::Decompress()
+{
+	guard(FBlockDecompressor::Decompress);
+	int NumRemaining = NumBlocks - NextBlock;
+	if (NumRemaining == 1)
+		DecompressNextBlock();
+	else if (NumRemaining > 0)
+		appParallelFor(NumRemaining, DecompressBlockWorker, *this);
+	unguard;
+}
+
+void FBlockDecompressor::DecompressInThisThread()
+{
+	guard(FBlockDecompressor::DecompressInThisThread);
+	while (NextBlock < NumBlocks)
+		DecompressNextBlock();
+	unguard;
+}
+
 void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int CompressionFlags)
 {
 	guard(appReadCompressedChunk);
@@ -1046,23 +1126,20 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 	// read header
 	FCompressedChunkHeader ChunkHeader;
 	Ar << ChunkHeader;
-	// prepare buffer for reading compressed data
-	int BufferSize = ChunkHeader.BlockSize * 16;
-	byte *ReadBuffer = (byte*)appMalloc(BufferSize);	// BlockSize is size of uncompressed data
-	// read and decompress data
+	// read compressed data of all blocks at once
+	int CompressedSize = 0;
 	for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
-	{
-		const FCompressedChunkBlock *Block = &ChunkHeader.Blocks[BlockIndex];
-		assert(Block->CompressedSize <= BufferSize);
-		assert(Block->UncompressedSize <= Size);
-		Ar.Serialize(ReadBuffer, Block->CompressedSize);
-		appDecompress(ReadBuffer, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
-		Size   -= Block->UncompressedSize;
-		Buffer += Block->UncompressedSize;
-	}
+		CompressedSize += ChunkHeader.Blocks[BlockIndex].CompressedSize;
+	byte *ReadBuffer = (byte*)appMalloc(CompressedSize);
+	Ar.Serialize(ReadBuffer, CompressedSize);
+	// decompress data
+	FBlockDecompressor Decompressor;
+	int UncompressedSize = Decompressor.Setup(ChunkHeader.Blocks.GetData(), ChunkHeader.Blocks.Num(), ReadBuffer, Buffer, CompressionFlags);
+	if (UncompressedSize != Size)
+		appError("Compressed chunk size mismatch: %d != %d", UncompressedSize, Size);
+	Decompressor.Decompress();
 	// finalize
-	assert(Size == 0);			// should be comletely read
-	delete ReadBuffer;
+	appFree(ReadBuffer);
 	unguard;
 }
 
@@ -1228,10 +1305,11 @@ header_done: ;
 }
 
 
-void FByteBulkData::Serialize(FArchive &Ar)
+void FByteBulkData::Serialize(FArchive &Ar, bool bAllowDeferred)
 {
 	guard(FByteBulkData::Serialize);
 
+	bDeferredLoad = false;
 	SerializeHeader(Ar);
 
 	if (BulkDataFlags & BULKDATA_Unused || ElementCount == 0)	// skip serializing
@@ -1242,6 +1320,12 @@ void FByteBulkData::Serialize(FArchive &Ar)
 		return;
 	}
 
+	// Data which is stored in the package file could be loaded later with LoadDeferredData(),
+	// so only remember that it exists. This eliminates seeks to distant data blocks while reading
+	// the object, and loading of data which will never be used.
+	if (bAllowDeferred && !Ar.IsPackageReader())
+		bAllowDeferred = false;
+
 #if UNREAL4
 	// Unreal Engine 4 code
 
@@ -1265,6 +1349,11 @@ void FByteBulkData::Serialize(FArchive &Ar)
 				BulkDataFlags |= BULKDATA_Unused;
 				return;
 			}
+			if (bAllowDeferred)
+			{
+				bDeferredLoad = true;
+				return;
+			}
 			// stored in the same file, but at different position
 			// save archive position
 			int savePos, saveStopper;
@@ -1299,6 +1388,11 @@ void FByteBulkData::Serialize(FArchive &Ar)
 
 	if (BulkDataFlags & BULKDATA_SeparateData)
 	{
+		if (bAllowDeferred)
+		{
+			bDeferredLoad = true;
+			return;
+		}
 		// stored in the same file, but at different position
 		// save archive position
 		int savePos, saveStopper;
@@ -1321,6 +1415,13 @@ void FByteBulkData::Serialize(FArchive &Ar)
 
 	if (ElementCount > 0)
 	{
+		if (bAllowDeferred && BulkDataOffsetInFile == Ar.Tell64() && BulkDataSizeOnDisk == ElementCount * GetElementSize())
+		{
+			// uncompressed inline data, skip it; don't rely on BulkDataSizeOnDisk for compressed data
+			bDeferredLoad = true;
+			Ar.Seek64(Ar.Tell64() + BulkDataSizeOnDisk);
+			return;
+		}
 //		assert(BulkDataOffsetInFile == Ar.Tell());
 		SerializeData(Ar);
 	}
@@ -1462,8 +1563,47 @@ void FByteBulkData::SerializeDataChunk(FArchive &Ar)
 	unguard;
 }
 
+void FByteBulkData::LoadDeferredData(FArchive& Ar)
+{
+	guard(FByteBulkData::LoadDeferredData);
+
+	if (BulkData) return;			// already loaded
+	assert(bDeferredLoad && Ar.IsOpen());
+
+	// save archive position
+	int64 savePos = Ar.Tell64();
+	int saveStopper = Ar.GetStopper();
+	Ar.SetStopper(0);
+#if UNREAL4
+	if (bIsUE4Data)
+	{
+		// BULKDATA_PayloadAtEndOfFile
+		SerializeData(Ar);
+	}
+	else
+#endif // UNREAL4
+	if (BulkDataFlags & BULKDATA_SeparateData)
+	{
+		SerializeData(Ar);
+	}
+	else
+	{
+		// inline data
+		Ar.Seek64(BulkDataOffsetInFile);
+		SerializeDataChunk(Ar);
+	}
+	// restore archive position
+	Ar.Seek64(savePos);
+	Ar.SetStopper(saveStopper);
+
+	unguard;
+}
+
 bool FByteBulkData::SerializeData(const UObject* MainObj) const
 {
+	// deferred data should be loaded with LoadDeferredData()
+	assert(!bDeferredLoad);
+
 #if UNREAL4
 	guard(FByteBulkData::SerializeData(UObject*));
 
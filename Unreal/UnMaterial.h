@@ -141,6 +141,11 @@ struct CPixelFormatInfo
 
 extern const CPixelFormatInfo PixelFormatInfo[];	// index in array is TPF_... constant
 
+// Convert 32-bit RGBA pixels to BGRA and vice versa (inplace)
+void SwapRedBlue(byte* pic, int numPixels);
+// The same, but copying pixels to another buffer
+void CopySwapRedBlue(const byte* src, byte* dst, int numPixels);
+
 struct CMipMap
 {
 	const byte*				CompressedData;			// not TArray because we could just point to another data block without memory reallocation
@@ -194,6 +199,7 @@ struct CTextureData
 	bool					isNormalmap;
 	const UObject			*Obj;					// for error reporting
 	const UPalette			*Palette;				// for TPF_P8
+	int						MaxMips;				// set before GetTextureData() call to limit number of loaded mips, 0 = all
 
 	CTextureData()
 	{
@@ -212,7 +218,9 @@ struct CTextureData
 	unsigned GetFourCC() const;
 	bool IsDXT() const;
 
-	byte *Decompress(int MipLevel = 0);				// may return NULL in a case of error
+	// Decode mipmap to 32-bit pixels (or float[4] for HDR formats). DstFormat selects byte order
+	// of the result, it could be TPF_RGBA8 or TPF_BGRA8. May return NULL in a case of error.
+	byte *Decompress(int MipLevel = 0, ETexturePixelFormat DstFormat = TPF_RGBA8);
 
 #if SUPPORT_XBOX360
 	bool DecodeXBox360(int MipLevel);
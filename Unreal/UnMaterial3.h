@@ -475,6 +475,8 @@ public:
 	const TArray<FTexture2DMipMap>* GetMipmapArray() const;
 
 	bool LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, const char* tfcSuffix, bool verbose) const;
+	// Close TFC files kept open by LoadBulkTexture() and drop cached data
+	static void ReleaseTextureFileCache();
 	virtual bool GetTextureData(CTextureData &TexData) const;
 	virtual void ReleaseTextureData() const;
 #if RENDERING
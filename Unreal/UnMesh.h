@@ -14,9 +14,26 @@ UE1 CLASS TREE:
 -----------------------------------------------------------------------------*/
 
 struct FPackedNormal;
+struct FMeshUVFloat;
+struct FMeshUVHalf;
 struct CMeshVertex;
+struct CMeshUVFloat;
+struct CSkelMeshVertex;
 void UnpackNormals(const FPackedNormal SrcNormal[3], CMeshVertex &V);
 
+// Conversion of vertex streams, used by ConvertMesh() code. Source and destination data are
+// arrays of structures, strides are in bytes. Functions are thread-safe, so ConvertMesh() could
+// process different parts of the mesh in parallel.
+void UnpackNormalsStream(CMeshVertex* Dst, int DstStride, const FPackedNormal* Src, int SrcStride, int Count);
+void ConvertUVStream(CMeshUVFloat* Dst, int DstStride, const FMeshUVHalf* Src, int SrcStride, int Count);
+void ConvertUVStream(CMeshUVFloat* Dst, int DstStride, const FMeshUVFloat* Src, int SrcStride, int Count);
+// Remove influences with zero weight, pack weights and remap bone indices with BoneMap.
+void PackInfluencesStream(CSkelMeshVertex* Dst, const byte* SrcBones, const byte* SrcWeights, int SrcStride,
+	const uint16* BoneMap, int BoneMapSize, int Count);
+
+// Number of vertices processed by a single job of parallel mesh conversion
+#define MESH_CONVERT_BLOCK_SIZE		16384
+
 //?? move these declarations outside
 class CSkeletalMesh;
 struct CSkelMeshLod;
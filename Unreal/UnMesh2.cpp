@@ -7,6 +7,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "Profiler.h"
 
 //#define DEBUG_SKELMESH		1
 //#define DEBUG_STATICMESH		1
@@ -664,6 +665,8 @@ void USkeletalMesh::ConvertMesh()
 {
 	guard(USkeletalMesh::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	CSkeletalMesh *Mesh = new CSkeletalMesh(this);
 	ConvertedMesh = Mesh;
 	Mesh->BoundingBox    = BoundingBox;
@@ -1833,6 +1836,8 @@ void UStaticMesh::ConvertMesh()
 {
 	guard(UStaticMesh::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	int i;
 
 	CStaticMesh *Mesh = new CStaticMesh(this);
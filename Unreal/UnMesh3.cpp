@@ -11,6 +11,10 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "Profiler.h"
+#include "Parallel.h"
+
+#include <emmintrin.h>			// SSE2 intrinsics
 
 
 //#define DEBUG_SKELMESH		1
@@ -52,6 +56,122 @@ void UnpackNormals(const FPackedNormal SrcNormal[3], CMeshVertex &V)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Vertex stream conversion
+-----------------------------------------------------------------------------*/
+
+void UnpackNormalsStream(CMeshVertex* Dst, int DstStride, const FPackedNormal* Src, int SrcStride, int Count)
+{
+	byte* d = (byte*)Dst;
+	const byte* s = (const byte*)Src;
+	for (int i = 0; i < Count; i++, d += DstStride, s += SrcStride)
+	{
+		const FPackedNormal* N = (const FPackedNormal*)s;
+		CMeshVertex* V = (CMeshVertex*)d;
+		if (N[1].Data == 0)
+		{
+			// no binormal, the same as UnpackNormals() but without unpacking to float
+			V->Tangent = CVT(N[0]);
+			V->Normal  = CVT(N[2]);
+		}
+		else
+		{
+			UnpackNormals(N, *V);
+		}
+	}
+}
+
+// Convert 4 float16 values stored in low 16 bits of each item to float32. This is SSE2 version
+// of half2float(), with exactly the same results (denormals and infinities are not processed,
+// so F16C instructions can't be used here).
+static FORCEINLINE __m128 HalfToFloat4(__m128i h)
+{
+	__m128i Sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+	__m128i ExpMant = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+	ExpMant = _mm_add_epi32(ExpMant, _mm_set1_epi32((127 - 15) << 23));
+	return _mm_castsi128_ps(_mm_or_si128(Sign, ExpMant));
+}
+
+void ConvertUVStream(CMeshUVFloat* Dst, int DstStride, const FMeshUVHalf* Src, int SrcStride, int Count)
+{
+	static_assert(sizeof(FMeshUVHalf) == 4, "Wrong FMeshUVHalf layout");
+	byte* d = (byte*)Dst;
+	const byte* s = (const byte*)Src;
+	int i = 0;
+	// 4 vertices per iteration
+	for ( ; i + 4 <= Count; i += 4, d += DstStride * 4, s += SrcStride * 4)
+	{
+		__m128i h = _mm_set_epi32(*(const int*)(s + SrcStride * 3), *(const int*)(s + SrcStride * 2),
+			*(const int*)(s + SrcStride), *(const int*)s);
+		__m128 U = HalfToFloat4(_mm_and_si128(h, _mm_set1_epi32(0xFFFF)));
+		__m128 V = HalfToFloat4(_mm_srli_epi32(h, 16));
+		__m128 UV01 = _mm_unpacklo_ps(U, V);
+		__m128 UV23 = _mm_unpackhi_ps(U, V);
+		_mm_storel_pi((__m64*)d, UV01);
+		_mm_storeh_pi((__m64*)(d + DstStride), UV01);
+		_mm_storel_pi((__m64*)(d + DstStride * 2), UV23);
+		_mm_storeh_pi((__m64*)(d + DstStride * 3), UV23);
+	}
+	// remaining vertices
+	for ( ; i < Count; i++, d += DstStride, s += SrcStride)
+	{
+		FMeshUVFloat UV = *(const FMeshUVHalf*)s;
+		*(CMeshUVFloat*)d = CVT(UV);
+	}
+}
+
+void ConvertUVStream(CMeshUVFloat* Dst, int DstStride, const FMeshUVFloat* Src, int SrcStride, int Count)
+{
+	byte* d = (byte*)Dst;
+	const byte* s = (const byte*)Src;
+	for (int i = 0; i < Count; i++, d += DstStride, s += SrcStride)
+	{
+		*(CMeshUVFloat*)d = *CVT((const FMeshUVFloat*)s);
+	}
+}
+
+// Indices of non-zero weights for every combination of them, used to pack influences
+// without branches. Index of the table is a bit mask of non-zero weights.
+struct CInfluenceOrder
+{
+	byte		Count;
+	byte		Index[NUM_INFLUENCES];
+};
+
+static const CInfluenceOrder GInfluenceOrder[1 << NUM_INFLUENCES] =
+{
+	{ 0 },             { 1, { 0 } },       { 1, { 1 } },       { 2, { 0, 1 } },
+	{ 1, { 2 } },      { 2, { 0, 2 } },    { 2, { 1, 2 } },    { 3, { 0, 1, 2 } },
+	{ 1, { 3 } },      { 2, { 0, 3 } },    { 2, { 1, 3 } },    { 3, { 0, 1, 3 } },
+	{ 2, { 2, 3 } },   { 3, { 0, 2, 3 } }, { 3, { 1, 2, 3 } }, { 4, { 0, 1, 2, 3 } },
+};
+
+void PackInfluencesStream(CSkelMeshVertex* Dst, const byte* SrcBones, const byte* SrcWeights, int SrcStride,
+	const uint16* BoneMap, int BoneMapSize, int Count)
+{
+	static_assert(NUM_INFLUENCES == 4, "PackInfluencesStream: wrong NUM_INFLUENCES");
+	for (int Vert = 0; Vert < Count; Vert++, Dst++, SrcBones += SrcStride, SrcWeights += SrcStride)
+	{
+		uint32 Weights = *(const uint32*)SrcWeights;
+		int Mask = ((Weights & 0xFF) != 0) | (((Weights & 0xFF00) != 0) << 1)
+			| (((Weights & 0xFF0000) != 0) << 2) | (((Weights & 0xFF000000) != 0) << 3);
+		const CInfluenceOrder& Order = GInfluenceOrder[Mask];
+		uint32 PackedWeights = 0;
+		for (int i = 0; i < Order.Count; i++)
+		{
+			int Index = Order.Index[i];
+			PackedWeights |= ((Weights >> (Index * 8)) & 0xFF) << (i * 8);
+			int BoneIndex = SrcBones[Index];
+			if (BoneIndex >= BoneMapSize)
+				appError("Bone index %d is out of range (%d)", BoneIndex, BoneMapSize);
+			Dst->Bone[i] = BoneMap[BoneIndex];
+		}
+		Dst->PackedWeights = PackedWeights;
+		if (Order.Count < NUM_INFLUENCES) Dst->Bone[Order.Count] = INDEX_NONE; // mark end of list
+	}
+}
+
+
 /*-----------------------------------------------------------------------------
 	UMorphTarget
 -----------------------------------------------------------------------------*/
@@ -2027,10 +2147,180 @@ after_skeleton:
 }
 
 
+// Part of LOD's vertices which belongs to a single chunk
+struct CSkelVertexJob3
+{
+	int							LodIndex;
+	const FStaticLODModel3*		SrcLod;
+	int							ChunkIndex;
+	int							FirstVertex;
+	int							NumVerts;
+	bool						UseGpuSkinVerts;
+};
+
+struct CSkelVertexContext3
+{
+	CSkeletalMesh*				Mesh;
+	TArray<CSkelVertexJob3>		Jobs;
+};
+
+static void ConvertSkelVerts3(int JobIndex, CSkelVertexContext3& Context)
+{
+	guard(ConvertSkelVerts3);
+
+	const CSkelVertexJob3& Job = Context.Jobs[JobIndex];
+	const FStaticLODModel3& SrcLod = *Job.SrcLod;
+	CSkelMeshLod* Lod = &Context.Mesh->Lods[Job.LodIndex];
+	const FSkelMeshChunk3 *C = &SrcLod.Chunks[Job.ChunkIndex];
+	const FSkeletalMeshVertexBuffer3 &S = SrcLod.GPUSkin;
+	int NumTexCoords = Lod->NumTexCoords;
+	int First = Job.FirstVertex;
+	int Count = Job.NumVerts;
+	CSkelMeshVertex *D = Lod->Verts + First;
+
+	if (Lod->VertexColors)
+		memcpy(Lod->VertexColors + First, &SrcLod.VertexColor[First], Count * sizeof(FColor));
+
+	if (Job.UseGpuSkinVerts)
+	{
+		// NOTE: Gears3 has some issues:
+		// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
+		//   previous chunk (FirstVertex=0 for a few chunks)
+		// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
+
+		// get vertices from GPU skin, and convert positions
+		const FGPUVert3Common *V;		// has normal and influences, but no UV[] and position
+		const FMeshUVHalf *SrcUVHalf = NULL;
+		const FMeshUVFloat *SrcUV = NULL;
+		int Stride;
+		if (!S.bUseFullPrecisionUVs)
+		{
+			if (!S.bUsePackedPosition)
+			{
+				const FGPUVert3Half *V0 = &S.VertsHalf[First];
+				for (int i = 0; i < Count; i++)
+					D[i].Position = CVT(V0[i].Pos);
+				V = V0;
+				SrcUVHalf = V0->UV;
+				Stride = sizeof(FGPUVert3Half);
+			}
+			else
+			{
+				const FGPUVert3PackedHalf *V0 = &S.VertsHalfPacked[First];
+				for (int i = 0; i < Count; i++)
+				{
+					FVector VPos;
+					VPos = V0[i].Pos.ToVector(S.MeshOrigin, S.MeshExtension);
+					D[i].Position = CVT(VPos);
+				}
+				V = V0;
+				SrcUVHalf = V0->UV;
+				Stride = sizeof(FGPUVert3PackedHalf);
+			}
+		}
+		else
+		{
+			if (!S.bUsePackedPosition)
+			{
+				const FGPUVert3Float *V0 = &S.VertsFloat[First];
+				for (int i = 0; i < Count; i++)
+					D[i].Position = CVT(V0[i].Pos);
+				V = V0;
+				SrcUV = V0->UV;
+				Stride = sizeof(FGPUVert3Float);
+			}
+			else
+			{
+				const FGPUVert3PackedFloat *V0 = &S.VertsFloatPacked[First];
+				for (int i = 0; i < Count; i++)
+				{
+					FVector VPos;
+					VPos = V0[i].Pos.ToVector(S.MeshOrigin, S.MeshExtension);
+					D[i].Position = CVT(VPos);
+				}
+				V = V0;
+				SrcUV = V0->UV;
+				Stride = sizeof(FGPUVert3PackedFloat);
+			}
+		}
+		// UV
+		for (int TexCoordIndex = 0; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		{
+			CMeshUVFloat* DstUV = TexCoordIndex ? Lod->ExtraUV[TexCoordIndex-1] + First : &D->UV;
+			int DstStride = TexCoordIndex ? sizeof(CMeshUVFloat) : sizeof(CSkelMeshVertex);
+			if (SrcUVHalf)
+				ConvertUVStream(DstUV, DstStride, SrcUVHalf + TexCoordIndex, Stride, Count);
+			else
+				ConvertUVStream(DstUV, DstStride, SrcUV + TexCoordIndex, Stride, Count);
+		}
+		// convert Normal[3]
+		UnpackNormalsStream(D, sizeof(CSkelMeshVertex), V->Normal, Stride, Count);
+		// convert influences
+		PackInfluencesStream(D, V->BoneIndex, V->BoneWeight, Stride, (const uint16*)C->Bones.GetData(), C->Bones.Num(), Count);
+		return;
+	}
+
+	for (int Vert = First; Vert < First + Count; Vert++, D++)
+	{
+		// old UE3 version without a GPU skin
+		// get vertex from chunk
+		const FMeshUVFloat *SUV;
+		if (Vert < C->FirstVertex + C->NumRigidVerts)
+		{
+			// rigid vertex
+			const FRigidVertex3 &V0 = C->RigidVerts[Vert - C->FirstVertex];
+			// position and normal
+			D->Position = CVT(V0.Pos);
+			UnpackNormals(V0.Normal, *D);
+			// single influence
+			D->PackedWeights = 0xFF;
+			D->Bone[0]   = C->Bones[V0.BoneIndex];
+			SUV = V0.UV;
+		}
+		else
+		{
+			// soft vertex
+			const FSoftVertex3 &V0 = C->SoftVerts[Vert - C->FirstVertex - C->NumRigidVerts];
+			// position and normal
+			D->Position = CVT(V0.Pos);
+			UnpackNormals(V0.Normal, *D);
+			// influences
+//			int TotalWeight = 0;
+			int i2 = 0;
+			unsigned PackedWeights = 0;
+			for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
+			{
+				int BoneIndex  = V0.BoneIndex[i];
+				byte BoneWeight = V0.BoneWeight[i];
+				if (BoneWeight == 0) continue;
+				PackedWeights |= BoneWeight << (i2 * 8);
+				D->Bone[i2]   = C->Bones[BoneIndex];
+				i2++;
+//				TotalWeight += BoneWeight;
+			}
+			D->PackedWeights = PackedWeights;
+//			assert(TotalWeight == 255);
+			if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
+			SUV = V0.UV;
+		}
+		// UV
+		FMeshUVFloat fUV = SUV[0];			// convert half->float
+		D->UV = CVT(fUV);
+		for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
+		{
+			Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
+		}
+	}
+
+	unguardf("lod=%d", Context.Jobs[JobIndex].LodIndex);
+}
+
 void USkeletalMesh3::ConvertMesh()
 {
 	guard(USkeletalMesh3::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	// We're calling ConvertMesh explicitly from UMorphTargetSet::PostLoad to ensure
 	// mesh is ready before we're filling morphs, so let's avoid repeating of PostLoad() ...
 	if (ConvertedMesh)
@@ -2075,6 +2365,8 @@ void USkeletalMesh3::ConvertMesh()
 	Mesh->MeshScale.Set(1, 1, 1);							// missing in UE3
 
 	// convert LODs
+	CSkelVertexContext3 Context;
+	Context.Mesh = Mesh;
 	Mesh->Lods.Empty(LODModels.Num());
 	assert(LODModels.Num() == LODInfo.Num());
 	for (int lod = 0; lod < LODModels.Num(); lod++)
@@ -2110,164 +2402,40 @@ void USkeletalMesh3::ConvertMesh()
 		else if (SrcLod.VertexColor.Num())
 			appPrintf("LOD %d has invalid vertex color stream\n", lod);
 
-		int chunkIndex = 0;
-		const FSkelMeshChunk3 *C = NULL;
-		int lastChunkVertex = -1;
-		const FSkeletalMeshVertexBuffer3 &S = SrcLod.GPUSkin;
-		CSkelMeshVertex *D = Lod->Verts;
-		int NumReweightedVerts = 0;
-
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
+		if (UseGpuSkinVerts)
 		{
-			if (Vert >= lastChunkVertex)
-			{
-				// proceed to next chunk
-				C = &SrcLod.Chunks[chunkIndex++];
-				lastChunkVertex = C->FirstVertex + C->NumRigidVerts + C->NumSoftVerts;
-			}
-
-			if (Lod->VertexColors)
-				Lod->VertexColors[Vert] = SrcLod.VertexColor[Vert];
-
-			if (UseGpuSkinVerts)
-			{
-				// NOTE: Gears3 has some issues:
-				// - chunk may have FirstVertex set to incorrect value (for recent UE3 versions), which overlaps with the
-				//   previous chunk (FirstVertex=0 for a few chunks)
-				// - index count may be greater than sum of all face counts * 3 from all mesh sections -- this is verified in PSK exporter
-
-				// get vertex from GPU skin
-				const FGPUVert3Common *V;		// has normal and influences, but no UV[] and position
+			const FSkeletalMeshVertexBuffer3 &S = SrcLod.GPUSkin;
+			int NumGpuVerts = S.bUseFullPrecisionUVs
+				? (S.bUsePackedPosition ? S.VertsFloatPacked.Num() : S.VertsFloat.Num())
+				: (S.bUsePackedPosition ? S.VertsHalfPacked.Num() : S.VertsHalf.Num());
+			if (NumGpuVerts < VertexCount)
+				appError("LOD %d: wrong vertex count", lod);
+		}
 
-				if (!S.bUseFullPrecisionUVs)
-				{
-					// position
-					const FMeshUVHalf *SUV;
-					if (!S.bUsePackedPosition)
-					{
-						const FGPUVert3Half &V0 = S.VertsHalf[Vert];
-						D->Position = CVT(V0.Pos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedHalf &V0 = S.VertsHalfPacked[Vert];
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						V   = &V0;
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];			// convert half->float
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				else
-				{
-					// position
-					const FMeshUVFloat *SUV;
-					if (!S.bUsePackedPosition)
-					{
-						const FGPUVert3Float &V0 = S.VertsFloat[Vert];
-						V = &V0;
-						D->Position = CVT(V0.Pos);
-						SUV = V0.UV;
-					}
-					else
-					{
-						const FGPUVert3PackedFloat &V0 = S.VertsFloatPacked[Vert];
-						V = &V0;
-						FVector VPos;
-						VPos = V0.Pos.ToVector(S.MeshOrigin, S.MeshExtension);
-						D->Position = CVT(VPos);
-						SUV = V0.UV;
-					}
-					// UV
-					FMeshUVFloat fUV = SUV[0];
-					D->UV = CVT(fUV);
-					for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-					{
-						Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-					}
-				}
-				// convert Normal[3]
-				UnpackNormals(V->Normal, *D);
-				// convert influences
-				int i2 = 0;
-				unsigned PackedWeights = 0;
-				for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-				{
-					int BoneIndex  = V->BoneIndex[i];
-					byte BoneWeight = V->BoneWeight[i];
-					if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-					PackedWeights |= BoneWeight << (i2 * 8);
-					D->Bone[i2]   = C->Bones[BoneIndex];
-					i2++;
-				}
-				D->PackedWeights = PackedWeights;
-				if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
-			}
-			else
+		// split vertices into jobs; the next chunk is taken when vertex index reaches the end of current chunk
+		int Vert = 0;
+		int chunkIndex = 0;
+		while (Vert < VertexCount)
+		{
+			if (chunkIndex >= SrcLod.Chunks.Num())
+				appError("LOD %d: vertex %d doesn't belong to any chunk", lod, Vert);
+			const FSkelMeshChunk3 &C = SrcLod.Chunks[chunkIndex];
+			int lastChunkVertex = C.FirstVertex + C.NumRigidVerts + C.NumSoftVerts;
+			int EndVertex = bound(lastChunkVertex, Vert + 1, VertexCount);
+			for ( ; Vert < EndVertex; Vert += MESH_CONVERT_BLOCK_SIZE)
 			{
-				// old UE3 version without a GPU skin
-				// get vertex from chunk
-				const FMeshUVFloat *SUV;
-				if (Vert < C->FirstVertex + C->NumRigidVerts)
-				{
-					// rigid vertex
-					const FRigidVertex3 &V0 = C->RigidVerts[Vert - C->FirstVertex];
-					// position and normal
-					D->Position = CVT(V0.Pos);
-					UnpackNormals(V0.Normal, *D);
-					// single influence
-					D->PackedWeights = 0xFF;
-					D->Bone[0]   = C->Bones[V0.BoneIndex];
-					SUV = V0.UV;
-				}
-				else
-				{
-					// soft vertex
-					const FSoftVertex3 &V0 = C->SoftVerts[Vert - C->FirstVertex - C->NumRigidVerts];
-					// position and normal
-					D->Position = CVT(V0.Pos);
-					UnpackNormals(V0.Normal, *D);
-					// influences
-//					int TotalWeight = 0;
-					int i2 = 0;
-					unsigned PackedWeights = 0;
-					for (int i = 0; i < NUM_INFLUENCES_UE3; i++)
-					{
-						int BoneIndex  = V0.BoneIndex[i];
-						byte BoneWeight = V0.BoneWeight[i];
-						if (BoneWeight == 0) continue;
-						PackedWeights |= BoneWeight << (i2 * 8);
-						D->Bone[i2]   = C->Bones[BoneIndex];
-						i2++;
-//						TotalWeight += BoneWeight;
-					}
-					D->PackedWeights = PackedWeights;
-//					assert(TotalWeight == 255);
-					if (i2 < NUM_INFLUENCES_UE3) D->Bone[i2] = INDEX_NONE; // mark end of list
-					SUV = V0.UV;
-				}
-				// UV
-				FMeshUVFloat fUV = SUV[0];			// convert half->float
-				D->UV = CVT(fUV);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SUV[TexCoordIndex]);
-				}
+				CSkelVertexJob3* Job = new (Context.Jobs) CSkelVertexJob3;
+				Job->LodIndex = Mesh->Lods.Num() - 1;
+				Job->SrcLod = &SrcLod;
+				Job->ChunkIndex = chunkIndex;
+				Job->FirstVertex = Vert;
+				Job->NumVerts = min(MESH_CONVERT_BLOCK_SIZE, EndVertex - Vert);
+				Job->UseGpuSkinVerts = UseGpuSkinVerts;
 			}
+			Vert = EndVertex;
+			chunkIndex++;
 		}
 
-		if (NumReweightedVerts > 0)
-			appPrintf("LOD %d: adjusted weights for %d vertices\n", lod, NumReweightedVerts);
-
 		unguard;	// ProcessVerts
 
 		// indices
@@ -2298,6 +2466,11 @@ void USkeletalMesh3::ConvertMesh()
 		unguardf("lod=%d", lod); // ConvertLod
 	}
 
+	// convert vertices of all LODs
+	guard(ProcessVerts);
+	appParallelFor(Context.Jobs.Num(), ConvertSkelVerts3, Context);
+	unguard;
+
 	// copy skeleton
 	guard(ProcessSkeleton);
 	Mesh->RefSkeleton.Empty(RefSkeleton.Num());
@@ -3816,11 +3989,66 @@ done:
 	unguard;
 }
 
+struct CStaticVertexJob3
+{
+	int							LodIndex;
+	const FStaticMeshLODModel3*	SrcLod;
+	int							FirstVertex;
+	int							NumVerts;
+};
+
+struct CStaticVertexContext3
+{
+	CStaticMesh*				Mesh;
+	TArray<CStaticVertexJob3>	Jobs;
+};
+
+static void ConvertStaticVerts3(int JobIndex, CStaticVertexContext3& Context)
+{
+	guard(ConvertStaticVerts3);
+
+	const CStaticVertexJob3& Job = Context.Jobs[JobIndex];
+	const FStaticMeshLODModel3& SrcLod = *Job.SrcLod;
+	CStaticMeshLod* Lod = &Context.Mesh->Lods[Job.LodIndex];
+	int First = Job.FirstVertex;
+	int Count = Job.NumVerts;
+	CStaticMeshVertex* D = Lod->Verts + First;
+	const FStaticMeshUVItem3* SUV = &SrcLod.UVStream.UV[First];
+
+	const FVector* Pos = &SrcLod.VertexStream.Verts[First];
+	for (int i = 0; i < Count; i++)
+	{
+		D[i].Position = CVT(Pos[i]);
+	}
+	UnpackNormalsStream(D, sizeof(CStaticMeshVertex), SUV->Normal, sizeof(FStaticMeshUVItem3), Count);
+	// copy UV
+	for (int TexCoordIndex = 0; TexCoordIndex < Lod->NumTexCoords; TexCoordIndex++)
+	{
+		CMeshUVFloat* DstUV = TexCoordIndex ? Lod->ExtraUV[TexCoordIndex-1] + First : &D->UV;
+		int DstStride = TexCoordIndex ? sizeof(CMeshUVFloat) : sizeof(CStaticMeshVertex);
+		ConvertUVStream(DstUV, DstStride, &SUV->UV[TexCoordIndex], sizeof(FStaticMeshUVItem3), Count);
+	}
+	// vertex colors
+	if (SrcLod.ColorStream.Colors.Num() == Lod->NumVerts)
+	{
+		memcpy(Lod->VertexColors + First, &SrcLod.ColorStream.Colors[First], Count * sizeof(FColor));
+	}
+	else
+	{
+		for (int i = 0; i < Count; i++)
+			Lod->VertexColors[First + i] = SUV[i].Color;
+	}
+
+	unguardf("lod=%d", Context.Jobs[JobIndex].LodIndex);
+}
+
 // convert UStaticMesh3 to CStaticMesh
 void UStaticMesh3::ConvertMesh()
 {
 	guard(UStaticMesh3::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	CStaticMesh *Mesh = new CStaticMesh(this);
 	ConvertedMesh = Mesh;
 
@@ -3833,6 +4061,8 @@ void UStaticMesh3::ConvertMesh()
 	VectorAdd     (CVT(Bounds.Origin), CVT(Bounds.BoxExtent), CVT(Mesh->BoundingBox.Max));
 
 	// convert lods
+	CStaticVertexContext3 Context;
+	Context.Mesh = Mesh;
 	Mesh->Lods.Empty(Lods.Num());
 	for (int lod = 0; lod < Lods.Num(); lod++)
 	{
@@ -3875,31 +4105,36 @@ void UStaticMesh3::ConvertMesh()
 		// vertices
 		Lod->AllocateVerts(NumVerts);
 		Lod->AllocateVertexColorBuffer();
-		for (int i = 0; i < NumVerts; i++)
+		if (SrcLod.UVStream.UV.Num() < NumVerts)
+			appError("StaticMesh lod #%d has wrong vertex count", lod);
+		for (int i = 0; i < NumVerts; i += MESH_CONVERT_BLOCK_SIZE)
 		{
-			const FStaticMeshUVItem3 &SUV = SrcLod.UVStream.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
-
-			V.Position = CVT(SrcLod.VertexStream.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			if (SrcLod.ColorStream.Colors.Num() == NumVerts)
-				Lod->VertexColors[i] = SrcLod.ColorStream.Colors[i];
-			else
-				Lod->VertexColors[i] = SUV.Color;
+			CStaticVertexJob3* Job = new (Context.Jobs) CStaticVertexJob3;
+			Job->LodIndex = Mesh->Lods.Num() - 1;
+			Job->SrcLod = &SrcLod;
+			Job->FirstVertex = i;
+			Job->NumVerts = min(MESH_CONVERT_BLOCK_SIZE, NumVerts - i);
 		}
 
+		// indices
+		Lod->Indices.Initialize(&SrcLod.Indices.Indices);			// 16-bit only
+		if (Lod->Indices.Num() == 0) appNotify("This StaticMesh doesn't have an index buffer");
+
+		unguardf("lod=%d", lod);
+	}
+
+	// convert vertices of all LODs
+	guard(ProcessVerts);
+	appParallelFor(Context.Jobs.Num(), ConvertStaticVerts3, Context);
+	unguard;
+
+	for (int lod = 0; lod < Mesh->Lods.Num(); lod++)
+	{
 		// Remove vertex colors if they're filled with white color
+		CStaticMeshLod* Lod = &Mesh->Lods[lod];
 		bool bAllWhite = true;
 		bool bAllBlack = true;
-		for (int i = 0; i < NumVerts; i++)
+		for (int i = 0; i < Lod->NumVerts; i++)
 		{
 			const FColor& c = Lod->VertexColors[i];
 			uint32 ci = *(uint32*) &c;
@@ -3917,12 +4152,6 @@ void UStaticMesh3::ConvertMesh()
 			appFree(Lod->VertexColors);
 			Lod->VertexColors = NULL;
 		}
-
-		// indices
-		Lod->Indices.Initialize(&SrcLod.Indices.Indices);			// 16-bit only
-		if (Lod->Indices.Num() == 0) appNotify("This StaticMesh doesn't have an index buffer");
-
-		unguardf("lod=%d", lod);
 	}
 
 	Mesh->FinalizeMesh();
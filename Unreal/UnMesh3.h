@@ -705,6 +705,7 @@ public:
 	END_PROP_TABLE
 
 	void ConvertAnims();
+	void DecodeSequence(const UAnimSequence *Seq, CAnimSequence *Dst, int offsetsPerBone, TArray<FString>& Warnings);
 	virtual void Serialize(FArchive &Ar);
 
 	virtual void PostLoad()
@@ -11,6 +11,8 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "Profiler.h"
+#include "Parallel.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -1627,10 +1629,103 @@ void USkeletalMesh4::PostLoad()
 	unguard;
 }
 
+// Part of LOD's vertices which belongs to a single chunk (section)
+struct CSkelVertexJob4
+{
+	int							LodIndex;
+	const FStaticLODModel4*		SrcLod;
+	int							ChunkIndex;
+	int							FirstVertex;
+	int							NumVerts;
+	int							ChunkVertexIndex;		// index of FirstVertex in section's SoftVertices
+	bool						bUseVerticesFromSections;
+};
+
+struct CSkelVertexContext4
+{
+	CSkeletalMesh*				Mesh;
+	TArray<CSkelVertexJob4>		Jobs;
+};
+
+static void ConvertSkelVerts4(int JobIndex, CSkelVertexContext4& Context)
+{
+	guard(ConvertSkelVerts4);
+
+	const CSkelVertexJob4& Job = Context.Jobs[JobIndex];
+	const FStaticLODModel4& SrcLod = *Job.SrcLod;
+	CSkelMeshLod* Lod = &Context.Mesh->Lods[Job.LodIndex];
+	const FSkeletalMeshVertexBuffer4& VertBuffer = SrcLod.VertexBufferGPUSkin;
+	int First = Job.FirstVertex;
+	int Count = Job.NumVerts;
+	CSkelMeshVertex* D = Lod->Verts + First;
+
+	const TArray<uint16>& BoneMap = SrcLod.Chunks.Num() ? SrcLod.Chunks[Job.ChunkIndex].BoneMap : SrcLod.Sections[Job.ChunkIndex].BoneMap;
+
+	// get vertex source
+	const FSkelMeshVertexBase* V;				// has everything but UV[]
+	const FMeshUVFloat* SrcUV = NULL;
+	const FMeshUVHalf* SrcUVHalf = NULL;
+	int Stride;
+	if (Job.bUseVerticesFromSections)
+	{
+		const TArray<FSoftVertex4>& SoftVertices = SrcLod.Sections[Job.ChunkIndex].SoftVertices;
+		if (Job.ChunkVertexIndex + Count > SoftVertices.Num())
+			appError("Section %d has %d vertices", Job.ChunkIndex, SoftVertices.Num());
+		const FSoftVertex4* V0 = &SoftVertices[Job.ChunkVertexIndex];
+		V = V0;
+		SrcUV = V0->UV;
+		Stride = sizeof(FSoftVertex4);
+	}
+	else if (!VertBuffer.bUseFullPrecisionUVs)
+	{
+		const FGPUVert4Half* V0 = &VertBuffer.VertsHalf[First];
+		V = V0;
+		SrcUVHalf = V0->UV;
+		Stride = sizeof(FGPUVert4Half);
+	}
+	else
+	{
+		const FGPUVert4Float* V0 = &VertBuffer.VertsFloat[First];
+		V = V0;
+		SrcUV = V0->UV;
+		Stride = sizeof(FGPUVert4Float);
+	}
+
+	// UV: copy float data or convert half -> float
+	for (int TexCoordIndex = 0; TexCoordIndex < Lod->NumTexCoords; TexCoordIndex++)
+	{
+		CMeshUVFloat* DstUV = TexCoordIndex ? Lod->ExtraUV[TexCoordIndex-1] + First : &D->UV;
+		int DstStride = TexCoordIndex ? sizeof(CMeshUVFloat) : sizeof(CSkelMeshVertex);
+		if (SrcUVHalf)
+			ConvertUVStream(DstUV, DstStride, SrcUVHalf + TexCoordIndex, Stride, Count);
+		else
+			ConvertUVStream(DstUV, DstStride, SrcUV + TexCoordIndex, Stride, Count);
+	}
+
+	// positions
+	const byte* Src = (const byte*)V;
+	for (int i = 0; i < Count; i++, Src += Stride)
+	{
+		D[i].Position = CVT(((const FSkelMeshVertexBase*)Src)->Pos);
+	}
+	UnpackNormalsStream(D, sizeof(CSkelMeshVertex), V->Normal, Stride, Count);
+	if (Lod->VertexColors)
+	{
+		//todo: check if this will work with "source" models - FSoftVertex4 has Color field
+		memcpy(Lod->VertexColors + First, &SrcLod.ColorVertexBuffer.Data[First], Count * sizeof(FColor));
+	}
+	// convert influences
+	PackInfluencesStream(D, V->Infs.BoneIndex, V->Infs.BoneWeight, Stride, BoneMap.GetData(), BoneMap.Num(), Count);
+
+	unguardf("lod=%d", Context.Jobs[JobIndex].LodIndex);
+}
+
 void USkeletalMesh4::ConvertMesh()
 {
 	guard(USkeletalMesh4::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	CSkeletalMesh *Mesh = new CSkeletalMesh(this);
 	ConvertedMesh = Mesh;
 
@@ -1647,6 +1742,8 @@ void USkeletalMesh4::ConvertMesh()
 	Mesh->MeshScale.Set(1, 1, 1);							// missing in UE4
 
 	// convert LODs
+	CSkelVertexContext4 Context;
+	Context.Mesh = Mesh;
 	Mesh->Lods.Empty(LODModels.Num());
 	assert(LODModels.Num() == LODInfo.Num());
 	for (int lod = 0; lod < LODModels.Num(); lod++)
@@ -1689,102 +1786,50 @@ void USkeletalMesh4::ConvertMesh()
 		// allocate the vertices
 		Lod->AllocateVerts(VertexCount);
 
-		int chunkIndex = -1;
-		int lastChunkVertex = -1;
-		int chunkVertexIndex = 0;
-
-		const TArray<uint16>* BoneMap = NULL;
-		const FSkeletalMeshVertexBuffer4& VertBuffer = SrcLod.VertexBufferGPUSkin;
-		CSkelMeshVertex* D = Lod->Verts;
-
 		if (SrcLod.ColorVertexBuffer.Data.Num() == VertexCount)
 			Lod->AllocateVertexColorBuffer();
 		else if (SrcLod.ColorVertexBuffer.Data.Num())
 			appPrintf("LOD %d has invalid vertex color stream\n", lod);
 
-		for (int Vert = 0; Vert < VertexCount; Vert++, D++)
-		{
-			while (Vert >= lastChunkVertex) // this will fix any issues with empty chunks or sections
-			{
-				// proceed to next chunk or section
-				if (SrcLod.Chunks.Num())
-				{
-					// pre-UE4.13 code: chunks
-					const FSkelMeshChunk4& C = SrcLod.Chunks[++chunkIndex];
-					lastChunkVertex = C.BaseVertexIndex + C.NumRigidVertices + C.NumSoftVertices;
-					BoneMap = &C.BoneMap;
-				}
-				else
-				{
-					// UE4.13+ code: chunk information migrated to sections
-					const FSkelMeshSection4& S = SrcLod.Sections[++chunkIndex];
-					lastChunkVertex = S.BaseVertexIndex + S.NumVertices;
-					BoneMap = &S.BoneMap;
-				}
-				chunkVertexIndex = 0;
-			}
-
-			// get vertex from GPU skin
-			const FSkelMeshVertexBase *V;				// has everything but UV[]
+		const FSkeletalMeshVertexBuffer4& VertBuffer = SrcLod.VertexBufferGPUSkin;
+		if (!bUseVerticesFromSections && VertBuffer.GetVertexCount() > (VertBuffer.bUseFullPrecisionUVs ? VertBuffer.VertsFloat.Num() : VertBuffer.VertsHalf.Num()))
+			appError("LOD %d: wrong vertex count", lod);
 
-			if (bUseVerticesFromSections)
-			{
-				const FSoftVertex4& V0 = SrcLod.Sections[chunkIndex].SoftVertices[chunkVertexIndex++];
-				const FMeshUVFloat *SrcUV = V0.UV;
-				V = &V0;
-				// UV: simply copy float data
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
-			}
-			else if (!VertBuffer.bUseFullPrecisionUVs)
+		// split vertices into jobs; chunk (section) vertices follow each other, but some chunks could be empty
+		int NumChunks = SrcLod.Chunks.Num() ? SrcLod.Chunks.Num() : SrcLod.Sections.Num();
+		int Vert = 0;
+		for (int chunkIndex = 0; chunkIndex < NumChunks && Vert < VertexCount; chunkIndex++)
+		{
+			int lastChunkVertex;
+			if (SrcLod.Chunks.Num())
 			{
-				const FGPUVert4Half& V0 = VertBuffer.VertsHalf[Vert];
-				const FMeshUVHalf* SrcUV = V0.UV;
-				V = &V0;
-				// UV: convert half -> float
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
+				// pre-UE4.13 code: chunks
+				const FSkelMeshChunk4& C = SrcLod.Chunks[chunkIndex];
+				lastChunkVertex = C.BaseVertexIndex + C.NumRigidVertices + C.NumSoftVertices;
 			}
 			else
 			{
-				const FGPUVert4Float& V0 = VertBuffer.VertsFloat[Vert];
-				const FMeshUVFloat *SrcUV = V0.UV;
-				V = &V0;
-				// UV: simply copy float data
-				D->UV = CVT(SrcUV[0]);
-				for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-				{
-					Lod->ExtraUV[TexCoordIndex-1][Vert] = CVT(SrcUV[TexCoordIndex]);
-				}
-			}
-			D->Position = CVT(V->Pos);
-			UnpackNormals(V->Normal, *D);
-			if (Lod->VertexColors)
-			{
-				//todo: check if this will work with "source" models - FSoftVertex4 has Color field
-				Lod->VertexColors[Vert] = SrcLod.ColorVertexBuffer.Data[Vert];
+				// UE4.13+ code: chunk information migrated to sections
+				const FSkelMeshSection4& S = SrcLod.Sections[chunkIndex];
+				lastChunkVertex = S.BaseVertexIndex + S.NumVertices;
 			}
-			// convert influences
-			int i2 = 0;
-			unsigned PackedWeights = 0;
-			for (int i = 0; i < NUM_INFLUENCES_UE4; i++)
+			int FirstChunkVertex = Vert;
+			int EndVertex = min(lastChunkVertex, VertexCount);
+			for ( ; Vert < EndVertex; Vert += MESH_CONVERT_BLOCK_SIZE)
 			{
-				int BoneIndex  = V->Infs.BoneIndex[i];
-				byte BoneWeight = V->Infs.BoneWeight[i];
-				if (BoneWeight == 0) continue;				// skip this influence (but do not stop the loop!)
-				PackedWeights |= BoneWeight << (i2 * 8);
-				D->Bone[i2]   = (*BoneMap)[BoneIndex];
-				i2++;
+				CSkelVertexJob4* Job = new (Context.Jobs) CSkelVertexJob4;
+				Job->LodIndex = Mesh->Lods.Num() - 1;
+				Job->SrcLod = &SrcLod;
+				Job->ChunkIndex = chunkIndex;
+				Job->FirstVertex = Vert;
+				Job->NumVerts = min(MESH_CONVERT_BLOCK_SIZE, EndVertex - Vert);
+				Job->ChunkVertexIndex = Vert - FirstChunkVertex;
+				Job->bUseVerticesFromSections = bUseVerticesFromSections;
 			}
-			D->PackedWeights = PackedWeights;
-			if (i2 < NUM_INFLUENCES_UE4) D->Bone[i2] = INDEX_NONE; // mark end of list
+			Vert = max(Vert, EndVertex);
 		}
+		if (Vert < VertexCount)
+			appError("LOD %d: vertex %d doesn't belong to any section", lod, Vert);
 
 		unguard;	// ProcessVerts
 
@@ -1818,6 +1863,11 @@ void USkeletalMesh4::ConvertMesh()
 		unguardf("lod=%d", lod); // ConvertLod
 	}
 
+	// convert vertices of all LODs
+	guard(ProcessVerts);
+	appParallelFor(Context.Jobs.Num(), ConvertSkelVerts4, Context);
+	unguard;
+
 	// copy skeleton
 	guard(ProcessSkeleton);
 	int NumBones = RefSkeleton.RefBoneInfo.Num();
@@ -2548,10 +2598,59 @@ no_nav_collision:
 }
 
 
+struct CStaticVertexJob4
+{
+	int							LodIndex;
+	const FStaticMeshLODModel4*	SrcLod;
+	int							FirstVertex;
+	int							NumVerts;
+};
+
+struct CStaticVertexContext4
+{
+	CStaticMesh*				Mesh;
+	TArray<CStaticVertexJob4>	Jobs;
+};
+
+static void ConvertStaticVerts4(int JobIndex, CStaticVertexContext4& Context)
+{
+	guard(ConvertStaticVerts4);
+
+	const CStaticVertexJob4& Job = Context.Jobs[JobIndex];
+	const FStaticMeshLODModel4& SrcLod = *Job.SrcLod;
+	CStaticMeshLod* Lod = &Context.Mesh->Lods[Job.LodIndex];
+	int First = Job.FirstVertex;
+	int Count = Job.NumVerts;
+	CStaticMeshVertex* D = Lod->Verts + First;
+	const FStaticMeshUVItem4* SUV = &SrcLod.VertexBuffer.UV[First];
+
+	const FVector* Pos = &SrcLod.PositionVertexBuffer.Verts[First];
+	for (int i = 0; i < Count; i++)
+	{
+		D[i].Position = CVT(Pos[i]);
+	}
+	UnpackNormalsStream(D, sizeof(CStaticMeshVertex), SUV->Normal, sizeof(FStaticMeshUVItem4), Count);
+	// copy UV
+	for (int TexCoordIndex = 0; TexCoordIndex < Lod->NumTexCoords; TexCoordIndex++)
+	{
+		CMeshUVFloat* DstUV = TexCoordIndex ? Lod->ExtraUV[TexCoordIndex-1] + First : &D->UV;
+		int DstStride = TexCoordIndex ? sizeof(CMeshUVFloat) : sizeof(CStaticMeshVertex);
+		ConvertUVStream(DstUV, DstStride, &SUV->UV[TexCoordIndex], sizeof(FStaticMeshUVItem4), Count);
+	}
+	if (Lod->VertexColors)
+	{
+		memcpy(Lod->VertexColors + First, &SrcLod.ColorVertexBuffer.Data[First], Count * sizeof(FColor));
+	}
+
+	unguardf("lod=%d", Context.Jobs[JobIndex].LodIndex);
+}
+
 void UStaticMesh4::ConvertMesh()
 {
 	guard(UStaticMesh4::ConvertMesh);
 
+	PROFILE_SCOPE("ConvertMesh");
+
 	CStaticMesh *Mesh = new CStaticMesh(this);
 	ConvertedMesh = Mesh;
 
@@ -2561,6 +2660,8 @@ void UStaticMesh4::ConvertMesh()
 	VectorAdd     (CVT(Bounds.Origin), CVT(Bounds.BoxExtent), CVT(Mesh->BoundingBox.Max));
 
 	// convert lods
+	CStaticVertexContext4 Context;
+	Context.Mesh = Mesh;
 	Mesh->Lods.Empty(Lods.Num());
 	for (int lodIndex = 0; lodIndex < Lods.Num(); lodIndex++)
 	{
@@ -2604,25 +2705,15 @@ void UStaticMesh4::ConvertMesh()
 		if (SrcLod.ColorVertexBuffer.NumVertices)
 			Lod->AllocateVertexColorBuffer();
 
-		for (int i = 0; i < NumVerts; i++)
+		if (SrcLod.VertexBuffer.UV.Num() < NumVerts || (Lod->VertexColors && SrcLod.ColorVertexBuffer.Data.Num() < NumVerts))
+			appError("Lod #%d has wrong vertex count", lodIndex);
+		for (int i = 0; i < NumVerts; i += MESH_CONVERT_BLOCK_SIZE)
 		{
-			const FStaticMeshUVItem4 &SUV = SrcLod.VertexBuffer.UV[i];
-			CStaticMeshVertex &V = Lod->Verts[i];
-
-			V.Position = CVT(SrcLod.PositionVertexBuffer.Verts[i]);
-			UnpackNormals(SUV.Normal, V);
-			// copy UV
-			const FMeshUVFloat* fUV = &SUV.UV[0];
-			V.UV = *CVT(fUV);
-			for (int TexCoordIndex = 1; TexCoordIndex < NumTexCoords; TexCoordIndex++)
-			{
-				fUV++;
-				Lod->ExtraUV[TexCoordIndex-1][i] = *CVT(fUV);
-			}
-			if (Lod->VertexColors)
-			{
-				Lod->VertexColors[i] = SrcLod.ColorVertexBuffer.Data[i];
-			}
+			CStaticVertexJob4* Job = new (Context.Jobs) CStaticVertexJob4;
+			Job->LodIndex = Mesh->Lods.Num() - 1;
+			Job->SrcLod = &SrcLod;
+			Job->FirstVertex = i;
+			Job->NumVerts = min(MESH_CONVERT_BLOCK_SIZE, NumVerts - i);
 		}
 
 		// indices
@@ -2632,6 +2723,11 @@ void UStaticMesh4::ConvertMesh()
 		unguardf("lod=%d", lodIndex);
 	}
 
+	// convert vertices of all LODs
+	guard(ProcessVerts);
+	appParallelFor(Context.Jobs.Num(), ConvertStaticVerts4, Context);
+	unguard;
+
 	Mesh->FinalizeMesh();
 
 	unguard;
@@ -178,10 +178,16 @@ public:
 	TArray<UAnimSequence4*>	OriginalAnims;
 	CAnimSet*				ConvertedAnim;
 
+	// sequences waiting for decoding in PostLoadBatch()
+	TArray<UAnimSequence4*>	PendingAnims;
+	TArray<CAnimSequence*>	PendingSequences;
+
 	virtual void Serialize(FArchive &Ar);
 	virtual void PostLoad();
+	virtual void PostLoadBatch();
 
 	void ConvertAnims(UAnimSequence4* Seq);
+	void DecodeSequence(const UAnimSequence4* Seq, CAnimSequence* Dst);
 };
 
 
@@ -627,6 +633,7 @@ public:
 	int GetNumTracks() const;
 	int GetTrackBoneIndex(int TrackIndex) const;
 	int FindTrackForBoneIndex(int BoneIndex) const;
+	void ReleaseAnimData();
 	void TransferPerTrackData(TArray<uint8>& Dst, const TArray<uint8>& Src);
 };
 
@@ -2,6 +2,7 @@
 #include "UnCore.h"
 #include "UnObject.h"
 #include "UnPackage.h"
+#include "Profiler.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
 
@@ -133,6 +134,7 @@ int UObject::GetLicenseeVer() const
 int              UObject::GObjBeginLoadCount = 0;
 TArray<UObject*> UObject::GObjLoaded;
 TArray<UObject*> UObject::GObjObjects;
+TArray<UObject*> UObject::GObjPostLoadBatch;
 UObject         *UObject::GLoadingObj = NULL;
 
 
@@ -143,6 +145,115 @@ void UObject::BeginLoad()
 }
 
 
+static int GetObjectSerialOffset(const UObject* Obj)
+{
+	const UnPackage* Package = Obj->Package;
+	if (!Package || Obj->PackageIndex < 0 || Obj->PackageIndex >= Package->Summary.ExportCount)
+		return -1;
+	return Package->ExportTable[Obj->PackageIndex].SerialOffset;
+}
+
+void SortObjectsByLocation(TArray<UObject*>& Objects)
+{
+	guard(SortObjectsByLocation);
+
+	Objects.Sort([](UObject* const& A, UObject* const& B) -> int
+		{
+			if (A->Package != B->Package)
+			{
+				if (!A->Package) return -1;
+				if (!B->Package) return 1;
+				return stricmp(A->Package->Filename, B->Package->Filename);
+			}
+			int OffsetA = GetObjectSerialOffset(A);
+			int OffsetB = GetObjectSerialOffset(B);
+			if (OffsetA != OffsetB)
+				return OffsetA < OffsetB ? -1 : 1;
+			return A->PackageIndex - B->PackageIndex;
+		});
+
+	unguard;
+}
+
+
+bool GCollectLoadStats = false;
+TArray<CObjectLoadStats> GClassLoadStats;
+TArray<CObjectLoadStats> GPackageLoadStats;
+
+// Find statistics entries for object's class and package, create them if not found
+static void FindLoadStats(const UObject* Obj, CObjectLoadStats* Stats[2])
+{
+	guard(FindLoadStats);
+
+	// Class names are stored in typeinfo and package names are pooled strings,
+	// so it is enough to compare pointers.
+	const char* ClassName = Obj->GetClassName();
+	CObjectLoadStats* ClassStats = NULL;
+	for (int i = 0; i < GClassLoadStats.Num(); i++)
+	{
+		if (GClassLoadStats[i].Name == ClassName)
+		{
+			ClassStats = &GClassLoadStats[i];
+			break;
+		}
+	}
+	if (!ClassStats)
+		ClassStats = new (GClassLoadStats) CObjectLoadStats(ClassName);
+
+	// Objects are loaded package by package, so look for the package starting from the end of list
+	const char* PackageName = Obj->Package->Filename;
+	CObjectLoadStats* PackageStats = NULL;
+	for (int i = GPackageLoadStats.Num() - 1; i >= 0; i--)
+	{
+		if (GPackageLoadStats[i].Name == PackageName)
+		{
+			PackageStats = &GPackageLoadStats[i];
+			break;
+		}
+	}
+	if (!PackageStats)
+	{
+		// There could be a lot of packages, grow the array exponentially
+		if (GPackageLoadStats.Num() == GPackageLoadStats.Max())
+			GPackageLoadStats.Reserve(GPackageLoadStats.Max() * 2);
+		PackageStats = new (GPackageLoadStats) CObjectLoadStats(PackageName);
+	}
+
+	Stats[0] = ClassStats;
+	Stats[1] = PackageStats;
+
+	unguard;
+}
+
+// Call PostLoad() or PostLoadBatch() of the object, with collecting statistics
+static void PostLoadObject(UObject* Obj, bool bBatch)
+{
+	if (!GCollectLoadStats)
+	{
+		if (bBatch)
+			Obj->PostLoadBatch();
+		else
+			Obj->PostLoad();
+		return;
+	}
+	int64 StatTime = appCycles64();
+	size_t StatMemory = GTotalAllocationSize;
+	int StatBlocks = GTotalAllocationCount;
+	if (bBatch)
+		Obj->PostLoadBatch();
+	else
+		Obj->PostLoad();
+	StatTime = appCycles64() - StatTime;
+	CObjectLoadStats* Stats[2];
+	FindLoadStats(Obj, Stats);
+	for (int j = 0; j < 2; j++)
+	{
+		Stats[j]->PostLoadTime += StatTime;
+		Stats[j]->MemoryBytes  += (int64)GTotalAllocationSize - (int64)StatMemory;
+		Stats[j]->MemoryBlocks += GTotalAllocationCount - StatBlocks;
+	}
+}
+
 void UObject::EndLoad()
 {
 	assert(GObjBeginLoadCount > 0);
@@ -155,13 +266,23 @@ void UObject::EndLoad()
 	guard(UObject::EndLoad);
 
 	// process GObjLoaded array
-	// NOTE: while loading one array element, array may grow!
+	// NOTE: while loading one array element, array may grow! Objects are serialized in passes:
+	// every pass takes all queued objects sorted by package and file offset, so package files
+	// are read sequentially. Objects created during a pass are serialized in the next one.
 	TArray<UObject*> LoadedObjects;
-	while (GObjLoaded.Num())
+	TArray<UObject*> PassObjects;
+	int PassIndex = 0;
+	while (true)
 	{
-		UObject *Obj = GObjLoaded[0];
-		GObjLoaded.RemoveAt(0);
-		//!! should sort by packages + package offset
+		if (PassIndex >= PassObjects.Num())
+		{
+			if (!GObjLoaded.Num()) break;
+			CopyArray(PassObjects, GObjLoaded);
+			GObjLoaded.Empty();
+			SortObjectsByLocation(PassObjects);
+			PassIndex = 0;
+		}
+		UObject *Obj = PassObjects[PassIndex++];
 		UnPackage *Package = Obj->Package;
 		guard(LoadObject);
 		Package->SetupReader(Obj->PackageIndex);
@@ -172,7 +293,37 @@ void UObject::EndLoad()
 		appResetProfiler();
 #endif
 		GLoadingObj = Obj;
-		Obj->Serialize(*Package);
+		int64 StatTime = 0, StatFileBytes = 0;
+		size_t StatMemory = 0;
+		int StatBlocks = 0;
+		if (GCollectLoadStats)
+		{
+			StatFileBytes = GFileBytesRead;
+			StatMemory = GTotalAllocationSize;
+			StatBlocks = GTotalAllocationCount;
+			StatTime = appCycles64();
+		}
+		{
+			PROFILE_SCOPE("Serialize");
+			Obj->Serialize(*Package);
+		}
+		if (GCollectLoadStats)
+		{
+			StatTime = appCycles64() - StatTime;
+			const FObjectExport& Exp = Package->GetExport(Obj->PackageIndex);
+			CObjectLoadStats* Stats[2];
+			FindLoadStats(Obj, Stats);
+			for (int j = 0; j < 2; j++)
+			{
+				CObjectLoadStats* S = Stats[j];
+				S->Count++;
+				S->SerializeTime += StatTime;
+				S->SerialBytes   += Exp.SerialSize;
+				S->FileBytes     += GFileBytesRead - StatFileBytes;
+				S->MemoryBytes   += (int64)GTotalAllocationSize - (int64)StatMemory;
+				S->MemoryBlocks  += GTotalAllocationCount - StatBlocks;
+			}
+		}
 		GLoadingObj = NULL;
 #if PROFILE_LOADING
 		appPrintProfiler();
@@ -197,10 +348,27 @@ void UObject::EndLoad()
 	}
 	// postload objects
 	int i;
-	guard(PostLoad);
-	for (i = 0; i < LoadedObjects.Num(); i++)
-		LoadedObjects[i]->PostLoad();
-	unguardf("%s", LoadedObjects[i]->Name);
+	TRY
+	{
+		guard(PostLoad);
+		PROFILE_SCOPE("PostLoad");
+		for (i = 0; i < LoadedObjects.Num(); i++)
+			PostLoadObject(LoadedObjects[i], false);
+		unguardf("%s", LoadedObjects[i]->Name);
+		// process work queued by PostLoad() calls, it could be done in parallel for many objects
+		guard(PostLoadBatch);
+		PROFILE_SCOPE("PostLoadBatch");
+		for (i = 0; i < GObjPostLoadBatch.Num(); i++)
+			PostLoadObject(GObjPostLoadBatch[i], true);
+		unguardf("%s", GObjPostLoadBatch[i]->Name);
+	}
+	CATCH
+	{
+		// don't leave queued work for the next EndLoad() call
+		GObjPostLoadBatch.Empty();
+		THROW_AGAIN;
+	}
+	GObjPostLoadBatch.Empty();
 	// cleanup
 	guard(Cleanup);
 	GObjLoaded.Empty();
@@ -29,6 +29,8 @@ public:
 	virtual void Serialize(FArchive &Ar);
 	virtual void PostLoad()			// called after serializing all objects
 	{}
+	virtual void PostLoadBatch()	// called after PostLoad() of all objects, when object was added to GObjPostLoadBatch
+	{}
 
 	// RTTI support
 	inline bool IsA(const char *ClassName) const
@@ -60,6 +62,7 @@ public:
 	static int				GObjBeginLoadCount;
 	static TArray<UObject*>	GObjLoaded;
 	static TArray<UObject*> GObjObjects;
+	static TArray<UObject*> GObjPostLoadBatch;
 	static UObject			*GLoadingObj;
 
 	static void BeginLoad();
@@ -89,4 +92,39 @@ public:
 UObject *CreateClass(const char *Name);
 void RegisterCoreClasses();
 
+// Sort objects by package and by position of object's data in package file
+void SortObjectsByLocation(TArray<UObject*>& Objects);
+
+
+/*-----------------------------------------------------------------------------
+	Load statistics
+-----------------------------------------------------------------------------*/
+
+// Statistics of object loading, collected by UObject::EndLoad() for every class
+// and every package when GCollectLoadStats is set
+struct CObjectLoadStats
+{
+	const char*	Name;			// class or package name
+	int			Count;			// number of loaded objects
+	int64		SerializeTime;	// time of Serialize() calls, in appCycles64() units
+	int64		PostLoadTime;	// time of PostLoad() calls
+	int64		SerialBytes;	// size of object data in package
+	int64		FileBytes;		// number of bytes read from disk, includes bulk data
+	int64		MemoryBytes;	// amount of memory allocated by objects
+	int			MemoryBlocks;	// number of memory blocks allocated by objects
+
+	CObjectLoadStats()
+	{}
+
+	CObjectLoadStats(const char* name)
+	{
+		memset(this, 0, sizeof(*this));
+		Name = name;
+	}
+};
+
+extern bool GCollectLoadStats;
+extern TArray<CObjectLoadStats> GClassLoadStats;
+extern TArray<CObjectLoadStats> GPackageLoadStats;
+
 #endif // __UNOBJECT_H__
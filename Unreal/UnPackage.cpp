@@ -4,8 +4,10 @@
 #include "UnObject.h"
 #include "UnPackage.h"
 #include "UnPackageUE3Reader.h"
+#include "Profiler.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
+#include "GameFileSystem.h"		// for file cache
 
 byte GForceCompMethod = 0;		// COMPRESS_...
 
@@ -1290,11 +1292,86 @@ void FObjectImport::Serialize(FArchive& Ar)
 	Package loading (creation) / unloading
 -----------------------------------------------------------------------------*/
 
+// Find file archive inside a package loader
+static FFileArchive* FindFileArchive(FArchive* Ar)
+{
+#if UNREAL3
+	FUE3ArchiveReader* ArUE3 = Ar->CastTo<FUE3ArchiveReader>();
+	if (ArUE3) Ar = ArUE3->Reader;
+#endif
+
+	FReaderWrapper* ArWrap = Ar->CastTo<FReaderWrapper>();
+	if (ArWrap) Ar = ArWrap->Reader;
+
+	return Ar->CastTo<FFileArchive>();
+}
+
+// Find a reader which waits for object data access to put the file to the file cache
+static FDeferredCacheReader* FindDeferredCacheReader(FArchive* Ar)
+{
+	while (Ar)
+	{
+		FDeferredCacheReader* ArCache = Ar->CastTo<FDeferredCacheReader>();
+		if (ArCache) return ArCache;
+#if UNREAL3
+		FUE3ArchiveReader* ArUE3 = Ar->CastTo<FUE3ArchiveReader>();
+		if (ArUE3)
+		{
+			Ar = ArUE3->Reader;
+			continue;
+		}
+#endif
+		FReaderWrapper* ArWrap = Ar->CastTo<FReaderWrapper>();
+		Ar = ArWrap ? ArWrap->Reader : NULL;
+	}
+	return NULL;
+}
+
+#if UNREAL3
+
+// Replace reader of compressed UE3 package with a reader of its decompressed copy
+// stored in the file cache. Data is stored in the cache when object data is read first time.
+static FArchive* GetCachedLoader(FArchive* Loader)
+{
+	guard(GetCachedLoader);
+
+	FUE3ArchiveReader* UE3Loader = Loader->CastTo<FUE3ArchiveReader>();
+	if (!UE3Loader || UE3Loader->PositionOffset) return Loader;
+	// Could cache only packages stored in OS file system, pak files are cached by CGameFileInfo::CreateReader()
+	FFileArchive* File = FindFileArchive(Loader);
+	if (!File) return Loader;
+
+	char Suffix[64];
+	appSprintf(ARRAY_ARG(Suffix), "ue3,flags=%X,full=%d", UE3Loader->CompressionFlags, UE3Loader->IsFullyCompressed);
+	FString Key;
+	if (!appMakeFileCacheKey(File->GetFilename(), Suffix, Key)) return Loader;
+
+	FArchive* CachedLoader = appOpenCachedFile(*Key, true);
+	if (CachedLoader)
+	{
+		CachedLoader->SetupFrom(*Loader);
+		delete Loader;
+	}
+	else
+	{
+		// Source loader will be owned by the new reader
+		CachedLoader = new FDeferredCacheReader(Loader, *Key, true);
+		CachedLoader->SetupFrom(*Loader);
+	}
+	return CachedLoader;
+
+	unguard;
+}
+
+#endif // UNREAL3
+
 UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 :	Loader(NULL)
 {
 	guard(UnPackage::UnPackage);
 
+	PROFILE_SCOPE("OpenPackage");
+
 #if PROFILE_PACKAGE_TABLES
 	appResetProfiler();
 #endif
@@ -1361,6 +1438,8 @@ UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 		// replace Loader with special reader for compressed UE3 archives
 		Loader = new FUE3ArchiveReader(Loader, Summary.CompressionFlags, Summary.CompressedChunks);
 	}
+	if (appFileCacheEnabled())
+		Loader = GetCachedLoader(Loader);
 #endif // UNREAL3
 
 	LoadNameTable();
@@ -1407,7 +1486,7 @@ no_depends: ;
 		if (expInfo)
 		{
 			// Open .exp file
-			FArchive* expLoader = expInfo->CreateReader();
+			FArchive* expLoader = expInfo->CreateReader(true);
 			// Replace loader with this file, but add offset so it will work like it is part of original uasset
 			delete Loader;
 			Loader = new FReaderWrapper(expLoader, -Summary.HeadersSize);
@@ -1829,29 +1908,11 @@ UnPackage::~UnPackage()
 	}
 }
 
-
-#if 0
-// Commented, not used
-// Find file archive inside a package loader
-static FFileArchive* FindFileArchive(FArchive* Ar)
-{
-#if UNREAL3
-	FUE3ArchiveReader* ArUE3 = Ar->CastTo<FUE3ArchiveReader>();
-	if (ArUE3) Ar = ArUE3->Reader;
-#endif
-
-	FReaderWrapper* ArWrap = Ar->CastTo<FReaderWrapper>();
-	if (ArWrap) Ar = ArWrap->Reader;
-
-	return Ar->CastTo<FFileArchive>();
-}
-#endif
-
 static TArray<UnPackage*> OpenReaders;
 
-void UnPackage::SetupReader(int ExportIndex)
+void UnPackage::OpenReader()
 {
-	guard(UnPackage::SetupReader);
+	guard(UnPackage::OpenReader);
 	// open loader if it is closed
 	if (!IsOpen())
 	{
@@ -1862,6 +1923,19 @@ void UnPackage::SetupReader(int ExportIndex)
 		}
 		OpenReaders.AddUnique(this);
 	}
+	unguard;
+}
+
+void UnPackage::SetupReader(int ExportIndex)
+{
+	guard(UnPackage::SetupReader);
+	OpenReader();
+	// Object data is accessed, so put the package to the file cache if it was postponed
+	if (appFileCacheEnabled())
+	{
+		FDeferredCacheReader* CacheReader = FindDeferredCacheReader(Loader);
+		if (CacheReader) CacheReader->StartCaching();
+	}
 	// setup for object
 	const FObjectExport &Exp = GetExport(ExportIndex);
 	SetStopper(Exp.SerialOffset + Exp.SerialSize);
@@ -2444,7 +2518,7 @@ TArray<char*>		MissingPackages;
 		if (info->Package)
 			return info->Package;
 		// Load the package.
-		UnPackage* package = new UnPackage(*info->GetRelativeName(), info->CreateReader(), silent);
+		UnPackage* package = new UnPackage(*info->GetRelativeName(), info->CreateReader(true), silent);
 		if (!package->IsValid())
 		{
 			delete package;
@@ -274,6 +274,8 @@ public:
 	// Prepare for serialization of particular object. Will open a reader if it was
 	// closed before.
 	void SetupReader(int ExportIndex);
+	// Open a reader if it was closed, used for reading data outside of object serialization.
+	void OpenReader();
 	// Close reader when not needed anymore. Could be reopened again with SetupReader().
 	void CloseReader();
 
@@ -355,6 +357,10 @@ public:
 	{
 		return Loader->IsCompressed();
 	}
+	virtual bool IsPackageReader() const
+	{
+		return true;
+	}
 #if UNREAL4
 	virtual bool ContainsEditorData() const
 	{
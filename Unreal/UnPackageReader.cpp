@@ -5,6 +5,420 @@
 #include "UnPackage.h"
 
 #include "UnPackageUE3Reader.h"
+#include "Parallel.h"
+
+#include <emmintrin.h>			// SSE2 intrinsics
+
+/*-----------------------------------------------------------------------------
+	UE3 compressed package reader
+-----------------------------------------------------------------------------*/
+
+#if UNREAL3
+
+// Maximal size of data decompressed at once. Regular UE3 compressed chunks are about 1Mb, so they're
+// decompressed completely. Fully compressed packages consist of a single large chunk, this value limits
+// amount of data which should be decompressed when random position in such package is accessed.
+#define UE3_DECOMPRESSION_BATCH_SIZE	(1 << 20)
+
+int FUE3ArchiveReader::FindChunk(int Pos) const
+{
+	int ChunkIndex;
+	for (ChunkIndex = 0; ChunkIndex < CompressedChunks.Num() - 1; ChunkIndex++)
+	{
+		const FCompressedChunk &Chunk = CompressedChunks[ChunkIndex];
+		if (Pos < Chunk.UncompressedOffset + Chunk.UncompressedSize)
+			break;
+	}
+	return ChunkIndex;
+}
+
+void FUE3ArchiveReader::ReadChunkHeader(const FCompressedChunk* Chunk)
+{
+	guard(FUE3ArchiveReader::ReadChunkHeader);
+
+	if (Chunk == CurrentChunk) return;
+	CurrentChunk = NULL;
+
+	// serialize compressed chunk header
+	Reader->Seek(Chunk->CompressedOffset);
+#if BIOSHOCK
+	if (Game == GAME_Bioshock)
+	{
+		// read block size
+		int CompressedSize;
+		*Reader << CompressedSize;
+		// generate ChunkHeader
+		ChunkHeader.Blocks.Empty(1);
+		FCompressedChunkBlock *Block = new (ChunkHeader.Blocks) FCompressedChunkBlock;
+		Block->UncompressedSize = 32768;
+		if (ArLicenseeVer >= 57)		//?? Bioshock 2; no version code found
+			*Reader << Block->UncompressedSize;
+		Block->CompressedSize = CompressedSize;
+	}
+	else
+#endif // BIOSHOCK
+	{
+		if (Chunk->CompressedSize != Chunk->UncompressedSize)
+			*Reader << ChunkHeader;
+		else
+		{
+			// have seen such block in Borderlands: chunk has CompressedSize==UncompressedSize
+			// and has no compression; no such code in original engine
+			ChunkHeader.BlockSize = -1;	// mark as uncompressed (checked in ReadBatch)
+			ChunkHeader.Sum.CompressedSize = ChunkHeader.Sum.UncompressedSize = Chunk->UncompressedSize;
+			ChunkHeader.Blocks.Empty(1);
+			FCompressedChunkBlock *Block = new (ChunkHeader.Blocks) FCompressedChunkBlock;
+			Block->UncompressedSize = Block->CompressedSize = Chunk->UncompressedSize;
+		}
+	}
+	ChunkDataPos = Reader->Tell();
+	CurrentChunk = Chunk;
+
+	unguard;
+}
+
+// Read compressed data of blocks starting with the one which contains Pos, and prepare
+// decompressor. Data is not decompressed here.
+void FUE3ArchiveReader::ReadBatch(FUE3DecompressionBatch& Batch, int Pos)
+{
+	guard(FUE3ArchiveReader::ReadBatch);
+
+	const FCompressedChunk *Chunk = &CompressedChunks[FindChunk(Pos)];
+	ReadChunkHeader(Chunk);
+
+	// find block in ChunkHeader.Blocks
+	int ChunkPosition = Chunk->UncompressedOffset;
+	int ChunkData     = ChunkDataPos;
+	assert(ChunkPosition <= Pos);
+	int FirstBlock;
+	for (FirstBlock = 0; FirstBlock < ChunkHeader.Blocks.Num() - 1; FirstBlock++)
+	{
+		const FCompressedChunkBlock &Block = ChunkHeader.Blocks[FirstBlock];
+		if (ChunkPosition + Block.UncompressedSize > Pos)
+			break;
+		ChunkPosition += Block.UncompressedSize;
+		ChunkData     += Block.CompressedSize;
+	}
+
+	// collect following blocks of the same chunk
+	int CompressedSize = 0, UncompressedSize = 0;
+	Batch.Blocks.Reset();
+	for (int BlockIndex = FirstBlock; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
+	{
+		const FCompressedChunkBlock &Block = ChunkHeader.Blocks[BlockIndex];
+		if (BlockIndex > FirstBlock && UncompressedSize + Block.UncompressedSize > UE3_DECOMPRESSION_BATCH_SIZE)
+			break;
+		Batch.Blocks.Add(Block);
+		CompressedSize   += Block.CompressedSize;
+		UncompressedSize += Block.UncompressedSize;
+	}
+
+	// prepare buffers
+	//?? optimize? can share compressed buffer and decompressed buffer between packages
+	if (CompressedSize > Batch.CompressedBufferSize)
+	{
+		if (Batch.CompressedBuffer) delete[] Batch.CompressedBuffer;
+		Batch.CompressedBuffer = new byte[CompressedSize];
+		Batch.CompressedBufferSize = CompressedSize;
+	}
+	if (UncompressedSize > Batch.BufferSize)
+	{
+		if (Batch.Buffer) delete[] Batch.Buffer;
+		Batch.Buffer = new byte[UncompressedSize];
+		Batch.BufferSize = UncompressedSize;
+	}
+
+	// read compressed data
+	Reader->Seek(ChunkData);
+	Reader->Serialize(Batch.CompressedBuffer, CompressedSize);
+
+	int UsedCompressionFlags = CompressionFlags;
+#if BATMAN
+	if (Game == GAME_Batman4 && CompressionFlags == 8) UsedCompressionFlags = COMPRESS_LZ4;
+#endif
+	if (ChunkHeader.BlockSize == -1)	// my own mark
+		UsedCompressionFlags = 0;		// no compression
+	Batch.Decompressor.Setup(Batch.Blocks.GetData(), Batch.Blocks.Num(), Batch.CompressedBuffer, Batch.Buffer, UsedCompressionFlags);
+
+	Batch.StartPos = ChunkPosition;
+	Batch.EndPos   = ChunkPosition + UncompressedSize;
+
+	unguardf("pos=%X", Pos);
+}
+
+static void DecompressBatchThread(void* Param)
+{
+	((FBlockDecompressor*)Param)->DecompressInThisThread();
+}
+
+void FUE3ArchiveReader::StartPrefetch(int Pos)
+{
+	FUE3DecompressionBatch& Batch = Batches[CurrentBatch ^ 1];
+	assert(!Batch.Thread);
+
+	// Errors are ignored here: they will appear later if this data will be really needed
+	bool bReadOk = false;
+	TRY
+	{
+		ReadBatch(Batch, Pos);
+		bReadOk = true;
+	}
+	CATCH
+	{
+		CurrentChunk = NULL;
+		appResetError();
+	}
+	if (bReadOk)
+		Batch.Thread = appCreateThread(DecompressBatchThread, &Batch.Decompressor);
+}
+
+// Complete decompression of the prefetched batch, returns false in a case of error. The
+// background thread is joined first: Decompress() uses appParallelFor(), which shouldn't
+// run together with DecompressInThisThread().
+bool FUE3ArchiveReader::FinishPrefetch(FUE3DecompressionBatch& Batch)
+{
+	assert(Batch.Thread);
+	bool bOk = appWaitThread(Batch.Thread);
+	Batch.Thread = NULL;
+	if (!bOk)
+	{
+		// the batch will be decompressed again by the caller, which will report the error
+		appResetError();
+		return false;
+	}
+	TRY
+	{
+		// decompress blocks which were not processed by the thread, if any
+		Batch.Decompressor.Decompress();
+	}
+	CATCH
+	{
+		appResetError();
+		bOk = false;
+	}
+	return bOk;
+}
+
+void FUE3ArchiveReader::CancelPrefetch()
+{
+	for (int i = 0; i < ARRAY_COUNT(Batches); i++)
+	{
+		FUE3DecompressionBatch& Batch = Batches[i];
+		if (Batch.Thread)
+		{
+			// skip remaining blocks and wait for completion
+			appInterlockedExchange(&Batch.Decompressor.NextBlock, Batch.Decompressor.NumBlocks);
+			if (!appWaitThread(Batch.Thread))
+				appResetError();		// data is dropped, so the error doesn't matter
+			Batch.Thread = NULL;
+		}
+	}
+}
+
+void FUE3ArchiveReader::ReleaseBuffers()
+{
+	CancelPrefetch();
+	for (int i = 0; i < ARRAY_COUNT(Batches); i++)
+		Batches[i].Release();
+	Buffer = NULL;
+	BufferStart = BufferEnd = 0;
+	CurrentChunk = NULL;
+}
+
+void FUE3ArchiveReader::PrepareBuffer(int Pos)
+{
+	guard(FUE3ArchiveReader::PrepareBuffer);
+
+	const FCompressedChunk *Chunk = &CompressedChunks[FindChunk(Pos)];
+	FUE3DecompressionBatch* Batch = &Batches[CurrentBatch];
+
+	// DC Universe has uncompressed package headers but compressed remaining package part
+	if (Pos < Chunk->UncompressedOffset)
+	{
+		int Size = Chunk->CompressedOffset;
+		if (Size > Batch->BufferSize)
+		{
+			if (Batch->Buffer) delete[] Batch->Buffer;
+			Batch->Buffer     = new byte[Size];
+			Batch->BufferSize = Size;
+		}
+		Reader->Seek(0);
+		Reader->Serialize(Batch->Buffer, Size);
+		Batch->StartPos = 0;
+		Batch->EndPos   = Size;
+		Buffer      = Batch->Buffer;
+		BufferStart = 0;
+		BufferEnd   = Size;
+		return;
+	}
+
+	int PrevEndPos = Batch->EndPos;
+	FUE3DecompressionBatch* Prefetched = &Batches[CurrentBatch ^ 1];
+	if (Prefetched->Thread && Pos >= Prefetched->StartPos && Pos < Prefetched->EndPos && FinishPrefetch(*Prefetched))
+	{
+		// use data decompressed in background
+		CurrentBatch ^= 1;
+		Batch = Prefetched;
+	}
+	else
+	{
+		ReadBatch(*Batch, Pos);
+		Batch->Decompressor.Decompress();
+	}
+
+	Buffer      = Batch->Buffer;
+	BufferStart = Batch->StartPos;
+	BufferEnd   = Batch->EndPos;
+
+	// When data is read sequentially, start decompression of the next batch
+	const FCompressedChunk &LastChunk = CompressedChunks[CompressedChunks.Num() - 1];
+	if (Batch->StartPos == PrevEndPos && Batch->EndPos < LastChunk.UncompressedOffset + LastChunk.UncompressedSize
+		&& appGetNumThreads() > 1)
+	{
+		CancelPrefetch();
+		StartPrefetch(Batch->EndPos);
+	}
+
+	unguard;
+}
+
+#endif // UNREAL3
+
+/*-----------------------------------------------------------------------------
+	Reader for packages with simple encryption
+-----------------------------------------------------------------------------*/
+
+#if LINEAGE2 || EXTEEL || BATTLE_TERR || AA2 || BLADENSOUL || NURIEN
+
+// Amount of data decrypted at once
+#define DECRYPT_BUFFER_SIZE		65536
+
+// Base class for readers of licensee packages with simple encryption. Data is read from
+// the underlying archive and decrypted in large blocks, so serialization of small values
+// takes data from the buffer and doesn't decrypt anything.
+class FDecryptingReader : public FReaderWrapper
+{
+	DECLARE_ARCHIVE(FDecryptingReader, FReaderWrapper);
+public:
+	FDecryptingReader(FArchive *File, int Offset = 0)
+	:	FReaderWrapper(File, Offset)
+	,	Buffer(NULL)
+	,	BufferStart(0)
+	,	BufferEnd(0)
+	{}
+
+	virtual ~FDecryptingReader()
+	{
+		if (Buffer) appFree(Buffer);
+	}
+
+	virtual void Serialize(void *data, int size)
+	{
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
+		if (ArPos >= BufferStart && ArPos + size <= BufferEnd)
+		{
+			// Data is in the buffer, use fast code for small values
+			const byte* BufferPtr = Buffer + (ArPos - BufferStart);
+			switch (size)
+			{
+			case 1:
+				*(byte*)data = *BufferPtr;
+				break;
+			case 2:
+				*(uint16*)data = *(uint16*)BufferPtr;
+				break;
+			case 4:
+				*(uint32*)data = *(uint32*)BufferPtr;
+				break;
+			default:
+				memcpy(data, BufferPtr, size);
+			}
+			ArPos += size;
+			return;
+		}
+		SerializeSlow(data, size);
+	}
+
+	// Position is maintained here, underlying archive is positioned only when data is read
+	virtual void Seek(int Pos)
+	{
+		ArPos = Pos;
+	}
+	virtual int Tell() const
+	{
+		return ArPos;
+	}
+	virtual bool IsEof() const
+	{
+		return ArPos >= GetFileSize();
+	}
+	// Stopper is checked here, because data is read ahead
+	virtual void SetStopper(int Pos)
+	{
+		ArStopper = Pos;
+	}
+	virtual int GetStopper() const
+	{
+		return ArStopper;
+	}
+
+protected:
+	byte		*Buffer;
+	int			BufferStart;
+	int			BufferEnd;
+
+	// Decrypt data which was read from position Pos
+	virtual void Decrypt(byte *Data, int Size, int Pos) = 0;
+
+	// Should be called when decryption parameters were changed
+	void InvalidateBuffer()
+	{
+		BufferStart = BufferEnd = 0;
+	}
+
+	void SerializeSlow(void *data, int size)
+	{
+		guard(FDecryptingReader::Serialize);
+
+		byte *dst = (byte*)data;
+		while (size > 0)
+		{
+			if (ArPos >= BufferStart && ArPos < BufferEnd)
+			{
+				// Copy the part of data which is in the buffer
+				int Count = min(size, BufferEnd - ArPos);
+				memcpy(dst, Buffer + (ArPos - BufferStart), Count);
+				dst += Count;
+				ArPos += Count;
+				size -= Count;
+				continue;
+			}
+			Reader->Seek(ArPos + ArPosOffset);
+			if (size >= DECRYPT_BUFFER_SIZE)
+			{
+				// Large block, decrypt it in place
+				Reader->Serialize(dst, size);
+				Decrypt(dst, size, ArPos);
+				ArPos += size;
+				break;
+			}
+			// Fill the buffer
+			if (!Buffer) Buffer = (byte*)appMalloc(DECRYPT_BUFFER_SIZE);
+			int Count = min(DECRYPT_BUFFER_SIZE, GetFileSize() - ArPos);
+			if (Count < size) Count = size;		// will fail with "end of file" error
+			Reader->Serialize(Buffer, Count);
+			Decrypt(Buffer, Count, ArPos);
+			BufferStart = ArPos;
+			BufferEnd = ArPos + Count;
+		}
+
+		unguard;
+	}
+};
+
+#endif // LINEAGE2 || EXTEEL || BATTLE_TERR || AA2 || BLADENSOUL || NURIEN
+
 
 /*-----------------------------------------------------------------------------
 	Lineage2 file reader
@@ -14,32 +428,26 @@
 
 #define LINEAGE_HEADER_SIZE		28
 
-class FFileReaderLineage : public FReaderWrapper
+class FFileReaderLineage : public FDecryptingReader
 {
-	DECLARE_ARCHIVE(FFileReaderLineage, FReaderWrapper);
+	DECLARE_ARCHIVE(FFileReaderLineage, FDecryptingReader);
 public:
 	FFileReaderLineage(FArchive *File, int Key)
-	:	FReaderWrapper(File, LINEAGE_HEADER_SIZE)
+	:	FDecryptingReader(File, LINEAGE_HEADER_SIZE)
 	,	XorKey(Key)
 	{
 		Game = GAME_Lineage2;
 		Seek(0);		// skip header
 	}
 
-	virtual void Serialize(void *data, int size)
+protected:
+	byte		XorKey;
+
+	virtual void Decrypt(byte *Data, int Size, int Pos)
 	{
-		Reader->Serialize(data, size);
 		if (XorKey)
-		{
-			int i;
-			byte *p;
-			for (i = 0, p = (byte*)data; i < size; i++, p++)
-				*p ^= XorKey;
-		}
+			appXorWithKey(Data, Size, &XorKey, 1);
 	}
-
-protected:
-	byte		XorKey;
 };
 
 #endif // LINEAGE2 || EXTEEL
@@ -51,33 +459,34 @@ protected:
 
 #if BATTLE_TERR
 
-class FFileReaderBattleTerr : public FReaderWrapper
+class FFileReaderBattleTerr : public FDecryptingReader
 {
-	DECLARE_ARCHIVE(FFileReaderBattleTerr, FReaderWrapper);
+	DECLARE_ARCHIVE(FFileReaderBattleTerr, FDecryptingReader);
 public:
 	FFileReaderBattleTerr(FArchive *File)
-	:	FReaderWrapper(File)
+	:	FDecryptingReader(File)
 	{
 		Game = GAME_BattleTerr;
-	}
-
-	virtual void Serialize(void *data, int size)
-	{
-		Reader->Serialize(data, size);
-
-		int i;
-		byte *p;
-		for (i = 0, p = (byte*)data; i < size; i++, p++)
+		// Decrypted value depends on the byte value only, so build a table
+		for (int i = 0; i < 256; i++)
 		{
-			byte b = *p;
+			byte b = i;
 			int shift;
 			byte v;
 			for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
 				shift++;
-			b = ROL8(b, shift);
-			*p = b;
+			Table[i] = ROL8(b, shift);
 		}
 	}
+
+protected:
+	byte		Table[256];
+
+	virtual void Decrypt(byte *Data, int Size, int Pos)
+	{
+		for (int i = 0; i < Size; i++)
+			Data[i] = Table[Data[i]];
+	}
 };
 
 #endif // BATTLE_TERR
@@ -89,43 +498,55 @@ public:
 
 #if AA2
 
-class FFileReaderAA2 : public FReaderWrapper
+class FFileReaderAA2 : public FDecryptingReader
 {
-	DECLARE_ARCHIVE(FFileReaderAA2, FReaderWrapper);
+	DECLARE_ARCHIVE(FFileReaderAA2, FDecryptingReader);
 public:
 	FFileReaderAA2(FArchive *File)
-	:	FReaderWrapper(File)
+	:	FDecryptingReader(File)
 	{}
 
-	virtual void Serialize(void *data, int size)
+protected:
+	// Note: there's another variant of encryption, used with ArraysAGPCount != 0: it is
+	// the same as Battle Territory one, but with ROR8 instead of ROL8.
+	// This one is used with ArraysAGPCount == 0.
+	static FORCEINLINE byte DecryptByte(byte b, int Pos)
 	{
-		int StartPos = Reader->Tell();
-		Reader->Serialize(data, size);
+		int PosXor = (Pos >> 8) ^ Pos;
+		b ^= (PosXor & 0xFF);
+		if (PosXor & 2)
+		{
+			b = ROL8(b, 1);
+		}
+		return b;
+	}
 
-		int i;
-		byte *p;
-		for (i = 0, p = (byte*)data; i < size; i++, p++)
+	virtual void Decrypt(byte *Data, int Size, int Pos)
+	{
+		int i = 0;
+		// Process single bytes until position is aligned, so 16 bytes of vector will have the same 'Pos >> 8'
+		for ( ; i < Size && ((Pos + i) & 15); i++)
+			Data[i] = DecryptByte(Data[i], Pos + i);
+
+		const __m128i Index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		const __m128i One   = _mm_set1_epi8(1);
+		const __m128i Two   = _mm_set1_epi8(2);
+		const __m128i Zero  = _mm_setzero_si128();
+		for ( ; i + 16 <= Size; i += 16)
 		{
-			byte b = *p;
-		#if 0
-			// used with ArraysAGPCount != 0
-			int shift;
-			byte v;
-			for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
-				shift++;
-			b = ROR8(b, shift);
-		#else
-			// used with ArraysAGPCount == 0
-			int PosXor = StartPos + i;
-			PosXor = (PosXor >> 8) ^ PosXor;
-			b ^= (PosXor & 0xFF);
-			if (PosXor & 2)
-			{
-				b = ROL8(b, 1);
-			}
-		#endif
-			*p = b;
+			int P = Pos + i;
+			// Low byte of PosXor for 16 positions
+			__m128i x = _mm_xor_si128(_mm_set1_epi8((char)((P >> 8) ^ P)), Index);
+			__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Data + i)), x);
+			// ROL8(b, 1) for bytes where (PosXor & 2) != 0
+			__m128i rol  = _mm_or_si128(_mm_add_epi8(b, b), _mm_and_si128(_mm_cmplt_epi8(b, Zero), One));
+			__m128i mask = _mm_cmpeq_epi8(_mm_and_si128(x, Two), Two);
+			b = _mm_or_si128(_mm_and_si128(mask, rol), _mm_andnot_si128(mask, b));
+			_mm_storeu_si128((__m128i*)(Data + i), b);
 		}
+
+		for ( ; i < Size; i++)
+			Data[i] = DecryptByte(Data[i], Pos + i);
 	}
 };
 
@@ -138,29 +559,22 @@ public:
 
 #if BLADENSOUL
 
-class FFileReaderBnS : public FReaderWrapper
+class FFileReaderBnS : public FDecryptingReader
 {
-	DECLARE_ARCHIVE(FFileReaderBnS, FReaderWrapper);
+	DECLARE_ARCHIVE(FFileReaderBnS, FDecryptingReader);
 public:
 	FFileReaderBnS(FArchive *File)
-	:	FReaderWrapper(File)
+	:	FDecryptingReader(File)
 	{
 		Game = GAME_BladeNSoul;
 	}
 
-	virtual void Serialize(void *data, int size)
+protected:
+	virtual void Decrypt(byte *Data, int Size, int Pos)
 	{
-		int Pos = Reader->Tell();
-		Reader->Serialize(data, size);
-
 		// Note: similar code exists in DecryptBladeAndSoul()
-		int i;
-		byte *p;
 		static const char *key = "qiffjdlerdoqymvketdcl0er2subioxq";
-		for (i = 0, p = (byte*)data; i < size; i++, p++, Pos++)
-		{
-			*p ^= key[Pos % 32];
-		}
+		appXorWithKey(Data, Size, (const byte*)key, 32, Pos);
 	}
 };
 
@@ -218,41 +632,34 @@ void PatchDunDefExports(FObjectExport *Exp, const FPackageFileSummary &Summary)
 
 #if NURIEN
 
-class FFileReaderNurien : public FReaderWrapper
+class FFileReaderNurien : public FDecryptingReader
 {
-	DECLARE_ARCHIVE(FFileReaderNurien, FReaderWrapper);
+	DECLARE_ARCHIVE(FFileReaderNurien, FDecryptingReader);
 public:
-	int			Threshold;
-
 	FFileReaderNurien(FArchive *File)
-	:	FReaderWrapper(File)
+	:	FDecryptingReader(File)
 	,	Threshold(0x7FFFFFFF)
 	{}
 
-	virtual void Serialize(void *data, int size)
+	virtual void SetStartingPosition(int pos)
 	{
-		int Pos = Reader->Tell();
-		Reader->Serialize(data, size);
+		Threshold = pos;
+		InvalidateBuffer();
+	}
+
+protected:
+	int			Threshold;
 
-		// only first Threshold bytes are compressed (package headers)
+	virtual void Decrypt(byte *Data, int Size, int Pos)
+	{
+		// only first Threshold bytes are encrypted (package headers)
 		if (Pos >= Threshold) return;
 
-		int i;
-		byte *p;
 		static const byte key[] = {
 			0xFE, 0xF2, 0x35, 0x2E, 0x12, 0xFF, 0x47, 0x8A,
 			0xE1, 0x2D, 0x53, 0xE2, 0x21, 0xA3, 0x74, 0xA8
 		};
-		for (i = 0, p = (byte*)data; i < size; i++, p++, Pos++)
-		{
-			if (Pos >= Threshold) return;
-			*p ^= key[Pos & 0xF];
-		}
-	}
-
-	virtual void SetStartingPosition(int pos)
-	{
-		Threshold = pos;
+		appXorWithKey(Data, min(Size, Threshold - Pos), key, ARRAY_COUNT(key), Pos);
 	}
 };
 
@@ -275,8 +682,16 @@ public:
 	:	FReaderWrapper(File)
 	,	EncryptionStart(0)
 	,	EncryptionEnd(0)
+	,	DecryptedBuffer(NULL)
+	,	DecryptedStart(0)
+	,	DecryptedSize(0)
 	{}
 
+	virtual ~FFileReaderRocketLeague()
+	{
+		if (DecryptedBuffer) appFree(DecryptedBuffer);
+	}
+
 	virtual void Serialize(void *data, int size)
 	{
 		int Pos = Reader->Tell();
@@ -292,13 +707,22 @@ public:
 		int CopySize			= EndOffset - StartOffset;
 		int CopyOffset			= max(0, EncryptionStart - Pos);
 
-		// Round to 16-byte AES blocks
-		int BlockStartOffset	= StartOffset & ~15;
-		int BlockEndOffset		= Align(EndOffset, 16);
-		int EncryptedSize		= BlockEndOffset - BlockStartOffset;
-		int EncryptedOffset		= StartOffset - BlockStartOffset;
+		// The whole encrypted area is decrypted once, data is copied from there. Note: EncryptionEnd
+		// could be reduced after data was decrypted, this doesn't invalidate decrypted data.
+		if (!DecryptedBuffer || DecryptedStart != EncryptionStart || DecryptedSize < EndOffset)
+			DecryptData();
+		memcpy(OffsetPointer(data, CopyOffset), DecryptedBuffer + StartOffset, CopySize);
+	}
+
+protected:
+	byte		*DecryptedBuffer;
+	int			DecryptedStart;
+	int			DecryptedSize;
+
+	void DecryptData()
+	{
+		guard(FFileReaderRocketLeague::DecryptData);
 
-		// Decrypt and copy
 		static const byte key[] = {
 			0xC7, 0xDF, 0x6B, 0x13, 0x25, 0x2A, 0xCC, 0x71,
 			0x47, 0xBB, 0x51, 0xC9, 0x8A, 0xD7, 0xE3, 0x4B,
@@ -306,21 +730,19 @@ public:
 			0x93, 0xE2, 0xF2, 0x4E, 0x6B, 0x17, 0xE7, 0x79
 		};
 
-		byte *EncryptedBuffer = (byte*)(appMalloc(EncryptedSize));
-		Reader->Seek(EncryptionStart + BlockStartOffset);
-		Reader->Serialize(EncryptedBuffer, EncryptedSize);
-		appDecryptAES(EncryptedBuffer, EncryptedSize, (char*)(key), ARRAY_COUNT(key));
-		memcpy(OffsetPointer(data, CopyOffset), &EncryptedBuffer[EncryptedOffset], CopySize);
-		appFree(EncryptedBuffer);
-
-		// Note: this code is absolutely not optimal, because it will read 16 bytes block and fully decrypt
-		// it many times for every small piece of serialized daya (for example if serializing array of bytes,
-		// we'll have full code above executed for each byte, instead of once per block). However, it is assumed
-		// that this reader is used only for decryption of package's header, so it is not so important to
-		// optimize it.
+		int SavePos = Reader->Tell();
+		if (DecryptedBuffer) appFree(DecryptedBuffer);
+		DecryptedStart = EncryptionStart;
+		DecryptedSize = Align(EncryptionEnd - EncryptionStart, 16);	// round to 16-byte AES blocks
+		DecryptedBuffer = (byte*)appMalloc(DecryptedSize);
+		Reader->Seek(DecryptedStart);
+		Reader->Serialize(DecryptedBuffer, DecryptedSize);
+		appDecryptAES(DecryptedBuffer, DecryptedSize, (char*)(key), ARRAY_COUNT(key));
 
 		// Restore position
-		Reader->Seek(Pos + size);
+		Reader->Seek(SavePos);
+
+		unguard;
 	}
 };
 
@@ -536,7 +958,7 @@ void UnPackage::ReplaceLoader()
 	// Nurien has encryption in header, and no encryption after
 	FFileReaderNurien* NurienReader = Loader->CastTo<FFileReaderNurien>();
 	if (NurienReader)
-		NurienReader->Threshold = Summary.HeadersSize;
+		NurienReader->SetStartingPosition(Summary.HeadersSize);
 #endif // NURIEN
 
 	unguard;
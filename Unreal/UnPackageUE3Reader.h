@@ -7,6 +7,45 @@
 
 #if UNREAL3
 
+// Sequence of compressed blocks of a single chunk which is decompressed at once
+struct FUE3DecompressionBatch
+{
+	int						StartPos;			// range of uncompressed data
+	int						EndPos;
+	byte					*Buffer;			// uncompressed data
+	int						BufferSize;
+	byte					*CompressedBuffer;
+	int						CompressedBufferSize;
+	TArray<FCompressedChunkBlock> Blocks;
+	FBlockDecompressor		Decompressor;
+	void					*Thread;			// background decompression thread, used for prefetching
+
+	FUE3DecompressionBatch()
+	:	StartPos(0)
+	,	EndPos(0)
+	,	Buffer(NULL)
+	,	BufferSize(0)
+	,	CompressedBuffer(NULL)
+	,	CompressedBufferSize(0)
+	,	Thread(NULL)
+	{}
+
+	~FUE3DecompressionBatch()
+	{
+		Release();
+	}
+
+	void Release()
+	{
+		assert(!Thread);
+		if (Buffer) delete[] Buffer;
+		if (CompressedBuffer) delete[] CompressedBuffer;
+		Buffer = CompressedBuffer = NULL;
+		BufferSize = CompressedBufferSize = 0;
+		StartPos = EndPos = 0;
+	}
+};
+
 class FUE3ArchiveReader : public FArchive
 {
 	DECLARE_ARCHIVE(FUE3ArchiveReader, FArchive);
@@ -22,12 +61,15 @@ public:
 	// used for compressed data)
 	int						Stopper;
 	int						Position;
-	// decompression buffer
+	// decompressed data, points to the data of current batch
 	byte					*Buffer;
-	int						BufferSize;
 	int						BufferStart;
 	int						BufferEnd;
-	// chunk
+	// Compressed blocks are decompressed in batches. When data is read sequentially, the
+	// next batch is decompressed in background while current one is being serialized.
+	FUE3DecompressionBatch	Batches[2];
+	int						CurrentBatch;
+	// header of the last used chunk
 	const FCompressedChunk	*CurrentChunk;
 	FCompressedChunkHeader	ChunkHeader;
 	int						ChunkDataPos;
@@ -38,10 +80,11 @@ public:
 	:	Reader(File)
 	,	IsFullyCompressed(false)
 	,	CompressionFlags(Flags)
+	,	Stopper(0)
 	,	Buffer(NULL)
-	,	BufferSize(0)
 	,	BufferStart(0)
 	,	BufferEnd(0)
+	,	CurrentBatch(0)
 	,	CurrentChunk(NULL)
 	,	PositionOffset(0)
 	{
@@ -55,7 +98,7 @@ public:
 
 	virtual ~FUE3ArchiveReader()
 	{
-		if (Buffer) delete[] Buffer;
+		ReleaseBuffers();
 		if (Reader) delete Reader;
 	}
 
@@ -93,121 +136,7 @@ public:
 		unguard;
 	}
 
-	void PrepareBuffer(int Pos)
-	{
-		guard(FUE3ArchiveReader::PrepareBuffer);
-		// find compressed chunk
-		const FCompressedChunk *Chunk = NULL;
-		for (int ChunkIndex = 0; ChunkIndex < CompressedChunks.Num(); ChunkIndex++)
-		{
-			Chunk = &CompressedChunks[ChunkIndex];
-			if (Pos < Chunk->UncompressedOffset + Chunk->UncompressedSize)
-				break;
-		}
-		assert(Chunk); // should be at least 1 chunk in CompressedChunks
-
-		// DC Universe has uncompressed package headers but compressed remaining package part
-		if (Pos < Chunk->UncompressedOffset)
-		{
-			if (Buffer) delete[] Buffer;
-			int Size = Chunk->CompressedOffset;
-			Buffer      = new byte[Size];
-			BufferSize  = Size;
-			BufferStart = 0;
-			BufferEnd   = Size;
-			Reader->Seek(0);
-			Reader->Serialize(Buffer, Size);
-			return;
-		}
-
-		if (Chunk != CurrentChunk)
-		{
-			// serialize compressed chunk header
-			Reader->Seek(Chunk->CompressedOffset);
-#if BIOSHOCK
-			if (Game == GAME_Bioshock)
-			{
-				// read block size
-				int CompressedSize;
-				*Reader << CompressedSize;
-				// generate ChunkHeader
-				ChunkHeader.Blocks.Empty(1);
-				FCompressedChunkBlock *Block = new (ChunkHeader.Blocks) FCompressedChunkBlock;
-				Block->UncompressedSize = 32768;
-				if (ArLicenseeVer >= 57)		//?? Bioshock 2; no version code found
-					*Reader << Block->UncompressedSize;
-				Block->CompressedSize = CompressedSize;
-			}
-			else
-#endif // BIOSHOCK
-			{
-				if (Chunk->CompressedSize != Chunk->UncompressedSize)
-					*Reader << ChunkHeader;
-				else
-				{
-					// have seen such block in Borderlands: chunk has CompressedSize==UncompressedSize
-					// and has no compression; no such code in original engine
-					ChunkHeader.BlockSize = -1;	// mark as uncompressed (checked below)
-					ChunkHeader.Sum.CompressedSize = ChunkHeader.Sum.UncompressedSize = Chunk->UncompressedSize;
-					ChunkHeader.Blocks.Empty(1);
-					FCompressedChunkBlock *Block = new (ChunkHeader.Blocks) FCompressedChunkBlock;
-					Block->UncompressedSize = Block->CompressedSize = Chunk->UncompressedSize;
-				}
-			}
-			ChunkDataPos = Reader->Tell();
-			CurrentChunk = Chunk;
-		}
-		// find block in ChunkHeader.Blocks
-		int ChunkPosition = Chunk->UncompressedOffset;
-		int ChunkData     = ChunkDataPos;
-		assert(ChunkPosition <= Pos);
-		const FCompressedChunkBlock *Block = NULL;
-		for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
-		{
-			Block = &ChunkHeader.Blocks[BlockIndex];
-			if (ChunkPosition + Block->UncompressedSize > Pos)
-				break;
-			ChunkPosition += Block->UncompressedSize;
-			ChunkData     += Block->CompressedSize;
-		}
-		assert(Block);
-		// read compressed data
-		//?? optimize? can share compressed buffer and decompressed buffer between packages
-		byte *CompressedBlock = new byte[Block->CompressedSize];
-		Reader->Seek(ChunkData);
-		Reader->Serialize(CompressedBlock, Block->CompressedSize);
-		// prepare buffer for decompression
-		if (Block->UncompressedSize > BufferSize)
-		{
-			if (Buffer) delete[] Buffer;
-			Buffer = new byte[Block->UncompressedSize];
-			BufferSize = Block->UncompressedSize;
-		}
-		// decompress data
-		guard(DecompressBlock);
-		if (ChunkHeader.BlockSize != -1)	// my own mark
-		{
-			// Decompress block
-			int UsedCompressionFlags = CompressionFlags;
-#if BATMAN
-			if (Game == GAME_Batman4 && CompressionFlags == 8) UsedCompressionFlags = COMPRESS_LZ4;
-#endif
-			appDecompress(CompressedBlock, Block->CompressedSize, Buffer, Block->UncompressedSize, UsedCompressionFlags);
-		}
-		else
-		{
-			// No compression
-			assert(Block->CompressedSize == Block->UncompressedSize);
-			memcpy(Buffer, CompressedBlock, Block->CompressedSize);
-		}
-		unguardf("block=%X+%X", ChunkData, Block->CompressedSize);
-		// setup BufferStart/BufferEnd
-		BufferStart = ChunkPosition;
-		BufferEnd   = ChunkPosition + Block->UncompressedSize;
-		// cleanup
-		delete[] CompressedBlock;
-		unguard;
-	}
+	void PrepareBuffer(int Pos);
 
 	// position controller
 	virtual void Seek(int Pos)
@@ -259,13 +188,7 @@ public:
 	{
 		guard(FUE3ArchiveReader::Close);
 		Reader->Close();
-		if (Buffer)
-		{
-			delete[] Buffer;
-			Buffer = NULL;
-			BufferStart = BufferEnd = BufferSize = 0;
-		}
-		CurrentChunk = NULL;
+		ReleaseBuffers();
 		unguard;
 	}
 
@@ -275,6 +198,15 @@ public:
 		Reader = file;
 		PositionOffset = offset;
 	}
+
+protected:
+	int FindChunk(int Pos) const;
+	void ReadChunkHeader(const FCompressedChunk* Chunk);
+	void ReadBatch(FUE3DecompressionBatch& Batch, int Pos);
+	void StartPrefetch(int Pos);
+	bool FinishPrefetch(FUE3DecompressionBatch& Batch);
+	void CancelPrefetch();
+	void ReleaseBuffers();
 };
 
 #endif // UNREAL3
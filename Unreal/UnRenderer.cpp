@@ -498,6 +498,7 @@ static int Upload2D(UUnrealMaterial *Tex, bool doMipmap, bool clampS, bool clamp
 	guard(Upload2D);
 
 	CTextureData TexData;
+	TexData.MaxMips = doMipmap ? 0 : 1;		// smaller mips are used only for mipmapping
 	PROFILE_UPLOAD(appResetProfiler());
 	if (!Tex->GetTextureData(TexData))
 	{
@@ -547,6 +548,7 @@ static bool UploadCubeSide(UUnrealMaterial *Tex, bool doMipmap, int side)
 	guard(UploadCubeSide);
 
 	CTextureData TexData;
+	TexData.MaxMips = doMipmap ? 0 : 1;
 	if (!Tex->GetTextureData(TexData))
 	{
 		appPrintf("WARNING: %s %s has no valid mipmaps\n", Tex->GetClassName(), Tex->Name);
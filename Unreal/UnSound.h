@@ -113,7 +113,7 @@ struct FSoundFormatData // FFormatContainer item representation
 
 struct FStreamedAudioChunk
 {
-	FByteBulkData		Data;
+	FByteBulkData		Data;					// loaded on demand by the exporter
 	int32				DataSize;
 	int32				AudioDataSize;
 
@@ -129,20 +129,20 @@ struct FStreamedAudioChunk
 		{
 			// No FStreamedAudioChunk before UE4.3
 			// UE4.3: only bulk
-			Chunk.Data.Serialize(Ar);
+			Chunk.Data.Serialize(Ar, true);
 			Chunk.AudioDataSize = Chunk.DataSize = Chunk.Data.ElementCount;
 		}
 		else if (Ar.Game < GAME_UE4(19))
 		{
 			// UE4.4..UE4.18
-			Chunk.Data.Serialize(Ar);
+			Chunk.Data.Serialize(Ar, true);
 			Ar << Chunk.DataSize;
 			Chunk.AudioDataSize = Chunk.DataSize;
 		}
 		else
 		{
 			// UE4.19+
-			Chunk.Data.Serialize(Ar);
+			Chunk.Data.Serialize(Ar, true);
 			Ar << Chunk.DataSize;
 			Ar << Chunk.AudioDataSize;
 		}
@@ -7,6 +7,7 @@
 #include "UnMaterial2.h"		// for UPalette
 
 #include "UnTexturePNG.h"
+#include "Profiler.h"
 
 #if SUPPORT_IPHONE
 #	include <PVRTDecompress.h>
@@ -18,6 +19,10 @@
 
 #include <detex.h>
 
+#include <emmintrin.h>			// SSE2 intrinsics for pixel conversion
+
+#include "Parallel.h"
+
 #if 0
 #	define PROFILE_DDS(cmd)		cmd
 #else
@@ -103,10 +108,424 @@ bool CTextureData::IsDXT() const
 }
 
 
-byte *CTextureData::Decompress(int MipLevel)
+/*-----------------------------------------------------------------------------
+	Pixel format conversion kernels
+-----------------------------------------------------------------------------*/
+
+// All kernels produce 32-bit pixels either in RGBA or BGRA byte order, so the
+// swizzle required by the consumer is applied while decoding and each texel
+// is touched only once. SSE2 is used as it is the baseline for all supported
+// targets.
+
+// Swap R and B of 4 pixels: RGBA <-> BGRA
+FORCEINLINE __m128i SwapRB_SSE(__m128i p)
+{
+	const __m128i maskGA = _mm_set1_epi32(0xFF00FF00);
+	const __m128i mask0  = _mm_set1_epi32(0x000000FF);
+	__m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask0);
+	__m128i b = _mm_slli_epi32(_mm_and_si128(p, mask0), 16);
+	return _mm_or_si128(_mm_and_si128(p, maskGA), _mm_or_si128(r, b));
+}
+
+FORCEINLINE uint32 SwapRB(uint32 p)
+{
+	return (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+}
+
+// Copy 32-bit pixels, swapping R and B channels. 'src' and 'dst' may point to the same buffer.
+static void ConvertSwapRB(const byte* src, byte* dst, int numPixels)
+{
+	int i = 0;
+	for ( ; i + 4 <= numPixels; i += 4, src += 16, dst += 16)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)src);
+		_mm_storeu_si128((__m128i*)dst, SwapRB_SSE(p));
+	}
+	for ( ; i < numPixels; i++, src += 4, dst += 4)
+		*(uint32*)dst = SwapRB(*(const uint32*)src);
+}
+
+void SwapRedBlue(byte* pic, int numPixels)
+{
+	ConvertSwapRB(pic, pic, numPixels);
+}
+
+void CopySwapRedBlue(const byte* src, byte* dst, int numPixels)
+{
+	ConvertSwapRB(src, dst, numPixels);
+}
+
+// Copy 32-bit pixels, changing byte order when needed
+static void ConvertRGBA8(const byte* src, byte* dst, int numPixels, bool srcIsBGRA, bool dstIsBGRA)
+{
+	if (srcIsBGRA == dstIsBGRA)
+		memcpy(dst, src, numPixels * 4);
+	else
+		ConvertSwapRB(src, dst, numPixels);
+}
+
+// 8-bit paletted: build swizzled 32-bit lookup table, then use a single store per pixel
+static void ConvertP8(const byte* src, byte* dst, int numPixels, const FColor* Colors, int NumColors, bool dstIsBGRA)
+{
+	uint32 Table[256];
+	memset(Table, 0, sizeof(Table));
+	if (NumColors > 256) NumColors = 256;
+	for (int i = 0; i < NumColors; i++)
+	{
+		const FColor &c = Colors[i];
+		byte* t = (byte*)&Table[i];
+		t[0] = dstIsBGRA ? c.B : c.R;
+		t[1] = c.G;
+		t[2] = dstIsBGRA ? c.R : c.B;
+		t[3] = c.A;
+	}
+	uint32* d = (uint32*)dst;
+	int i = 0;
+	for ( ; i + 4 <= numPixels; i += 4, src += 4, d += 4)
+	{
+		d[0] = Table[src[0]];
+		d[1] = Table[src[1]];
+		d[2] = Table[src[2]];
+		d[3] = Table[src[3]];
+	}
+	for ( ; i < numPixels; i++)
+		*d++ = Table[*src++];
+}
+
+// 24-bit BGR source
+static void ConvertRGB8(const byte* src, byte* dst, int numPixels, bool dstIsBGRA)
+{
+	uint32* d = (uint32*)dst;
+	if (dstIsBGRA)
+	{
+		for (int i = 0; i < numPixels; i++, src += 3)
+			*d++ = src[0] | (src[1] << 8) | (src[2] << 16) | 0xFF000000;
+	}
+	else
+	{
+		for (int i = 0; i < numPixels; i++, src += 3)
+			*d++ = src[2] | (src[1] << 8) | (src[0] << 16) | 0xFF000000;
+	}
+}
+
+// 16-bit packed pixels, 4 bits per channel
+static void ConvertRGBA4(const byte* src, byte* dst, int numPixels, bool dstIsBGRA)
+{
+	// Source pixel is 2 bytes b1,b2. Result: R = b2 & F0, G = b2 << 4, B = b1 & F0, A = b1 << 4.
+	// After byte interleaving of high and low nibbles we're getting [B A R G].
+	const __m128i maskHi = _mm_set1_epi8((char)0xF0);
+	const __m128i maskLo = _mm_set1_epi8(0x0F);
+	int i = 0;
+	for ( ; i + 8 <= numPixels; i += 8, src += 16, dst += 32)
+	{
+		__m128i p  = _mm_loadu_si128((const __m128i*)src);
+		__m128i hi = _mm_and_si128(p, maskHi);
+		__m128i lo = _mm_slli_epi16(_mm_and_si128(p, maskLo), 4);
+		__m128i q0 = _mm_unpacklo_epi8(hi, lo);		// [B A R G] x4
+		__m128i q1 = _mm_unpackhi_epi8(hi, lo);
+		// [B A R G] -> [R G B A]: rotate dword by 16 bits
+		q0 = _mm_or_si128(_mm_srli_epi32(q0, 16), _mm_slli_epi32(q0, 16));
+		q1 = _mm_or_si128(_mm_srli_epi32(q1, 16), _mm_slli_epi32(q1, 16));
+		if (dstIsBGRA)
+		{
+			q0 = SwapRB_SSE(q0);
+			q1 = SwapRB_SSE(q1);
+		}
+		_mm_storeu_si128((__m128i*)dst, q0);
+		_mm_storeu_si128((__m128i*)(dst + 16), q1);
+	}
+	int ri = dstIsBGRA ? 2 : 0;
+	int bi = 2 - ri;
+	for ( ; i < numPixels; i++, src += 2, dst += 4)
+	{
+		byte b1 = src[0];
+		byte b2 = src[1];
+		dst[ri] = b2 & 0xF0;
+		dst[1]  = (b2 & 0xF) << 4;
+		dst[bi] = b1 & 0xF0;
+		dst[3]  = (b1 & 0xF) << 4;
+	}
+}
+
+// 8-bit grayscale, the result doesn't depend on byte order
+static void ConvertG8(const byte* src, byte* dst, int numPixels)
+{
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+	int i = 0;
+	for ( ; i + 16 <= numPixels; i += 16, src += 16, dst += 64)
+	{
+		__m128i g   = _mm_loadu_si128((const __m128i*)src);
+		__m128i gg0 = _mm_unpacklo_epi8(g, g);			// [g g] x8
+		__m128i gg1 = _mm_unpackhi_epi8(g, g);
+		__m128i ga0 = _mm_unpacklo_epi8(g, alpha);		// [g FF] x8
+		__m128i ga1 = _mm_unpackhi_epi8(g, alpha);
+		_mm_storeu_si128((__m128i*)(dst     ), _mm_unpacklo_epi16(gg0, ga0));
+		_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(gg0, ga0));
+		_mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(gg1, ga1));
+		_mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(gg1, ga1));
+	}
+	uint32* d = (uint32*)dst;
+	for ( ; i < numPixels; i++)
+	{
+		uint32 b = *src++;
+		*d++ = b | (b << 8) | (b << 16) | 0xFF000000;
+	}
+}
+
+// Half-float RGBA to float RGBA. Uses the same bit conversion as half2float(), 8 values at a time.
+static void ConvertFloatRGBA(const uint16* src, float* dst, int numValues)
+{
+	const __m128i zero     = _mm_setzero_si128();
+	const __m128i signMask = _mm_set1_epi32(0x8000);
+	const __m128i bodyMask = _mm_set1_epi32(0x7FFF);
+	const __m128i expBias  = _mm_set1_epi32((127 - 15) << 23);
+	int i = 0;
+	for ( ; i + 8 <= numValues; i += 8, src += 8, dst += 8)
+	{
+		__m128i h = _mm_loadu_si128((const __m128i*)src);
+		__m128i v[2] = { _mm_unpacklo_epi16(h, zero), _mm_unpackhi_epi16(h, zero) };
+		for (int j = 0; j < 2; j++)
+		{
+			__m128i sign = _mm_slli_epi32(_mm_and_si128(v[j], signMask), 16);
+			__m128i body = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(v[j], bodyMask), 13), expBias);
+			_mm_storeu_ps(dst + j * 4, _mm_castsi128_ps(_mm_or_si128(sign, body)));
+		}
+	}
+	for ( ; i < numValues; i++)
+		*dst++ = half2float(*src++);
+}
+
+// Called for decoders which can produce RGBA output only
+static FORCEINLINE void FinishRGBA(byte* pic, int numPixels, bool dstIsBGRA)
+{
+	if (dstIsBGRA)
+		ConvertSwapRB(pic, pic, numPixels);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Parallel block decoding
+-----------------------------------------------------------------------------*/
+
+// Images are split into horizontal strips of block rows which are decoded
+// independently, every strip writes to its own part of destination buffer.
+
+// Number of block rows processed by a single job: use several jobs per thread
+// for better load balancing.
+static int GetBlockRowsPerJob(int NumBlockRows)
+{
+	int NumJobs = appGetNumThreads() * 4;
+	return max((NumBlockRows + NumJobs - 1) / NumJobs, 1);
+}
+
+struct CDetexDecodeContext
+{
+	detexTexture	Tex;
+	byte*			Dst;
+	uint32			PixelFormat;
+	int				RowsPerJob;
+};
+
+static void DecodeDetexRows(int Job, CDetexDecodeContext& Ctx)
+{
+	int Row = Job * Ctx.RowsPerJob;
+	int NumRows = min(Ctx.RowsPerJob, Ctx.Tex.height_in_blocks - Row);
+	detexTexture Tex = Ctx.Tex;
+	Tex.data = Ctx.Tex.data + Row * Tex.width_in_blocks * detexGetCompressedBlockSize(Tex.format);
+	Tex.height_in_blocks = NumRows;
+	Tex.height = min(NumRows * 4, Ctx.Tex.height - Row * 4);
+	int PixelSize = detexGetPixelSize(Ctx.PixelFormat);
+	detexDecompressTextureLinear(&Tex, Ctx.Dst + Row * 4 * Tex.width * PixelSize, Ctx.PixelFormat);
+}
+
+static void DecompressDetex(uint32 TexFormat, const byte* Data, int USize, int VSize, byte* dst, uint32 PixelFormat)
+{
+	guard(DecompressDetex);
+
+	CDetexDecodeContext Ctx;
+	Ctx.Tex.format = TexFormat;
+	Ctx.Tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
+	Ctx.Tex.width = USize;
+	Ctx.Tex.height = VSize;
+	Ctx.Tex.width_in_blocks = USize / 4;
+	Ctx.Tex.height_in_blocks = VSize / 4;
+	Ctx.Dst = dst;
+	Ctx.PixelFormat = PixelFormat;
+	Ctx.RowsPerJob = GetBlockRowsPerJob(Ctx.Tex.height_in_blocks);
+	PROFILE_DDS(appResetProfiler());
+	appParallelFor((Ctx.Tex.height_in_blocks + Ctx.RowsPerJob - 1) / Ctx.RowsPerJob, DecodeDetexRows, Ctx);
+	PROFILE_DDS(appPrintProfiler());
+
+	unguard;
+}
+
+#if SUPPORT_ANDROID
+
+struct CETCDecodeContext
+{
+	const byte*		Data;
+	byte*			Dst;
+	int				USize;
+	int				VSize;
+	int				RowsPerJob;
+};
+
+static void DecodeETCRows(int Job, CETCDecodeContext& Ctx)
+{
+	int Row = Job * Ctx.RowsPerJob;
+	unsigned Width = Ctx.USize;
+	unsigned Height = min(Ctx.RowsPerJob * 4, Ctx.VSize - Row * 4);
+	PVRTDecompressETC(Ctx.Data + Row * (Ctx.USize / 4) * 8, Width, Height, Ctx.Dst + Row * 4 * Ctx.USize * 4, 0);
+}
+
+static void DecompressETC1(const byte* Data, int USize, int VSize, byte* dst)
+{
+	guard(DecompressETC1);
+
+	PROFILE_DDS(appResetProfiler());
+	if ((USize & 3) || (VSize & 3) || USize < 4 || VSize < 4)
+	{
+		// strips require whole blocks, small mips are decoded at once
+		unsigned Width = USize, Height = VSize;
+		PVRTDecompressETC(Data, Width, Height, dst, 0);
+	}
+	else
+	{
+		CETCDecodeContext Ctx;
+		Ctx.Data = Data;
+		Ctx.Dst = dst;
+		Ctx.USize = USize;
+		Ctx.VSize = VSize;
+		int NumRows = VSize / 4;
+		Ctx.RowsPerJob = GetBlockRowsPerJob(NumRows);
+		appParallelFor((NumRows + Ctx.RowsPerJob - 1) / Ctx.RowsPerJob, DecodeETCRows, Ctx);
+	}
+	PROFILE_DDS(appPrintProfiler());
+
+	unguard;
+}
+
+struct CASTCDecodeContext
+{
+	const byte*		Data;
+	byte*			Dst;
+	int				USize;
+	int				VSize;
+	int				BlockDim;
+	int				XBlocks;
+	bool			IsNormalmap;
+	bool			DstIsBGRA;
+};
+
+FORCEINLINE byte ASTCFloatToByte(float v)
+{
+	v = bound(v, 0.0f, 1.0f);
+	return (byte)appFloor(v * 255.0f + 0.5f);
+}
+
+// Decode a single row of ASTC blocks. This code replaces write_imageblock() from
+// astc library and writes pixels directly to the destination buffer.
+static void DecodeASTCRow(int y, CASTCDecodeContext& Ctx)
+{
+	const int dim = Ctx.BlockDim;
+	int ri = Ctx.DstIsBGRA ? 2 : 0;
+	int bi = 2 - ri;
+	imageblock pb;
+
+	for (int x = 0; x < Ctx.XBlocks; x++)
+	{
+		const byte* bp = Ctx.Data + (y * Ctx.XBlocks + x) * 16;
+		physical_compressed_block pcb = *(physical_compressed_block *) bp;
+		symbolic_compressed_block scb;
+		physical_to_symbolic(dim, dim, 1, pcb, &scb);
+		decompress_symbolic_block(DECODE_LDR, dim, dim, 1, x * dim, y * dim, 0, &scb, &pb);
+
+		// store pixels, clip block by image size
+		int x0 = x * dim;
+		int y0 = y * dim;
+		int w = min(dim, Ctx.USize - x0);
+		int h = min(dim, Ctx.VSize - y0);
+		for (int by = 0; by < h; by++)
+		{
+			const float* fptr = pb.orig_data + by * dim * 4;
+			const uint8_t* nptr = pb.nan_texel + by * dim;
+			byte* d = Ctx.Dst + ((y0 + by) * Ctx.USize + x0) * 4;
+			for (int bx = 0; bx < w; bx++, fptr += 4, d += 4)
+			{
+				byte r, g, b, a;
+				if (nptr[bx])
+				{
+					// NaN-pixel, display it as purple
+					r = 255; g = 0; b = 255; a = 255;
+				}
+				else
+				{
+					r = ASTCFloatToByte(fptr[0]);
+					g = ASTCFloatToByte(fptr[1]);
+					b = ASTCFloatToByte(fptr[2]);
+					a = ASTCFloatToByte(fptr[3]);
+				}
+				if (Ctx.IsNormalmap)
+				{
+					// UE4 drops blue channel for normal maps before encoding, restore it
+					float uf = r / 255.0f * 2 - 1;
+					float vf = g / 255.0f * 2 - 1;
+					float t  = 1.0f - uf * uf - vf * vf;
+					if (t >= 0)
+						b = appFloor((t + 1.0f) * 127.5f);
+					else
+						b = 255;
+				}
+				d[ri] = r;
+				d[1]  = g;
+				d[bi] = b;
+				d[3]  = a;
+			}
+		}
+	}
+}
+
+static void DecompressASTC(const byte* Data, int USize, int VSize, int blockDim, bool isNormalmap, byte* dst, bool dstIsBGRA)
+{
+	guard(DecompressASTC);
+
+	static bool initialized = false;
+	if (!initialized)
+	{
+		build_quantization_mode_table();
+		initialized = true;
+	}
+	// astc library builds these tables on demand, do that before starting worker threads
+	get_block_size_descriptor(blockDim, blockDim, 1);
+	get_partition_table(blockDim, blockDim, 1, 1);
+
+	CASTCDecodeContext Ctx;
+	Ctx.Data = Data;
+	Ctx.Dst = dst;
+	Ctx.USize = USize;
+	Ctx.VSize = VSize;
+	Ctx.BlockDim = blockDim;
+	Ctx.XBlocks = (USize + blockDim - 1) / blockDim;
+	Ctx.IsNormalmap = isNormalmap;
+	Ctx.DstIsBGRA = dstIsBGRA;
+	int yBlocks = (VSize + blockDim - 1) / blockDim;
+
+	PROFILE_DDS(appResetProfiler());
+	appParallelFor(yBlocks, DecodeASTCRow, Ctx);
+	PROFILE_DDS(appPrintProfiler());
+
+	unguard;
+}
+
+#endif // SUPPORT_ANDROID
+
+
+byte *CTextureData::Decompress(int MipLevel, ETexturePixelFormat DstFormat)
 {
 	guard(CTextureData::Decompress);
 
+	PROFILE_SCOPE("DecodeTexture");
+
 	if (!Mips.IsValidIndex(MipLevel))
 		return NULL;
 
@@ -141,6 +560,10 @@ byte *CTextureData::Decompress(int MipLevel)
 	}
 #endif
 
+	assert(DstFormat == TPF_RGBA8 || DstFormat == TPF_BGRA8);
+	bool dstIsBGRA = (DstFormat == TPF_BGRA8);
+	int numPixels = USize * VSize;
+
 	// Process non-dxt formats here. If texture format has FourCC, then it will be
 	// processed by code below this switch.
 	switch (Format)
@@ -153,95 +576,26 @@ byte *CTextureData::Decompress(int MipLevel)
 				memset(dst, 0xFF, size);
 				return dst;
 			}
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				const FColor &c = Palette->Colors[Data[i]];
-				*d++ = c.R;
-				*d++ = c.G;
-				*d++ = c.B;
-				*d++ = c.A;
-			}
+			ConvertP8(Data, dst, numPixels, Palette->Colors.GetData(), Palette->Colors.Num(), dstIsBGRA);
 		}
 		return dst;
 	case TPF_RGB8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = 255;
-				s += 3;
-			}
-		}
+		ConvertRGB8(Data, dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_RGBA8:
-		{
-			memcpy(dst, Data, USize * VSize * 4);
-		}
+		ConvertRGBA8(Data, dst, numPixels, false, dstIsBGRA);
 		return dst;
 	case TPF_FLOAT_RGBA:
-		{
-			const uint16 *s = (uint16*)Data;
-			float *d = (float*)dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-				*d++ = half2float(*s++);
-			}
-		}
+		ConvertFloatRGBA((const uint16*)Data, (float*)dst, numPixels * 4);
 		return dst;
 	case TPF_BGRA8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				// BGRA -> RGBA
-				*d++ = s[2];
-				*d++ = s[1];
-				*d++ = s[0];
-				*d++ = s[3];
-				s += 4;
-			}
-		}
+		ConvertRGBA8(Data, dst, numPixels, true, dstIsBGRA);
 		return dst;
 	case TPF_RGBA4:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b1 = s[0];
-				byte b2 = s[1];
-				// BGRA -> RGBA
-				*d++ = b2 & 0xF0;
-				*d++ = (b2 & 0xF) << 4;
-				*d++ = b1 & 0xF0;
-				*d++ = (b1 & 0xF) << 4;
-				s += 2;
-			}
-		}
+		ConvertRGBA4(Data, dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_G8:
-		{
-			const byte *s = Data;
-			byte *d = dst;
-			for (int i = 0; i < USize * VSize; i++)
-			{
-				byte b = *s++;
-				*d++ = b;
-				*d++ = b;
-				*d++ = b;
-				*d++ = 255;
-			}
-		}
+		ConvertG8(Data, dst, numPixels);
 		return dst;
 	case TPF_V8U8:
 	case TPF_V8U8_2:
@@ -249,19 +603,21 @@ byte *CTextureData::Decompress(int MipLevel)
 			const byte *s = Data;
 			byte *d = dst;
 			byte offset = (Format == TPF_V8U8) ? 128 : 0;
-			for (int i = 0; i < USize * VSize; i++)
+			int ri = dstIsBGRA ? 2 : 0;
+			int bi = 2 - ri;
+			for (int i = 0; i < numPixels; i++)
 			{
 				byte u = *s++ + offset;		// byte + byte -> byte, overflow is normal here
 				byte v = *s++ + offset;
-				d[0] = u;
+				d[ri] = u;
 				d[1] = v;
 				float uf = (u - offset) / 255.0f * 2 - 1;
 				float vf = (v - offset) / 255.0f * 2 - 1;
 				float t  = 1.0f - uf * uf - vf * vf;
 				if (t >= 0)
-					d[2] = 255 - 255 * appFloor(sqrt(t));	//!! TODO: check for correct function here - should be (t+1.0)*127.5, at least for 'offset==0'
+					d[bi] = 255 - 255 * appFloor(sqrt(t));	//!! TODO: check for correct function here - should be (t+1.0)*127.5, at least for 'offset==0'
 				else
-					d[2] = 255;
+					d[bi] = 255;
 				d[3] = 255;
 				d += 4;
 			}
@@ -277,155 +633,43 @@ byte *CTextureData::Decompress(int MipLevel)
 		PROFILE_DDS(appResetProfiler());
 		PVRTDecompressPVRTC(Data, Format == TPF_PVRTC2, USize, VSize, dst);
 		PROFILE_DDS(appPrintProfiler());
+		FinishRGBA(dst, numPixels, dstIsBGRA);
 		return dst;
 #endif // SUPPORT_IPHONE
 
 #if SUPPORT_ANDROID
 	case TPF_ETC1:
-#if 1
-		PROFILE_DDS(appResetProfiler());
-		PVRTDecompressETC(Data, USize, VSize, dst, 0);
-		PROFILE_DDS(appPrintProfiler());
-#else
-		{
-			// NOTE: this code works well too
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC1;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
-#endif
+		DecompressETC1(Data, USize, VSize, dst);
+		FinishRGBA(dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_ETC2_RGB:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		DecompressDetex(DETEX_TEXTURE_FORMAT_ETC2, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		FinishRGBA(dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_ETC2_RGBA:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_ETC2_EAC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		DecompressDetex(DETEX_TEXTURE_FORMAT_ETC2_EAC, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		FinishRGBA(dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_ASTC_4x4:
 	case TPF_ASTC_6x6:
 	case TPF_ASTC_8x8:
 	case TPF_ASTC_10x10:
 	case TPF_ASTC_12x12:
-		{
-			static bool initialized = false;
-			if (!initialized)
-			{
-				build_quantization_mode_table();
-				initialized = true;
-			}
-			int blockDim = PixelFormatInfo[Format].BlockSizeX;
-			assert(PixelFormatInfo[Format].BlockSizeY == blockDim);
-			int xBlocks = (USize + blockDim - 1) / blockDim;
-			int yBlocks = (VSize + blockDim - 1) / blockDim;
-			const int xdim = blockDim, ydim = blockDim, zdim = 1, z = 0;
-			const astc_decode_mode decode_mode = DECODE_LDR;
-			static const swizzlepattern swz_decode = { 0, 1, 2, 3 };
-			imageblock pb;
-
-			astc_codec_image* img = allocate_image(8 /*bitness*/, USize, VSize, 1 /*zsize*/, 0);
-			initialize_image(img);
-
-			for (int y = 0; y < yBlocks; y++)
-			{
-				for (int x = 0; x < xBlocks; x++)
-				{
-					int offset = ((y * xBlocks) + x) * 16;
-					const byte* bp = Data + offset;
-					physical_compressed_block pcb = *(physical_compressed_block *) bp;
-					symbolic_compressed_block scb;
-					physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
-					decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
-					write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
-				}
-			}
-
-			memcpy(dst, img->imagedata8[0][0], size);
-
-			if (isNormalmap)
-			{
-				// UE4 drops blue channel for normal maps before encoding, restore it
-				byte *d = dst;
-				for (int i = 0; i < USize * VSize; i++)
-				{
-					byte u = d[0];
-					byte v = d[1];
-					assert(d[2] == 0);
-					float uf = u / 255.0f * 2 - 1;
-					float vf = v / 255.0f * 2 - 1;
-					float t  = 1.0f - uf * uf - vf * vf;
-					if (t >= 0)
-						d[2] = appFloor((t + 1.0f) * 127.5f);
-					else
-						d[2] = 255;
-					d += 4;
-				}
-			}
-
-			destroy_image(img);
-		}
+		assert(PixelFormatInfo[Format].BlockSizeY == PixelFormatInfo[Format].BlockSizeX);
+		DecompressASTC(Data, USize, VSize, PixelFormatInfo[Format].BlockSizeX, isNormalmap, dst, dstIsBGRA);
 		return dst;
 #endif // SUPPORT_ANDROID
 	case TPF_BC6H:
-		{
-			// decompress HDR image as float[w*h*4]
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC_FLOAT;
-			tex.data = const_cast<byte*>(Data);
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		// decompress HDR image as float[w*h*4]
+		DecompressDetex(DETEX_TEXTURE_FORMAT_BPTC_FLOAT, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_FLOAT_RGBX32);
 		return dst;
 	case TPF_BC7:
-		{
-			detexTexture tex;
-			tex.format = DETEX_TEXTURE_FORMAT_BPTC;
-			tex.data = const_cast<byte*>(Data);	// will be used as 'const' anyway
-			tex.width = USize;
-			tex.height = VSize;
-			tex.width_in_blocks = USize / 4;
-			tex.height_in_blocks = VSize / 4;
-			PROFILE_DDS(appResetProfiler());
-			detexDecompressTextureLinear(&tex, dst, DETEX_PIXEL_FORMAT_RGBA8);
-			PROFILE_DDS(appPrintProfiler());
-		}
+		DecompressDetex(DETEX_TEXTURE_FORMAT_BPTC, Data, USize, VSize, dst, DETEX_PIXEL_FORMAT_RGBA8);
+		FinishRGBA(dst, numPixels, dstIsBGRA);
 		return dst;
 	case TPF_PNG_BGRA:
 	case TPF_PNG_RGBA:
-		if (UncompressPNG(Mip.CompressedData, Mip.DataSize, Mip.USize, Mip.VSize, dst, Format == TPF_PNG_BGRA))
+		if (UncompressPNG(Mip.CompressedData, Mip.DataSize, Mip.USize, Mip.VSize, dst, (Format == TPF_PNG_BGRA) != dstIsBGRA))
 		{
 			return dst;
 		}
@@ -451,17 +695,8 @@ byte *CTextureData::Decompress(int MipLevel)
 	header.setNormalFlag(Format == TPF_DXT5N || Format == TPF_BC5);	// flag to restore normalmap from 2 colors
 	DecodeDDS(Data, USize, VSize, header, image);
 
-	byte *s = (byte*)image.pixels();
-	byte *d = dst;
-
-	for (int i = 0; i < USize * VSize; i++, s += 4, d += 4)
-	{
-		// BGRA -> RGBA
-		d[0] = s[2];
-		d[1] = s[1];
-		d[2] = s[0];
-		d[3] = s[3];
-	}
+	// nvtt produces BGRA image
+	ConvertRGBA8((byte*)image.pixels(), dst, numPixels, true, dstIsBGRA);
 
 	PROFILE_DDS(appPrintProfiler());
 
@@ -473,6 +708,278 @@ byte *CTextureData::Decompress(int MipLevel)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Console texture untiling
+-----------------------------------------------------------------------------*/
+
+#if SUPPORT_XBOX360 || SUPPORT_PS4 || SUPPORT_SWITCH
+
+// Tiled layout is described with a table of copy operations, which is built
+// once per layout (platform, mip dimensions and format) and reused for all
+// textures sharing it. Neighbouring blocks which are stored sequentially in
+// tiled data are merged into a single copy operation.
+
+struct CUntileRun
+{
+	int				SrcOffset;
+	int				DstOffset;
+	int				Size;					// in bytes
+};
+
+enum EUntilePlatform
+{
+	UNTILE_XBOX360,
+	UNTILE_PS4,
+	UNTILE_NSW,
+};
+
+struct CUntileLayout
+{
+	// key
+	int				Platform;				// EUntilePlatform
+	int				Width;					// size of image in blocks
+	int				Height;
+	int				BytesPerBlock;
+	int				Param;					// platform-specific value
+	// layout
+	int				MaxSrcOffset;			// offset of the last block in tiled data, used for validation
+	TArray<CUntileRun> Runs;
+	TArray<int>		RowRuns;				// index of the first run for each row of blocks, and end marker
+	// cache
+	int				RefCount;				// number of threads using the layout, it can't be evicted while used
+	bool			IsCached;
+
+	void Init(int InPlatform, int InWidth, int InHeight, int InBytesPerBlock, int InParam)
+	{
+		Platform = InPlatform;
+		Width = InWidth;
+		Height = InHeight;
+		BytesPerBlock = InBytesPerBlock;
+		Param = InParam;
+		MaxSrcOffset = 0;
+		Runs.Empty(Width * Height / 4);
+		RowRuns.Empty(Height + 1);
+	}
+
+	// Should be called before adding blocks of the next row
+	void BeginRow()
+	{
+		RowRuns.Add(Runs.Num());
+	}
+
+	void EndLayout()
+	{
+		RowRuns.Add(Runs.Num());
+	}
+
+	// Add a block at destination position (x,y) taken from 'SrcOffset' byte of tiled data
+	void AddBlock(int x, int y, int SrcOffset)
+	{
+		int DstOffset = (y * Width + x) * BytesPerBlock;
+		MaxSrcOffset = max(MaxSrcOffset, SrcOffset);
+		if (Runs.Num() > RowRuns[RowRuns.Num() - 1])
+		{
+			// try to extend previous run of this row
+			CUntileRun& Last = Runs[Runs.Num() - 1];
+			if (Last.SrcOffset + Last.Size == SrcOffset && Last.DstOffset + Last.Size == DstOffset)
+			{
+				Last.Size += BytesPerBlock;
+				return;
+			}
+		}
+		CUntileRun* Run = new (Runs) CUntileRun;
+		Run->SrcOffset = SrcOffset;
+		Run->DstOffset = DstOffset;
+		Run->Size = BytesPerBlock;
+	}
+};
+
+#define MAX_UNTILE_LAYOUTS		16
+
+// Textures are decoded by several threads, so the cache is guarded with a lock. Layouts are
+// built and applied outside of the lock: a layout which is in use is never evicted, and a new
+// layout is put to the cache only when it is complete.
+static CMutex GUntileLock;
+static CUntileLayout* GUntileLayouts[MAX_UNTILE_LAYOUTS];
+static int GUntileLayoutTime[MAX_UNTILE_LAYOUTS];
+static int GUntileTime = 0;
+
+static bool MatchUntileLayout(const CUntileLayout* L, int Platform, int Width, int Height, int BytesPerBlock, int Param)
+{
+	return L->Platform == Platform && L->Width == Width && L->Height == Height && L->BytesPerBlock == BytesPerBlock && L->Param == Param;
+}
+
+// Find cached layout. When not found, returns a new layout which should be filled by caller,
+// with Runs array empty. Layout should be returned with ReleaseUntileLayout().
+static CUntileLayout* AcquireUntileLayout(int Platform, int Width, int Height, int BytesPerBlock, int Param)
+{
+	{
+		CScopedLock Lock(GUntileLock);
+		for (int i = 0; i < MAX_UNTILE_LAYOUTS; i++)
+		{
+			CUntileLayout* L = GUntileLayouts[i];
+			if (L && MatchUntileLayout(L, Platform, Width, Height, BytesPerBlock, Param))
+			{
+				GUntileLayoutTime[i] = ++GUntileTime;
+				L->RefCount++;
+				return L;
+			}
+		}
+	}
+	CUntileLayout* L = new CUntileLayout;
+	L->Init(Platform, Width, Height, BytesPerBlock, Param);
+	L->RefCount = 1;
+	L->IsCached = false;
+	return L;
+}
+
+// Release the layout; new complete layout is put to the cache replacing least recently used one
+static void ReleaseUntileLayout(CUntileLayout* L)
+{
+	CScopedLock Lock(GUntileLock);
+	if (L->IsCached)
+	{
+		L->RefCount--;
+		return;
+	}
+
+	// find a slot for the new layout
+	int Slot = -1;
+	for (int i = 0; i < MAX_UNTILE_LAYOUTS && L->RowRuns.Num(); i++)
+	{
+		CUntileLayout* L2 = GUntileLayouts[i];
+		if (L2 && MatchUntileLayout(L2, L->Platform, L->Width, L->Height, L->BytesPerBlock, L->Param))
+		{
+			// the same layout was cached by another thread
+			Slot = -1;
+			break;
+		}
+		if (L2 && L2->RefCount) continue;
+		if (Slot < 0 || !L2 || (GUntileLayouts[Slot] && GUntileLayoutTime[i] < GUntileLayoutTime[Slot]))
+			Slot = i;
+	}
+	if (Slot < 0)
+	{
+		delete L;
+		return;
+	}
+	delete GUntileLayouts[Slot];
+	L->RefCount = 0;
+	L->IsCached = true;
+	GUntileLayouts[Slot] = L;
+	GUntileLayoutTime[Slot] = ++GUntileTime;
+}
+
+// Holds a layout while it is built and used
+struct CUntileLayoutRef
+{
+	CUntileLayout* L;
+
+	CUntileLayoutRef(int Platform, int Width, int Height, int BytesPerBlock, int Param)
+	{
+		L = AcquireUntileLayout(Platform, Width, Height, BytesPerBlock, Param);
+	}
+	~CUntileLayoutRef()
+	{
+		ReleaseUntileLayout(L);
+	}
+	CUntileLayout* operator->() const
+	{
+		return L;
+	}
+	CUntileLayout& operator*() const
+	{
+		return *L;
+	}
+};
+
+// Copy data swapping byte order of 16-bit or 32-bit values
+static void CopySwapped(byte* dst, const byte* src, int size, int swapSize)
+{
+	int i = 0;
+	if (swapSize == 2)
+	{
+		for ( ; i + 16 <= size; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			_mm_storeu_si128((__m128i*)(dst + i), v);
+		}
+		for ( ; i + 2 <= size; i += 2)
+		{
+			dst[i]     = src[i + 1];
+			dst[i + 1] = src[i];
+		}
+	}
+	else // if (swapSize == 4)
+	{
+		for ( ; i + 16 <= size; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);	// swap words
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));	// swap bytes in words
+			_mm_storeu_si128((__m128i*)(dst + i), v);
+		}
+		for ( ; i + 4 <= size; i += 4)
+		{
+			dst[i]     = src[i + 3];
+			dst[i + 1] = src[i + 2];
+			dst[i + 2] = src[i + 1];
+			dst[i + 3] = src[i];
+		}
+	}
+}
+
+struct CUntileContext
+{
+	const CUntileLayout* Layout;
+	const byte*		Src;
+	byte*			Dst;
+	int				SwapSize;
+	int				RowsPerJob;
+};
+
+static void UntileRows(int Job, CUntileContext& Ctx)
+{
+	const CUntileLayout& L = *Ctx.Layout;
+	int Row = Job * Ctx.RowsPerJob;
+	int FirstRun = L.RowRuns[Row];
+	int LastRun = L.RowRuns[min(Row + Ctx.RowsPerJob, L.Height)];
+	for (int i = FirstRun; i < LastRun; i++)
+	{
+		const CUntileRun& Run = L.Runs[i];
+		if (Ctx.SwapSize > 1)
+			CopySwapped(Ctx.Dst + Run.DstOffset, Ctx.Src + Run.SrcOffset, Run.Size, Ctx.SwapSize);
+		else
+			memcpy(Ctx.Dst + Run.DstOffset, Ctx.Src + Run.SrcOffset, Run.Size);
+	}
+}
+
+// Perform untiling, optionally swapping bytes of 16-bit (SwapSize=2) or 32-bit (SwapSize=4) values
+static void ApplyUntileLayout(const CUntileLayout& L, const byte* src, byte* dst, int SwapSize = 0)
+{
+	guard(ApplyUntileLayout);
+
+	if (!L.Height) return;
+
+	CUntileContext Ctx;
+	Ctx.Layout = &L;
+	Ctx.Src = src;
+	Ctx.Dst = dst;
+	Ctx.SwapSize = SwapSize;
+	// starting threads costs more than copying a small texture
+	if (L.Width * L.Height * L.BytesPerBlock < (256 << 10))
+		Ctx.RowsPerJob = L.Height;
+	else
+		Ctx.RowsPerJob = GetBlockRowsPerJob(L.Height);
+	appParallelFor((L.Height + Ctx.RowsPerJob - 1) / Ctx.RowsPerJob, UntileRows, Ctx);
+
+	unguard;
+}
+
+#endif // SUPPORT_XBOX360 || SUPPORT_PS4 || SUPPORT_SWITCH
+
+
 /*-----------------------------------------------------------------------------
 	XBox360 texture decompression
 -----------------------------------------------------------------------------*/
@@ -514,52 +1021,12 @@ static unsigned GetXbox360TiledOffset(int x, int y, int width, int logBpb)
 			) >> logBpb;
 }
 
-// Untile decompressed texture. The function also removes U alignment when originalWidth < tiledWidth
-// Note: this function is no longer used, and now it is outdated. UntileCompressedXbox360Texture is now used and up-to-date.
-static void UntileXbox360Texture(const unsigned *src, unsigned *dst, int tiledWidth, int originalWidth, int height, int blockSizeX, int blockSizeY, int bytesPerBlock)
-{
-	guard(UntileXbox360Texture);
-
-	int blockWidth          = tiledWidth / blockSizeX;			// width of image in blocks
-	int originalBlockWidth  = originalWidth / blockSizeX;		// width of image in blocks
-	int blockHeight         = height / blockSizeY;				// height of image in blocks
-	int logBpp              = appLog2(bytesPerBlock);
-
-	int numImageBlocks = blockWidth * blockHeight;				// used for verification
-
-	// iterate over image blocks
-	for (int y = 0; y < blockHeight; y++)
-	{
-		for (int x = 0; x < originalBlockWidth; x++)			// process only a part of image when originalWidth < tiledWidth
-		{
-			unsigned swzAddr = GetXbox360TiledOffset(x, y, blockWidth, logBpp);	// do once for whole block
-			assert(swzAddr < numImageBlocks);
-			int sy = swzAddr / blockWidth;
-			int sx = swzAddr % blockWidth;
-			// copy block per-pixel from [sx,sy] to [x,y]
-			int y2 = y * blockSizeY;
-			int y3 = sy * blockSizeY;
-			for (int y1 = 0; y1 < blockSizeY; y1++, y2++, y3++)
-			{
-				// copy line of blockSizeX pixels
-				int x2 = x * blockSizeX;
-				int x3 = sx * blockSizeX;
-				unsigned       *pDst = dst + y2 * originalWidth + x2;
-				const unsigned *pSrc = src + y3 * tiledWidth + x3;
-				for (int x1 = 0; x1 < blockSizeX; x1++)
-					*pDst++ = *pSrc++;
-			}
-		}
-	}
-	unguard;
-}
-
 // Untile compressed texture - it will remains compressed, but in PC format instead of XBox360.
 // This function also removes U alignment when originalWidth < tiledWidth
 //!! Note: this function doesn't work well with non-square textures - UModel will not crash, but textures
 //!! will not appear correctly. Example (from Gears of War 3):
 //!!   umodel GearGame.xxx -game=gowj T_Ramp_Right_To_Left
-static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiledWidth, int originalWidth, int tiledHeight, int originalHeight, int blockSizeX, int blockSizeY, int bytesPerBlock)
+static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiledWidth, int originalWidth, int tiledHeight, int originalHeight, int blockSizeX, int blockSizeY, int bytesPerBlock, int swapSize)
 {
 	guard(UntileCompressedXbox360Texture);
 
@@ -595,21 +1062,26 @@ static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiled
 
 	int numImageBlocks = tiledBlockWidth * tiledBlockHeight;	// used for verification
 
-	// Iterate over image blocks
-	for (int dy = 0; dy < originalBlockHeight; dy++)
+	CUntileLayoutRef L(UNTILE_XBOX360, originalBlockWidth, originalBlockHeight, bytesPerBlock, tiledBlockWidth | (sxOffset << 16));
+	if (!L->RowRuns.Num())
 	{
-		for (int dx = 0; dx < originalBlockWidth; dx++)
+		// Iterate over image blocks
+		for (int dy = 0; dy < originalBlockHeight; dy++)
 		{
-			unsigned swzAddr = GetXbox360TiledOffset(dx + sxOffset, dy, tiledBlockWidth, logBpp);	// do once for whole block
-			assert(swzAddr < numImageBlocks);
-			int sy = swzAddr / tiledBlockWidth;
-			int sx = swzAddr % tiledBlockWidth;
-
-			byte       *pDst = dst + (dy * originalBlockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + (sy * tiledBlockWidth    + sx) * bytesPerBlock;
-			memcpy(pDst, pSrc, bytesPerBlock);
+			L->BeginRow();
+			for (int dx = 0; dx < originalBlockWidth; dx++)
+			{
+				unsigned swzAddr = GetXbox360TiledOffset(dx + sxOffset, dy, tiledBlockWidth, logBpp);	// do once for whole block
+				int sy = swzAddr / tiledBlockWidth;
+				int sx = swzAddr % tiledBlockWidth;
+				L->AddBlock(dx, dy, (sy * tiledBlockWidth + sx) * bytesPerBlock);
+			}
 		}
+		L->EndLayout();
 	}
+	assert(L->MaxSrcOffset < numImageBlocks * bytesPerBlock);
+
+	ApplyUntileLayout(*L, src, dst, swapSize);
 	unguard;
 }
 
@@ -688,21 +1160,16 @@ bool CTextureData::DecodeXBox360(int MipLevel)
 		}
 	}
 
-	// untile and unalign
-	byte *buf = (byte*)appMalloc(Mip.DataSize);   	// older code: 'Mip.DataSize * 16'; perhaps should use Mip.USize * Mip.VSize * BytesPerPixel
-	UntileCompressedXbox360Texture(Mip.CompressedData, buf, USize1, Mip.USize, VSize1, Mip.VSize, Info.BlockSizeX, Info.BlockSizeY, Info.BytesPerBlock);
-
-	// swap bytes
+	// swap bytes: dwords for 32-bit formats, words for everything else
+	int swapSize = 0;
 	if (Format == TPF_RGBA8 || Format == TPF_BGRA8)
-	{
-		// Swap dwords for 32-bit formats
-		appReverseBytes(buf, Mip.DataSize / 4, 4);
-	}
+		swapSize = 4;
 	else if (Info.BytesPerBlock > 1)
-	{
-		// Swap words for everything else
-		appReverseBytes(buf, Mip.DataSize / 2, 2);
-	}
+		swapSize = 2;
+
+	// untile, unalign and swap bytes
+	byte *buf = (byte*)appMalloc(Mip.DataSize);   	// older code: 'Mip.DataSize * 16'; perhaps should use Mip.USize * Mip.VSize * BytesPerPixel
+	UntileCompressedXbox360Texture(Mip.CompressedData, buf, USize1, Mip.USize, VSize1, Mip.VSize, Info.BlockSizeX, Info.BlockSizeY, Info.BytesPerBlock, swapSize);
 
 	Mip.SetOwnedDataBuffer(buf, max(Mip.USize / Info.BlockSizeX, 1) * max(Mip.VSize / Info.BlockSizeY, 1) * Info.BytesPerBlock);
 	return true;	// no error
@@ -753,31 +1220,45 @@ static void UntileCompressedPS4Texture(const byte *src, byte *dst, int width, in
 	int blockWidth = width / blockSizeX;			// width of image in blocks
 	int blockHeight = height / blockSizeY;			// height of image in blocks
 
-	// PS4 image is encoded as 8x8 block min
-	int blockWidth2 = max(blockWidth, 8);
-	int blockHeight2 = max(blockHeight, 8);
-
-	// Iterate over image blocks
-	for (int sy = 0; sy < blockHeight2; sy++)
+	CUntileLayoutRef L(UNTILE_PS4, blockWidth, blockHeight, bytesPerBlock, 0);
+	if (!L->RowRuns.Num())
 	{
-		for (int sx = 0; sx < blockWidth2; sx++)
+		// PS4 image is encoded as 8x8 block min
+		int blockWidth2 = max(blockWidth, 8);
+		int blockHeight2 = max(blockHeight, 8);
+		int numBlocks2 = blockWidth2 * blockHeight2;
+
+		// Tiling function maps source blocks to the destination image, build inverse mapping
+		TArray<int> srcBlocks;
+		srcBlocks.AddUninitialized(numBlocks2);
+		memset(srcBlocks.GetData(), 0xFF, numBlocks2 * sizeof(int));
+		for (int sy = 0; sy < blockHeight2; sy++)
 		{
-			unsigned swzAddr = GetPS4TiledOffset(sx, sy, blockWidth2);	// do once for whole block
-			int dy = swzAddr / blockWidth2;
-			int dx = swzAddr % blockWidth2;
-			if (dx >= blockWidth || dy >= blockHeight)
+			for (int sx = 0; sx < blockWidth2; sx++)
 			{
-				// We're sampling over source image coordinates which could be
-				// larger than target image, so perform clamping
-				continue;
+				unsigned swzAddr = GetPS4TiledOffset(sx, sy, blockWidth2);	// do once for whole block
+				if (swzAddr < numBlocks2)
+					srcBlocks[swzAddr] = sy * blockWidth2 + sx;
 			}
+		}
 
-			byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + (sy * blockWidth2 + sx) * bytesPerBlock;
-			memcpy(pDst, pSrc, bytesPerBlock);
+		// We're sampling over source image coordinates which could be
+		// larger than target image, so perform clamping
+		for (int dy = 0; dy < blockHeight; dy++)
+		{
+			L->BeginRow();
+			for (int dx = 0; dx < blockWidth; dx++)
+			{
+				int srcBlock = srcBlocks[dy * blockWidth2 + dx];
+				if (srcBlock >= 0)
+					L->AddBlock(dx, dy, srcBlock * bytesPerBlock);
+			}
 		}
+		L->EndLayout();
 	}
 
+	ApplyUntileLayout(*L, src, dst);
+
 	unguard;
 }
 
@@ -874,38 +1355,41 @@ static bool UntileCompressedNSWTexture(const byte *src, int dataSize, byte *dst,
 //	appPrintf("mip: %d x %d (%d/%d x %d/%d) data: comp: %X, real: %X\n",
 //		blockWidth, blockHeight, width, blockSizeX, height, blockSizeY,
 //		blockWidth * blockHeight * bytesPerBlock, dataSize);
-	// Iterate over image blocks
-	for (int dy = 0; dy < blockHeight; dy++)
+	CUntileLayoutRef L(UNTILE_NSW, blockWidth, blockHeight, bytesPerBlock, blockSizeX == 1 && blockSizeY == 1);
+	if (!L->RowRuns.Num())
 	{
-		for (int dx = 0; dx < blockWidth; dx++)
+		// Iterate over image blocks
+		for (int dy = 0; dy < blockHeight; dy++)
 		{
-			int x_coord_in_block = dx * bytesPerBlock;
-			int y_coord_in_block = dy;
-			unsigned gobOffset =
-				(x_coord_in_block / bytes_per_gob_x) * bytes_per_gob_y +
-				y_coord_in_block / (bytes_per_gob_y * 8) * bytes_per_gob_y * gobs_per_block_x +
-				(y_coord_in_block % (bytes_per_gob_y * 8) >> 3);
-			gobOffset = gobOffset * 512; // should be gob_bytes, but this won't work for (bytes_per_gob_y != 8), so we'll use a constant here
-
-			unsigned offset =
-				(((x_coord_in_block & 0x3f) >> 5) << 8) + //?? 0011.1111 >> 5 -> 0001, i.e. mask 1 bit and shift it to appropriate position
-				(((y_coord_in_block &    7) >> 1) << 6) +
-				(((x_coord_in_block & 0x1f) >> 4) << 5) +
-				( (y_coord_in_block &    1)       << 4) +
-				(  x_coord_in_block &  0xf            );
-
-			unsigned swzAddr = gobOffset + offset;
-//			if (swzAddr >= dataSize) appPrintf("x=%d/%d, y=%d/%d, sy=%d, swzAddr=%d+%d->%d >= %d\n",
-//				dx, blockWidth, dy, blockHeight, bytes_per_gob_y, gobOffset, offset, swzAddr, dataSize);
-			if (swzAddr >= dataSize)
-				return false; // failed, something's wrong with parameters or decoder
-
-			byte       *pDst = dst + (dy * blockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + swzAddr;
-			memcpy(pDst, pSrc, bytesPerBlock);
+			L->BeginRow();
+			for (int dx = 0; dx < blockWidth; dx++)
+			{
+				int x_coord_in_block = dx * bytesPerBlock;
+				int y_coord_in_block = dy;
+				unsigned gobOffset =
+					(x_coord_in_block / bytes_per_gob_x) * bytes_per_gob_y +
+					y_coord_in_block / (bytes_per_gob_y * 8) * bytes_per_gob_y * gobs_per_block_x +
+					(y_coord_in_block % (bytes_per_gob_y * 8) >> 3);
+				gobOffset = gobOffset * 512; // should be gob_bytes, but this won't work for (bytes_per_gob_y != 8), so we'll use a constant here
+
+				unsigned offset =
+					(((x_coord_in_block & 0x3f) >> 5) << 8) + //?? 0011.1111 >> 5 -> 0001, i.e. mask 1 bit and shift it to appropriate position
+					(((y_coord_in_block &    7) >> 1) << 6) +
+					(((x_coord_in_block & 0x1f) >> 4) << 5) +
+					( (y_coord_in_block &    1)       << 4) +
+					(  x_coord_in_block &  0xf            );
+
+				L->AddBlock(dx, dy, gobOffset + offset);
+			}
 		}
+		L->EndLayout();
 	}
 
+	if (L->Runs.Num() && L->MaxSrcOffset >= dataSize)
+		return false; // failed, something's wrong with parameters or decoder
+
+	ApplyUntileLayout(*L, src, dst);
+
 	return true;
 	unguard;
 }
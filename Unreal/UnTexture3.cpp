@@ -4,6 +4,7 @@
 #include "UnMaterial.h"
 #include "UnMaterial3.h"
 #include "UnPackage.h"
+#include "Parallel.h"
 
 
 /*-----------------------------------------------------------------------------
@@ -16,7 +17,8 @@
 {
 	guard(FTexture2DMipMap::Serialize3);
 
-	Mip.Data.Serialize(Ar);
+	// data will be loaded on demand by UTexture2D::GetTextureData()
+	Mip.Data.Serialize(Ar, true);
 #if DARKVOID
 	if (Ar.Game == GAME_DarkVoid)
 	{
@@ -644,6 +646,349 @@ static int GetRealTextureOffset_MH(const UTexture2D *Obj, int MipIndex)
 #endif // MARVEL_HEROES
 
 
+/*-----------------------------------------------------------------------------
+	Texture file cache (TFC) manager
+-----------------------------------------------------------------------------*/
+
+// Textures exported from a single package usually reference the same few TFC
+// files. Keep one reader per file open for the whole export session instead
+// of reopening it for every mip, and remember decompressed mips: the same mip
+// could be requested several times (e.g. viewed and then exported), so it is
+// decoded only once.
+
+#define TFC_CHUNK_CACHE_SIZE	(64 << 20)		// limit for decompressed data held in cache
+#define TFC_CHUNK_HASH_SIZE		1024
+
+struct CTfcFile;
+
+// Decompressed data of a single mip
+struct CTfcChunk
+{
+	CTfcFile*			Owner;
+	int64				Offset;					// position of the compressed mip data in file
+	uint32				BulkDataFlags;			// compression flags used for this mip
+	int					DataSize;				// decompressed size
+	byte*				Data;					// NULL while the chunk is being loaded
+	int					RefCount;				// number of threads copying Data, chunk can't be released
+	CTfcChunk*			HashNext;
+	// LRU list of loaded chunks, most recently used chunk is at the head
+	CTfcChunk*			Prev;
+	CTfcChunk*			Next;
+};
+
+struct CTfcFile
+{
+	FString				CacheName;				// TextureFileCacheName as stored in texture
+	FString				Suffix;					// tfcSuffix used for lookup
+	const CGameFileInfo* File;					// NULL when file is missing
+	FArchive*			Reader;					// created on demand
+	CMutex				ReaderLock;				// Reader is used by a single thread at a time
+};
+
+// Textures could be decoded from several threads. GTfcLock protects the list of files and
+// the chunk cache, it is held only for lookup and insertion. File reading and decompression
+// are done without it.
+static CMutex GTfcLock;
+static TArray<CTfcFile*> GTfcFiles;
+static CTfcChunk* GTfcChunkHash[TFC_CHUNK_HASH_SIZE];
+static CTfcChunk* GTfcLruHead = NULL;
+static CTfcChunk* GTfcLruTail = NULL;
+static int GTfcCacheSize = 0;
+
+static void LinkTfcChunk(CTfcChunk* Chunk)
+{
+	Chunk->Prev = NULL;
+	Chunk->Next = GTfcLruHead;
+	if (GTfcLruHead)
+		GTfcLruHead->Prev = Chunk;
+	else
+		GTfcLruTail = Chunk;
+	GTfcLruHead = Chunk;
+}
+
+static void UnlinkTfcChunk(CTfcChunk* Chunk)
+{
+	if (Chunk->Prev)
+		Chunk->Prev->Next = Chunk->Next;
+	else
+		GTfcLruHead = Chunk->Next;
+	if (Chunk->Next)
+		Chunk->Next->Prev = Chunk->Prev;
+	else
+		GTfcLruTail = Chunk->Prev;
+}
+
+static const CGameFileInfo* FindTfcGameFile(const char* TextureFileCacheName, const char* tfcSuffix)
+{
+	const CGameFileInfo* bulkFile = NULL;
+	char bulkFileName[256];
+	static const char* tfcExtensions[] = { "tfc", "xxx" };
+	for (int i = 0; i < ARRAY_COUNT(tfcExtensions); i++)
+	{
+		appStrncpyz(bulkFileName, TextureFileCacheName, ARRAY_COUNT(bulkFileName));
+		if (char* s = strchr(bulkFileName, '.'))
+		{
+			// MK X has string with file extension - cut it
+			if (!stricmp(s, ".tfc") || !stricmp(s, ".xxx"))
+				*s = 0;
+		}
+		const char* bulkFileExt = tfcExtensions[i];
+		bulkFile = appFindGameFile(bulkFileName, bulkFileExt);
+		if (bulkFile) break;
+#if SUPPORT_ANDROID
+		if (!bulkFile)
+		{
+			if (!tfcSuffix) tfcSuffix = "DXT";
+			char androidName[256];
+			appSprintf(ARRAY_ARG(androidName), "%s_%s", bulkFileName, tfcSuffix);
+			bulkFile = appFindGameFile(androidName, bulkFileExt);
+			if (bulkFile) break;
+		}
+#endif // SUPPORT_ANDROID
+	}
+	return bulkFile;
+}
+
+// When File is not NULL, it is used instead of looking for TFC file by name
+static CTfcFile* FindTfcFile(const char* TextureFileCacheName, const char* tfcSuffix, const CGameFileInfo* File = NULL)
+{
+	guard(FindTfcFile);
+
+	CScopedLock Lock(GTfcLock);
+
+	const char* Suffix = tfcSuffix ? tfcSuffix : "";
+	for (int i = 0; i < GTfcFiles.Num(); i++)
+	{
+		CTfcFile* Tfc = GTfcFiles[i];
+		if (!stricmp(*Tfc->CacheName, TextureFileCacheName) && !stricmp(*Tfc->Suffix, Suffix))
+			return Tfc;
+	}
+
+	// not seen yet - resolve the file name (result is cached even when file is missing)
+	CTfcFile* Tfc = new CTfcFile;
+	Tfc->CacheName = TextureFileCacheName;
+	Tfc->Suffix = Suffix;
+	Tfc->File = File ? File : FindTfcGameFile(TextureFileCacheName, tfcSuffix);
+	Tfc->Reader = NULL;
+	GTfcFiles.Add(Tfc);
+	return Tfc;
+
+	unguardf("%s", TextureFileCacheName);
+}
+
+static int GetTfcChunkHash(const CTfcFile* Tfc, int64 Offset)
+{
+	uint32 Hash = (uint32)((size_t)Tfc >> 4) ^ (uint32)Offset ^ (uint32)(Offset >> 17);
+	return Hash & (TFC_CHUNK_HASH_SIZE - 1);
+}
+
+// Find the chunk of the mip. Should be called with GTfcLock held.
+static CTfcChunk* FindTfcChunk(const CTfcFile* Tfc, const FByteBulkData* Bulk, int DataSize)
+{
+	for (CTfcChunk* Chunk = GTfcChunkHash[GetTfcChunkHash(Tfc, Bulk->BulkDataOffsetInFile)]; Chunk; Chunk = Chunk->HashNext)
+	{
+		if (Chunk->Owner == Tfc && Chunk->Offset == Bulk->BulkDataOffsetInFile &&
+			Chunk->BulkDataFlags == Bulk->BulkDataFlags && Chunk->DataSize == DataSize)
+		{
+			return Chunk;
+		}
+	}
+	return NULL;
+}
+
+// Remove the chunk from cache, should be called with GTfcLock held
+static void FreeTfcChunk(CTfcChunk* Chunk)
+{
+	assert(!Chunk->RefCount);
+	CTfcChunk** Link = &GTfcChunkHash[GetTfcChunkHash(Chunk->Owner, Chunk->Offset)];
+	while (*Link != Chunk)
+		Link = &(*Link)->HashNext;
+	*Link = Chunk->HashNext;
+	if (Chunk->Data)
+	{
+		UnlinkTfcChunk(Chunk);
+		GTfcCacheSize -= Chunk->DataSize;
+		appFree(Chunk->Data);
+	}
+	delete Chunk;
+}
+
+static void CancelTfcChunk(CTfcChunk* Chunk)
+{
+	CScopedLock Lock(GTfcLock);
+	FreeTfcChunk(Chunk);
+}
+
+// Read bulk data using persistent reader of the file. Compressed data is read with the
+// reader locked, decompression is performed without locks.
+static void LoadTfcBulk(CTfcFile* Tfc, const UnPackage* Package, FByteBulkData* Bulk, bool bCompressed)
+{
+	guard(LoadTfcBulk);
+
+	if (!bCompressed)
+	{
+		CScopedLock Lock(Tfc->ReaderLock);
+		if (!Tfc->Reader)
+			Tfc->Reader = Tfc->File->CreateReader();
+		Tfc->Reader->SetupFrom(*Package);
+		Bulk->SerializeData(*Tfc->Reader);
+		return;
+	}
+
+	// Read chunk header and compressed blocks. Size is computed from the header, because
+	// BulkDataSizeOnDisk is known to be wrong in some games.
+	TArray<byte> CompressedData;
+	{
+		CScopedLock Lock(Tfc->ReaderLock);
+		if (!Tfc->Reader)
+			Tfc->Reader = Tfc->File->CreateReader();
+		FArchive* Ar = Tfc->Reader;
+		Ar->SetupFrom(*Package);
+		Ar->Seek64(Bulk->BulkDataOffsetInFile);
+		FCompressedChunkHeader ChunkHeader;
+		*Ar << ChunkHeader;
+		int64 Size = Ar->Tell64() - Bulk->BulkDataOffsetInFile;
+		for (int i = 0; i < ChunkHeader.Blocks.Num(); i++)
+			Size += ChunkHeader.Blocks[i].CompressedSize;
+		if (Bulk->BulkDataOffsetInFile + Size > Ar->GetFileSize64())
+			appError("Compressed data is out of file bounds (size %llX)", Size);
+		CompressedData.AddUninitialized((int)Size);
+		Ar->Seek64(Bulk->BulkDataOffsetInFile);
+		Ar->Serialize(CompressedData.GetData(), (int)Size);
+	}
+
+	FMemReader Reader(CompressedData.GetData(), CompressedData.Num());
+	Reader.SetupFrom(*Package);
+	Bulk->SerializeDataChunk(Reader);
+
+	unguard;
+}
+
+// Load data of the chunk which was registered as "loading". Chunk is removed from cache
+// in a case of error, so it won't stay in "loading" state.
+static void LoadTfcChunk(CTfcChunk* Chunk, const UnPackage* Package, FByteBulkData* Bulk)
+{
+	TRY
+	{
+		LoadTfcBulk(Chunk->Owner, Package, Bulk, true);
+	}
+	CATCH
+	{
+		CancelTfcChunk(Chunk);
+		THROW_AGAIN;
+	}
+}
+
+// Read bulk data using persistent reader and decompressed mip cache
+static void ReadTfcBulk(CTfcFile* Tfc, const UnPackage* Package, FByteBulkData* Bulk)
+{
+	guard(ReadTfcBulk);
+
+	int DataSize = Bulk->ElementCount * Bulk->GetElementSize();
+	bool bCompressed = (Bulk->BulkDataFlags & (BULKDATA_CompressedLzo | BULKDATA_CompressedZlib | BULKDATA_CompressedLzx)) != 0;
+	if (!bCompressed || !DataSize || DataSize > TFC_CHUNK_CACHE_SIZE / 4)
+	{
+		// uncompressed data is cheap to read, and huge blocks would flush everything else
+		LoadTfcBulk(Tfc, Package, Bulk, bCompressed);
+		return;
+	}
+
+	CTfcChunk* Chunk;
+	bool bLoad = false;
+	{
+		CScopedLock Lock(GTfcLock);
+		Chunk = FindTfcChunk(Tfc, Bulk, DataSize);
+		if (!Chunk)
+		{
+			// register the chunk in "loading" state, so other threads won't load it too
+			Chunk = new CTfcChunk;
+			Chunk->Owner = Tfc;
+			Chunk->Offset = Bulk->BulkDataOffsetInFile;
+			Chunk->BulkDataFlags = Bulk->BulkDataFlags;
+			Chunk->DataSize = DataSize;
+			Chunk->Data = NULL;
+			Chunk->RefCount = 0;
+			int Hash = GetTfcChunkHash(Tfc, Chunk->Offset);
+			Chunk->HashNext = GTfcChunkHash[Hash];
+			GTfcChunkHash[Hash] = Chunk;
+			bLoad = true;
+		}
+		else if (Chunk->Data)
+		{
+			// cache hit, data will be copied without the lock
+			Chunk->RefCount++;
+			UnlinkTfcChunk(Chunk);
+			LinkTfcChunk(Chunk);
+		}
+		else
+		{
+			// the mip is being loaded by another thread, don't wait for it
+			Chunk = NULL;
+		}
+	}
+
+	if (!Chunk)
+	{
+		LoadTfcBulk(Tfc, Package, Bulk, true);
+		return;
+	}
+
+	if (!bLoad)
+	{
+		if (Bulk->BulkData) appFree(Bulk->BulkData);
+		Bulk->BulkData = (byte*)appMalloc(DataSize);
+		memcpy(Bulk->BulkData, Chunk->Data, DataSize);
+		CScopedLock Lock(GTfcLock);
+		Chunk->RefCount--;
+		return;
+	}
+
+	LoadTfcChunk(Chunk, Package, Bulk);
+
+	byte* Data = (byte*)appMalloc(DataSize);
+	memcpy(Data, Bulk->BulkData, DataSize);
+
+	// put decompressed data to cache, release least recently used chunks
+	CScopedLock Lock(GTfcLock);
+	CTfcChunk* Old = GTfcLruTail;
+	while (Old && GTfcCacheSize + DataSize > TFC_CHUNK_CACHE_SIZE)
+	{
+		CTfcChunk* Prev = Old->Prev;
+		if (!Old->RefCount)
+			FreeTfcChunk(Old);
+		Old = Prev;
+	}
+	Chunk->Data = Data;
+	LinkTfcChunk(Chunk);
+	GTfcCacheSize += DataSize;
+
+	unguard;
+}
+
+void UTexture2D::ReleaseTextureFileCache()
+{
+	guard(UTexture2D::ReleaseTextureFileCache);
+
+	CScopedLock Lock(GTfcLock);
+
+	for (int i = 0; i < TFC_CHUNK_HASH_SIZE; i++)
+	{
+		while (GTfcChunkHash[i])
+			FreeTfcChunk(GTfcChunkHash[i]);
+	}
+	for (int i = 0; i < GTfcFiles.Num(); i++)
+	{
+		CTfcFile* Tfc = GTfcFiles[i];
+		if (Tfc->Reader) delete Tfc->Reader;
+		delete Tfc;
+	}
+	GTfcFiles.Empty();
+	assert(GTfcCacheSize == 0 && !GTfcLruHead);
+
+	unguard;
+}
+
+
 bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int MipIndex, const char* tfcSuffix, bool verbose) const
 {
 	const CGameFileInfo* bulkFile = NULL;
@@ -653,34 +998,14 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 	const FTexture2DMipMap &Mip = MipsArray[MipIndex];
 
 	// Here: data is either in TFC file or in other package
+	CTfcFile* Tfc = NULL;
 	char bulkFileName[256];
 	bulkFileName[0] = 0;
 	if (TextureFileCacheName != "None")
 	{
 		// TFC file is assigned
-		static const char* tfcExtensions[] = { "tfc", "xxx" };
-		for (int i = 0; i < ARRAY_COUNT(tfcExtensions); i++)
-		{
-			strcpy(bulkFileName, TextureFileCacheName);
-			if (char* s = strchr(bulkFileName, '.'))
-			{
-				// MK X has string with file extension - cut it
-				if (!stricmp(s, ".tfc") || !stricmp(s, ".xxx"))
-					*s = 0;
-			}
-			const char* bulkFileExt = tfcExtensions[i];
-			bulkFile = appFindGameFile(bulkFileName, bulkFileExt);
-			if (bulkFile) break;
-#if SUPPORT_ANDROID
-			if (!bulkFile)
-			{
-				if (!tfcSuffix) tfcSuffix = "DXT";
-				appSprintf(ARRAY_ARG(bulkFileName), "%s_%s", bulkFileName, tfcSuffix);
-				bulkFile = appFindGameFile(bulkFileName, bulkFileExt);
-				if (bulkFile) break;
-			}
-#endif // SUPPORT_ANDROID
-		}
+		Tfc = FindTfcFile(TextureFileCacheName, tfcSuffix);
+		bulkFile = Tfc->File;
 		if (!bulkFile)
 		{
 			appPrintf("Decompressing %s: TFC file \"%s\" is missing\n", Name, *TextureFileCacheName);
@@ -723,6 +1048,8 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 			appPrintf("Decompressing %s: package %s is missing\n", Name, bulkFileName);
 			return false;
 		}
+		// share reader and block cache with TFC files, use a key which can't collide with TFC names
+		Tfc = FindTfcFile(va("*%s", *bulkFile->GetRelativeName()), NULL, bulkFile);
 	}
 
 	assert(bulkFile);									// missing file is processed above
@@ -731,8 +1058,6 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 		appPrintf("Reading %s mip level %d (%dx%d) from %s\n", Name, MipIndex, Mip.SizeX, Mip.SizeY, *bulkFile->GetRelativeName());
 	}
 
-	FArchive *Ar = bulkFile->CreateReader();
-	Ar->SetupFrom(*Package);
 	FByteBulkData *Bulk = const_cast<FByteBulkData*>(&Mip.Data);
 	if (Bulk->BulkDataOffsetInFile < 0)
 	{
@@ -760,8 +1085,7 @@ bool UTexture2D::LoadBulkTexture(const TArray<FTexture2DMipMap> &MipsArray, int
 		}
 	}
 //	appPrintf("Bulk %X %llX [%d] f=%X\n", Bulk, Bulk->BulkDataOffsetInFile, Bulk->ElementCount, Bulk->BulkDataFlags);
-	Bulk->SerializeData(*Ar);
-	delete Ar;
+	ReadTfcBulk(Tfc, Package, Bulk);
 	return true;
 
 	unguardf("File=%s Mip=%d", bulkFile ? *bulkFile->GetRelativeName() : "none", MipIndex);
@@ -930,6 +1254,8 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 		int OrigVSize = (*MipsArray)[0].SizeY;
 		for (int mipLevel = 0; mipLevel < MipsArray->Num(); mipLevel++)
 		{
+			// don't load mips which caller doesn't need
+			if (TexData.MaxMips > 0 && TexData.Mips.Num() >= TexData.MaxMips) break;
 			// find 1st mipmap with non-null data array
 			// reference: DemoPlayerSkins.utx/DemoSkeleton have null-sized 1st 2 mips
 			const FTexture2DMipMap &Mip = (*MipsArray)[mipLevel];
@@ -941,17 +1267,28 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 				//!! * -notfc cmdline switch
 				//!! * material viewer: support switching mip levels (for xbox decompression testing)
 				if (Bulk.BulkDataFlags & BULKDATA_Unused) continue;		// mip level is stripped
-				if (!(Bulk.BulkDataFlags & BULKDATA_StoreInSeparateFile)) continue; // equals to BULKDATA_PayloadAtEndOfFile for UE4
-				// some optimization in a case of missing bulk file
-				if (bulkFailed) continue;				// already checked for previous mip levels - no TFC file exists
-				if (!LoadBulkTexture(*MipsArray, mipLevel, tfcSuffix, !dataLoaded))
+				if (Bulk.bDeferredLoad)
 				{
-					bulkFailed = true;
-					continue;	// note: this could be called for any mip level, not for the 1st only
+					// data is in this package, it was not loaded with the texture object;
+					// package reader could be already closed
+					Package->OpenReader();
+					const_cast<FByteBulkData&>(Bulk).LoadDeferredData(*Package);
+					if (!Bulk.BulkData) continue;
 				}
 				else
 				{
-					dataLoaded = true;
+					if (!(Bulk.BulkDataFlags & BULKDATA_StoreInSeparateFile)) continue; // equals to BULKDATA_PayloadAtEndOfFile for UE4
+					// some optimization in a case of missing bulk file
+					if (bulkFailed) continue;			// already checked for previous mip levels - no TFC file exists
+					if (!LoadBulkTexture(*MipsArray, mipLevel, tfcSuffix, !dataLoaded))
+					{
+						bulkFailed = true;
+						continue;	// note: this could be called for any mip level, not for the 1st only
+					}
+					else
+					{
+						dataLoaded = true;
+					}
 				}
 			}
 			// this mipmap has data
@@ -30,13 +30,10 @@ void FTexture2DMipMap::Serialize4(FArchive &Ar, FTexture2DMipMap& Mip)
 	if (Ar.ArVer >= VER_UE4_TEXTURE_SOURCE_ART_REFACTOR)
 		Ar << cooked;
 
-	//?? Can all 'Mip.Data.Skip(Ar)' here, but ensure any mip types will be loaded by LoadBulkTexture().
-	//?? Calling Skip() will eliminate extra seeks when interleaving reading of FTexture2DMipMap and
-	//?? bulk data which located in the same uasset, but at different position.
-	//?? To see the problem (performance problem): load data from pak, modify FPakFile, add logging of
-	//?? Seek() and decompression calls. You'll see that loading of big bulk data chinks is interleaved
-	//?? with reading 4-byte ints at different locations.
-	Mip.Data.Serialize(Ar);
+	// Don't load bulk data which is located in the same uasset, but at different position: this
+	// eliminates extra seeks (and decompression of pak blocks) caused by interleaving of reading
+	// FTexture2DMipMap and bulk data. Mips will be loaded on demand by UTexture2D::GetTextureData().
+	Mip.Data.Serialize(Ar, true);
 
 #if BORDERLANDS3
 	if (Ar.Game == GAME_Borderlands3)
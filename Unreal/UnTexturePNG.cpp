@@ -2,6 +2,7 @@
 
 #include "Core.h"
 #include "UnCore.h"
+#include "Profiler.h"
 
 struct PngReadCtx
 {
@@ -193,6 +194,8 @@ void CompressPNG(const unsigned char* pic, int Width, int Height, TArray<byte>&
 {
 	guard(CompressPNG);
 
+	PROFILE_SCOPE("EncodePNG");
+
 	int PixelChannels = /*(RawFormat == ERGBFormat::Gray) ? 1 :*/ 3;
 
 	// Verify alpha channels of texture, see the possibility to drop one
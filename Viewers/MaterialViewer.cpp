@@ -469,7 +469,7 @@ void CMaterialViewer::Draw2D()
 		for (int i = 0; i < MipsArray->Num(); i++)
 		{
 			const FTexture2DMipMap& Mip = (*MipsArray)[i];
-			if (Mip.Data.BulkData)
+			if (Mip.Data.BulkData || Mip.Data.bDeferredLoad)
 			{
 				width = Mip.SizeX;
 				height = Mip.SizeY;